@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// Shared by the benchmarks built into webcpp_bench.
+namespace bench {
+
+	// Mean wall time of one call of f, over iterations calls.
+	template <typename F>
+	double ns_per_op(std::size_t iterations, F&& f) {
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < iterations; ++i) {
+			f();
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+	}
+
+	// HttpResponse serialization against the stream-based baseline.
+	void RunHttpResponseBench(std::size_t iterations);
+
+}
@@ -8,37 +8,40 @@
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <string_view>
+#include <system_error>
 
 namespace tests {
 	int RunBigDecimalTests(bool verbose);
 };
 
+// Value = coefficient * 10^-scale. The coefficient is an unsigned
+// magnitude in base 10^9 limbs, least significant limb first, with no
+// high zero limbs (zero is the empty coefficient and is never negative).
 class BigDecimal {
 public:
+	using limb_t = std::uint32_t;
+	static constexpr limb_t BASE = 1000000000u;
+	static constexpr int BASE_DIGITS = 9;
+
 	BigDecimal() : negative(false), scale(0) {
-		digits.push_back(0);
 	}
 
-	explicit BigDecimal(const std::string& s) {
+	// Surrounding whitespace is ignored; anything else that is not a
+	// decimal number throws std::invalid_argument.
+	explicit BigDecimal(std::string_view s) {
 		parseFromString(s);
 	}
 
-	BigDecimal(long long v) {
-		if (v < 0) {
-			negative = true;
-			v = -v;
-		}
-		else {
-			negative = false;
-		}
-		scale = 0;
-		if (v == 0) {
-			digits = { 0 };
-		}
-		else {
-			std::string tmp = std::to_string(v);
-			digits.clear();
-			for (char c : tmp) digits.push_back(c - '0');
+	BigDecimal(long long v) : negative(v < 0), scale(0) {
+		unsigned long long m = negative ? 0ull - static_cast<unsigned long long>(v)
+			: static_cast<unsigned long long>(v);
+		while (m != 0) {
+			coef.push_back(static_cast<limb_t>(m % BASE));
+			m /= BASE;
 		}
 	}
 
@@ -62,10 +65,20 @@ public:
 		return multiply(a, b);
 	}
 
+	static constexpr int DIVISION_PRECISION = 20;
+
 	friend BigDecimal operator/(const BigDecimal& a, const BigDecimal& b) {
-		return divide(a, b, 20);
+		return divide(a, b, DIVISION_PRECISION);
 	}
 
+	// Quotient truncated toward zero after `precision` fraction digits.
+	// The result carries no trailing zeros, so a quotient that terminates
+	// within `precision` digits is exact and as short as its value
+	// (10 / 4 has scale 1, not 20). Throws std::runtime_error on zero.
+	static BigDecimal divide(const BigDecimal& numerator,
+		const BigDecimal& denominator,
+		int precision);
+
 	BigDecimal operator-() const {
 		BigDecimal r = *this;
 		if (!r.isZero())
@@ -84,50 +97,126 @@ public:
 	}
 
 	bool isZero() const {
-		return digits.size() == 1 && digits[0] == 0;
+		return coef.empty();
 	}
 
 	std::string toString() const {
-		if (isZero()) return "0";
-
-		std::string s;
-
-		if (negative && !isZero())
-			s.push_back('-');
-
-		int n = static_cast<int>(digits.size());
-		int integerDigits = n - scale;
+		std::string s(static_cast<size_t>(std::max(digitCount(), scale)) + 3, '\0');
+		auto res = toChars(s.data(), s.data() + s.size());
+		s.resize(static_cast<size_t>(res.ptr - s.data()));
+		return s;
+	}
 
-		if (integerDigits <= 0) {
-			s += "0.";
-			for (int i = 0; i < -integerDigits; ++i)
-				s.push_back('0');
-			for (int d : digits)
-				s.push_back(static_cast<char>('0' + d));
+	// Writes toString() into [first, last) without allocating. On success
+	// ptr is one past the last character written; if the buffer is too
+	// small ec is value_too_large and ptr is last.
+	std::to_chars_result toChars(char* first, char* last) const {
+		if (isZero()) {
+			if (first == last) return { last, std::errc::value_too_large };
+			*first = '0';
+			return { first + 1, std::errc{} };
 		}
-		else {
-			int idx = 0;
-			for (; idx < integerDigits; ++idx)
-				s.push_back(static_cast<char>('0' + digits[idx]));
-
-			if (scale > 0) {
-				s.push_back('.');
-				for (; idx < n; ++idx)
-					s.push_back(static_cast<char>('0' + digits[idx]));
+
+		// Trailing zeros of the fraction are not printed.
+		int trailing = std::min(trailingZeros(), scale);
+		int digits = digitCount() - trailing;
+		int fraction = scale - trailing;
+
+		size_t len = (negative ? 1u : 0u) + static_cast<size_t>(
+			fraction == 0 ? digits
+			: digits > fraction ? digits + 1
+			: 2 + fraction);
+		if (static_cast<size_t>(last - first) < len)
+			return { last, std::errc::value_too_large };
+
+		// Right to left, least significant digit first.
+		char* p = first + len;
+		int skip = trailing;
+		int written = 0;
+		for (std::uint32_t i = 0; i < coef.size(); ++i) {
+			limb_t v = coef[i];
+			bool top = i + 1 == coef.size();
+			for (int k = 0; k < BASE_DIGITS && (!top || v != 0); ++k) {
+				char c = static_cast<char>('0' + v % 10);
+				v /= 10;
+				if (skip > 0) {
+					--skip;
+					continue;
+				}
+				if (written == fraction && fraction > 0)
+					*--p = '.';
+				*--p = c;
+				++written;
 			}
 		}
+		if (digits <= fraction && fraction > 0) {
+			for (; written < fraction; ++written)
+				*--p = '0';
+			*--p = '.';
+			*--p = '0';
+		}
+		if (negative)
+			*--p = '-';
+		return { first + len, std::errc{} };
+	}
 
-		if (scale > 0) {
-			while (!s.empty() && s.back() == '0')
-				s.pop_back();
-			if (!s.empty() && s.back() == '.')
-				s.pop_back();
+	// Parses the longest prefix of [first, last) of the form
+	// [+-]digits[.digits] or [+-].digits, like std::from_chars: no
+	// whitespace is skipped and `out` is left untouched when no number
+	// starts at first (ec is then invalid_argument).
+	static std::from_chars_result from_chars(const char* first, const char* last, BigDecimal& out) {
+		const char* p = first;
+		bool neg = false;
+		if (p != last && (*p == '+' || *p == '-')) {
+			neg = *p == '-';
+			++p;
+		}
+		const char* digits_begin = p;
+		while (p != last && static_cast<unsigned char>(*p - '0') <= 9) ++p;
+		const char* dot = nullptr;
+		if (p != last && *p == '.') {
+			dot = p++;
+			while (p != last && static_cast<unsigned char>(*p - '0') <= 9) ++p;
 		}
+		if (p - digits_begin - (dot ? 1 : 0) <= 0)
+			return { first, std::errc::invalid_argument };
+
+		out.negative = neg;
+		out.scale = dot ? static_cast<int>(p - dot - 1) : 0;
+		out.coef.clear();
+		out.assignDigits(digits_begin, p, dot);
+		out.normalize();
+		return { p, std::errc{} };
+	}
 
-		if (s == "" || s == "-" || s == "-0")
-			return "0";
+	// True when s (surrounding whitespace allowed) is a number this class
+	// accepts with at most max_digits digits. Builds nothing.
+	static bool isValid(std::string_view s, std::size_t max_digits = static_cast<std::size_t>(-1)) {
+		s = trim(s);
+		size_t i = 0;
+		if (i < s.size() && (s[i] == '+' || s[i] == '-')) ++i;
+		std::size_t digits = 0;
+		bool dot = false;
+		for (; i < s.size(); ++i) {
+			if (s[i] == '.' && !dot) {
+				dot = true;
+			}
+			else if (static_cast<unsigned char>(s[i] - '0') <= 9) {
+				++digits;
+			}
+			else {
+				return false;
+			}
+		}
+		return digits != 0 && digits <= max_digits;
+	}
 
-		return s;
+	// Number of digits in the coefficient (0 for zero).
+	int digitCount() const noexcept {
+		if (coef.empty()) return 0;
+		int n = static_cast<int>(coef.size() - 1) * BASE_DIGITS;
+		for (limb_t v = coef.back(); v != 0; v /= 10) ++n;
+		return n;
 	}
 
 
@@ -177,316 +266,602 @@ public:
 	friend bool operator>=(double a, const BigDecimal& b) { return BigDecimal(a) >= b; }
 
 private:
-	std::vector<int> digits;
-	bool negative;
-	int scale;
+	// Small-buffer limb vector: up to INLINE_LIMBS limbs (36 digits) are
+	// stored in the object, larger coefficients spill to the heap.
+	class Limbs {
+	public:
+		static constexpr std::uint32_t INLINE_LIMBS = 4;
+
+		Limbs() noexcept = default;
+		Limbs(const Limbs& o) { assign(o.data(), o.size_); }
+		Limbs(Limbs&& o) noexcept { steal(o); }
+		Limbs& operator=(const Limbs& o) {
+			if (this != &o) assign(o.data(), o.size_);
+			return *this;
+		}
+		Limbs& operator=(Limbs&& o) noexcept {
+			if (this != &o) {
+				release();
+				steal(o);
+			}
+			return *this;
+		}
+		~Limbs() { release(); }
 
-	void parseFromString(const std::string& str) {
-		digits.clear();
-		negative = false;
-		scale = 0;
+		std::uint32_t size() const noexcept { return size_; }
+		bool empty() const noexcept { return size_ == 0; }
+		limb_t* data() noexcept { return heap_ ? heap_ : inline_; }
+		const limb_t* data() const noexcept { return heap_ ? heap_ : inline_; }
+		limb_t& operator[](std::size_t i) noexcept { return data()[i]; }
+		limb_t operator[](std::size_t i) const noexcept { return data()[i]; }
+		limb_t back() const noexcept { return data()[size_ - 1]; }
 
-		std::string s;
-		size_t start = 0, end = str.size();
-		while (start < end && std::isspace((unsigned char)str[start])) ++start;
-		while (end > start && std::isspace((unsigned char)str[end - 1])) --end;
-		if (start >= end) throw std::invalid_argument("Empty numeric string");
+		void clear() noexcept { size_ = 0; }
 
-		s = str.substr(start, end - start);
+		void reserve(std::uint32_t n) {
+			if (n > capacity_) grow(n);
+		}
 
-		if (s[0] == '+' || s[0] == '-') {
-			negative = (s[0] == '-');
-			s.erase(s.begin());
+		// New limbs are zero.
+		void resize(std::uint32_t n) {
+			reserve(n);
+			if (n > size_)
+				std::memset(data() + size_, 0, (n - size_) * sizeof(limb_t));
+			size_ = n;
 		}
 
-		if (s.empty()) throw std::invalid_argument("Empty numeric string after sign");
+		void push_back(limb_t v) {
+			if (size_ == capacity_) grow(size_ + 1);
+			data()[size_++] = v;
+		}
+
+		// Drops high zero limbs.
+		void trim() noexcept {
+			const limb_t* p = data();
+			while (size_ != 0 && p[size_ - 1] == 0) --size_;
+		}
 
-		size_t dotPos = s.find('.');
-		if (dotPos != std::string::npos) {
-			if (s.find('.', dotPos + 1) != std::string::npos) {
-				throw std::invalid_argument("Multiple decimal points");
+		// Drops the n least significant limbs (a division by BASE^n).
+		void drop_low(std::uint32_t n) noexcept {
+			if (n >= size_) {
+				size_ = 0;
+				return;
 			}
-			scale = static_cast<int>(s.size() - dotPos - 1);
-			s.erase(dotPos, 1);
+			std::memmove(data(), data() + n, (size_ - n) * sizeof(limb_t));
+			size_ -= n;
 		}
 
-		bool hasDigit = false;
-		for (char c : s) {
-			if (c < '0' || c > '9')
-				throw std::invalid_argument("Invalid character in numeric string");
-			digits.push_back(c - '0');
-			hasDigit = true;
+		void assign(const limb_t* p, std::uint32_t n) {
+			size_ = 0;
+			reserve(n);
+			if (n != 0) std::memcpy(data(), p, n * sizeof(limb_t));
+			size_ = n;
 		}
-		if (!hasDigit) throw std::invalid_argument("No digits in numeric string");
 
-		size_t firstNonZero = 0;
-		while (firstNonZero < digits.size() && digits[firstNonZero] == 0)
-			++firstNonZero;
+	private:
+		void grow(std::uint32_t n) {
+			n = std::max(n, capacity_ * 2);
+			limb_t* p = new limb_t[n];
+			if (size_ != 0) std::memcpy(p, data(), size_ * sizeof(limb_t));
+			release();
+			heap_ = p;
+			capacity_ = n;
+		}
 
-		if (firstNonZero == digits.size()) {
-			digits.assign(1, 0);
-			scale = 0;
-			negative = false;
+		void release() noexcept {
+			delete[] heap_;
+			heap_ = nullptr;
+			capacity_ = INLINE_LIMBS;
 		}
-		else if (firstNonZero > 0) {
-			digits.erase(digits.begin(), digits.begin() + (long)firstNonZero);
+
+		void steal(Limbs& o) noexcept {
+			size_ = o.size_;
+			if (o.heap_) {
+				heap_ = o.heap_;
+				capacity_ = o.capacity_;
+				o.heap_ = nullptr;
+				o.capacity_ = INLINE_LIMBS;
+			}
+			else if (size_ != 0) {
+				std::memcpy(inline_, o.inline_, size_ * sizeof(limb_t));
+			}
+			o.size_ = 0;
 		}
+
+		limb_t* heap_ = nullptr;
+		std::uint32_t size_ = 0;
+		std::uint32_t capacity_ = INLINE_LIMBS;
+		limb_t inline_[INLINE_LIMBS];
+	};
+
+	Limbs coef;
+	bool negative;
+	int scale;
+
+	static constexpr limb_t POW10[BASE_DIGITS + 1] = {
+		1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+	};
+
+	static std::string_view trim(std::string_view s) noexcept {
+		size_t start = 0, end = s.size();
+		while (start < end && std::isspace((unsigned char)s[start])) ++start;
+		while (end > start && std::isspace((unsigned char)s[end - 1])) --end;
+		return s.substr(start, end - start);
 	}
 
-	void trimLeadingZeros() {
-		size_t firstNonZero = 0;
-		while (firstNonZero < digits.size() && digits[firstNonZero] == 0)
-			++firstNonZero;
-		if (firstNonZero == digits.size()) {
-			digits.assign(1, 0);
-			scale = 0;
-			negative = false;
-		}
-		else if (firstNonZero > 0) {
-			digits.erase(digits.begin(), digits.begin() + (long)firstNonZero);
+	void parseFromString(std::string_view str) {
+		coef.clear();
+		negative = false;
+		scale = 0;
+
+		str = trim(str);
+		if (str.empty()) throw std::invalid_argument("Empty numeric string");
+
+		const char* last = str.data() + str.size();
+		auto res = from_chars(str.data(), last, *this);
+		if (res.ec != std::errc{} || res.ptr != last)
+			throw std::invalid_argument("Invalid numeric string");
+	}
+
+	// Fills coef from the digits in [first, last), skipping the '.' at
+	// dot (if any), nine per limb from the least significant end.
+	void assignDigits(const char* first, const char* last, const char* dot) {
+		coef.reserve(static_cast<std::uint32_t>((last - first) / BASE_DIGITS + 1));
+		limb_t limb = 0;
+		int filled = 0;
+		for (const char* p = last; p != first;) {
+			--p;
+			if (p == dot) continue;
+			limb += static_cast<limb_t>(*p - '0') * POW10[filled];
+			if (++filled == BASE_DIGITS) {
+				coef.push_back(limb);
+				limb = 0;
+				filled = 0;
+			}
 		}
+		if (filled != 0) coef.push_back(limb);
 	}
 
-	static void alignScales(BigDecimal& a, BigDecimal& b) {
-		if (a.scale == b.scale) return;
-		if (a.scale < b.scale) {
-			int diff = b.scale - a.scale;
-			a.digits.insert(a.digits.end(), diff, 0);
-			a.scale = b.scale;
+	// Trailing decimal zeros of the (non-zero) coefficient.
+	int trailingZeros() const noexcept {
+		int t = 0;
+		for (std::uint32_t i = 0; i < coef.size(); ++i) {
+			limb_t v = coef[i];
+			if (v == 0) {
+				t += BASE_DIGITS;
+				continue;
+			}
+			while (v % 10 == 0) {
+				v /= 10;
+				++t;
+			}
+			break;
 		}
-		else {
-			int diff = a.scale - b.scale;
-			b.digits.insert(b.digits.end(), diff, 0);
-			b.scale = a.scale;
+		return t;
+	}
+
+	// Trims the coefficient; zero becomes the canonical "0" (scale 0,
+	// not negative).
+	void normalize() noexcept {
+		coef.trim();
+		if (coef.empty()) {
+			scale = 0;
+			negative = false;
 		}
 	}
 
-	static int compareAbs(const BigDecimal& a, const BigDecimal& b) {
-		if (a.digits.size() != b.digits.size())
-			return (a.digits.size() < b.digits.size()) ? -1 : 1;
+	// --- magnitude arithmetic ------------------------------------------
 
-		for (size_t i = 0; i < a.digits.size(); ++i) {
-			if (a.digits[i] != b.digits[i])
-				return (a.digits[i] < b.digits[i]) ? -1 : 1;
+	static int compareMag(const Limbs& a, const Limbs& b) noexcept {
+		if (a.size() != b.size())
+			return (a.size() < b.size()) ? -1 : 1;
+		for (std::uint32_t i = a.size(); i-- > 0;) {
+			if (a[i] != b[i])
+				return (a[i] < b[i]) ? -1 : 1;
 		}
 		return 0;
 	}
 
-	static int compare(const BigDecimal& a, const BigDecimal& b) {
-		if (a.negative != b.negative) {
-			if (a.isZero() && b.isZero()) return 0;
-			return a.negative ? -1 : 1;
+	// a = a * m + add; an empty a is treated as zero.
+	static void mulSmall(Limbs& a, limb_t m, limb_t add = 0) {
+		std::uint64_t carry = add;
+		limb_t* p = a.data();
+		for (std::uint32_t i = 0; i < a.size(); ++i) {
+			std::uint64_t t = static_cast<std::uint64_t>(p[i]) * m + carry;
+			p[i] = static_cast<limb_t>(t % BASE);
+			carry = t / BASE;
 		}
-
-		BigDecimal lhs = a;
-		BigDecimal rhs = b;
-
-		alignScales(lhs, rhs);
-
-		lhs.trimLeadingZeros();
-		rhs.trimLeadingZeros();
-
-		int cmp = compareAbs(lhs, rhs);
-		return a.negative ? -cmp : cmp;
+		if (carry != 0) a.push_back(static_cast<limb_t>(carry));
 	}
 
+	// a *= 10^k.
+	static void mulPow10(Limbs& a, int k) {
+		if (a.empty() || k <= 0) return;
+		std::uint32_t whole = static_cast<std::uint32_t>(k / BASE_DIGITS);
+		if (whole != 0) {
+			std::uint32_t n = a.size();
+			a.resize(n + whole);
+			limb_t* p = a.data();
+			std::memmove(p + whole, p, n * sizeof(limb_t));
+			std::memset(p, 0, whole * sizeof(limb_t));
+		}
+		if (k % BASE_DIGITS != 0)
+			mulSmall(a, POW10[k % BASE_DIGITS]);
+	}
 
-	static BigDecimal fromDouble(double v) {
-		if (std::isnan(v) || std::isinf(v))
-			throw std::invalid_argument("Cannot convert NaN or Inf to BigDecimal");
+	// a += b.
+	static void addMag(Limbs& a, const Limbs& b) {
+		std::uint32_t nb = b.size();
+		if (a.size() < nb) a.resize(nb);
+		limb_t* p = a.data();
+		const limb_t* q = b.data();
+		limb_t carry = 0;
+		std::uint32_t i = 0;
+		for (; i < nb; ++i) {
+			limb_t s = p[i] + q[i] + carry;
+			carry = s >= BASE;
+			p[i] = carry ? s - BASE : s;
+		}
+		for (; carry && i < a.size(); ++i) {
+			limb_t s = p[i] + 1;
+			carry = s >= BASE;
+			p[i] = carry ? 0 : s;
+		}
+		if (carry) a.push_back(1);
+	}
 
-		std::ostringstream oss;
-		oss.setf(std::ios::fixed);
-		oss << std::setprecision(15) << v;
-		return BigDecimal(oss.str());
+	// a -= b, requires |a| >= |b|.
+	static void subMag(Limbs& a, const Limbs& b) noexcept {
+		limb_t* p = a.data();
+		const limb_t* q = b.data();
+		limb_t borrow = 0;
+		std::uint32_t i = 0;
+		for (; i < b.size(); ++i) {
+			limb_t sub = q[i] + borrow;
+			borrow = p[i] < sub;
+			p[i] = borrow ? p[i] + BASE - sub : p[i] - sub;
+		}
+		for (; borrow && i < a.size(); ++i) {
+			borrow = p[i] == 0;
+			p[i] = borrow ? BASE - 1 : p[i] - 1;
+		}
+		a.trim();
 	}
 
-	static void padLeft(std::vector<int>& a, std::vector<int>& b) {
-		if (a.size() < b.size()) {
-			a.insert(a.begin(), b.size() - a.size(), 0);
+	// a = b - a, requires |b| > |a|.
+	static void subMagReversed(Limbs& a, const Limbs& b) {
+		std::uint32_t na = a.size();
+		a.resize(b.size());
+		limb_t* p = a.data();
+		const limb_t* q = b.data();
+		limb_t borrow = 0;
+		for (std::uint32_t i = 0; i < b.size(); ++i) {
+			limb_t sub = (i < na ? p[i] : 0) + borrow;
+			borrow = q[i] < sub;
+			p[i] = borrow ? q[i] + BASE - sub : q[i] - sub;
 		}
-		else if (b.size() < a.size()) {
-			b.insert(b.begin(), a.size() - b.size(), 0);
+		a.trim();
+	}
+
+	// out = a * b; out must not alias a or b.
+	static void mulMag(const Limbs& a, const Limbs& b, Limbs& out) {
+		std::uint32_t na = a.size(), nb = b.size();
+		out.clear();
+		out.resize(na + nb);
+		limb_t* r = out.data();
+		const limb_t* p = a.data();
+		const limb_t* q = b.data();
+		for (std::uint32_t i = 0; i < na; ++i) {
+			std::uint64_t carry = 0;
+			std::uint64_t ai = p[i];
+			for (std::uint32_t j = 0; j < nb; ++j) {
+				std::uint64_t t = ai * q[j] + r[i + j] + carry;
+				r[i + j] = static_cast<limb_t>(t % BASE);
+				carry = t / BASE;
+			}
+			r[i + nb] = static_cast<limb_t>(carry);
 		}
+		out.trim();
 	}
 
-	static std::vector<int> addVectors(const std::vector<int>& a, const std::vector<int>& b) {
-		std::vector<int> ra = a;
-		std::vector<int> rb = b;
-		padLeft(ra, rb);
+	// Division by a fixed single limb through a precomputed 64-bit
+	// reciprocal: one multiply-high plus at most two corrections instead
+	// of a hardware divide per limb.
+	struct Reciprocal {
+		std::uint64_t d;
+		std::uint64_t inv;
 
-		int n = (int)ra.size();
-		std::vector<int> res(n);
-		int carry = 0;
+		explicit Reciprocal(limb_t divisor) noexcept
+			: d(divisor), inv(~std::uint64_t{ 0 } / divisor) {
+		}
 
-		for (int i = n - 1; i >= 0; --i) {
-			int sum = ra[i] + rb[i] + carry;
-			res[i] = sum % 10;
-			carry = sum / 10;
+		std::uint64_t divmod(std::uint64_t n, std::uint64_t& rem) const noexcept {
+			std::uint64_t q = mulhi(n, inv);
+			std::uint64_t r = n - q * d;
+			while (r >= d) {
+				++q;
+				r -= d;
+			}
+			rem = r;
+			return q;
 		}
-		if (carry) res.insert(res.begin(), carry);
-		return res;
+
+		static std::uint64_t mulhi(std::uint64_t a, std::uint64_t b) noexcept {
+#if defined(__SIZEOF_INT128__)
+			return static_cast<std::uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			return __umulh(a, b);
+#else
+			std::uint64_t a_lo = a & 0xFFFFFFFFu, a_hi = a >> 32;
+			std::uint64_t b_lo = b & 0xFFFFFFFFu, b_hi = b >> 32;
+			std::uint64_t lo = a_lo * b_lo;
+			std::uint64_t mid1 = a_hi * b_lo + (lo >> 32);
+			std::uint64_t mid2 = a_lo * b_hi + (mid1 & 0xFFFFFFFFu);
+			return a_hi * b_hi + (mid1 >> 32) + (mid2 >> 32);
+#endif
+		}
+	};
+
+	// a /= d in place; returns the remainder.
+	static limb_t divSmall(Limbs& a, limb_t d) noexcept {
+		Reciprocal rec(d);
+		std::uint64_t rem = 0;
+		limb_t* p = a.data();
+		for (std::uint32_t i = a.size(); i-- > 0;) {
+			p[i] = static_cast<limb_t>(rec.divmod(rem * BASE + p[i], rem));
+		}
+		a.trim();
+		return static_cast<limb_t>(rem);
 	}
 
-	static std::vector<int> subtractVectors(const std::vector<int>& a, const std::vector<int>& b) {
-		std::vector<int> ra = a;
-		std::vector<int> rb = b;
-		padLeft(ra, rb);
+	// a /= 10^k, truncating.
+	static void divPow10(Limbs& a, int k) noexcept {
+		if (k <= 0) return;
+		a.drop_low(static_cast<std::uint32_t>(k / BASE_DIGITS));
+		if (k % BASE_DIGITS != 0)
+			divSmall(a, POW10[k % BASE_DIGITS]);
+		a.trim();
+	}
 
-		int n = (int)ra.size();
-		std::vector<int> res(n);
-		int borrow = 0;
+	// q = floor(u / v) for a divisor of two or more limbs: Knuth's
+	// algorithm D in base 10^9. Both operands are scaled so the top
+	// divisor limb is at least BASE / 2, which keeps each estimated
+	// quotient limb at most two above the true one.
+	static void divKnuth(const Limbs& u_in, const Limbs& v_in, Limbs& q) {
+		q.clear();
+		if (compareMag(u_in, v_in) < 0) return;
+
+		const std::uint32_t n = v_in.size();
+		const std::uint32_t m = u_in.size() - n;
+
+		const limb_t f = BASE / (v_in.back() + 1);
+		Limbs u = u_in;
+		Limbs v = v_in;
+		std::uint32_t un = u.size();
+		if (f != 1) {
+			mulSmall(u, f);
+			mulSmall(v, f);
+		}
+		if (u.size() == un) u.push_back(0);
+
+		q.resize(m + 1);
+		limb_t* up = u.data();
+		const limb_t* vp = v.data();
+		const std::uint64_t vtop = vp[n - 1];
+		const std::uint64_t vnext = vp[n - 2];
+		const Reciprocal top(vp[n - 1]);
+
+		for (std::uint32_t j = m + 1; j-- > 0;) {
+			std::uint64_t rhat;
+			std::uint64_t qhat = top.divmod(static_cast<std::uint64_t>(up[j + n]) * BASE + up[j + n - 1], rhat);
+			while (qhat >= BASE || qhat * vnext > rhat * BASE + up[j + n - 2]) {
+				--qhat;
+				rhat += vtop;
+				if (rhat >= BASE) break;
+			}
 
-		for (int i = n - 1; i >= 0; --i) {
-			int diff = ra[i] - rb[i] - borrow;
-			if (diff < 0) {
-				diff += 10;
-				borrow = 1;
+			// u[j..j+n] -= qhat * v
+			std::uint64_t carry = 0;
+			limb_t borrow = 0;
+			for (std::uint32_t i = 0; i < n; ++i) {
+				std::uint64_t prod = qhat * vp[i] + carry;
+				carry = prod / BASE;
+				limb_t sub = static_cast<limb_t>(prod % BASE) + borrow;
+				borrow = up[i + j] < sub;
+				up[i + j] = borrow ? up[i + j] + BASE - sub : up[i + j] - sub;
+			}
+			std::uint64_t sub = carry + borrow;
+			if (up[j + n] >= sub) {
+				up[j + n] = static_cast<limb_t>(up[j + n] - sub);
 			}
 			else {
-				borrow = 0;
+				// qhat was one too large: add v back.
+				--qhat;
+				limb_t c = 0;
+				for (std::uint32_t i = 0; i < n; ++i) {
+					limb_t sum = up[i + j] + vp[i] + c;
+					c = sum >= BASE;
+					up[i + j] = c ? sum - BASE : sum;
+				}
+				up[j + n] = static_cast<limb_t>(up[j + n] + BASE + c - sub);
 			}
-			res[i] = diff;
+			q[j] = static_cast<limb_t>(qhat);
 		}
+		q.trim();
+	}
 
-		size_t firstNonZero = 0;
-		while (firstNonZero + 1 < res.size() && res[firstNonZero] == 0)
-			++firstNonZero;
-		if (firstNonZero > 0)
-			res.erase(res.begin(), res.begin() + (long)firstNonZero);
+	// Strips trailing zero fraction digits without changing the value.
+	void reduceScale() noexcept {
+		if (coef.empty()) return;
+		std::uint32_t whole = 0;
+		while (scale - static_cast<int>(whole) * BASE_DIGITS >= BASE_DIGITS && coef[whole] == 0)
+			++whole;
+		if (whole != 0) {
+			coef.drop_low(whole);
+			scale -= static_cast<int>(whole) * BASE_DIGITS;
+		}
 
-		return res;
+		int k = 0;
+		limb_t low = coef[0];
+		if (low == 0) {
+			k = scale;
+		}
+		else {
+			while (k < scale && low % 10 == 0) {
+				low /= 10;
+				++k;
+			}
+		}
+		if (k != 0) {
+			divSmall(coef, POW10[k]);
+			scale -= k;
+		}
+	}
+
+	static int compare(const BigDecimal& a, const BigDecimal& b) {
+		if (a.negative != b.negative) {
+			if (a.isZero() && b.isZero()) return 0;
+			return a.negative ? -1 : 1;
+		}
+
+		int cmp;
+		if (a.scale == b.scale) {
+			cmp = compareMag(a.coef, b.coef);
+		}
+		else if (a.scale < b.scale) {
+			Limbs lhs = a.coef;
+			mulPow10(lhs, b.scale - a.scale);
+			cmp = compareMag(lhs, b.coef);
+		}
+		else {
+			Limbs rhs = b.coef;
+			mulPow10(rhs, a.scale - b.scale);
+			cmp = compareMag(a.coef, rhs);
+		}
+		return a.negative ? -cmp : cmp;
+	}
+
+
+	static BigDecimal fromDouble(double v) {
+		if (std::isnan(v) || std::isinf(v))
+			throw std::invalid_argument("Cannot convert NaN or Inf to BigDecimal");
+
+		// Same text as fixed << setprecision(15): DBL_MAX has 309 integer
+		// digits, plus sign, point and 15 fraction digits.
+		char buf[400];
+		auto printed = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed, 15);
+		BigDecimal out;
+		from_chars(buf, printed.ptr, out);
+		return out;
 	}
 
 	void addOrSubtract(const BigDecimal& other, bool isAddition) {
-		BigDecimal lhs = *this;
-		BigDecimal rhs = other;
-		alignScales(lhs, rhs);
+		bool otherNegative = isAddition ? other.negative : !other.negative;
+		if (other.isZero()) return;
+		if (isZero()) {
+			coef = other.coef;
+			scale = other.scale;
+			negative = otherNegative;
+			return;
+		}
 
-		if (!isAddition) rhs.negative = !rhs.negative;
+		Limbs scaled;
+		const Limbs* rhs = &other.coef;
+		if (scale < other.scale) {
+			mulPow10(coef, other.scale - scale);
+			scale = other.scale;
+		}
+		else if (other.scale < scale) {
+			scaled = other.coef;
+			mulPow10(scaled, scale - other.scale);
+			rhs = &scaled;
+		}
 
-		if (lhs.negative == rhs.negative) {
-			digits = addVectors(lhs.digits, rhs.digits);
-			negative = lhs.negative;
-			scale = lhs.scale;
+		if (negative == otherNegative) {
+			addMag(coef, *rhs);
 		}
 		else {
-			int cmp = compareAbs(lhs, rhs);
+			int cmp = compareMag(coef, *rhs);
 			if (cmp == 0) {
-				digits.assign(1, 0);
-				scale = 0;
-				negative = false;
+				coef.clear();
 			}
 			else if (cmp > 0) {
-				digits = subtractVectors(lhs.digits, rhs.digits);
-				negative = lhs.negative;
-				scale = lhs.scale;
+				subMag(coef, *rhs);
 			}
 			else {
-				digits = subtractVectors(rhs.digits, lhs.digits);
-				negative = rhs.negative;
-				scale = lhs.scale;
+				subMagReversed(coef, *rhs);
+				negative = otherNegative;
 			}
 		}
 
-		trimLeadingZeros();
+		normalize();
 	}
 
 	static BigDecimal multiply(const BigDecimal& a, const BigDecimal& b) {
+		BigDecimal res;
 		if (a.isZero() || b.isZero())
-			return BigDecimal("0");
+			return res;
 
-		BigDecimal res;
 		res.negative = (a.negative != b.negative);
 		res.scale = a.scale + b.scale;
-
-		int n = (int)a.digits.size();
-		int m = (int)b.digits.size();
-		std::vector<int> tmp(n + m, 0);
-
-		for (int i = n - 1; i >= 0; --i) {
-			int carry = 0;
-			for (int j = m - 1; j >= 0; --j) {
-				int idx = i + j + 1;
-				int prod = a.digits[i] * b.digits[j] + tmp[idx] + carry;
-				tmp[idx] = prod % 10;
-				carry = prod / 10;
-			}
-			tmp[i] += carry;
-		}
-
-		size_t firstNonZero = 0;
-		while (firstNonZero + 1 < tmp.size() && tmp[firstNonZero] == 0)
-			++firstNonZero;
-		if (firstNonZero > 0)
-			tmp.erase(tmp.begin(), tmp.begin() + (long)firstNonZero);
-
-		res.digits = std::move(tmp);
-
-		if (res.isZero()) {
-			res.negative = false;
-			res.scale = 0;
-		}
+		mulMag(a.coef, b.coef, res.coef);
+		res.normalize();
 		return res;
 	}
+};
 
-	static BigDecimal divide(const BigDecimal& numerator,
-		const BigDecimal& denominator,
-		int precision) {
-		if (denominator.isZero())
-			throw std::runtime_error("Division by zero");
-
-		BigDecimal a = numerator;
-		BigDecimal b = denominator;
-
-		alignScales(a, b);
+inline BigDecimal BigDecimal::divide(const BigDecimal& numerator,
+	const BigDecimal& denominator,
+	int precision) {
+	if (denominator.isZero())
+		throw std::runtime_error("Division by zero");
 
-		int totalScale = a.scale - b.scale;
-		a.scale = 0;
-		b.scale = 0;
+	BigDecimal res;
+	if (numerator.isZero())
+		return res;
 
-		if (precision > 0) {
-			a.digits.insert(a.digits.end(), precision, 0);
-			totalScale += precision;
+	precision = std::max(precision, 0);
+	res.negative = (numerator.negative != denominator.negative);
+	res.scale = precision;
+
+	const Limbs& b = denominator.coef;
+
+	// Halving is exact as x * 5 / 10: one O(n) pass, no division unless
+	// the extra digit runs past `precision`.
+	if (b.size() == 1 && b[0] == 2 && denominator.scale == 0) {
+		res.coef = numerator.coef;
+		mulSmall(res.coef, 5);
+		res.scale = numerator.scale + 1;
+		if (res.scale > precision) {
+			divPow10(res.coef, res.scale - precision);
+			res.scale = precision;
 		}
-
-		a.negative = false;
-		b.negative = false;
-
-		BigDecimal current("0");
-		BigDecimal res;
-		res.digits.clear();
-		res.negative = (numerator.negative != denominator.negative);
-		res.scale = totalScale;
-
-		for (size_t i = 0; i < a.digits.size(); ++i) {
-			if (!current.isZero()) {
-				current.digits.push_back(a.digits[i]);
-			}
-			else {
-				current.digits[0] = a.digits[i];
-			}
-			current.trimLeadingZeros();
-			current.scale = 0;
-
-			int qDigit = 0;
-			for (int d = 9; d >= 1; --d) {
-				BigDecimal t = b * BigDecimal((long long)d);
-				if (compareAbs(t, current) <= 0) {
-					qDigit = d;
-					current = current - t;
-					break;
-				}
-			}
-			res.digits.push_back(qDigit);
+	}
+	else {
+		// floor(|n| / |d| * 10^precision) with both sides made integral.
+		int shift = precision + denominator.scale - numerator.scale;
+		Limbs a = numerator.coef;
+		Limbs scaledB;
+		const Limbs* divisor = &b;
+		if (shift >= 0) {
+			mulPow10(a, shift);
+		}
+		else {
+			scaledB = b;
+			mulPow10(scaledB, -shift);
+			divisor = &scaledB;
 		}
 
-		res.trimLeadingZeros();
-		if (res.isZero()) {
-			res.scale = 0;
-			res.negative = false;
+		if (divisor->size() == 1) {
+			divSmall(a, (*divisor)[0]);
+			res.coef = std::move(a);
+		}
+		else {
+			divKnuth(a, *divisor, res.coef);
 		}
-		return res;
 	}
-};
 
+	res.normalize();
+	res.reduceScale();
+	return res;
+}
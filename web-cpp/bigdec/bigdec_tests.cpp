@@ -1,4 +1,5 @@
 	#include "bigdec.hpp"
+#include "lab/math.hpp"
 
 #include <iostream>
 #include <string>
@@ -7,6 +8,11 @@
 #include <cmath>
 #include <cstdlib>
 #include <stdexcept>
+#include <sstream>
+#include <iomanip>
+#include <string_view>
+#include <system_error>
+#include <vector>
 
 namespace tests
 {
@@ -157,6 +163,34 @@ namespace tests
 		std::cout << "  OK\n";
 	}
 
+	void test_limb_boundaries() {
+		std::cout << "test_limb_boundaries...\n";
+
+		CHECK_STR((BigDecimal("999999999") + BigDecimal("1")).toString(), "1000000000");
+		CHECK_STR((BigDecimal("1000000000000000000") - BigDecimal("1")).toString(), "999999999999999999");
+		CHECK_STR((BigDecimal("1000000000") * BigDecimal("1000000000")).toString(), "1000000000000000000");
+		CHECK_STR(
+			(BigDecimal("99999999999999999999999999999999999999.5") + BigDecimal("0.5")).toString(),
+			"100000000000000000000000000000000000000"
+		);
+		CHECK_STR(
+			(BigDecimal("1000000000000000000000000000000000000000") - BigDecimal("0.000000001")).toString(),
+			"999999999999999999999999999999999999999.999999999"
+		);
+		CHECK_STR(
+			(BigDecimal("123456789012345678901234567890") * BigDecimal("-987654321098765432109876543210")).toString(),
+			"-121932631137021795226185032733622923332237463801111263526900"
+		);
+		CHECK_STR((BigDecimal("1") / BigDecimal("3")).toString(), "0.33333333333333333333");
+		CHECK_STR(BigDecimal(-9223372036854775807LL - 1).toString(), "-9223372036854775808");
+
+		// Zero operands keep their scale out of the result.
+		CHECK_STR((BigDecimal("0.000") - BigDecimal("0.00033")).toString(), "-0.00033");
+		CHECK_STR((BigDecimal("0.5") - BigDecimal("-0.0")).toString(), "0.5");
+
+		std::cout << "  OK\n";
+	}
+
 	void test_multiplication() {
 		std::cout << "test_multiplication...\n";
 
@@ -178,6 +212,66 @@ namespace tests
 		std::cout << "  OK\n";
 	}
 
+	void test_views_and_buffers() {
+		std::cout << "test_views_and_buffers...\n";
+
+		// string_view input need not be NUL-terminated.
+		std::string_view text = "x=-12.500;";
+		CHECK_STR(BigDecimal(text.substr(2, 7)).toString(), "-12.5");
+
+		{
+			BigDecimal v(7ll);
+			const char in[] = "+3.25e7";
+			auto res = BigDecimal::from_chars(in, in + sizeof(in) - 1, v);
+			CHECK_BOOL(res.ec == std::errc{} && res.ptr == in + 5, "from_chars stops at the first non-number byte");
+			CHECK_STR(v.toString(), "3.25");
+
+			const char bad[] = "-.x";
+			res = BigDecimal::from_chars(bad, bad + 3, v);
+			CHECK_BOOL(res.ec == std::errc::invalid_argument && res.ptr == bad, "from_chars rejects a bare sign and point");
+			CHECK_STR(v.toString(), "3.25");
+		}
+
+		{
+			char buf[32];
+			const char* values[] = { "0", "-0.00123", "1000", "123456789012345678.9", "-5", "0.5" };
+			for (const char* in : values) {
+				BigDecimal v(in);
+				auto res = v.toChars(buf, buf + sizeof(buf));
+				CHECK_BOOL(res.ec == std::errc{}, std::string("toChars fits ") + in);
+				CHECK_STR(std::string(buf, res.ptr), v.toString());
+			}
+			auto res = BigDecimal("-0.00123").toChars(buf, buf + 7);
+			CHECK_BOOL(res.ec == std::errc::value_too_large && res.ptr == buf + 7, "toChars reports a short buffer");
+		}
+
+		{
+			double values[] = { 0.1, -2.25, 1e-20, 123456.789, -1e300, 5e-324 };
+			for (double d : values) {
+				std::ostringstream oss;
+				oss.setf(std::ios::fixed);
+				oss << std::setprecision(15) << d;
+				CHECK_STR(BigDecimal(d).toString(), BigDecimal(oss.str()).toString());
+			}
+		}
+
+		CHECK_BOOL(BigDecimal::isValid(" -1.5 "), "isValid accepts what the constructor accepts");
+		CHECK_BOOL(!BigDecimal::isValid("1.5.") && !BigDecimal::isValid("+") && !BigDecimal::isValid(""), "isValid rejects malformed input");
+		CHECK_BOOL(BigDecimal::isValid("123.45", 5) && !BigDecimal::isValid("123.456", 5), "isValid enforces max_digits");
+
+		HitChecker::Limits limits;
+		limits.max_digits = 8;
+		limits.r_min = BigDecimal("1");
+		limits.r_max = BigDecimal("5");
+		CHECK_BOOL(HitChecker::validate("0.5", "-1", "4.5", limits), "validate accepts a dot in range");
+		CHECK_BOOL(!HitChecker::validate("0.5", "-1", "5.01", limits), "validate enforces r_max");
+		CHECK_BOOL(!HitChecker::validate("0.5", "-1", "0.99", limits), "validate enforces r_min");
+		CHECK_BOOL(!HitChecker::validate("0.123456789", "-1", "2", limits), "validate enforces max_digits");
+		CHECK_BOOL(!HitChecker::validate("0.5", "1e3", "2", limits), "validate rejects malformed input");
+
+		std::cout << "  OK\n";
+	}
+
 	void test_division_basic() {
 		std::cout << "test_division_basic...\n";
 
@@ -211,6 +305,44 @@ namespace tests
 		std::cout << "  OK\n";
 	}
 
+	void test_division_engine() {
+		std::cout << "test_division_engine...\n";
+
+		// Halving and other terminating quotients come back exact.
+		CHECK_STR((BigDecimal("3") / BigDecimal(2ll)).toString(), "1.5");
+		CHECK_STR((BigDecimal("-0.0000000000000000001") / BigDecimal(2ll)).toString(), "-0.00000000000000000005");
+		CHECK_STR((BigDecimal("0.00000000000000000001") / BigDecimal(2ll)).toString(), "0");
+		CHECK_STR((BigDecimal("10") / BigDecimal("4")).toString(), "2.5");
+		CHECK_STR((BigDecimal("7.5") / BigDecimal("0.25")).toString(), "30");
+
+		// Multi-limb divisors.
+		CHECK_STR(
+			(BigDecimal("121932631137021795226185032733622923332237463801111263526900.5") /
+				BigDecimal("987654321098765432109876543210")).toString(),
+			"123456789012345678901234567890"
+		);
+		CHECK_STR(
+			(BigDecimal("10000000000000000000000000000000000000000") / BigDecimal("-99999999999999999999")).toString(),
+			"-100000000000000000001.00000000000000000001"
+		);
+
+		// Explicit precision truncates toward zero.
+		CHECK_STR(BigDecimal::divide(BigDecimal("2"), BigDecimal("3"), 5).toString(), "0.66666");
+		CHECK_STR(BigDecimal::divide(BigDecimal("-2"), BigDecimal("3"), 0).toString(), "0");
+		CHECK_STR(BigDecimal::divide(BigDecimal("-7"), BigDecimal("2"), 0).toString(), "-3");
+
+		bool thrown = false;
+		try {
+			(void)(BigDecimal("1") / BigDecimal("0.000"));
+		}
+		catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		CHECK_BOOL(thrown, "Division by zero throws");
+
+		std::cout << "  OK\n";
+	}
+
 	void test_chained_ops() {
 		std::cout << "test_chained_ops...\n";
 
@@ -543,6 +675,119 @@ namespace tests
 	}
 
 
+	void test_hit_checker_tiers(unsigned int seed, int numTests) {
+		std::cout << "test_hit_checker_tiers... (seed=" << seed
+			<< ", N=" << numTests << ")\n";
+
+		// Boundary points, values that need 128-bit squares, and inputs
+		// too long for the fixed-point tiers.
+		const char* cases[][3] = {
+			{ "1.5", "0", "3" }, { "1.5000001", "0", "3" }, { "0", "1.5", "-3" },
+			{ "1.0606601717798212", "1.0606601717798212", "3" },
+			{ "-3", "1.5", "3" }, { "-3.0000000001", "1.5", "3" },
+			{ "-1.5", "0", "3" }, { "-1", "-1", "3" }, { "-1", "-1.0000000001", "3" },
+			{ "0", "0", "0" }, { "0", "0", "-0.000" },
+			{ "300000000000", "400000000000", "1000000000000" },
+			{ "300000000000", "400000000001", "1000000000000" },
+			{ "0.000000000000000001", "0", "0.000000000000000003" },
+			{ "0.0000000000000000000001", "0", "0.0000000000000000000003" },
+			{ "123456789012345678901234567890", "1", "246913578024691357802469135780" },
+		};
+		for (const auto& c : cases) {
+			HitChecker hc;
+			bool fast = hc.hit_check(c[0], c[1], c[2]);
+			bool ref = hc.hit_check_bigdec(c[0], c[1], c[2]);
+			CHECK_BOOL(fast == ref, std::string("hit_check tiers disagree on ") + c[0] + ", " + c[1] + ", " + c[2]);
+		}
+
+		bool thrown = false;
+		try {
+			(void)HitChecker().hit_check("1..5", "0", "3");
+		}
+		catch (const std::invalid_argument&) {
+			thrown = true;
+		}
+		CHECK_BOOL(thrown, "hit_check rejects malformed input");
+
+		std::mt19937 rng(seed);
+		for (int i = 0; i < numTests; ++i) {
+			std::string x = randomDecimalString(rng);
+			std::string y = randomDecimalString(rng);
+			std::string r = randomDecimalString(rng);
+			HitChecker hc;
+			if (hc.hit_check(x, y, r) != hc.hit_check_bigdec(x, y, r))
+				fail("hit_check tiers disagree on " + x + ", " + y + ", " + r);
+		}
+
+		std::cout << "  OK\n";
+	}
+
+
+	void test_hit_check_batch(unsigned int seed, int numTests) {
+		std::cout << "test_hit_check_batch... (seed=" << seed
+			<< ", N=" << numTests << ", kernel=" << hit_simd::kernel_name() << ")\n";
+
+		std::mt19937 rng(seed);
+		std::vector<std::string> xs, ys, rs;
+		for (int i = 0; i < numTests; ++i) {
+			xs.push_back(randomDecimalString(rng));
+			ys.push_back(randomDecimalString(rng));
+			rs.push_back(randomDecimalString(rng));
+		}
+		// Lane boundaries and points that leave the 32-bit lanes.
+		const char* extra[][3] = {
+			{ "1.5", "0", "3" }, { "-3", "1.5", "3" }, { "-1", "-1", "3" }, { "0", "0", "0" },
+			{ "268435455", "0", "536870911" }, { "-536870911", "268435455", "536870911" },
+			{ "300000000000", "400000000000", "1000000000000" },
+			{ "0.0000000000000000000001", "0", "0.0000000000000000000003" },
+		};
+		for (const auto& e : extra) {
+			xs.push_back(e[0]);
+			ys.push_back(e[1]);
+			rs.push_back(e[2]);
+		}
+
+		std::vector<HitChecker::Point> points;
+		for (size_t i = 0; i < xs.size(); ++i)
+			points.push_back({ xs[i], ys[i], rs[i] });
+
+		std::vector<std::uint8_t> hits;
+		HitChecker hc;
+		hc.hit_check_batch(points, hits);
+		CHECK_BOOL(hits.size() == points.size(), "hit_check_batch result size");
+		for (size_t i = 0; i < points.size(); ++i) {
+			if ((hits[i] != 0) != hc.hit_check(xs[i], ys[i], rs[i]))
+				fail("hit_check_batch disagrees on " + xs[i] + ", " + ys[i] + ", " + rs[i]);
+		}
+
+		std::vector<std::int32_t> lx, ly, lr;
+		std::uniform_int_distribution<std::int32_t> coord(-hit_simd::SMALL_LIMIT + 1, hit_simd::SMALL_LIMIT - 1);
+		std::uniform_int_distribution<std::int32_t> radius(1, hit_simd::SMALL_LIMIT - 1);
+		for (int i = 0; i < numTests; ++i) {
+			std::int32_t r = radius(rng);
+			lr.push_back(r);
+			lx.push_back(i % 2 ? coord(rng) : coord(rng) % (r + 1));
+			ly.push_back(i % 3 ? coord(rng) : coord(rng) % (r + 1));
+		}
+		std::vector<std::uint8_t> simd(lr.size()), ref(lr.size());
+		hit_simd::check_small(lx.data(), ly.data(), lr.data(), simd.data(), lr.size());
+		hit_simd::scalar::check_small(lx.data(), ly.data(), lr.data(), ref.data(), lr.size());
+		CHECK_BOOL(simd == ref, "hit_simd kernel matches the scalar kernel");
+
+		bool thrown = false;
+		try {
+			std::vector<HitChecker::Point> bad = { { "1", "1", "2" }, { "1", "x", "2" } };
+			hc.hit_check_batch(bad, hits);
+		}
+		catch (const std::invalid_argument&) {
+			thrown = true;
+		}
+		CHECK_BOOL(thrown, "hit_check_batch rejects malformed input");
+
+		std::cout << "  OK\n";
+	}
+
+
 	int RunBigDecimalTests(bool verbose) {
 		g_verbose = verbose;
 		unsigned int seed = 123456u;
@@ -551,14 +796,19 @@ namespace tests
 		try {
 			test_parsing_and_toString();
 			test_invalid_input();
+			test_views_and_buffers();
 			test_addition_subtraction();
 			test_multiplication();
+			test_limb_boundaries();
 			test_division_basic();
+			test_division_engine();
 			test_chained_ops();
 			test_compare();
 
 			random_add_sub_mul_div_tests(seed, numRandomTests);
 			random_compare_tests(seed + 1, numRandomTests);
+			test_hit_checker_tiers(seed + 2, numRandomTests);
+			test_hit_check_batch(seed + 3, numRandomTests);
 		}
 		catch (const std::exception& ex) {
 			std::cerr << "Exception in tests: " << ex.what() << "\n";
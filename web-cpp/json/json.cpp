@@ -57,52 +57,9 @@ JsonValue JsonValue::random(std::mt19937& rng, int depth) {
 }
 
 std::string JsonValue::to_string(const JsonValue& v) {
-	return std::visit([](auto&& arg) -> std::string {
-		using T = std::decay_t<decltype(arg)>;
-		if constexpr (std::is_same_v<T, std::nullptr_t>) {
-			return "null";
-		}
-		else if constexpr (std::is_same_v<T, bool>) {
-			return arg ? "true" : "false";
-		}
-		else if constexpr (std::is_same_v<T, long long>) {  
-			std::ostringstream oss;
-			oss << arg;
-			return oss.str();
-		}
-		else if constexpr (std::is_same_v<T, double>) {
-			std::ostringstream oss;
-			oss << std::setprecision(17) << arg;
-			return oss.str();
-		}
-		else if constexpr (std::is_same_v<T, std::string>) {
-			return JsonValue::escape_string(arg);
-		}
-		else if constexpr (std::is_same_v<T, array>) {
-			std::string out = "[";
-			bool first = true;
-			for (const auto& el : arg) {
-				if (!first) out += ",";
-				first = false;
-				out += JsonValue::to_string(el);
-			}
-			out += "]";
-			return out;
-		}
-		else if constexpr (std::is_same_v<T, object>) {
-			std::string out = "{";
-			bool first = true;
-			for (const auto& kv : arg) {
-				if (!first) out += ",";
-				first = false;
-				out += JsonValue::escape_string(kv.first);
-				out += ":";
-				out += JsonValue::to_string(kv.second);
-			}
-			out += "}";
-			return out;
-		}
-		}, v.value);
+	std::string out;
+	JsonWriter(out).value(v);
+	return out;
 }
 
 void JsonValue::to_string_pretty_impl(const JsonValue& v,
@@ -118,13 +75,11 @@ void JsonValue::to_string_pretty_impl(const JsonValue& v,
 		else if constexpr (std::is_same_v<T, bool>) {
 			out += (arg ? "true" : "false");
 		}
-		else if constexpr (std::is_same_v<T, double>) {
-			std::ostringstream oss;
-			oss << std::setprecision(17) << arg;
-			out += oss.str();
+		else if constexpr (std::is_same_v<T, long long> || std::is_same_v<T, double>) {
+			JsonWriter(out).value(arg);
 		}
 		else if constexpr (std::is_same_v<T, std::string>) {
-			out += JsonValue::escape_string(arg);
+			JsonValue::append_escaped(out, arg);
 		}
 		else if constexpr (std::is_same_v<T, array>) {
 			out += "[";
@@ -151,7 +106,7 @@ void JsonValue::to_string_pretty_impl(const JsonValue& v,
 					if (!first) out += ",\n";
 					first = false;
 					out.append(indent + indent_step, ' ');
-					out += JsonValue::escape_string(kv.first);
+					JsonValue::append_escaped(out, kv.first);
 					out += ": ";
 					JsonValue::to_string_pretty_impl(kv.second, out, indent + indent_step, indent_step);
 				}
@@ -165,9 +120,26 @@ void JsonValue::to_string_pretty_impl(const JsonValue& v,
 
 std::string JsonValue::escape_string(const std::string& s) {
 	std::string out;
-	out.reserve(s.size() + 2);
+	append_escaped(out, s);
+	return out;
+}
+
+void JsonValue::append_escaped(std::string& out, std::string_view s) {
+	static const char hex[] = "0123456789abcdef";
+
+	out.reserve(out.size() + s.size() + 2);
 	out.push_back('"');
-	for (char c : s) {
+
+	const char* p = s.data();
+	const char* end = p + s.size();
+	while (p < end) {
+		// Most strings have nothing to escape: copy whole runs.
+		const char* run_end = json_simd::find_escape(p, end);
+		out.append(p, static_cast<std::size_t>(run_end - p));
+		if (run_end == end) break;
+		p = run_end + 1;
+
+		char c = *run_end;
 		switch (c) {
 		case '"':  out += "\\\""; break;
 		case '\\': out += "\\\\"; break;
@@ -176,20 +148,59 @@ std::string JsonValue::escape_string(const std::string& s) {
 		case '\n': out += "\\n";  break;
 		case '\r': out += "\\r";  break;
 		case '\t': out += "\\t";  break;
-		default:
-			if (static_cast<unsigned char>(c) < 0x20) {
-				std::ostringstream oss;
-				oss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
-					<< static_cast<int>(static_cast<unsigned char>(c));
-				out += oss.str();
-			}
-			else {
-				out.push_back(c);
-			}
+		default: {
+			unsigned char u = static_cast<unsigned char>(c);
+			char esc[] = { '\\', 'u', '0', '0', hex[u >> 4], hex[u & 0x0F] };
+			out.append(esc, sizeof(esc));
+		}
 		}
 	}
 	out.push_back('"');
-	return out;
+}
+
+
+JsonWriter& JsonWriter::value(long long i) {
+	separate();
+	char buf[24];
+	auto res = std::to_chars(buf, buf + sizeof(buf), i);
+	out_.append(buf, res.ptr);
+	comma_ = true;
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(double d) {
+	separate();
+	char buf[32];
+	auto res = std::to_chars(buf, buf + sizeof(buf), d);
+	out_.append(buf, res.ptr);
+	comma_ = true;
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(const JsonValue& v) {
+	std::visit([this](auto&& arg) {
+		using T = std::decay_t<decltype(arg)>;
+		if constexpr (std::is_same_v<T, std::nullptr_t>) {
+			null();
+		}
+		else if constexpr (std::is_same_v<T, JsonValue::array>) {
+			begin_array();
+			for (const auto& el : arg) value(el);
+			end_array();
+		}
+		else if constexpr (std::is_same_v<T, JsonValue::object>) {
+			begin_object();
+			for (const auto& kv : arg) {
+				key(kv.first);
+				value(kv.second);
+			}
+			end_object();
+		}
+		else {
+			value(arg);
+		}
+		}, v.value);
+	return *this;
 }
 
 
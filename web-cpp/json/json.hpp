@@ -1,7 +1,12 @@
 ﻿#pragma once
 
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <deque>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 #include <unordered_map>
@@ -14,11 +19,13 @@
 #include <optional>
 #include <type_traits>
 
+#include "json_simd.hpp"
+
 namespace tests {
 	int RunJsonTests(bool verbose);
 };
 
-enum class JsonType {
+enum class JsonType : std::uint8_t {
 	Null,
 	Bool,
 	Number,
@@ -84,11 +91,79 @@ struct JsonValue {
 	static void to_string_pretty_impl(const JsonValue& v, std::string& out, int indent, int indent_step);
 
 	static std::string escape_string(const std::string& s);
+
+	// Appends s as a quoted, escaped JSON string literal.
+	static void append_escaped(std::string& out, std::string_view s);
+};
+
+// Appends JSON to one caller-provided buffer, so nothing is built per
+// level and no intermediate JsonValue is needed. Commas are inserted
+// automatically; begin/end calls must balance and object members start
+// with key(). Types with `void write_json(JsonWriter&) const` can be
+// passed to value() directly.
+class JsonWriter {
+public:
+	explicit JsonWriter(std::string& out) : out_(out) {}
+
+	JsonWriter& begin_object() { separate(); out_.push_back('{'); comma_ = false; return *this; }
+	JsonWriter& end_object() { out_.push_back('}'); comma_ = true; return *this; }
+	JsonWriter& begin_array() { separate(); out_.push_back('['); comma_ = false; return *this; }
+	JsonWriter& end_array() { out_.push_back(']'); comma_ = true; return *this; }
+
+	JsonWriter& key(std::string_view k) {
+		separate();
+		JsonValue::append_escaped(out_, k);
+		out_.push_back(':');
+		comma_ = false;
+		return *this;
+	}
+
+	JsonWriter& null() { separate(); out_ += "null"; comma_ = true; return *this; }
+	JsonWriter& value(bool b) { separate(); out_ += b ? "true" : "false"; comma_ = true; return *this; }
+	JsonWriter& value(long long i);
+	JsonWriter& value(int i) { return value(static_cast<long long>(i)); }
+	// Shortest representation that parses back to the same double.
+	JsonWriter& value(double d);
+	JsonWriter& value(std::string_view str) { separate(); JsonValue::append_escaped(out_, str); comma_ = true; return *this; }
+	JsonWriter& value(const std::string& str) { return value(std::string_view(str)); }
+	JsonWriter& value(const char* str) { return value(std::string_view(str)); }
+	JsonWriter& value(const JsonValue& v);
+
+	template <typename T>
+	auto value(const T& v) -> decltype(v.write_json(std::declval<JsonWriter&>()), std::declval<JsonWriter&>()) {
+		v.write_json(*this);
+		return *this;
+	}
+
+	template <typename T>
+	JsonWriter& member(std::string_view k, const T& v) {
+		key(k);
+		return value(v);
+	}
+
+	// Pre-serialized JSON, inserted as one value.
+	JsonWriter& raw(std::string_view json) { separate(); out_.append(json); comma_ = true; return *this; }
+
+	// Pre-escaped key including quotes and colon, e.g. "\"x\":".
+	JsonWriter& raw_key(std::string_view quoted) { separate(); out_.append(quoted); comma_ = false; return *this; }
+
+	std::string& buffer() { return out_; }
+
+private:
+	void separate() {
+		if (comma_) out_.push_back(',');
+	}
+
+	std::string& out_;
+	bool comma_ = false; // a value was just completed at this level
 };
 
+class JsonObjectView;
+class JsonReader;
+
 class JsonParser {
 public:
-	explicit JsonParser(const std::string& text) : s(text), pos(0) {}
+	explicit JsonParser(std::string_view text) : s(text), pos(0) {}
 
 	JsonValue parse() {
 		skip_ws();
@@ -100,12 +175,47 @@ public:
 		return v;
 	}
 
+	// SAX mode: one validating pass that reports values to the handler
+	// instead of building a tree. The handler provides
+	//   null(), boolean(bool), integer(long long), floating(double),
+	//   string(std::string_view), key(std::string_view),
+	//   start_object(), end_object(), start_array(), end_array().
+	// Strings without escapes are views into the text; escaped ones are
+	// decoded into a scratch buffer that is only valid during the call.
+	template <typename Handler>
+	void parse_sax(Handler& h) {
+		skip_ws();
+		sax_value(h);
+		skip_ws();
+		if (pos != s.size()) {
+			throw std::runtime_error("Extra characters after valid JSON");
+		}
+	}
+
+	// Checks the whole text, building nothing.
+	void validate() {
+		Skip skip;
+		parse_sax(skip);
+	}
+
+	// Decodes the raw contents of a validated string literal (between the
+	// quotes), appending to out.
+	static void unescape(std::string_view raw, std::string& out);
+
 private:
-	const std::string& s;
+	friend class JsonObjectView;
+	friend class JsonReader;
+
+	std::string_view s;
 	std::size_t pos;
+	std::string scratch_;
+
+	struct Skip {};
 
 	void skip_ws() {
-		while (pos < s.size() && std::isspace(static_cast<unsigned char>(s[pos]))) ++pos;
+		// Between tokens there is usually no whitespace, or one space.
+		if (pos >= s.size() || static_cast<unsigned char>(s[pos]) > ' ') return;
+		pos = static_cast<std::size_t>(json_simd::skip_whitespace(s.data() + pos, s.data() + s.size()) - s.data());
 	}
 
 	char get() {
@@ -122,41 +232,45 @@ private:
 		}
 	}
 
-	JsonValue parse_value() {
-		if (pos >= s.size()) throw std::runtime_error("Unexpected end of input while parsing value");
-		char c = s[pos];
-		switch (c) {
-		case 'n': return parse_null();
-		case 't': return parse_true();
-		case 'f': return parse_false();
-		case '"': return parse_string();
-		case '[': return parse_array();
-		case '{': return parse_object();
-		default:
-			if (c == '-' || (c >= '0' && c <= '9')) {
-				return parse_number();
-			}
-			throw std::runtime_error(std::string("Unexpected character while parsing value: ") + c);
-		}
+	static bool is_hex(char h) {
+		return (h >= '0' && h <= '9') || (h >= 'a' && h <= 'f') || (h >= 'A' && h <= 'F');
 	}
 
-	JsonValue parse_null() {
-		expect("null");
-		return JsonValue(nullptr);
-	}
-
-	JsonValue parse_true() {
-		expect("true");
-		return JsonValue(true);
-	}
+	// Validates the string literal at pos and returns its raw contents.
+	std::string_view scan_string(bool& escaped) {
+		if (get() != '"') throw std::runtime_error("Expected opening quote for string");
+		std::size_t start = pos;
+		escaped = false;
+		while (true) {
+			pos = static_cast<std::size_t>(json_simd::find_quote_or_backslash(s.data() + pos, s.data() + s.size()) - s.data());
+			if (pos >= s.size()) throw std::runtime_error("Unterminated string");
+			char c = s[pos++];
+			if (c == '"') break;
 
-	JsonValue parse_false() {
-		expect("false");
-		return JsonValue(false);
+			// c is a backslash.
+			if (pos >= s.size()) throw std::runtime_error("Unterminated escape sequence");
+			escaped = true;
+			char e = s[pos++];
+			switch (e) {
+			case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+				break;
+			case 'u':
+				if (pos + 4 > s.size()) throw std::runtime_error("Invalid unicode escape");
+				for (int i = 0; i < 4; ++i) {
+					if (!is_hex(s[pos++])) throw std::runtime_error("Invalid unicode escape");
+				}
+				break;
+			default:
+				throw std::runtime_error("Invalid escape character in string");
+			}
+		}
+		return s.substr(start, pos - 1 - start);
 	}
 
-	JsonValue parse_number() {
+	// Validates the number at pos and returns its text.
+	std::string_view scan_number(bool& integral) {
 		std::size_t start = pos;
+		integral = true;
 		if (s[pos] == '-') ++pos;
 		if (pos >= s.size()) throw std::runtime_error("Invalid number");
 		if (s[pos] == '0') {
@@ -169,82 +283,190 @@ private:
 			throw std::runtime_error("Invalid number");
 		}
 		if (pos < s.size() && s[pos] == '.') {
+			integral = false;
 			++pos;
 			if (pos >= s.size() || !std::isdigit(static_cast<unsigned char>(s[pos])))
 				throw std::runtime_error("Invalid number");
 			while (pos < s.size() && std::isdigit(static_cast<unsigned char>(s[pos]))) ++pos;
 		}
 		if (pos < s.size() && (s[pos] == 'e' || s[pos] == 'E')) {
+			integral = false;
 			++pos;
 			if (pos < s.size() && (s[pos] == '+' || s[pos] == '-')) ++pos;
 			if (pos >= s.size() || !std::isdigit(static_cast<unsigned char>(s[pos])))
 				throw std::runtime_error("Invalid number");
 			while (pos < s.size() && std::isdigit(static_cast<unsigned char>(s[pos]))) ++pos;
 		}
+		return s.substr(start, pos - start);
+	}
 
-		std::string num_str = s.substr(start, pos - start);
-		if (num_str.find_first_of(".eE") == std::string::npos) {
-			long long iv = std::strtoll(num_str.c_str(), nullptr, 10);
-			return JsonValue(iv);
+	// Same results as strtoll/strtod, without copying the token.
+	static long long to_integer(std::string_view num) {
+		long long v = 0;
+		auto [ptr, ec] = std::from_chars(num.data(), num.data() + num.size(), v);
+		if (ec == std::errc::result_out_of_range) {
+			return num[0] == '-' ? LLONG_MIN : LLONG_MAX;
 		}
+		return v;
+	}
 
-		double dv = std::strtod(s.c_str() + start, nullptr);
-		return JsonValue(dv);
+	static double to_double(std::string_view num) {
+		double v = 0;
+		auto [ptr, ec] = std::from_chars(num.data(), num.data() + num.size(), v);
+		if (ec == std::errc::result_out_of_range) {
+			return std::strtod(std::string(num).c_str(), nullptr); // +-HUGE_VAL or 0
+		}
+		return v;
 	}
 
+	template <typename Handler>
+	void sax_string(Handler& h, bool is_key) {
+		bool escaped = false;
+		std::string_view raw = scan_string(escaped);
+		if constexpr (!std::is_same_v<Handler, Skip>) {
+			if (escaped) {
+				scratch_.clear();
+				unescape(raw, scratch_);
+				raw = scratch_;
+			}
+			if (is_key) h.key(raw);
+			else h.string(raw);
+		}
+	}
 
-	JsonValue parse_string() {
-		if (get() != '"') throw std::runtime_error("Expected opening quote for string");
-		std::string result;
-		while (true) {
-			if (pos >= s.size()) throw std::runtime_error("Unterminated string");
-			char c = get();
-			if (c == '"') break;
-			if (c == '\\') {
-				if (pos >= s.size()) throw std::runtime_error("Unterminated escape sequence");
-				char e = get();
-				switch (e) {
-				case '"': result.push_back('"'); break;
-				case '\\': result.push_back('\\'); break;
-				case '/': result.push_back('/'); break;
-				case 'b': result.push_back('\b'); break;
-				case 'f': result.push_back('\f'); break;
-				case 'n': result.push_back('\n'); break;
-				case 'r': result.push_back('\r'); break;
-				case 't': result.push_back('\t'); break;
-				case 'u': {
-					if (pos + 4 > s.size()) throw std::runtime_error("Invalid unicode escape");
-					unsigned code = 0;
-					for (int i = 0; i < 4; ++i) {
-						char h = s[pos++];
-						code <<= 4;
-						if (h >= '0' && h <= '9') code |= (h - '0');
-						else if (h >= 'a' && h <= 'f') code |= (h - 'a' + 10);
-						else if (h >= 'A' && h <= 'F') code |= (h - 'A' + 10);
-						else throw std::runtime_error("Invalid unicode escape");
-					}
-					if (code <= 0x7F) {
-						result.push_back(static_cast<char>(code));
-					}
-					else if (code <= 0x7FF) {
-						result.push_back(static_cast<char>(0xC0 | (code >> 6)));
-						result.push_back(static_cast<char>(0x80 | (code & 0x3F)));
-					}
-					else {
-						result.push_back(static_cast<char>(0xE0 | (code >> 12)));
-						result.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
-						result.push_back(static_cast<char>(0x80 | (code & 0x3F)));
-					}
-					break;
-				}
-				default:
-					throw std::runtime_error("Invalid escape character in string");
+	template <typename Handler>
+	void sax_value(Handler& h) {
+		if (pos >= s.size()) throw std::runtime_error("Unexpected end of input while parsing value");
+		char c = s[pos];
+		constexpr bool skip = std::is_same_v<Handler, Skip>;
+		switch (c) {
+		case 'n':
+			expect("null");
+			if constexpr (!skip) h.null();
+			return;
+		case 't':
+			expect("true");
+			if constexpr (!skip) h.boolean(true);
+			return;
+		case 'f':
+			expect("false");
+			if constexpr (!skip) h.boolean(false);
+			return;
+		case '"':
+			sax_string(h, false);
+			return;
+		case '[': {
+			++pos;
+			if constexpr (!skip) h.start_array();
+			skip_ws();
+			if (pos < s.size() && s[pos] == ']') {
+				++pos;
+			}
+			else {
+				while (true) {
+					skip_ws();
+					sax_value(h);
+					skip_ws();
+					if (pos >= s.size()) throw std::runtime_error("Unterminated array");
+					char d = get();
+					if (d == ']') break;
+					if (d != ',') throw std::runtime_error("Expected ',' or ']' in array");
 				}
 			}
+			if constexpr (!skip) h.end_array();
+			return;
+		}
+		case '{': {
+			++pos;
+			if constexpr (!skip) h.start_object();
+			skip_ws();
+			if (pos < s.size() && s[pos] == '}') {
+				++pos;
+			}
 			else {
-				result.push_back(c);
+				while (true) {
+					skip_ws();
+					if (pos >= s.size() || s[pos] != '"') throw std::runtime_error("Expected string key in object");
+					sax_string(h, true);
+					skip_ws();
+					if (get() != ':') throw std::runtime_error("Expected ':' after key in object");
+					skip_ws();
+					sax_value(h);
+					skip_ws();
+					if (pos >= s.size()) throw std::runtime_error("Unterminated object");
+					char d = get();
+					if (d == '}') break;
+					if (d != ',') throw std::runtime_error("Expected ',' or '}' in object");
+				}
 			}
+			if constexpr (!skip) h.end_object();
+			return;
+		}
+		default:
+			if (c == '-' || (c >= '0' && c <= '9')) {
+				bool integral = true;
+				std::string_view num = scan_number(integral);
+				if constexpr (!skip) {
+					if (integral) h.integer(to_integer(num));
+					else h.floating(to_double(num));
+				}
+				return;
+			}
+			throw std::runtime_error(std::string("Unexpected character while parsing value: ") + c);
 		}
+	}
+
+	JsonValue parse_value() {
+		if (pos >= s.size()) throw std::runtime_error("Unexpected end of input while parsing value");
+		char c = s[pos];
+		switch (c) {
+		case 'n': return parse_null();
+		case 't': return parse_true();
+		case 'f': return parse_false();
+		case '"': return parse_string();
+		case '[': return parse_array();
+		case '{': return parse_object();
+		default:
+			if (c == '-' || (c >= '0' && c <= '9')) {
+				return parse_number();
+			}
+			throw std::runtime_error(std::string("Unexpected character while parsing value: ") + c);
+		}
+	}
+
+	JsonValue parse_null() {
+		expect("null");
+		return JsonValue(nullptr);
+	}
+
+	JsonValue parse_true() {
+		expect("true");
+		return JsonValue(true);
+	}
+
+	JsonValue parse_false() {
+		expect("false");
+		return JsonValue(false);
+	}
+
+	JsonValue parse_number() {
+		bool integral = true;
+		std::string_view num = scan_number(integral);
+		if (integral) {
+			return JsonValue(to_integer(num));
+		}
+		return JsonValue(to_double(num));
+	}
+
+	JsonValue parse_string() {
+		bool escaped = false;
+		std::string_view raw = scan_string(escaped);
+		if (!escaped) {
+			return JsonValue(std::string(raw));
+		}
+		std::string result;
+		result.reserve(raw.size());
+		unescape(raw, result);
 		return JsonValue(std::move(result));
 	}
 
@@ -296,33 +518,106 @@ private:
 	}
 };
 
+inline void JsonParser::unescape(std::string_view raw, std::string& out) {
+	for (std::size_t i = 0; i < raw.size(); ++i) {
+		char c = raw[i];
+		if (c != '\\') {
+			// Copy the run up to the next escape in one go.
+			std::size_t next = raw.find('\\', i);
+			if (next == std::string_view::npos) next = raw.size();
+			out.append(raw.data() + i, next - i);
+			i = next - 1;
+			continue;
+		}
+		char e = raw[++i];
+		switch (e) {
+		case '"': out.push_back('"'); break;
+		case '\\': out.push_back('\\'); break;
+		case '/': out.push_back('/'); break;
+		case 'b': out.push_back('\b'); break;
+		case 'f': out.push_back('\f'); break;
+		case 'n': out.push_back('\n'); break;
+		case 'r': out.push_back('\r'); break;
+		case 't': out.push_back('\t'); break;
+		default: { // 'u', hex digits already checked
+			unsigned code = 0;
+			for (int k = 0; k < 4; ++k) {
+				char h = raw[++i];
+				code <<= 4;
+				if (h >= '0' && h <= '9') code |= (h - '0');
+				else if (h >= 'a' && h <= 'f') code |= (h - 'a' + 10);
+				else code |= (h - 'A' + 10);
+			}
+			if (code <= 0x7F) {
+				out.push_back(static_cast<char>(code));
+			}
+			else if (code <= 0x7FF) {
+				out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+				out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+			}
+			else {
+				out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+				out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+			}
+			break;
+		}
+		}
+	}
+}
+
 template<typename T>
 struct always_false : std::false_type {};
 
+// Read access to a JSON object, either over a parsed tree or on demand
+// over the text itself (JsonObjectView::on_demand): the text is validated
+// in one pass that only records where each top-level member lies, and
+// get() decodes just the member asked for. Unescaped strings come back as
+// views into the text, which must outlive the view. As when building the
+// tree, the first of duplicate keys wins.
 class JsonObjectView {
 public:
-	explicit JsonObjectView(const JsonValue& v) : v_(v) {
-		if (!std::holds_alternative<JsonValue::object>(v_.value)) {
+	explicit JsonObjectView(const JsonValue& v) : v_(&v) {
+		if (!std::holds_alternative<JsonValue::object>(v_->value)) {
 			throw std::runtime_error("JsonObjectView: value is not an object");
 		}
 	}
 
+	static JsonObjectView on_demand(std::string_view text) {
+		JsonObjectView view;
+		view.scan(text);
+		return view;
+	}
+
 	bool has(const std::string& key) const {
-		const auto& obj = std::get<JsonValue::object>(v_.value);
+		if (!v_) return find_member(key) != nullptr;
+		const auto& obj = std::get<JsonValue::object>(v_->value);
 		return obj.find(key) != obj.end();
 	}
 
 	const JsonValue& at(const std::string& key) const {
-		const auto& obj = std::get<JsonValue::object>(v_.value);
+		if (!v_) {
+			// Materialized on first use; kept alive as long as the view.
+			std::size_t index = member_index(key);
+			for (const auto& [i, val] : materialized_) {
+				if (i == index) return val;
+			}
+			return materialized_.emplace_back(index, JsonParser(members_[index].value).parse()).second;
+		}
+		const auto& obj = std::get<JsonValue::object>(v_->value);
 		auto it = obj.find(key);
 		if (it == obj.end()) {
-			throw std::runtime_error("JsonObjectView::at: missing key '" + key + "'");
+			throw missing(key);
 		}
 		return it->second;
 	}
 
 	template<typename T>
 	T get(const std::string& key) const {
+		if (!v_) {
+			return get_on_demand<T>(key);
+		}
+
 		const JsonValue& val = at(key);
 
 		if constexpr (std::is_same_v<T, bool>) {
@@ -345,6 +640,11 @@ public:
 				throw std::runtime_error("JsonObjectView::get<string>: wrong type for '" + key + "'");
 			return std::get<std::string>(val.value);
 		}
+		else if constexpr (std::is_same_v<T, std::string_view>) {
+			if (!std::holds_alternative<std::string>(val.value))
+				throw std::runtime_error("JsonObjectView::get<string_view>: wrong type for '" + key + "'");
+			return std::get<std::string>(val.value);
+		}
 		else if constexpr (std::is_same_v<T, JsonValue::array>) {
 			if (!std::holds_alternative<JsonValue::array>(val.value))
 				throw std::runtime_error("JsonObjectView::get<array>: wrong type for '" + key + "'");
@@ -364,14 +664,14 @@ public:
 	}
 
 
+	// Tree mode only.
 	const JsonValue& cJsonVal() const {
-		return this->v_;
+		if (!v_) throw std::logic_error("JsonObjectView::cJsonVal: on-demand view has no tree");
+		return *this->v_;
 	}
 	template<typename T>
 	std::optional<T> get_optional(const std::string& key) const {
-		const auto& obj = std::get<JsonValue::object>(v_.value);
-		auto it = obj.find(key);
-		if (it == obj.end()) {
+		if (!has(key)) {
 			return std::nullopt;
 		}
 		try {
@@ -383,7 +683,157 @@ public:
 	}
 
 private:
-	const JsonValue& v_;
+	// A top-level member of an on-demand object: the raw text of its key
+	// and value. Keys with escapes are decoded into decoded_[decoded_key]
+	// (an index, so copies of the view stay valid).
+	struct Member {
+		std::string_view key;
+		std::string_view value;
+		std::size_t decoded_key = npos;
+	};
+
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	JsonObjectView() = default;
+
+	static std::runtime_error missing(const std::string& key) {
+		return std::runtime_error("JsonObjectView::at: missing key '" + key + "'");
+	}
+
+	void scan(std::string_view text) {
+		JsonParser p(text);
+		p.skip_ws();
+		if (p.pos >= text.size() || text[p.pos] != '{') {
+			p.validate(); // reports malformed input as such
+			throw std::runtime_error("JsonObjectView: value is not an object");
+		}
+		++p.pos;
+		p.skip_ws();
+		if (p.pos < text.size() && text[p.pos] == '}') {
+			++p.pos;
+		}
+		else {
+			while (true) {
+				p.skip_ws();
+				if (p.pos >= text.size() || text[p.pos] != '"') throw std::runtime_error("Expected string key in object");
+				bool escaped = false;
+				Member m;
+				m.key = p.scan_string(escaped);
+				if (escaped) {
+					m.decoded_key = decoded_.size();
+					JsonParser::unescape(m.key, decoded_.emplace_back());
+				}
+				p.skip_ws();
+				if (p.get() != ':') throw std::runtime_error("Expected ':' after key in object");
+				p.skip_ws();
+				std::size_t start = p.pos;
+				JsonParser::Skip skip;
+				p.sax_value(skip);
+				m.value = text.substr(start, p.pos - start);
+				members_.push_back(m);
+				p.skip_ws();
+				if (p.pos >= text.size()) throw std::runtime_error("Unterminated object");
+				char c = p.get();
+				if (c == '}') break;
+				if (c != ',') throw std::runtime_error("Expected ',' or '}' in object");
+			}
+		}
+		p.skip_ws();
+		if (p.pos != text.size()) {
+			throw std::runtime_error("Extra characters after valid JSON");
+		}
+	}
+
+	const Member* find_member(std::string_view key) const {
+		for (const auto& m : members_) {
+			std::string_view k = m.decoded_key == npos ? m.key : std::string_view(decoded_[m.decoded_key]);
+			if (k == key) return &m;
+		}
+		return nullptr;
+	}
+
+	std::size_t member_index(const std::string& key) const {
+		const Member* m = find_member(key);
+		if (!m) throw missing(key);
+		return static_cast<std::size_t>(m - members_.data());
+	}
+
+	std::string_view member_value(const std::string& key) const {
+		return members_[member_index(key)].value;
+	}
+
+	JsonValue parse_member(const std::string& key) const {
+		return JsonParser(member_value(key)).parse();
+	}
+
+	// The value text is already validated, so scanning it cannot fail;
+	// only the type can be wrong.
+	template<typename T>
+	T get_on_demand(const std::string& key) const {
+		std::string_view raw = member_value(key);
+		auto wrong_type = [&key](const char* type) {
+			return std::runtime_error(std::string("JsonObjectView::get<") + type + ">: wrong type for '" + key + "'");
+			};
+
+		if constexpr (std::is_same_v<T, bool>) {
+			if (raw == "true") return true;
+			if (raw == "false") return false;
+			throw wrong_type("bool");
+		}
+		else if constexpr (std::is_same_v<T, double> || std::is_same_v<T, long long>) {
+			constexpr bool want_integer = std::is_same_v<T, long long>;
+			if (raw[0] != '-' && !std::isdigit(static_cast<unsigned char>(raw[0]))) {
+				throw wrong_type(want_integer ? "long long" : "double");
+			}
+			JsonParser p(raw);
+			bool integral = true;
+			std::string_view num = p.scan_number(integral);
+			if (integral != want_integer) {
+				throw wrong_type(want_integer ? "long long" : "double");
+			}
+			if constexpr (want_integer) return JsonParser::to_integer(num);
+			else return JsonParser::to_double(num);
+		}
+		else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+			constexpr bool want_view = std::is_same_v<T, std::string_view>;
+			if (raw[0] != '"') throw wrong_type(want_view ? "string_view" : "string");
+			JsonParser p(raw);
+			bool escaped = false;
+			std::string_view str = p.scan_string(escaped);
+			if (!escaped) return T(str);
+			if constexpr (want_view) {
+				std::string& decoded = decoded_.emplace_back();
+				JsonParser::unescape(str, decoded);
+				return decoded;
+			}
+			else {
+				std::string decoded;
+				JsonParser::unescape(str, decoded);
+				return decoded;
+			}
+		}
+		else if constexpr (std::is_same_v<T, JsonValue::array>) {
+			if (raw[0] != '[') throw wrong_type("array");
+			return std::get<JsonValue::array>(parse_member(key).value);
+		}
+		else if constexpr (std::is_same_v<T, JsonValue::object>) {
+			if (raw[0] != '{') throw wrong_type("object");
+			return std::get<JsonValue::object>(parse_member(key).value);
+		}
+		else if constexpr (std::is_same_v<T, JsonValue>) {
+			return parse_member(key);
+		}
+		else {
+			static_assert(always_false<T>::value, "JsonObjectView::get: unsupported type");
+		}
+	}
+
+	const JsonValue* v_ = nullptr; // null in on-demand mode
+
+	std::vector<Member> members_;
+	// Decoded escaped keys and string_view results; deque keeps them put.
+	mutable std::deque<std::string> decoded_;
+	mutable std::deque<std::pair<std::size_t, JsonValue>> materialized_; // by member index
 };
 
 class JsonObjectViewMut {
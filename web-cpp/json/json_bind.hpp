@@ -0,0 +1,365 @@
+#pragma once
+
+#include "json.hpp"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Compile-time JSON binding for plain structs. Describe the fields once:
+//
+//   template <>
+//   struct JsonFields<Point> {
+//       static constexpr auto fields = std::tuple{
+//           json_field<"x">(&Point::x),
+//           json_field<"label">(&Point::label),
+//       };
+//   };
+//
+// and json_bind::read / json_bind::write parse into and serialize from
+// the struct directly, with no JsonValue in between. Keys are matched by
+// length and a hash computed at compile time; serialized keys are
+// literals escaped at compile time. Members may be std::string, bool,
+// integers, floating point, std::optional, std::vector or other bound
+// structs. std::optional members may be missing or null; every other
+// member is required. Unknown keys are skipped, and the first of
+// duplicate keys wins, as with JsonValue.
+
+template <std::size_t N>
+struct JsonFixedString {
+	char data[N]{};
+
+	constexpr JsonFixedString(const char(&s)[N]) {
+		for (std::size_t i = 0; i < N; ++i) data[i] = s[i];
+	}
+
+	constexpr std::string_view view() const { return std::string_view(data, N - 1); }
+};
+
+constexpr std::uint32_t json_key_hash(std::string_view s) {
+	std::uint32_t h = 2166136261u; // FNV-1a
+	for (char c : s) {
+		h ^= static_cast<unsigned char>(c);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+template <JsonFixedString Name, typename C, typename M>
+struct JsonField {
+	using Class = C;
+	using Member = M;
+
+	M C::* member;
+
+	static constexpr std::string_view name = Name.view();
+	static constexpr std::uint32_t hash = json_key_hash(name);
+
+	static constexpr bool plain_name() {
+		for (char c : name) {
+			if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20) return false;
+		}
+		return true;
+	}
+	static_assert(plain_name(), "JSON field names must not need escaping");
+
+	// "\"name\":"
+	static constexpr std::array<char, Name.view().size() + 3> quoted_storage = [] {
+		std::array<char, Name.view().size() + 3> a{};
+		a[0] = '"';
+		for (std::size_t i = 0; i < name.size(); ++i) a[i + 1] = name[i];
+		a[name.size() + 1] = '"';
+		a[name.size() + 2] = ':';
+		return a;
+		}();
+	static constexpr std::string_view quoted_key = std::string_view(quoted_storage.data(), quoted_storage.size());
+};
+
+template <JsonFixedString Name, typename C, typename M>
+constexpr JsonField<Name, C, M> json_field(M C::* member) {
+	return JsonField<Name, C, M>{ member };
+}
+
+// Specialize with `static constexpr auto fields = std::tuple{ json_field... };`.
+template <typename T>
+struct JsonFields;
+
+template <typename T>
+concept JsonBound = requires { JsonFields<T>::fields; };
+
+// Token-level access to JsonParser for the binding code.
+class JsonReader {
+public:
+	explicit JsonReader(std::string_view text) : p_(text) {}
+
+	void ws() { p_.skip_ws(); }
+
+	char peek() const {
+		if (p_.pos >= p_.s.size()) throw std::runtime_error("Unexpected end of input");
+		return p_.s[p_.pos];
+	}
+
+	bool consume(char c) {
+		if (p_.pos < p_.s.size() && p_.s[p_.pos] == c) {
+			++p_.pos;
+			return true;
+		}
+		return false;
+	}
+
+	char get() { return p_.get(); }
+
+	void literal(const char* text) { p_.expect(text); }
+
+	// Raw string contents; decoded into scratch when escaped.
+	std::string_view string(std::string& scratch) {
+		bool escaped = false;
+		std::string_view raw = p_.scan_string(escaped);
+		if (!escaped) return raw;
+		scratch.clear();
+		JsonParser::unescape(raw, scratch);
+		return scratch;
+	}
+
+	std::string_view number(bool& integral) { return p_.scan_number(integral); }
+
+	static long long to_integer(std::string_view num) { return JsonParser::to_integer(num); }
+	static double to_double(std::string_view num) { return JsonParser::to_double(num); }
+
+	void skip_value() {
+		JsonParser::Skip skip;
+		p_.sax_value(skip);
+	}
+
+	void finish() {
+		p_.skip_ws();
+		if (p_.pos != p_.s.size()) throw std::runtime_error("Extra characters after valid JSON");
+	}
+
+private:
+	JsonParser p_;
+};
+
+namespace json_bind {
+
+	namespace detail {
+
+		template <typename T> struct is_optional : std::false_type {};
+		template <typename U> struct is_optional<std::optional<U>> : std::true_type {};
+
+		template <typename T> struct is_vector : std::false_type {};
+		template <typename U, typename A> struct is_vector<std::vector<U, A>> : std::true_type {};
+
+		[[noreturn]] inline void wrong_type(std::string_view what) {
+			throw std::runtime_error("JSON binding: expected " + std::string(what));
+		}
+
+		template <typename T>
+		void read_object(JsonReader& r, T& out);
+
+		template <typename T>
+		void read_value(JsonReader& r, T& out) {
+			if constexpr (is_optional<T>::value) {
+				if (r.peek() == 'n') {
+					r.literal("null");
+					out.reset();
+				}
+				else {
+					read_value(r, out.emplace());
+				}
+			}
+			else if constexpr (std::is_same_v<T, std::string>) {
+				if (r.peek() != '"') wrong_type("a string");
+				std::string scratch;
+				std::string_view s = r.string(scratch);
+				if (s.data() == scratch.data()) out = std::move(scratch);
+				else out.assign(s);
+			}
+			else if constexpr (std::is_same_v<T, bool>) {
+				char c = r.peek();
+				if (c == 't') { r.literal("true"); out = true; }
+				else if (c == 'f') { r.literal("false"); out = false; }
+				else wrong_type("a bool");
+			}
+			else if constexpr (std::is_integral_v<T>) {
+				char c = r.peek();
+				if (c != '-' && (c < '0' || c > '9')) wrong_type("an integer");
+				bool integral = true;
+				std::string_view num = r.number(integral);
+				if (!integral) wrong_type("an integer");
+				long long v = JsonReader::to_integer(num);
+				if constexpr (!std::is_same_v<T, long long>) {
+					if (v < static_cast<long long>(std::numeric_limits<T>::min()) ||
+						(v > 0 && static_cast<unsigned long long>(v) > static_cast<unsigned long long>(std::numeric_limits<T>::max()))) {
+						wrong_type("an integer in range");
+					}
+				}
+				out = static_cast<T>(v);
+			}
+			else if constexpr (std::is_floating_point_v<T>) {
+				char c = r.peek();
+				if (c != '-' && (c < '0' || c > '9')) wrong_type("a number");
+				bool integral = true;
+				std::string_view num = r.number(integral);
+				out = static_cast<T>(integral ? static_cast<double>(JsonReader::to_integer(num)) : JsonReader::to_double(num));
+			}
+			else if constexpr (is_vector<T>::value) {
+				if (!r.consume('[')) wrong_type("an array");
+				out.clear();
+				r.ws();
+				if (r.consume(']')) return;
+				while (true) {
+					r.ws();
+					read_value(r, out.emplace_back());
+					r.ws();
+					char c = r.get();
+					if (c == ']') break;
+					if (c != ',') throw std::runtime_error("Expected ',' or ']' in array");
+				}
+			}
+			else if constexpr (JsonBound<T>) {
+				read_object(r, out);
+			}
+			else {
+				static_assert(always_false<T>::value, "json_bind: unsupported member type");
+			}
+		}
+
+		template <typename T, std::size_t... I>
+		bool read_field(JsonReader& r, T& out, std::string_view key, std::uint32_t hash,
+			std::uint64_t& seen, std::index_sequence<I...>) {
+			constexpr auto& fields = JsonFields<T>::fields;
+			bool matched = false;
+			auto try_field = [&](auto index) {
+				constexpr std::size_t i = decltype(index)::value;
+				using F = std::remove_cv_t<std::tuple_element_t<i, std::remove_cv_t<std::remove_reference_t<decltype(fields)>>>>;
+				if (matched || key.size() != F::name.size() || hash != F::hash || key != F::name) return;
+				matched = true;
+				if (seen & (std::uint64_t(1) << i)) {
+					r.skip_value(); // duplicate: the first one wins
+					return;
+				}
+				seen |= std::uint64_t(1) << i;
+				read_value(r, out.*(std::get<i>(fields).member));
+				};
+			(try_field(std::integral_constant<std::size_t, I>{}), ...);
+			return matched;
+		}
+
+		template <typename T, std::size_t... I>
+		void check_required(std::uint64_t seen, std::index_sequence<I...>) {
+			constexpr auto& fields = JsonFields<T>::fields;
+			auto check = [&](auto index) {
+				constexpr std::size_t i = decltype(index)::value;
+				using F = std::remove_cv_t<std::tuple_element_t<i, std::remove_cv_t<std::remove_reference_t<decltype(fields)>>>>;
+				if (!is_optional<typename F::Member>::value && !(seen & (std::uint64_t(1) << i))) {
+					throw std::runtime_error("JSON binding: missing field '" + std::string(F::name) + "'");
+				}
+				};
+			(check(std::integral_constant<std::size_t, I>{}), ...);
+		}
+
+		template <typename T>
+		void read_object(JsonReader& r, T& out) {
+			constexpr std::size_t count = std::tuple_size_v<std::remove_cv_t<decltype(JsonFields<T>::fields)>>;
+			static_assert(count <= 64, "json_bind: at most 64 fields per struct");
+			using Indices = std::make_index_sequence<count>;
+
+			if (!r.consume('{')) wrong_type("an object");
+			std::uint64_t seen = 0;
+			std::string scratch;
+			r.ws();
+			if (!r.consume('}')) {
+				while (true) {
+					r.ws();
+					if (r.peek() != '"') throw std::runtime_error("Expected string key in object");
+					std::string_view key = r.string(scratch);
+					r.ws();
+					if (r.get() != ':') throw std::runtime_error("Expected ':' after key in object");
+					r.ws();
+					if (!read_field(r, out, key, json_key_hash(key), seen, Indices{})) {
+						r.skip_value();
+					}
+					r.ws();
+					char c = r.get();
+					if (c == '}') break;
+					if (c != ',') throw std::runtime_error("Expected ',' or '}' in object");
+				}
+			}
+			check_required<T>(seen, Indices{});
+		}
+
+		template <typename T>
+		void write_value(JsonWriter& w, const T& v);
+
+		template <typename T>
+		void write_object(JsonWriter& w, const T& v) {
+			w.begin_object();
+			std::apply([&](const auto&... field) {
+				((w.raw_key(std::remove_cvref_t<decltype(field)>::quoted_key), write_value(w, v.*(field.member))), ...);
+				}, JsonFields<T>::fields);
+			w.end_object();
+		}
+
+		template <typename T>
+		void write_value(JsonWriter& w, const T& v) {
+			if constexpr (is_optional<T>::value) {
+				if (v) write_value(w, *v);
+				else w.null();
+			}
+			else if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, std::string>) {
+				w.value(v);
+			}
+			else if constexpr (std::is_integral_v<T>) {
+				w.value(static_cast<long long>(v));
+			}
+			else if constexpr (std::is_floating_point_v<T>) {
+				w.value(static_cast<double>(v));
+			}
+			else if constexpr (is_vector<T>::value) {
+				w.begin_array();
+				for (const auto& el : v) write_value(w, el);
+				w.end_array();
+			}
+			else if constexpr (JsonBound<T>) {
+				write_object(w, v);
+			}
+			else {
+				static_assert(always_false<T>::value, "json_bind: unsupported member type");
+			}
+		}
+
+	}
+
+	// Parses text (a JSON object) into out. Throws std::runtime_error on
+	// malformed JSON, a missing required field or a wrongly typed value.
+	template <JsonBound T>
+	void read(std::string_view text, T& out) {
+		JsonReader r(text);
+		r.ws();
+		detail::read_object(r, out);
+		r.finish();
+	}
+
+	template <JsonBound T>
+	void write(JsonWriter& w, const T& v) {
+		detail::write_object(w, v);
+	}
+
+	template <JsonBound T>
+	std::string to_string(const T& v) {
+		std::string out;
+		JsonWriter w(out);
+		write(w, v);
+		return out;
+	}
+
+}
@@ -0,0 +1,193 @@
+#include "json_document.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+// SAX handler that appends nodes; open containers are patched with their
+// member count and end index when they close.
+class JsonDocument::Builder {
+public:
+	explicit Builder(JsonDocument& doc) : doc_(doc) {}
+
+	void null() { push(JsonType::Null); }
+	void boolean(bool b) { push(JsonType::Bool).boolean = b; }
+	void integer(long long i) { push(JsonType::Number).integer = i; }
+	void floating(double d) {
+		Node& n = push(JsonType::Number);
+		n.is_double = true;
+		n.real = d;
+	}
+	void string(std::string_view s) { push_string(s, true); }
+	void key(std::string_view s) { push_string(s, false); }
+
+	void start_object() { open(JsonType::Object); }
+	void end_object() { close(); }
+	void start_array() { open(JsonType::Array); }
+	void end_array() { close(); }
+
+private:
+	Node& push(JsonType type, bool counts = true) {
+		if (counts && !open_.empty()) {
+			Node& parent = doc_.nodes_[open_.back()];
+			// Object members are counted at their key.
+			if (parent.type == JsonType::Array) ++parent.count;
+		}
+		if (doc_.nodes_.size() >= std::numeric_limits<std::uint32_t>::max()) {
+			throw std::runtime_error("JSON document too large");
+		}
+		Node& n = doc_.nodes_.emplace_back();
+		n.type = type;
+		return n;
+	}
+
+	void push_string(std::string_view s, bool is_value) {
+		if (!is_value) ++doc_.nodes_[open_.back()].count;
+		if (doc_.strings_.size() + s.size() > std::numeric_limits<std::uint32_t>::max()) {
+			throw std::runtime_error("JSON document too large");
+		}
+		Node& n = push(JsonType::String, is_value);
+		n.str.offset = static_cast<std::uint32_t>(doc_.strings_.size());
+		n.str.length = static_cast<std::uint32_t>(s.size());
+		doc_.strings_.append(s);
+	}
+
+	void open(JsonType type) {
+		push(type);
+		open_.push_back(static_cast<std::uint32_t>(doc_.nodes_.size() - 1));
+	}
+
+	void close() {
+		doc_.nodes_[open_.back()].end = static_cast<std::uint32_t>(doc_.nodes_.size());
+		open_.pop_back();
+	}
+
+	JsonDocument& doc_;
+	std::vector<std::uint32_t> open_;
+};
+
+JsonDocument JsonDocument::parse(std::string_view text) {
+	JsonDocument doc;
+	// Decoded strings never outgrow the text, so the arena is allocated
+	// once; the node count is a guess the vector grows from.
+	doc.nodes_.reserve(text.size() / 8 + 1);
+	doc.strings_.reserve(text.size());
+
+	Builder builder(doc);
+	JsonParser(text).parse_sax(builder);
+	return doc;
+}
+
+bool JsonDocument::Ref::as_bool() const {
+	if (type() != JsonType::Bool) throw std::runtime_error("JsonDocument: value is not a bool");
+	return node().boolean;
+}
+
+long long JsonDocument::Ref::as_integer() const {
+	if (!is_integer()) throw std::runtime_error("JsonDocument: value is not an integer");
+	return node().integer;
+}
+
+double JsonDocument::Ref::as_double() const {
+	if (type() != JsonType::Number) throw std::runtime_error("JsonDocument: value is not a number");
+	return node().is_double ? node().real : static_cast<double>(node().integer);
+}
+
+std::string_view JsonDocument::Ref::as_string() const {
+	if (type() != JsonType::String) throw std::runtime_error("JsonDocument: value is not a string");
+	return doc_->string_at(node());
+}
+
+std::size_t JsonDocument::Ref::size() const {
+	JsonType t = type();
+	return (t == JsonType::Array || t == JsonType::Object) ? node().count : 0;
+}
+
+JsonDocument::Ref JsonDocument::Ref::operator[](std::size_t i) const {
+	if (type() != JsonType::Array) throw std::runtime_error("JsonDocument: value is not an array");
+	if (i >= node().count) throw std::runtime_error("JsonDocument: index out of range");
+	std::uint32_t child = index_ + 1;
+	for (; i > 0; --i) child = doc_->next(child);
+	return Ref(doc_, child);
+}
+
+std::optional<JsonDocument::Ref> JsonDocument::Ref::find(std::string_view key) const {
+	if (type() != JsonType::Object) return std::nullopt;
+	for (std::uint32_t k = index_ + 1; k < node().end; k = doc_->next(k + 1)) {
+		if (doc_->string_at(doc_->nodes_[k]) == key) return Ref(doc_, k + 1);
+	}
+	return std::nullopt;
+}
+
+JsonDocument::Ref JsonDocument::Ref::at(std::string_view key) const {
+	auto r = find(key);
+	if (!r) throw std::runtime_error("JsonDocument: missing key '" + std::string(key) + "'");
+	return *r;
+}
+
+JsonDocument::Ref::Iterator JsonDocument::Ref::begin() const {
+	JsonType t = type();
+	if (t != JsonType::Array && t != JsonType::Object) return end();
+	return Iterator(doc_, index_ + 1, t == JsonType::Object);
+}
+
+JsonDocument::Ref::Iterator JsonDocument::Ref::end() const {
+	return Iterator(doc_, doc_->next(index_), type() == JsonType::Object);
+}
+
+JsonDocument::Ref::Iterator::value_type JsonDocument::Ref::Iterator::operator*() const {
+	if (!object_) return { std::string_view{}, Ref(doc_, index_) };
+	return { doc_->string_at(doc_->nodes_[index_]), Ref(doc_, index_ + 1) };
+}
+
+JsonDocument::Ref::Iterator& JsonDocument::Ref::Iterator::operator++() {
+	index_ = object_ ? doc_->next(index_ + 1) : doc_->next(index_);
+	return *this;
+}
+
+JsonValue JsonDocument::Ref::to_value() const {
+	const Node& n = node();
+	switch (n.type) {
+	case JsonType::Null: return JsonValue(nullptr);
+	case JsonType::Bool: return JsonValue(n.boolean);
+	case JsonType::Number: return n.is_double ? JsonValue(n.real) : JsonValue(n.integer);
+	case JsonType::String: return JsonValue(std::string(doc_->string_at(n)));
+	case JsonType::Array: {
+		JsonValue::array arr;
+		arr.reserve(n.count);
+		for (auto [key, child] : *this) arr.push_back(child.to_value());
+		return JsonValue(std::move(arr));
+	}
+	case JsonType::Object:
+	default: {
+		JsonValue::object obj;
+		for (auto [key, child] : *this) obj.emplace(std::string(key), child.to_value());
+		return JsonValue(std::move(obj));
+	}
+	}
+}
+
+void JsonDocument::Ref::write_json(JsonWriter& w) const {
+	const Node& n = node();
+	switch (n.type) {
+	case JsonType::Null: w.null(); break;
+	case JsonType::Bool: w.value(n.boolean); break;
+	case JsonType::Number:
+		if (n.is_double) w.value(n.real);
+		else w.value(n.integer);
+		break;
+	case JsonType::String: w.value(doc_->string_at(n)); break;
+	case JsonType::Array:
+		w.begin_array();
+		for (auto [key, child] : *this) child.write_json(w);
+		w.end_array();
+		break;
+	case JsonType::Object:
+		w.begin_object();
+		for (auto [key, child] : *this) {
+			w.key(key);
+			child.write_json(w);
+		}
+		w.end_object();
+		break;
+	}
+}
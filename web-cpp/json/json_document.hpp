@@ -0,0 +1,140 @@
+#pragma once
+
+#include "json.hpp"
+
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Flat alternative to a JsonValue tree. A parsed document is two
+// contiguous arrays: the nodes in document order, where a container is
+// followed by its children and records where its subtree ends, and one
+// arena holding every key and string (decoded). Parsing appends to those
+// two arrays only, so there is no allocation per node, and traversal
+// walks memory front to back. Objects keep their members in document
+// order and are searched linearly, which for the small objects of a
+// request beats hashing; the first of duplicate keys wins, as with
+// JsonValue.
+class JsonDocument {
+	struct Node;
+
+public:
+	// Throws std::runtime_error on malformed input, like JsonParser.
+	static JsonDocument parse(std::string_view text);
+
+	// Cheap handle to one value; valid while the document is.
+	class Ref {
+	public:
+		JsonType type() const { return node().type; }
+		bool is_null() const { return type() == JsonType::Null; }
+		bool is_integer() const { return type() == JsonType::Number && !node().is_double; }
+
+		// Throw std::runtime_error on a type mismatch. as_double accepts
+		// integers too.
+		bool as_bool() const;
+		long long as_integer() const;
+		double as_double() const;
+		std::string_view as_string() const;
+
+		// Elements of an array, members of an object, 0 otherwise.
+		std::size_t size() const;
+
+		// Linear in i; use the iterators to walk a whole array.
+		Ref operator[](std::size_t i) const;
+
+		std::optional<Ref> find(std::string_view key) const;
+		Ref at(std::string_view key) const;
+
+		// Children of an array, or (key, value) pairs of an object.
+		class Iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = std::pair<std::string_view, Ref>;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = value_type;
+
+			// key is empty for array elements.
+			value_type operator*() const;
+			Iterator& operator++();
+			bool operator==(const Iterator& other) const { return index_ == other.index_; }
+			bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+		private:
+			friend class Ref;
+			Iterator(const JsonDocument* doc, std::uint32_t index, bool object)
+				: doc_(doc), index_(index), object_(object) {}
+
+			const JsonDocument* doc_;
+			std::uint32_t index_;
+			bool object_;
+		};
+
+		Iterator begin() const;
+		Iterator end() const;
+
+		// Materializes this value as a tree.
+		JsonValue to_value() const;
+
+		void write_json(JsonWriter& w) const;
+
+	private:
+		friend class JsonDocument;
+		Ref(const JsonDocument* doc, std::uint32_t index) : doc_(doc), index_(index) {}
+
+		const Node& node() const { return doc_->nodes_[index_]; }
+
+		const JsonDocument* doc_;
+		std::uint32_t index_;
+	};
+
+	Ref root() const { return Ref(this, 0); }
+
+	void write_json(JsonWriter& w) const { root().write_json(w); }
+
+	std::size_t node_count() const { return nodes_.size(); }
+
+	// Bytes held by the node array and the string arena.
+	std::size_t memory_bytes() const {
+		return nodes_.capacity() * sizeof(Node) + strings_.capacity();
+	}
+
+private:
+	struct Node {
+		JsonType type = JsonType::Null;
+		bool is_double = false; // Number
+		bool boolean = false;   // Bool
+		std::uint32_t count = 0; // Array elements / Object members
+		union {
+			long long integer;
+			double real;
+			struct {
+				std::uint32_t offset;
+				std::uint32_t length;
+			} str;           // String and keys, into strings_
+			std::uint32_t end; // Array/Object: index past the subtree
+		};
+
+		Node() : integer(0) {}
+	};
+	static_assert(sizeof(Node) == 16, "keep nodes at 16 bytes");
+
+	class Builder;
+
+	// Index of the node after the subtree rooted at i.
+	std::uint32_t next(std::uint32_t i) const {
+		const Node& n = nodes_[i];
+		return (n.type == JsonType::Array || n.type == JsonType::Object) ? n.end : i + 1;
+	}
+
+	std::string_view string_at(const Node& n) const {
+		return std::string_view(strings_).substr(n.str.offset, n.str.length);
+	}
+
+	std::vector<Node> nodes_;
+	std::string strings_;
+};
@@ -0,0 +1,259 @@
+#include "json_simd.hpp"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define JSON_SIMD_X86 1
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#  define JSON_SIMD_NEON 1
+#  include <arm_neon.h>
+#endif
+
+#if defined(JSON_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#  define JSON_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#  define JSON_SIMD_TARGET_AVX2
+#endif
+
+namespace json_simd {
+
+	namespace scalar {
+
+		inline bool is_ws(unsigned char c) {
+			return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+		}
+
+		const char* skip_whitespace(const char* p, const char* end) {
+			while (p < end && is_ws(static_cast<unsigned char>(*p))) ++p;
+			return p;
+		}
+
+		const char* find_quote_or_backslash(const char* p, const char* end) {
+			while (p < end && *p != '"' && *p != '\\') ++p;
+			return p;
+		}
+
+		const char* find_escape(const char* p, const char* end) {
+			while (p < end) {
+				unsigned char c = static_cast<unsigned char>(*p);
+				if (c == '"' || c == '\\' || c < 0x20) break;
+				++p;
+			}
+			return p;
+		}
+
+	}
+
+	namespace {
+
+#if defined(JSON_SIMD_X86)
+
+		// SSE2 is part of x86-64, so these need no dispatch.
+		namespace sse2 {
+
+			inline unsigned ws_mask(__m128i b) {
+				// \t..\r is one range: (b - 9) <= 4, unsigned.
+				__m128i t = _mm_sub_epi8(b, _mm_set1_epi8('\t'));
+				__m128i range = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(4)), t);
+				__m128i space = _mm_cmpeq_epi8(b, _mm_set1_epi8(' '));
+				return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(range, space)));
+			}
+
+			inline unsigned quote_mask(__m128i b) {
+				__m128i q = _mm_cmpeq_epi8(b, _mm_set1_epi8('"'));
+				__m128i bs = _mm_cmpeq_epi8(b, _mm_set1_epi8('\\'));
+				return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(q, bs)));
+			}
+
+			inline unsigned escape_mask(__m128i b) {
+				__m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(b, _mm_set1_epi8(0x1F)), b);
+				return quote_mask(b) | static_cast<unsigned>(_mm_movemask_epi8(ctl));
+			}
+
+			const char* skip_whitespace(const char* p, const char* end) {
+				for (; end - p >= 16; p += 16) {
+					unsigned m = ~ws_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) & 0xFFFFu;
+					if (m) return p + std::countr_zero(m);
+				}
+				return scalar::skip_whitespace(p, end);
+			}
+
+			const char* find_quote_or_backslash(const char* p, const char* end) {
+				for (; end - p >= 16; p += 16) {
+					unsigned m = quote_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+					if (m) return p + std::countr_zero(m);
+				}
+				return scalar::find_quote_or_backslash(p, end);
+			}
+
+			const char* find_escape(const char* p, const char* end) {
+				for (; end - p >= 16; p += 16) {
+					unsigned m = escape_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+					if (m) return p + std::countr_zero(m);
+				}
+				return scalar::find_escape(p, end);
+			}
+
+		}
+
+		namespace avx2 {
+
+			JSON_SIMD_TARGET_AVX2 inline std::uint32_t ws_mask(__m256i b) {
+				__m256i t = _mm256_sub_epi8(b, _mm256_set1_epi8('\t'));
+				__m256i range = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(4)), t);
+				__m256i space = _mm256_cmpeq_epi8(b, _mm256_set1_epi8(' '));
+				return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(range, space)));
+			}
+
+			JSON_SIMD_TARGET_AVX2 inline std::uint32_t quote_mask(__m256i b) {
+				__m256i q = _mm256_cmpeq_epi8(b, _mm256_set1_epi8('"'));
+				__m256i bs = _mm256_cmpeq_epi8(b, _mm256_set1_epi8('\\'));
+				return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(q, bs)));
+			}
+
+			JSON_SIMD_TARGET_AVX2 inline std::uint32_t escape_mask(__m256i b) {
+				__m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(b, _mm256_set1_epi8(0x1F)), b);
+				return quote_mask(b) | static_cast<std::uint32_t>(_mm256_movemask_epi8(ctl));
+			}
+
+			JSON_SIMD_TARGET_AVX2 const char* skip_whitespace(const char* p, const char* end) {
+				for (; end - p >= 32; p += 32) {
+					std::uint32_t m = ~ws_mask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+					if (m) return p + std::countr_zero(m);
+				}
+				return sse2::skip_whitespace(p, end);
+			}
+
+			JSON_SIMD_TARGET_AVX2 const char* find_quote_or_backslash(const char* p, const char* end) {
+				for (; end - p >= 32; p += 32) {
+					std::uint32_t m = quote_mask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+					if (m) return p + std::countr_zero(m);
+				}
+				return sse2::find_quote_or_backslash(p, end);
+			}
+
+			JSON_SIMD_TARGET_AVX2 const char* find_escape(const char* p, const char* end) {
+				for (; end - p >= 32; p += 32) {
+					std::uint32_t m = escape_mask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+					if (m) return p + std::countr_zero(m);
+				}
+				return sse2::find_escape(p, end);
+			}
+
+		}
+
+		bool cpu_has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+			int regs[4];
+			__cpuid(regs, 0);
+			if (regs[0] < 7) return false;
+			__cpuid(regs, 1);
+			bool osxsave = (regs[2] & (1 << 27)) != 0;
+			bool avx = (regs[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false; // YMM state saved by the OS
+			__cpuidex(regs, 7, 0);
+			return (regs[1] & (1 << 5)) != 0;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		}
+
+#elif defined(JSON_SIMD_NEON)
+
+		namespace neon {
+
+			// NEON has no movemask: narrowing each 16-bit lane by 4 leaves
+			// one nibble per byte, so the first match is ctz / 4.
+			inline std::uint64_t to_mask(uint8x16_t m) {
+				uint8x8_t n = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+				return vget_lane_u64(vreinterpret_u64_u8(n), 0);
+			}
+
+			inline uint8x16_t quote_bytes(uint8x16_t b) {
+				return vorrq_u8(vceqq_u8(b, vdupq_n_u8('"')), vceqq_u8(b, vdupq_n_u8('\\')));
+			}
+
+			const char* skip_whitespace(const char* p, const char* end) {
+				for (; end - p >= 16; p += 16) {
+					uint8x16_t b = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p));
+					uint8x16_t range = vcleq_u8(vsubq_u8(b, vdupq_n_u8('\t')), vdupq_n_u8(4));
+					uint8x16_t ws = vorrq_u8(range, vceqq_u8(b, vdupq_n_u8(' ')));
+					std::uint64_t m = to_mask(vmvnq_u8(ws));
+					if (m) return p + (std::countr_zero(m) >> 2);
+				}
+				return scalar::skip_whitespace(p, end);
+			}
+
+			const char* find_quote_or_backslash(const char* p, const char* end) {
+				for (; end - p >= 16; p += 16) {
+					uint8x16_t b = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p));
+					std::uint64_t m = to_mask(quote_bytes(b));
+					if (m) return p + (std::countr_zero(m) >> 2);
+				}
+				return scalar::find_quote_or_backslash(p, end);
+			}
+
+			const char* find_escape(const char* p, const char* end) {
+				for (; end - p >= 16; p += 16) {
+					uint8x16_t b = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p));
+					uint8x16_t hit = vorrq_u8(quote_bytes(b), vcltq_u8(b, vdupq_n_u8(0x20)));
+					std::uint64_t m = to_mask(hit);
+					if (m) return p + (std::countr_zero(m) >> 2);
+				}
+				return scalar::find_escape(p, end);
+			}
+
+		}
+
+#endif
+
+		struct Kernels {
+			const char* (*skip_whitespace)(const char*, const char*);
+			const char* (*find_quote_or_backslash)(const char*, const char*);
+			const char* (*find_escape)(const char*, const char*);
+			const char* name;
+		};
+
+		Kernels select_kernels() {
+#if defined(JSON_SIMD_X86)
+			if (cpu_has_avx2()) {
+				return { avx2::skip_whitespace, avx2::find_quote_or_backslash, avx2::find_escape, "avx2" };
+			}
+			return { sse2::skip_whitespace, sse2::find_quote_or_backslash, sse2::find_escape, "sse2" };
+#elif defined(JSON_SIMD_NEON)
+			return { neon::skip_whitespace, neon::find_quote_or_backslash, neon::find_escape, "neon" };
+#else
+			return { scalar::skip_whitespace, scalar::find_quote_or_backslash, scalar::find_escape, "scalar" };
+#endif
+		}
+
+		const Kernels& kernels() {
+			static const Kernels k = select_kernels();
+			return k;
+		}
+
+	}
+
+	const char* skip_whitespace(const char* p, const char* end) {
+		return kernels().skip_whitespace(p, end);
+	}
+
+	const char* find_quote_or_backslash(const char* p, const char* end) {
+		return kernels().find_quote_or_backslash(p, end);
+	}
+
+	const char* find_escape(const char* p, const char* end) {
+		return kernels().find_escape(p, end);
+	}
+
+	const char* kernel_name() {
+		return kernels().name;
+	}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+// Byte-classification kernels for the JSON parser and serializer. Each
+// scans [p, end) 16 or 32 bytes at a time and returns a pointer to the
+// first matching byte, or end. The vector width is picked once at run
+// time: AVX2 where the CPU and OS support it, else SSE2 on x86-64, NEON on
+// ARM64, scalar elsewhere.
+namespace json_simd {
+
+	// First byte that is not whitespace in the sense of std::isspace in
+	// the "C" locale (space, \t, \n, \v, \f, \r).
+	const char* skip_whitespace(const char* p, const char* end);
+
+	// First '"' or '\\': the end of the unescaped run inside a string.
+	const char* find_quote_or_backslash(const char* p, const char* end);
+
+	// First byte a JSON string literal must escape: '"', '\\' or a
+	// control character below 0x20.
+	const char* find_escape(const char* p, const char* end);
+
+	// "avx2", "sse2", "neon" or "scalar".
+	const char* kernel_name();
+
+	// The portable kernels, for tests to compare against.
+	namespace scalar {
+		const char* skip_whitespace(const char* p, const char* end);
+		const char* find_quote_or_backslash(const char* p, const char* end);
+		const char* find_escape(const char* p, const char* end);
+	}
+
+}
@@ -1,4 +1,40 @@
 #include "json.hpp"
+#include "json_bind.hpp"
+#include "json_document.hpp"
+
+struct BindInner {
+	std::vector<int> ids;
+	std::optional<double> weight;
+};
+
+struct BindOuter {
+	std::string name;
+	bool active = false;
+	long long count = 0;
+	std::uint8_t small = 0;
+	BindInner inner;
+	std::optional<std::string> note;
+};
+
+template <>
+struct JsonFields<BindInner> {
+	static constexpr auto fields = std::tuple{
+		json_field<"ids">(&BindInner::ids),
+		json_field<"weight">(&BindInner::weight),
+	};
+};
+
+template <>
+struct JsonFields<BindOuter> {
+	static constexpr auto fields = std::tuple{
+		json_field<"name">(&BindOuter::name),
+		json_field<"active">(&BindOuter::active),
+		json_field<"count">(&BindOuter::count),
+		json_field<"small">(&BindOuter::small),
+		json_field<"inner">(&BindOuter::inner),
+		json_field<"note">(&BindOuter::note),
+	};
+};
 
 namespace tests
 {
@@ -59,6 +95,14 @@ namespace tests
 			}
 			catch (const std::exception&) {
 			}
+
+			try {
+				JsonParser(js).validate();
+				std::cerr << "ERROR: Expected validate() failure: \"" << js << "\"\n";
+				all_failed_as_expected = false;
+			}
+			catch (const std::exception&) {
+			}
 		}
 
 		return all_failed_as_expected;
@@ -250,6 +294,336 @@ namespace tests
 	}
 
 
+	bool run_on_demand_tests(std::mt19937& rng) {
+		std::string text = R"({ "x": "1.5", "y" : -2, "r": 3.25e0, "ok": true, "esc\"key": "a\nb\u00e9",
+			"arr": [1, {"k": null}], "obj": {"z": "w"}, "x": "dup" })";
+
+		try {
+			JsonObjectView view = JsonObjectView::on_demand(text);
+
+			std::string_view x = view.get<std::string_view>("x");
+			if (x != "1.5" || x.data() < text.data() || x.data() >= text.data() + text.size()) {
+				std::cerr << "on-demand string is not a view into the text\n";
+				return false;
+			}
+			if (view.get<long long>("y") != -2 || view.get<double>("r") != 3.25 || !view.get<bool>("ok")) {
+				std::cerr << "on-demand scalars decoded wrongly\n";
+				return false;
+			}
+			if (!view.has("esc\"key") || view.get<std::string>("esc\"key") != "a\nb\xC3\xA9") {
+				std::cerr << "on-demand escapes decoded wrongly\n";
+				return false;
+			}
+			if (view.get<JsonValue::array>("arr").size() != 2 ||
+				JsonObjectView(view.at("obj")).get<std::string>("z") != "w") {
+				std::cerr << "on-demand nested values decoded wrongly\n";
+				return false;
+			}
+
+			bool wrong_type_threw = false;
+			try {
+				view.get<double>("y"); // integral, like in the tree
+			}
+			catch (...) {
+				wrong_type_threw = true;
+			}
+			if (!wrong_type_threw || view.get_optional<std::string>("y") || view.get_optional<bool>("missing")) {
+				std::cerr << "on-demand type checks failed\n";
+				return false;
+			}
+		}
+		catch (const std::exception& e) {
+			std::cerr << "on-demand tests threw: " << e.what() << "\n";
+			return false;
+		}
+
+		for (const char* bad : { "[1]", "{\"a\": 1} x", "{\"a\": [1, }", "{ \"a\": \"\\q\" }", "{\"a\" 1}" }) {
+			bool threw = false;
+			try {
+				JsonObjectView::on_demand(bad);
+			}
+			catch (...) {
+				threw = true;
+			}
+			if (!threw) {
+				std::cerr << "on-demand view accepted: " << bad << "\n";
+				return false;
+			}
+		}
+
+		// Same answers as the tree for random objects.
+		for (int i = 0; i < 200; ++i) {
+			JsonValue::object obj;
+			std::uniform_int_distribution<int> count(0, 6);
+			for (int k = count(rng); k > 0; --k) {
+				obj["k" + std::to_string(k)] = random_json(rng, 1);
+			}
+			JsonValue tree(obj);
+			std::string json = to_string(tree);
+			try {
+				JsonParser(json).validate();
+				JsonObjectView view = JsonObjectView::on_demand(json);
+				for (const auto& [key, val] : obj) {
+					if (!(view.get<JsonValue>(key) == val)) {
+						std::cerr << "on-demand mismatch for '" << key << "' in " << json << "\n";
+						return false;
+					}
+				}
+			}
+			catch (const std::exception& e) {
+				std::cerr << "on-demand threw: " << e.what() << " for " << json << "\n";
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+
+	// The dispatched kernels against the scalar ones, at every offset and
+	// length around the vector widths, on inputs dense in edge bytes.
+	bool run_simd_kernel_tests(std::mt19937& rng) {
+		const char alphabet[] = { ' ', '\t', '\n', '\v', '\f', '\r', '\x08', '\x1F', '\x20', '\x7F',
+			'"', '\\', 'a', '{', '\x80', '\xFF', '\x00', '\x0E' };
+		std::uniform_int_distribution<std::size_t> pick(0, sizeof(alphabet) - 1);
+		std::uniform_int_distribution<int> ws_pick(0, 5);
+
+		for (int round = 0; round < 300; ++round) {
+			std::string buf(80, ' ');
+			for (char& c : buf) c = alphabet[pick(rng)];
+			// Mostly whitespace (or mostly plain text) with rare hits, so
+			// the kernels run past whole vectors before matching.
+			std::string ws(80, ' ');
+			std::string text(80, 'x');
+			for (std::size_t i = 0; i < 80; ++i) {
+				ws[i] = alphabet[ws_pick(rng)];
+			}
+			std::size_t hit = rng() % 80;
+			ws[hit] = 'x';
+			text[hit] = alphabet[pick(rng)];
+
+			for (const std::string* in : { &buf, &ws, &text }) {
+				for (std::size_t off = 0; off < 4; ++off) {
+					for (std::size_t len = 0; off + len <= in->size(); ++len) {
+						const char* p = in->data() + off;
+						const char* e = p + len;
+						if (json_simd::skip_whitespace(p, e) != json_simd::scalar::skip_whitespace(p, e) ||
+							json_simd::find_quote_or_backslash(p, e) != json_simd::scalar::find_quote_or_backslash(p, e) ||
+							json_simd::find_escape(p, e) != json_simd::scalar::find_escape(p, e)) {
+							std::cerr << "SIMD kernel (" << json_simd::kernel_name() << ") mismatch at offset "
+								<< off << ", length " << len << "\n";
+							return false;
+						}
+					}
+				}
+			}
+			if (json_simd::scalar::skip_whitespace(ws.data(), ws.data() + ws.size()) != ws.data() + hit) {
+				std::cerr << "scalar whitespace kernel stopped at the wrong byte\n";
+				return false;
+			}
+		}
+
+		std::string long_str(1000, 'a');
+		long_str[500] = '\n';
+		long_str[700] = '"';
+		std::string escaped = JsonValue::escape_string(long_str);
+		if (escaped.size() != long_str.size() + 2 + 2 || escaped.find("\\n") != 501 || escaped.find("\\\"") != 702) {
+			std::cerr << "escape_string copied runs wrongly\n";
+			return false;
+		}
+		if (JsonValue::escape_string(std::string("\x01", 1)) != "\"\\u0001\"") {
+			std::cerr << "escape_string control character wrong\n";
+			return false;
+		}
+		return true;
+	}
+
+
+	struct WriterPoint {
+		long long x;
+		double y;
+
+		void write_json(JsonWriter& w) const {
+			w.begin_object().member("x", x).member("y", y).end_object();
+		}
+	};
+
+	bool run_writer_tests() {
+		std::string out = "prefix:";
+		JsonWriter w(out);
+		w.begin_object()
+			.member("a", 1)
+			.member("b", 0.1)
+			.member("s", "q\"\n")
+			.key("arr").begin_array().value(true).null().begin_array().end_array().value(WriterPoint{ -3, 2.5 }).end_array()
+			.key("empty").begin_object().end_object()
+			.member("big", 1e300)
+			.end_object();
+
+		const std::string expected =
+			"prefix:{\"a\":1,\"b\":0.1,\"s\":\"q\\\"\\n\",\"arr\":[true,null,[],{\"x\":-3,\"y\":2.5}],\"empty\":{},\"big\":1e+300}";
+		if (out != expected) {
+			std::cerr << "JsonWriter wrote " << out << "\n";
+			return false;
+		}
+
+		// Shortest round-trip doubles.
+		std::mt19937_64 rng(12345);
+		std::uniform_real_distribution<double> dist(-1e9, 1e9);
+		for (int i = 0; i < 1000; ++i) {
+			double d = dist(rng) / 7.0;
+			std::string num;
+			JsonWriter(num).value(d);
+			JsonValue parsed = JsonParser(num).parse();
+			if (!std::holds_alternative<double>(parsed.value) || std::get<double>(parsed.value) != d || num.size() > 24) {
+				std::cerr << "JsonWriter double did not round-trip: " << num << "\n";
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	bool run_document_tests(std::mt19937& rng) {
+		try {
+			JsonDocument doc = JsonDocument::parse(
+				R"({"b": [1, 2.5, "sé", [], {}], "a": {"k": null, "k": true}, "e": "", "n": -7})");
+			JsonDocument::Ref root = doc.root();
+
+			std::string keys;
+			for (auto [key, value] : root) keys += std::string(key) + ";";
+			if (keys != "b;a;e;n;" || root.size() != 4) {
+				std::cerr << "JsonDocument member order wrong: " << keys << "\n";
+				return false;
+			}
+
+			JsonDocument::Ref b = root.at("b");
+			if (b.size() != 5 || b[0].as_integer() != 1 || b[1].as_double() != 2.5 ||
+				b[2].as_string() != "s\xC3\xA9" || b[3].size() != 0 || b[4].type() != JsonType::Object) {
+				std::cerr << "JsonDocument array access wrong\n";
+				return false;
+			}
+			JsonDocument::Ref a = root.at("a");
+			if (!a.at("k").is_null() || a.size() != 2 || root.at("e").as_string() != "" ||
+				root.at("n").as_double() != -7.0 || root.find("missing")) {
+				std::cerr << "JsonDocument object access wrong\n";
+				return false;
+			}
+
+			bool threw = false;
+			try {
+				root.at("n").as_string();
+			}
+			catch (const std::runtime_error&) {
+				threw = true;
+			}
+			if (!threw) {
+				std::cerr << "JsonDocument type mismatch did not throw\n";
+				return false;
+			}
+		}
+		catch (const std::exception& e) {
+			std::cerr << "JsonDocument tests threw: " << e.what() << "\n";
+			return false;
+		}
+
+		// Same values as the tree parser, and the same output when written.
+		for (int i = 0; i < 300; ++i) {
+			JsonValue original = random_json(rng);
+			std::string json = to_string(original);
+			try {
+				JsonDocument doc = JsonDocument::parse(json);
+				std::string written;
+				JsonWriter(written).value(doc);
+				if (!(doc.root().to_value() == original) || !(JsonParser(written).parse() == original)) {
+					std::cerr << "JsonDocument mismatch for " << json << "\n";
+					return false;
+				}
+			}
+			catch (const std::exception& e) {
+				std::cerr << "JsonDocument threw: " << e.what() << " for " << json << "\n";
+				return false;
+			}
+		}
+
+		for (const char* bad : { "", "[1,]", "{\"a\" 1}", "[1] 2" }) {
+			bool threw = false;
+			try {
+				JsonDocument::parse(bad);
+			}
+			catch (const std::runtime_error&) {
+				threw = true;
+			}
+			if (!threw) {
+				std::cerr << "JsonDocument accepted: " << bad << "\n";
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	bool run_bind_tests() {
+		try {
+			BindOuter v;
+			json_bind::read(R"( {"extra": [1, {"a": null}], "name": "né", "active": true, "count": -12,
+				"small": 200, "inner": {"ids": [1, 2, 3]}, "name": "second" } )", v);
+			if (v.name != "n\xC3\xA9" || !v.active || v.count != -12 || v.small != 200 ||
+				v.inner.ids.size() != 3 || v.inner.weight || v.note) {
+				std::cerr << "json_bind::read filled wrong values\n";
+				return false;
+			}
+
+			v.inner.weight = 0.5;
+			v.note = "q\"";
+			std::string out = json_bind::to_string(v);
+			const std::string expected =
+				"{\"name\":\"n\xC3\xA9\",\"active\":true,\"count\":-12,\"small\":200,"
+				"\"inner\":{\"ids\":[1,2,3],\"weight\":0.5},\"note\":\"q\\\"\"}";
+			if (out != expected) {
+				std::cerr << "json_bind::write wrote " << out << "\n";
+				return false;
+			}
+
+			BindOuter back;
+			json_bind::read(out, back);
+			if (json_bind::to_string(back) != out) {
+				std::cerr << "json_bind round trip failed\n";
+				return false;
+			}
+		}
+		catch (const std::exception& e) {
+			std::cerr << "json_bind tests threw: " << e.what() << "\n";
+			return false;
+		}
+
+		const char* bad[] = {
+			R"({"name": "x", "active": true, "count": 1, "small": 1})",                  // inner missing
+			R"({"name": 1, "active": true, "count": 1, "small": 1, "inner": {"ids": []}})",
+			R"({"name": "x", "active": true, "count": 1.5, "small": 1, "inner": {"ids": []}})",
+			R"({"name": "x", "active": true, "count": 1, "small": 256, "inner": {"ids": []}})",
+			R"({"name": "x", "active": true, "count": 1, "small": 1, "inner": {"ids": []}} x)",
+			R"({"name": "x", "active": true, "count": 1, "small": 1, "inner": {"ids": [1,]}})",
+			R"([1])",
+		};
+		for (const char* js : bad) {
+			BindOuter v;
+			bool threw = false;
+			try {
+				json_bind::read(js, v);
+			}
+			catch (const std::runtime_error&) {
+				threw = true;
+			}
+			if (!threw) {
+				std::cerr << "json_bind::read accepted: " << js << "\n";
+				return false;
+			}
+		}
+		return true;
+	}
+
+
 	int RunJsonTests(bool verbose) {
 		std::random_device rd;
 		std::mt19937 rng(rd());
@@ -288,6 +662,46 @@ namespace tests
 			std::cout << "All JsonObjectViewMut tests passed.\n";
 		}
 
+		if (!run_on_demand_tests(rng)) {
+			std::cerr << "On-demand JSON tests failed.\n";
+			++failures;
+		}
+		else {
+			std::cout << "All on-demand JSON tests passed.\n";
+		}
+
+		if (!run_simd_kernel_tests(rng)) {
+			std::cerr << "SIMD kernel tests failed.\n";
+			++failures;
+		}
+		else {
+			std::cout << "All SIMD kernel tests passed (" << json_simd::kernel_name() << ").\n";
+		}
+
+		if (!run_writer_tests()) {
+			std::cerr << "JsonWriter tests failed.\n";
+			++failures;
+		}
+		else {
+			std::cout << "All JsonWriter tests passed.\n";
+		}
+
+		if (!run_document_tests(rng)) {
+			std::cerr << "JsonDocument tests failed.\n";
+			++failures;
+		}
+		else {
+			std::cout << "All JsonDocument tests passed.\n";
+		}
+
+		if (!run_bind_tests()) {
+			std::cerr << "JSON binding tests failed.\n";
+			++failures;
+		}
+		else {
+			std::cout << "All JSON binding tests passed.\n";
+		}
+
 		const int NUM_TESTS = 1000;
 		int random_failures = 0;
 		for (int i = 0; i < NUM_TESTS; ++i) {
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tests {
+	int RunDbPoolTests(bool verbose);
+};
+
+struct DbPoolConfig {
+	std::size_t read_connections = 4;   // SELECT-only work
+	std::size_t write_connections = 2;  // anything that writes
+	std::chrono::milliseconds checkout_timeout{ 2000 };
+	std::size_t executor_queue = 1024;  // async calls waiting for a DbExecutor thread
+};
+
+enum class DbLane { Read, Write };
+
+// Fixed set of connections split into a read and a write lane, so long
+// reads never hold up writes and one caller's slow query only occupies
+// its own connection. Connections are opened lazily; every checkout first
+// runs `ensure`, which (re)connects the slot if needed and reports
+// whether it is usable.
+template <typename Conn>
+class ConnectionPool {
+public:
+	using Ensure = std::function<bool(std::unique_ptr<Conn>&)>;
+
+	class Lease {
+	public:
+		Lease() = default;
+		Lease(Lease&& o) noexcept : pool_(o.pool_), lane_(o.lane_), slot_(o.slot_) { o.slot_ = nullptr; }
+		Lease& operator=(Lease&& o) noexcept {
+			if (this != &o) {
+				release();
+				pool_ = o.pool_;
+				lane_ = o.lane_;
+				slot_ = o.slot_;
+				o.slot_ = nullptr;
+			}
+			return *this;
+		}
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		~Lease() { release(); }
+
+		explicit operator bool() const noexcept { return slot_ != nullptr; }
+		Conn& operator*() const noexcept { return **slot_; }
+		Conn* operator->() const noexcept { return slot_->get(); }
+
+		// Drops the connection so the next checkout of this slot reconnects.
+		void invalidate() noexcept {
+			if (slot_) slot_->reset();
+		}
+
+	private:
+		friend class ConnectionPool;
+
+		Lease(ConnectionPool* pool, DbLane lane, std::unique_ptr<Conn>* slot)
+			: pool_(pool), lane_(lane), slot_(slot) {
+		}
+
+		void release() noexcept {
+			if (slot_) {
+				pool_->give_back(lane_, slot_);
+				slot_ = nullptr;
+			}
+		}
+
+		ConnectionPool* pool_ = nullptr;
+		DbLane lane_ = DbLane::Read;
+		std::unique_ptr<Conn>* slot_ = nullptr;
+	};
+
+	ConnectionPool(const DbPoolConfig& cfg, Ensure ensure)
+		: timeout_(cfg.checkout_timeout), ensure_(std::move(ensure)) {
+		read_.init(std::max<std::size_t>(1, cfg.read_connections));
+		write_.init(std::max<std::size_t>(1, cfg.write_connections));
+	}
+
+	ConnectionPool(const ConnectionPool&) = delete;
+	ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+	// A healthy connection from `lane`, or an empty Lease if none frees up
+	// within the checkout timeout or the slot cannot be (re)connected.
+	Lease acquire(DbLane lane) {
+		Lane& l = lane_of(lane);
+		std::unique_ptr<Conn>* slot = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(l.mutex);
+			if (!l.cv.wait_for(lock, timeout_, [&] { return !l.idle.empty(); })) {
+				return {};
+			}
+			slot = l.idle.back();
+			l.idle.pop_back();
+		}
+
+		// Connecting can be slow; other checkouts go on meanwhile.
+		bool ok = false;
+		try {
+			ok = ensure_(*slot);
+		}
+		catch (...) {
+			ok = false;
+		}
+		if (!ok) {
+			give_back(lane, slot);
+			return {};
+		}
+		return Lease(this, lane, slot);
+	}
+
+	std::size_t size(DbLane lane) const { return lane_of(lane).slots.size(); }
+
+	std::size_t idle(DbLane lane) const {
+		const Lane& l = lane_of(lane);
+		std::lock_guard<std::mutex> lock(l.mutex);
+		return l.idle.size();
+	}
+
+private:
+	struct Lane {
+		void init(std::size_t n) {
+			slots.resize(n);
+			for (auto& s : slots) idle.push_back(&s);
+		}
+
+		mutable std::mutex mutex;
+		std::condition_variable cv;
+		std::vector<std::unique_ptr<Conn>> slots;
+		std::vector<std::unique_ptr<Conn>*> idle;
+	};
+
+	Lane& lane_of(DbLane lane) { return lane == DbLane::Read ? read_ : write_; }
+	const Lane& lane_of(DbLane lane) const { return lane == DbLane::Read ? read_ : write_; }
+
+	void give_back(DbLane lane, std::unique_ptr<Conn>* slot) noexcept {
+		Lane& l = lane_of(lane);
+		{
+			std::lock_guard<std::mutex> lock(l.mutex);
+			l.idle.push_back(slot);
+		}
+		l.cv.notify_one();
+	}
+
+	std::chrono::milliseconds timeout_;
+	Ensure ensure_;
+	Lane read_;
+	Lane write_;
+};
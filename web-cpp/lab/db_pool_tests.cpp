@@ -0,0 +1,171 @@
+#include "db_pool.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace tests {
+
+	struct FakeConn {
+		int id = 0;
+		bool healthy = true;
+	};
+
+	// Pool over FakeConn whose ensure() opens connections on demand and
+	// counts how many it opened.
+	struct FakePool {
+		std::atomic<int> opened{ 0 };
+		std::atomic<bool> reachable{ true };
+		ConnectionPool<FakeConn> pool;
+
+		explicit FakePool(DbPoolConfig cfg)
+			: pool(cfg, [this](std::unique_ptr<FakeConn>& c) {
+			if (c && c->healthy) return true;
+			if (!reachable) {
+				c.reset();
+				return false;
+			}
+			c = std::make_unique<FakeConn>();
+			c->id = ++opened;
+			return true;
+				}) {
+		}
+	};
+
+	DbPoolConfig small_pool(std::size_t reads, std::size_t writes, int timeout_ms) {
+		DbPoolConfig cfg;
+		cfg.read_connections = reads;
+		cfg.write_connections = writes;
+		cfg.checkout_timeout = std::chrono::milliseconds(timeout_ms);
+		return cfg;
+	}
+
+	bool test_pool_lanes_and_timeout() {
+		FakePool fp(small_pool(2, 1, 20));
+		assert(fp.pool.size(DbLane::Read) == 2);
+		assert(fp.pool.size(DbLane::Write) == 1);
+
+		auto r1 = fp.pool.acquire(DbLane::Read);
+		auto r2 = fp.pool.acquire(DbLane::Read);
+		assert(r1 && r2 && r1->id != r2->id);
+
+		// An exhausted read lane leaves writes alone...
+		auto w = fp.pool.acquire(DbLane::Write);
+		assert(w);
+
+		// ...and times out for further reads.
+		auto start = std::chrono::steady_clock::now();
+		auto r3 = fp.pool.acquire(DbLane::Read);
+		auto waited = std::chrono::steady_clock::now() - start;
+		assert(!r3);
+		assert(waited >= std::chrono::milliseconds(15));
+
+		r1 = {};
+		assert(fp.pool.idle(DbLane::Read) == 1);
+		auto r4 = fp.pool.acquire(DbLane::Read);
+		assert(r4);
+		assert(fp.opened == 3); // the returned connection was reused
+		return true;
+	}
+
+	bool test_pool_health_checks() {
+		FakePool fp(small_pool(1, 1, 20));
+		int first = 0;
+		{
+			auto c = fp.pool.acquire(DbLane::Write);
+			assert(c);
+			first = c->id;
+			c->healthy = false;
+		}
+		{
+			auto c = fp.pool.acquire(DbLane::Write);
+			assert(c && c->id != first);
+			c.invalidate();
+		}
+		{
+			auto c = fp.pool.acquire(DbLane::Write);
+			assert(c);
+			assert(fp.opened == 3);
+		}
+
+		// A failed reconnect gives the slot back instead of leaking it.
+		fp.reachable = false;
+		{
+			auto c = fp.pool.acquire(DbLane::Read);
+			assert(!c);
+			assert(fp.pool.idle(DbLane::Read) == 1);
+		}
+		fp.reachable = true;
+		auto back = fp.pool.acquire(DbLane::Read);
+		assert(back);
+		return true;
+	}
+
+	bool test_pool_waiters_and_concurrency() {
+		FakePool fp(small_pool(3, 1, 2000));
+
+		// A blocked checkout is woken by a release.
+		{
+			auto w = fp.pool.acquire(DbLane::Write);
+			std::atomic<bool> got{ false };
+			std::thread t([&] {
+				auto c = fp.pool.acquire(DbLane::Write);
+				got = static_cast<bool>(c);
+				});
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			assert(!got);
+			w = {};
+			t.join();
+			assert(got);
+		}
+
+		std::atomic<int> in_use{ 0 };
+		std::atomic<int> peak{ 0 };
+		std::atomic<int> failures{ 0 };
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 8; ++t) {
+			threads.emplace_back([&] {
+				for (int i = 0; i < 500; ++i) {
+					auto c = fp.pool.acquire(DbLane::Read);
+					if (!c) {
+						++failures;
+						continue;
+					}
+					int now = ++in_use;
+					int seen = peak.load();
+					while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+					}
+					std::this_thread::yield();
+					--in_use;
+				}
+				});
+		}
+		for (auto& t : threads) t.join();
+		assert(failures == 0);
+		assert(peak <= 3);
+		assert(fp.pool.idle(DbLane::Read) == 3);
+		return true;
+	}
+
+	int RunDbPoolTests(bool verbose) {
+		try {
+			if (verbose) std::cout << "test_pool_lanes_and_timeout...\n";
+			test_pool_lanes_and_timeout();
+
+			if (verbose) std::cout << "test_pool_health_checks...\n";
+			test_pool_health_checks();
+
+			if (verbose) std::cout << "test_pool_waiters_and_concurrency...\n";
+			test_pool_waiters_and_concurrency();
+
+			std::cout << "All DB pool tests passed.\n";
+		}
+		catch (const std::exception& ex) {
+			std::cerr << "Test threw exception: " << ex.what() << "\n";
+			return 1;
+		}
+		return 0;
+	}
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tests {
+	int RunDbQueueTests(bool verbose);
+};
+
+struct DbWriterConfig {
+	std::size_t queue_capacity_dots = 100000; // push_task refuses beyond this
+	std::size_t batch_max_dots = 5000;        // per COPY transaction
+	std::chrono::milliseconds batch_max_wait{ 5 };
+	std::chrono::milliseconds flush_timeout{ 2000 };
+};
+
+// FIFO with a capacity counted in caller-defined weight (dots for the DB
+// writer) instead of items. try_push never blocks: a full queue refuses,
+// so callers can shed load instead of buffering without bound. An item
+// heavier than the whole capacity is still taken when the queue is empty.
+template <typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(std::size_t capacity) : capacity_(capacity) {}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	bool try_push(T item, std::size_t weight = 1) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (closed_) return false;
+			if (!items_.empty() && weight_ + weight > capacity_) {
+				++refused_;
+				return false;
+			}
+			items_.push_back({ std::move(item), weight });
+			weight_ += weight;
+			++pushed_;
+		}
+		cv_.notify_one();
+		return true;
+	}
+
+	// Waits for the first item, then keeps collecting for up to `linger`
+	// until the batch weighs max_weight. Appends to out; false once the
+	// queue is closed and drained.
+	bool pop_batch(std::vector<T>& out, std::size_t max_weight, std::chrono::milliseconds linger) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		cv_.wait(lock, [&] { return closed_ || !items_.empty(); });
+		if (items_.empty()) return false;
+
+		std::size_t taken = 0;
+		bool full = take(out, taken, max_weight);
+
+		auto deadline = std::chrono::steady_clock::now() + linger;
+		while (!full && !closed_) {
+			if (!cv_.wait_until(lock, deadline, [&] { return closed_ || !items_.empty(); }))
+				break;
+			full = take(out, taken, max_weight);
+		}
+		return true;
+	}
+
+	// Refuses further pushes and wakes the consumer; queued items are
+	// still handed out.
+	void close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			closed_ = true;
+		}
+		cv_.notify_all();
+	}
+
+	std::size_t weight() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return weight_;
+	}
+
+	std::size_t capacity() const { return capacity_; }
+
+	// Items accepted so far, in queue order.
+	std::uint64_t pushed() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return pushed_;
+	}
+
+	// Items turned away because the queue was full.
+	std::uint64_t refused() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return refused_;
+	}
+
+private:
+	struct Entry {
+		T item;
+		std::size_t weight;
+	};
+
+	// Moves items while the batch stays within max_weight, always at
+	// least one into an empty batch. True once the batch is full.
+	bool take(std::vector<T>& out, std::size_t& taken, std::size_t max_weight) {
+		while (!items_.empty()) {
+			Entry& e = items_.front();
+			if (taken > 0 && taken + e.weight > max_weight) return true;
+			taken += e.weight;
+			weight_ -= e.weight;
+			out.push_back(std::move(e.item));
+			items_.pop_front();
+		}
+		return taken >= max_weight;
+	}
+
+	const std::size_t capacity_;
+	mutable std::mutex mutex_;
+	std::condition_variable cv_;
+	std::deque<Entry> items_;
+	std::size_t weight_ = 0;
+	std::uint64_t pushed_ = 0;
+	std::uint64_t refused_ = 0;
+	bool closed_ = false;
+};
+
+// Threads that run blocking database calls for coroutines, so HTTP
+// workers are not parked on them. Jobs wait in a BoundedQueue: once it is
+// full, run() refuses instead of queueing without bound.
+class DbExecutor {
+public:
+	using Job = std::function<void()>;
+
+	DbExecutor(std::size_t threads, std::size_t queue_capacity) : jobs_(queue_capacity) {
+		for (std::size_t i = 0; i < threads; ++i) {
+			threads_.emplace_back([this] { worker_loop(); });
+		}
+	}
+
+	DbExecutor(const DbExecutor&) = delete;
+	DbExecutor& operator=(const DbExecutor&) = delete;
+
+	// Runs the jobs already queued, then joins.
+	~DbExecutor() {
+		jobs_.close();
+		for (auto& t : threads_) t.join();
+	}
+
+	bool post(Job job) { return jobs_.try_push(std::move(job)); }
+
+	// co_await run(fn) suspends the coroutine, calls fn on an executor
+	// thread and resumes it there with fn's result, or right away with
+	// nullopt when the queue is full. An exception from fn is rethrown in
+	// the coroutine.
+	template <typename F>
+	class Call {
+	public:
+		using Value = std::invoke_result_t<F&>;
+		static_assert(!std::is_void_v<Value>, "DbExecutor::run needs a function returning a value");
+
+		Call(DbExecutor& executor, F fn) : executor_(executor), fn_(std::move(fn)) {}
+
+		bool await_ready() const noexcept { return false; }
+
+		// The job may resume the coroutine before post() returns, so
+		// nothing here touches *this after posting.
+		bool await_suspend(std::coroutine_handle<> h) {
+			return executor_.post([this, h] {
+				try {
+					result_.emplace(fn_());
+				}
+				catch (...) {
+					error_ = std::current_exception();
+				}
+				h.resume();
+				});
+		}
+
+		std::optional<Value> await_resume() {
+			if (error_) std::rethrow_exception(error_);
+			return std::move(result_);
+		}
+
+	private:
+		DbExecutor& executor_;
+		F fn_;
+		std::optional<Value> result_;
+		std::exception_ptr error_;
+	};
+
+	template <typename F>
+	Call<F> run(F fn) { return Call<F>(*this, std::move(fn)); }
+
+	std::size_t queued() const { return jobs_.weight(); }
+	std::uint64_t refused() const { return jobs_.refused(); }
+
+private:
+	void worker_loop() {
+		std::vector<Job> batch;
+		while (jobs_.pop_batch(batch, 1, std::chrono::milliseconds(0))) {
+			for (auto& job : batch) job();
+			batch.clear();
+		}
+	}
+
+	BoundedQueue<Job> jobs_;
+	std::vector<std::thread> threads_;
+};
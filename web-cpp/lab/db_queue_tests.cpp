@@ -0,0 +1,235 @@
+#include "db_queue.hpp"
+#include "db_user_repo.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tests {
+
+	bool test_queue_capacity() {
+		BoundedQueue<int> q(10);
+		bool a = q.try_push(1, 6);
+		bool b = q.try_push(2, 4);
+		bool c = q.try_push(3, 1); // full: refused, not queued
+		assert(a && b && !c);
+		assert(q.weight() == 10 && q.refused() == 1);
+
+		std::vector<int> out;
+		bool got = q.pop_batch(out, 100, std::chrono::milliseconds(0));
+		assert(got);
+		assert(out.size() == 2 && out[0] == 1 && out[1] == 2);
+		assert(q.weight() == 0);
+
+		// An oversized item still fits into an empty queue.
+		a = q.try_push(4, 50);
+		b = q.try_push(5, 1);
+		assert(a && !b);
+		return true;
+	}
+
+	bool test_queue_batches() {
+		BoundedQueue<int> q(1000);
+		for (int i = 0; i < 10; ++i) q.try_push(i, 3);
+		assert(q.pushed() == 10);
+
+		// Batches stop before exceeding max_weight, but always take one.
+		std::vector<int> out;
+		bool got = q.pop_batch(out, 10, std::chrono::milliseconds(0));
+		assert(got && out.size() == 3);
+		out.clear();
+		got = q.pop_batch(out, 1, std::chrono::milliseconds(0));
+		assert(got && out.size() == 1 && out[0] == 3);
+
+		// A short batch lingers for late items.
+		out.clear();
+		BoundedQueue<int> late(100);
+		bool pushed = late.try_push(1);
+		assert(pushed);
+		std::thread producer([&] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			late.try_push(2);
+			});
+		got = late.pop_batch(out, 100, std::chrono::milliseconds(500));
+		assert(got);
+		producer.join();
+		if (out.size() == 1) {
+			got = late.pop_batch(out, 100, std::chrono::milliseconds(0));
+			assert(got);
+		}
+		assert(out.size() == 2 && out[1] == 2);
+		return true;
+	}
+
+	bool test_queue_close_drains() {
+		BoundedQueue<std::string> q(100);
+		bool a = q.try_push("a");
+		bool b = q.try_push("b");
+		q.close();
+		bool c = q.try_push("c");
+		assert(a && b && !c);
+
+		std::vector<std::string> out;
+		a = q.pop_batch(out, 1, std::chrono::milliseconds(1000));
+		b = q.pop_batch(out, 1, std::chrono::milliseconds(1000));
+		c = q.pop_batch(out, 1, std::chrono::milliseconds(1000));
+		assert(a && b && !c);
+		assert(out.size() == 2);
+
+		// close() wakes a consumer blocked on an empty queue.
+		BoundedQueue<int> empty(10);
+		std::thread consumer([&] {
+			std::vector<int> none;
+			bool got = empty.pop_batch(none, 10, std::chrono::milliseconds(0));
+			assert(!got);
+			});
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		empty.close();
+		consumer.join();
+		return true;
+	}
+
+	bool test_queue_concurrent_producers() {
+		BoundedQueue<int> q(64);
+		std::atomic<int> accepted{ 0 };
+		std::vector<std::thread> producers;
+		for (int t = 0; t < 4; ++t) {
+			producers.emplace_back([&] {
+				for (int i = 0; i < 2000; ++i) {
+					if (q.try_push(i)) ++accepted;
+					else std::this_thread::yield();
+				}
+				});
+		}
+
+		int consumed = 0;
+		std::thread consumer([&] {
+			std::vector<int> out;
+			while (q.pop_batch(out, 16, std::chrono::milliseconds(1))) {
+				assert(out.size() <= 16);
+				consumed += static_cast<int>(out.size());
+				out.clear();
+			}
+			});
+
+		for (auto& p : producers) p.join();
+		q.close();
+		consumer.join();
+		assert(consumed == accepted);
+		assert(q.pushed() == static_cast<std::uint64_t>(accepted.load()));
+		assert(q.weight() == 0);
+		return true;
+	}
+
+	// Starts at once and frees itself when it finishes.
+	struct Detached {
+		struct promise_type {
+			Detached get_return_object() { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	Detached await_value(DbExecutor& ex, int v, std::promise<std::pair<std::optional<int>, std::thread::id>>& out) {
+		std::optional<int> r = co_await ex.run([v] { return v * 2; });
+		out.set_value({ r, std::this_thread::get_id() });
+	}
+
+	Detached await_throw(DbExecutor& ex, std::promise<std::string>& out) {
+		try {
+			co_await ex.run([]() -> int { throw std::runtime_error("db down"); });
+			out.set_value("no error");
+		}
+		catch (const std::runtime_error& e) {
+			out.set_value(e.what());
+		}
+	}
+
+	bool test_executor_run() {
+		DbExecutor ex(1, 1);
+
+		// The call runs on the executor and the coroutine resumes there.
+		std::promise<std::pair<std::optional<int>, std::thread::id>> p1;
+		await_value(ex, 21, p1);
+		auto [value, resumed_on] = p1.get_future().get();
+		assert(value && *value == 42);
+		assert(resumed_on != std::this_thread::get_id());
+
+		std::promise<std::string> p2;
+		await_throw(ex, p2);
+		std::string error = p2.get_future().get();
+		assert(error == "db down");
+
+		// Worker busy and queue full: the coroutine gets nullopt right away.
+		std::promise<void> release;
+		std::shared_future<void> released = release.get_future().share();
+		std::atomic<bool> running{ false };
+		bool posted = ex.post([&] { running = true; released.wait(); });
+		assert(posted);
+		while (!running) std::this_thread::yield();
+		posted = ex.post([] {});
+		assert(posted);
+		assert(ex.queued() == 1);
+
+		std::promise<std::pair<std::optional<int>, std::thread::id>> p3;
+		await_value(ex, 1, p3);
+		auto f3 = p3.get_future();
+		assert(f3.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+		auto [refused, here] = f3.get();
+		assert(!refused && here == std::this_thread::get_id());
+		assert(ex.refused() == 1);
+		release.set_value();
+		return true;
+	}
+
+	bool test_repo_flush_writes() {
+		DbUserRepository repo("");
+		bool flushed = repo.flush_writes(); // nothing queued
+		assert(flushed);
+		for (int i = 0; i < 50; ++i) {
+			repo.push_task(DbTask{ "u", { DotView{ "1", "1", "1", true, 0, "t" } } });
+		}
+		assert(repo.refused_tasks() == 0);
+		flushed = repo.flush_writes();
+		assert(flushed);
+		assert(repo.pending_dots() == 0);
+		return true;
+	}
+
+	int RunDbQueueTests(bool verbose) {
+		try {
+			if (verbose) std::cout << "test_queue_capacity...\n";
+			test_queue_capacity();
+
+			if (verbose) std::cout << "test_queue_batches...\n";
+			test_queue_batches();
+
+			if (verbose) std::cout << "test_queue_close_drains...\n";
+			test_queue_close_drains();
+
+			if (verbose) std::cout << "test_queue_concurrent_producers...\n";
+			test_queue_concurrent_producers();
+
+			if (verbose) std::cout << "test_executor_run...\n";
+			test_executor_run();
+
+			if (verbose) std::cout << "test_repo_flush_writes...\n";
+			test_repo_flush_writes();
+
+			std::cout << "All DB queue tests passed.\n";
+		}
+		catch (const std::exception& ex) {
+			std::cerr << "Test threw exception: " << ex.what() << "\n";
+			return 1;
+		}
+		return 0;
+	}
+};
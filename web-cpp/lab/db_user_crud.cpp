@@ -1,40 +1,86 @@
 #include "db_user_repo.hpp"
 
-bool DbUserRepository::db_ensure_connection_unlocked() {
+#include <unordered_map>
+
 #ifdef USE_PQXX
+void DbUserRepository::prepare_statements(pqxx::connection& conn) {
+	conn.prepare("user_insert",
+		"INSERT INTO users(login, hashed_password) VALUES($1, $2) RETURNING id");
+	conn.prepare("user_password",
+		"SELECT id, hashed_password FROM users WHERE login = $1");
+	conn.prepare("user_id",
+		"SELECT id FROM users WHERE login = $1");
+	conn.prepare("user_delete",
+		"DELETE FROM users WHERE login = $1");
+	conn.prepare("dot_insert",
+		"INSERT INTO dots(x, y, r, hit, exec_time, cur_time, user_id) "
+		"VALUES($1, $2, $3, $4, $5, $6, $7)");
+	conn.prepare("dots_by_user",
+		"SELECT x, y, r, hit, exec_time, cur_time FROM dots "
+		"WHERE user_id = $1 ORDER BY id");
+	conn.prepare("dots_clear",
+		"DELETE FROM dots WHERE user_id = $1");
+}
+
+bool DbUserRepository::db_ensure_connection_unlocked(std::unique_ptr<pqxx::connection>& conn) {
 	try {
-		if (!g_db || !g_db->is_open()) {
-			g_db = std::make_unique<pqxx::connection>(g_conninfo);
+		if (!conn || !conn->is_open()) {
+			conn = std::make_unique<pqxx::connection>(g_conninfo);
+			prepare_statements(*conn);
 		}
-		return g_db && g_db->is_open();
+		return conn && conn->is_open();
 	}
 	catch (const std::exception& e) {
 		std::cerr << "DB connection error: " << e.what() << std::endl;
-		g_db.reset();
+		conn.reset();
 		return false;
 	}
-#else
-	return true;
-#endif
 }
 
+std::optional<long long> DbUserRepository::resolve_user_id(pqxx::work& tx, const std::string& login) {
+	if (auto id = cached_user_id(login)) {
+		return id;
+	}
+	auto res = tx.exec(pqxx::prepped{ "user_id" }, pqxx::params{ login });
+	if (res.empty()) {
+		return std::nullopt;
+	}
+	long long id = res[0][0].as<long long>();
+	remember_user_id(login, id);
+	return id;
+}
+#endif
+
 bool DbUserRepository::db_ensure_connection() {
-	std::lock_guard<std::mutex> lock(g_db_mutex);
-	return db_ensure_connection_unlocked();
+#ifdef USE_PQXX
+	return static_cast<bool>(g_pool->acquire(DbLane::Read));
+#else
+	return true;
+#endif
 }
 
 void DbUserRepository::init_db() {
 #ifdef USE_PQXX
-	std::lock_guard<std::mutex> lock(g_db_mutex);
+	g_pool = std::make_unique<ConnectionPool<pqxx::connection>>(g_pool_config,
+		[this](std::unique_ptr<pqxx::connection>& conn) { return db_ensure_connection_unlocked(conn); });
 
-	if (!db_ensure_connection_unlocked()) {
+	// Statements are prepared on connect and need the tables, so the
+	// schema goes through a connection of its own.
+	std::unique_ptr<pqxx::connection> conn;
+	try {
+		conn = std::make_unique<pqxx::connection>(g_conninfo);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "DB connection error: " << e.what() << std::endl;
+	}
+	if (!conn || !conn->is_open()) {
 		std::cerr << "WARNING: PostgreSQL not available at startup. "
 			"Endpoints that need DB will return 503 until DB is reachable.\n";
 		return;
 	}
 
 	try {
-		pqxx::work tx(*g_db);
+		pqxx::work tx(*conn);
 
 
 		tx.exec(
@@ -58,12 +104,15 @@ void DbUserRepository::init_db() {
 			")"
 		);
 
+		tx.exec(
+			"CREATE INDEX IF NOT EXISTS dots_user_id_id_idx ON dots(user_id, id)"
+		);
+
 		tx.commit();
 		std::cout << "Connected to PostgreSQL, schema OK\n";
 	}
 	catch (const std::exception& e) {
 		std::cerr << "DB schema init error: " << e.what() << std::endl;
-		g_db.reset();
 	}
 #endif
 }
@@ -71,19 +120,16 @@ void DbUserRepository::init_db() {
 
 bool DbUserRepository::db_create_user(const std::string& login, const std::string& password) {
 #ifdef USE_PQXX
-	std::lock_guard<std::mutex> lock(g_db_mutex);
-
-	if (!db_ensure_connection_unlocked()) {
+	auto conn = g_pool->acquire(DbLane::Write);
+	if (!conn) {
 		throw std::runtime_error("DB unavailable");
 	}
 
 	try {
-		pqxx::work tx(*g_db);
-		tx.exec(
-			"INSERT INTO users(login, hashed_password) VALUES($1, $2)",
-			pqxx::params{ login, password }
-		);
+		pqxx::work tx(*conn);
+		auto res = tx.exec(pqxx::prepped{ "user_insert" }, pqxx::params{ login, password });
 		tx.commit();
+		remember_user_id(login, res[0][0].as<long long>());
 		return true;
 	}
 	catch (const pqxx::unique_violation&) {
@@ -102,24 +148,22 @@ bool DbUserRepository::db_create_user(const std::string& login, const std::strin
 bool DbUserRepository::db_check_password(const std::string& login, const std::string& password) {
 #ifdef USE_PQXX
 
-	std::lock_guard<std::mutex> lock(g_db_mutex);
-
-	if (!db_ensure_connection_unlocked()) {
+	auto conn = g_pool->acquire(DbLane::Read);
+	if (!conn) {
 		throw std::runtime_error("DB unavailable");
 	}
 
 	try {
-		pqxx::work tx(*g_db);
-		auto res = tx.exec(
-			"SELECT hashed_password FROM users WHERE login = $1",
-			pqxx::params{ login }
-		);
+		pqxx::work tx(*conn);
+		auto res = tx.exec(pqxx::prepped{ "user_password" }, pqxx::params{ login });
 		tx.commit();
 
 		if (res.empty()) return false;
-		std::string stored = res[0][0].as<std::string>();
+		std::string stored = res[0][1].as<std::string>();
+		if (stored != password) return false;
 
-		return stored == password;
+		remember_user_id(login, res[0][0].as<long long>());
+		return true;
 	}
 	catch (const std::exception& e) {
 		std::cerr << "db_check_password error: " << e.what() << std::endl;
@@ -133,19 +177,16 @@ bool DbUserRepository::db_check_password(const std::string& login, const std::st
 bool DbUserRepository::db_delete_user(const std::string& login) {
 #ifdef USE_PQXX
 
-	std::lock_guard<std::mutex> lock(g_db_mutex);
-
-	if (!db_ensure_connection_unlocked()) {
+	auto conn = g_pool->acquire(DbLane::Write);
+	if (!conn) {
 		throw std::runtime_error("DB unavailable");
 	}
 
 	try {
-		pqxx::work tx(*g_db);
-		auto res = tx.exec(
-			"DELETE FROM users WHERE login = $1",
-			pqxx::params{ login }
-		);
+		pqxx::work tx(*conn);
+		auto res = tx.exec(pqxx::prepped{ "user_delete" }, pqxx::params{ login });
 		tx.commit();
+		forget_user_id(login);
 		return res.affected_rows() > 0;
 	}
 	catch (const std::exception& e) {
@@ -161,27 +202,27 @@ bool DbUserRepository::db_delete_user(const std::string& login) {
 void DbUserRepository::db_insert_dot(const std::string& login, const DotView& d) {
 #ifdef USE_PQXX
 
-	std::lock_guard<std::mutex> lock(g_db_mutex);
-
-	if (!db_ensure_connection_unlocked()) {
+	auto conn = g_pool->acquire(DbLane::Write);
+	if (!conn) {
 		throw std::runtime_error("DB unavailable");
 	}
 
 	try {
-		pqxx::work tx(*g_db);
+		pqxx::work tx(*conn);
+		auto user_id = resolve_user_id(tx, login);
+		if (!user_id) {
+			throw std::runtime_error("unknown user " + login);
+		}
 		tx.exec(
-			"INSERT INTO dots(x, y, r, hit, exec_time, cur_time, user_id) "
-			"VALUES($1, $2, $3, $4, $5, $6, "
-			"  (SELECT id FROM users WHERE login = $7)"
-			")",
+			pqxx::prepped{ "dot_insert" },
 			pqxx::params{
 				d.x,
 				d.y,
 				d.r,
 				d.hit,
 				d.exec_time_ms,
-				d.timestamp, 
-				login
+				d.timestamp,
+				*user_id
 			}
 		);
 		tx.commit();
@@ -195,28 +236,111 @@ void DbUserRepository::db_insert_dot(const std::string& login, const DotView& d)
 #endif
 }
 
+void DbUserRepository::db_insert_dots(const std::string& login, const std::vector<DotView>& dots) {
+#ifdef USE_PQXX
+	if (dots.empty()) return;
+
+	auto conn = g_pool->acquire(DbLane::Write);
+	if (!conn) {
+		throw std::runtime_error("DB unavailable");
+	}
+
+	try {
+		pqxx::work tx(*conn);
+		auto user = resolve_user_id(tx, login);
+		if (!user) {
+			throw std::runtime_error("unknown user " + login);
+		}
+		long long user_id = *user;
+
+		for (const auto& d : dots) {
+			tx.exec(
+				pqxx::prepped{ "dot_insert" },
+				pqxx::params{
+					d.x,
+					d.y,
+					d.r,
+					d.hit,
+					d.exec_time_ms,
+					d.timestamp,
+					user_id
+				}
+			);
+		}
+		tx.commit();
+	}
+	catch (const std::exception& e) {
+		std::cerr << "db_insert_dots error: " << e.what() << std::endl;
+		throw;
+	}
+#else
+	return;
+#endif
+}
+
+void DbUserRepository::db_insert_batch(const std::vector<DbTask>& tasks) {
+#ifdef USE_PQXX
+	if (tasks.empty()) return;
+
+	auto conn = g_pool->acquire(DbLane::Write);
+	if (!conn) {
+		throw std::runtime_error("DB unavailable");
+	}
+
+	try {
+		pqxx::work tx(*conn);
+
+		std::unordered_map<std::string, long long> user_ids;
+		for (const auto& task : tasks) {
+			if (user_ids.count(task.login)) continue;
+			user_ids[task.login] = resolve_user_id(tx, task.login).value_or(-1);
+		}
+
+		auto stream = pqxx::stream_to::table(tx, { "dots" },
+			{ "x", "y", "r", "hit", "exec_time", "cur_time", "user_id" });
+		for (const auto& task : tasks) {
+			long long user_id = user_ids[task.login];
+			if (user_id < 0) {
+				std::cerr << "db_insert_batch: dropping " << task.dots.size()
+					<< " dots of unknown user " << task.login << std::endl;
+				continue;
+			}
+			for (const auto& d : task.dots) {
+				stream.write_values(d.x, d.y, d.r, d.hit, d.exec_time_ms, d.timestamp, user_id);
+			}
+		}
+		stream.complete();
+		tx.commit();
+	}
+	catch (const std::exception& e) {
+		std::cerr << "db_insert_batch error: " << e.what() << std::endl;
+		throw;
+	}
+#else
+	return;
+#endif
+}
+
 std::vector<DotView> DbUserRepository::db_get_dots(const std::string& login) {
 #ifdef USE_PQXX 
-	std::lock_guard<std::mutex> lock(g_db_mutex);
-
-	if (!db_ensure_connection_unlocked()) {
+	auto conn = g_pool->acquire(DbLane::Read);
+	if (!conn) {
 		throw std::runtime_error("DB unavailable");
 	}
 
 	std::vector<DotView> out;
 
 	try {
-		pqxx::work tx(*g_db);
-		auto res = tx.exec(
-			"SELECT d.x, d.y, d.r, d.hit, d.exec_time, d.cur_time "
-			"FROM dots d "
-			"JOIN users u ON d.user_id = u.id "
-			"WHERE u.login = $1 "
-			"ORDER BY d.id",
-			pqxx::params{ login }
-		);
+		pqxx::work tx(*conn);
+		auto user_id = resolve_user_id(tx, login);
+		if (!user_id) {
+			return out;
+		}
+		auto res = tx.exec(pqxx::prepped{ "dots_by_user" }, pqxx::params{ *user_id });
 		tx.commit();
 
+		out.reserve(res.size());
+
 		for (const auto& row : res) {
 			DotView d;
 			d.x = row[0].as<std::string>();
@@ -242,20 +366,18 @@ std::vector<DotView> DbUserRepository::db_get_dots(const std::string& login) {
 void DbUserRepository::db_clear_dots(const std::string& login) {
 #ifdef USE_PQXX
 
-	std::lock_guard<std::mutex> lock(g_db_mutex);
-
-	if (!db_ensure_connection_unlocked()) {
+	auto conn = g_pool->acquire(DbLane::Write);
+	if (!conn) {
 		throw std::runtime_error("DB unavailable");
 	}
 
 	try {
-		pqxx::work tx(*g_db);
-		tx.exec(
-			"DELETE FROM dots d "
-			"USING users u "
-			"WHERE d.user_id = u.id AND u.login = $1",
-			pqxx::params{ login }
-		);
+		pqxx::work tx(*conn);
+		auto user_id = resolve_user_id(tx, login);
+		if (!user_id) {
+			return;
+		}
+		tx.exec(pqxx::prepped{ "dots_clear" }, pqxx::params{ *user_id });
 		tx.commit();
 	}
 	catch (const std::exception& e) {
@@ -1,52 +1,87 @@
 #include "db_user_repo.hpp"
 
-void DbUserRepository::db_worker_loop() {
-	for (;;) {
-		DbTask task;
-
-		{
-			std::unique_lock<std::mutex> lock(g_db_queue_mutex);
-			g_db_cv.wait(lock, [&] {
-				return g_db_stop || !g_db_tasks.empty();
-				});
-
-			if (g_db_stop && g_db_tasks.empty()) {
-				return;
-			}
-
-			task = std::move(g_db_tasks.front());
-			g_db_tasks.pop();
-		}
+#include <algorithm>
 
+void DbUserRepository::db_worker_loop() {
+	std::vector<DbTask> batch;
+	while (g_db_tasks.pop_batch(batch, g_writer_config.batch_max_dots, g_writer_config.batch_max_wait)) {
 		try {
-			db_insert_dot(task.login, task.dot);
+			db_insert_batch(batch);
 		}
 		catch (const std::exception& e) {
-			std::cerr << "Async DB insert failed for user " << task.login
-				<< ": " << e.what() << "\n";
+			// One bad row aborts the whole COPY. Write the tasks again one
+			// transaction each, so only the ones that still fail are lost.
+			std::cerr << "Async DB insert failed for a batch of " << batch.size()
+				<< " tasks, retrying per task: " << e.what() << "\n";
+			for (const auto& task : batch) {
+				try {
+					db_insert_dots(task.login, task.dots);
+				}
+				catch (const std::exception&) {
+					std::cerr << "Dropping " << task.dots.size() << " dots of " << task.login << "\n";
+				}
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(g_done_mutex);
+			g_tasks_done += batch.size();
 		}
+		g_done_cv.notify_all();
+		batch.clear();
 	}
 }
 
 
-bool DbUserRepository::push_task(const DbTask& task) {
-	{
-		std::lock_guard<std::mutex> qlock(g_db_queue_mutex);
-		g_db_tasks.push(task);
-	}
-	g_db_cv.notify_one();
-	return true;
+bool DbUserRepository::push_task(DbTask task) {
+	std::size_t weight = std::max<std::size_t>(1, task.dots.size());
+	return g_db_tasks.try_push(std::move(task), weight);
 }
 
-DbUserRepository::DbUserRepository(const std::string coninfo) : g_conninfo(coninfo) {
+std::size_t DbUserRepository::pending_dots() const {
+	return g_db_tasks.weight();
+}
+
+std::uint64_t DbUserRepository::refused_tasks() const {
+	return g_db_tasks.refused();
+}
+
+bool DbUserRepository::flush_writes() {
+	std::uint64_t target = g_db_tasks.pushed();
+	std::unique_lock<std::mutex> lock(g_done_mutex);
+	return g_done_cv.wait_for(lock, g_writer_config.flush_timeout, [&] { return g_tasks_done >= target; });
+}
+
+std::optional<long long> DbUserRepository::cached_user_id(const std::string& login) const {
+	std::lock_guard<std::mutex> lock(g_user_ids_mutex);
+	auto it = g_user_ids.find(login);
+	if (it == g_user_ids.end()) return std::nullopt;
+	return it->second;
+}
+
+void DbUserRepository::remember_user_id(const std::string& login, long long id) {
+	std::lock_guard<std::mutex> lock(g_user_ids_mutex);
+	g_user_ids[login] = id;
+}
+
+void DbUserRepository::forget_user_id(const std::string& login) {
+	std::lock_guard<std::mutex> lock(g_user_ids_mutex);
+	g_user_ids.erase(login);
+}
+
+DbUserRepository::DbUserRepository(const std::string coninfo, const DbPoolConfig& pool, const DbWriterConfig& writer)
+	: g_conninfo(coninfo), g_pool_config(pool), g_writer_config(writer),
+	g_db_tasks(writer.queue_capacity_dots),
+	g_executor(pool.read_connections + pool.write_connections, pool.executor_queue) {
 
 
 	this->init_db();
-	std::thread worker(&DbUserRepository::db_worker_loop, this);
-	worker.detach();
+	g_db_worker = std::thread(&DbUserRepository::db_worker_loop, this);
 }
 
 DbUserRepository::~DbUserRepository() {
-	this->g_db_stop = true;
-	this->g_db_cv.notify_all();
+	// Whatever is still queued is written before the worker exits.
+	g_db_tasks.close();
+	if (g_db_worker.joinable()) {
+		g_db_worker.join();
+	}
 }
\ No newline at end of file
@@ -1,12 +1,16 @@
 #pragma once
 #include "models.hpp"
+#include "db_pool.hpp"
+#include "db_queue.hpp"
 
 #include <condition_variable>
+#include <cstdint>
 #include <vector>
 #include <memory>
-#include <thread>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <thread>
+#include <unordered_map>
 
 //#define USE_PQXX
 #ifdef USE_PQXX
@@ -16,22 +20,49 @@
 class DbUserRepository {
 private:
 #ifdef USE_PQXX
-	std::unique_ptr<pqxx::connection> g_db;
+	std::unique_ptr<ConnectionPool<pqxx::connection>> g_pool;
 #endif
 
-	std::queue<DbTask> g_db_tasks;
-	std::mutex g_db_queue_mutex;
-	std::condition_variable g_db_cv;
-	bool g_db_stop = false;
-	std::mutex g_db_mutex;
-
 	const std::string g_conninfo;
+	const DbPoolConfig g_pool_config;
+	const DbWriterConfig g_writer_config;
+
+	BoundedQueue<DbTask> g_db_tasks;
+	std::thread g_db_worker;
+
+	// Tasks the worker has finished with, written or not.
+	std::uint64_t g_tasks_done = 0;
+	std::mutex g_done_mutex;
+	std::condition_variable g_done_cv;
+
+	// login -> users.id, filled at registration and login, so queries on
+	// dots go by the indexed user_id instead of joining users.
+	std::unordered_map<std::string, long long> g_user_ids;
+	mutable std::mutex g_user_ids_mutex;
+
+	// One thread per pooled connection for async callers; declared last so
+	// it is joined before anything its jobs use goes away.
+	DbExecutor g_executor;
 
 private:
 
 	void init_db();
 
-	bool db_ensure_connection_unlocked();
+#ifdef USE_PQXX
+	// (Re)opens conn if it is missing or closed; the pool's health check.
+	bool db_ensure_connection_unlocked(std::unique_ptr<pqxx::connection>& conn);
+
+	// Registers every statement below on a freshly opened connection.
+	static void prepare_statements(pqxx::connection& conn);
+
+	// Cached id of login, else looked up through tx; nullopt if the user
+	// does not exist.
+	std::optional<long long> resolve_user_id(pqxx::work& tx, const std::string& login);
+#endif
+
+	std::optional<long long> cached_user_id(const std::string& login) const;
+	void remember_user_id(const std::string& login, long long id);
+	void forget_user_id(const std::string& login);
 
 	void db_worker_loop();
 
@@ -47,15 +78,36 @@ public:
 
 	void db_insert_dot(const std::string& login, const DotView& d);
 
+	void db_insert_dots(const std::string& login, const std::vector<DotView>& dots);
+
+	// All dots of `tasks` in one transaction through COPY, each login
+	// resolved once. Tasks of users that no longer exist are dropped.
+	void db_insert_batch(const std::vector<DbTask>& tasks);
+
 	std::vector<DotView> db_get_dots(const std::string& login);
 
 	void db_clear_dots(const std::string& login);
 
 public:
 
-	bool push_task(const DbTask& task);
+	// Queues dots for the writer thread; false, without queueing, when
+	// the queue already holds queue_capacity_dots.
+	bool push_task(DbTask task);
+
+	// Dots queued but not yet written.
+	std::size_t pending_dots() const;
+
+	// Tasks push_task turned away.
+	std::uint64_t refused_tasks() const;
+
+	// Waits until every task queued before the call has been handled, at
+	// most flush_timeout. Reads that must see those dots call it first.
+	bool flush_writes();
+
+	// Where coroutines send the blocking calls above.
+	DbExecutor& executor() { return g_executor; }
 
-	DbUserRepository(const std::string coninfo);
+	DbUserRepository(const std::string coninfo, const DbPoolConfig& pool = {}, const DbWriterConfig& writer = {});
 
 	~DbUserRepository();
 };
\ No newline at end of file
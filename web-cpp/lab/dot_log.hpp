@@ -0,0 +1,533 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json/json.hpp"
+#include "models.hpp"
+
+// Read-only view of a DotLog at one moment: the first size() dots of one
+// generation of the log. Taking a snapshot copies a single pointer, and
+// the snapshot stays valid and unchanged while the log keeps growing or
+// is reset, so it can be read without any lock. Each dot is also kept as
+// its rendered JSON, so a snapshot can hand out its array body as shared
+// bytes instead of serializing it again.
+class DotSnapshot {
+public:
+	static constexpr std::size_t chunk_size = 64;
+
+	// time[] value of a dot whose timestamp is kept as text.
+	static constexpr std::int64_t text_time = std::numeric_limits<std::int64_t>::min();
+
+	// Bump allocator over blocks that never move, so pointers handed out
+	// stay valid while later allocations are made. With grow set, each
+	// new block is twice the last, up to max_block.
+	struct Arena {
+		static constexpr std::size_t max_block = 64 * 1024;
+
+		Arena(std::size_t first_block, bool grow) : next_block(first_block), grow(grow) {}
+
+		char* allocate(std::size_t n, std::size_t& bytes) {
+			if (n > left) {
+				std::size_t size = std::max(n, next_block);
+				blocks.push_back(std::make_unique<char[]>(size));
+				cursor = blocks.back().get();
+				left = size;
+				bytes += size;
+				if (grow) next_block = std::min(next_block * 2, max_block);
+			}
+			char* p = cursor;
+			cursor += n;
+			left -= n;
+			return p;
+		}
+
+		std::vector<std::unique_ptr<char[]>> blocks;
+		char* cursor = nullptr;
+		std::size_t left = 0;
+		std::size_t next_block;
+		bool grow;
+	};
+
+	// Up to chunk_size dots as columns. x, y and r (and the timestamp,
+	// when it is not a plain "YYYY-MM-DDTHH:MM:SS") are stored back to
+	// back in the chunk's text arena; other timestamps are packed into
+	// seconds of the proleptic Gregorian calendar and formatted again when
+	// read. Every dot is rendered once on append as ",{...}" into the json
+	// arena; json_at/json_len locate it.
+	//
+	// The columns share one allocation of `capacity` slots. Most users
+	// have a handful of dots, so a log's first chunk starts at
+	// first_capacity and is replaced by a bigger copy as it fills, which
+	// takes over its arenas; arenas start small and grow.
+	struct Chunk {
+		static constexpr std::size_t first_capacity = 4;
+		static constexpr std::size_t first_text_block = 32;
+		static constexpr std::size_t first_json_block = 128;
+
+		// Column bytes per dot, widest first so every column is aligned.
+		static constexpr std::size_t slot_bytes = 2 * sizeof(const char*) + sizeof(std::int64_t)
+			+ sizeof(std::int32_t) + sizeof(std::uint32_t) + 4 * sizeof(std::uint16_t) + sizeof(bool);
+
+		Chunk(std::size_t capacity, std::size_t text_block, std::size_t json_block)
+			: capacity(capacity)
+			, columns(std::make_unique<char[]>(capacity * slot_bytes))
+			, text_arena(text_block, true)
+			, json(json_block, true) {
+			char* p = columns.get();
+			carve(p, text);
+			carve(p, json_at);
+			carve(p, time);
+			carve(p, exec_ms);
+			carve(p, json_len);
+			carve(p, x_len);
+			carve(p, y_len);
+			carve(p, r_len);
+			carve(p, t_len);
+			carve(p, hit);
+		}
+
+		// from's dots with room for capacity, taking over its arenas. from
+		// keeps the copy alive for the snapshots still reading through it.
+		Chunk(Chunk& from, std::size_t capacity) : Chunk(capacity, 0, 0) {
+			std::size_t n = from.capacity;
+			std::copy_n(from.text, n, text);
+			std::copy_n(from.json_at, n, json_at);
+			std::copy_n(from.time, n, time);
+			std::copy_n(from.exec_ms, n, exec_ms);
+			std::copy_n(from.json_len, n, json_len);
+			std::copy_n(from.x_len, n, x_len);
+			std::copy_n(from.y_len, n, y_len);
+			std::copy_n(from.r_len, n, r_len);
+			std::copy_n(from.t_len, n, t_len);
+			std::copy_n(from.hit, n, hit);
+			text_arena = std::move(from.text_arena);
+			json = std::move(from.json);
+			text_bytes = from.text_bytes;
+			json_bytes = from.json_bytes;
+			bytes = from.bytes + (capacity - n) * slot_bytes;
+		}
+
+		std::size_t capacity;
+		std::unique_ptr<char[]> columns;
+		const char** text = nullptr;
+		const char** json_at = nullptr;
+		std::int64_t* time = nullptr;
+		std::int32_t* exec_ms = nullptr;
+		std::uint32_t* json_len = nullptr;
+		std::uint16_t* x_len = nullptr;
+		std::uint16_t* y_len = nullptr;
+		std::uint16_t* r_len = nullptr;
+		std::uint16_t* t_len = nullptr;
+		bool* hit = nullptr;
+
+		// Writer side only.
+		Arena text_arena;
+		Arena json;
+		std::size_t text_bytes = 0; // text put into text_arena
+		std::size_t json_bytes = 0; // sum of json_len
+		std::size_t bytes = sizeof(Chunk) + capacity * slot_bytes;
+		std::shared_ptr<const Chunk> grown_into;
+
+	private:
+		template <typename T>
+		void carve(char*& p, T*& column) {
+			column = reinterpret_cast<T*>(p);
+			p += capacity * sizeof(T);
+		}
+	};
+
+	// Chunk pointers in slots[0, capacity). Slots past what a snapshot
+	// can see are filled in place; a full table, or one whose last chunk
+	// is replaced by a grown copy, is copied, which older snapshots never
+	// notice.
+	struct Table {
+		explicit Table(std::size_t cap) : slots(new std::shared_ptr<Chunk>[cap]), capacity(cap) {}
+		std::unique_ptr<std::shared_ptr<Chunk>[]> slots;
+		std::size_t capacity;
+	};
+
+	class const_iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = DotView;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = DotView;
+
+		const_iterator() = default;
+		const_iterator(const DotSnapshot* s, std::size_t i) : s_(s), i_(i) {}
+
+		DotView operator*() const { return (*s_)[i_]; }
+		std::size_t index() const { return i_; }
+		const_iterator& operator++() { ++i_; return *this; }
+		const_iterator operator++(int) { const_iterator t = *this; ++i_; return t; }
+		bool operator==(const const_iterator& o) const { return i_ == o.i_; }
+		bool operator!=(const const_iterator& o) const { return i_ != o.i_; }
+
+	private:
+		const DotSnapshot* s_ = nullptr;
+		std::size_t i_ = 0;
+	};
+
+	DotSnapshot() = default;
+	DotSnapshot(std::shared_ptr<const Table> table, std::size_t size, std::uint64_t generation)
+		: table_(std::move(table)), size_(size), generation_(generation) {
+	}
+
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	// Dot i rebuilt as a DotView.
+	DotView operator[](std::size_t i) const {
+		const Chunk& c = chunk_of(i);
+		std::size_t k = i % chunk_size;
+		const char* p = c.text[k];
+
+		DotView d;
+		d.x.assign(p, c.x_len[k]);
+		p += c.x_len[k];
+		d.y.assign(p, c.y_len[k]);
+		p += c.y_len[k];
+		d.r.assign(p, c.r_len[k]);
+		p += c.r_len[k];
+		d.hit = c.hit[k];
+		d.exec_time_ms = c.exec_ms[k];
+		char buf[time_chars];
+		d.timestamp = time_of(c, k, p, buf);
+		return d;
+	}
+
+	// Dot i as the same JSON object DotView::write_json would produce,
+	// straight from the columns.
+	void write_json(JsonWriter& w, std::size_t i) const {
+		write_json(w, chunk_of(i), i % chunk_size);
+	}
+
+	static void write_json(JsonWriter& w, const Chunk& c, std::size_t k) {
+		const char* p = c.text[k];
+		std::string_view x(p, c.x_len[k]);
+		std::string_view y(p + x.size(), c.y_len[k]);
+		std::string_view r(p + x.size() + y.size(), c.r_len[k]);
+		char buf[time_chars];
+
+		w.begin_object()
+			.member("x", x)
+			.member("y", y)
+			.member("r", r)
+			.member("hit", c.hit[k])
+			.member("execTime", static_cast<long long>(c.exec_ms[k]))
+			.member("time", time_of(c, k, r.data() + r.size(), buf))
+			.end_object();
+	}
+
+	// Dots [from, size()) as the elements of a JSON array, comma separated
+	// but without the brackets. emit(owner, bytes) is called, in order,
+	// for each run of pre-rendered bytes; they stay valid while a copy of
+	// owner (a std::shared_ptr<const void>) is held.
+	template <typename Emit>
+	void json_elements(std::size_t from, Emit&& emit) const {
+		std::shared_ptr<const void> owner = table_;
+		const char* run = nullptr;
+		std::size_t len = 0;
+		std::size_t run_chunk = 0;
+		for (std::size_t i = from; i < size_; ++i) {
+			const Chunk& c = chunk_of(i);
+			std::size_t k = i % chunk_size;
+			const char* p = c.json_at[k];
+			std::size_t n = c.json_len[k];
+			if (i == from) {
+				++p; // no comma before the first element
+				--n;
+			}
+			if (run && i / chunk_size == run_chunk && p == run + len) {
+				len += n;
+				continue;
+			}
+			if (run) emit(owner, std::string_view(run, len));
+			run = p;
+			len = n;
+			run_chunk = i / chunk_size;
+		}
+		if (run) emit(owner, std::string_view(run, len));
+	}
+
+	const_iterator begin() const { return { this, 0 }; }
+	const_iterator end() const { return { this, size_ }; }
+	const_iterator at_index(std::size_t i) const { return { this, i < size_ ? i : size_ }; }
+
+	// Changes whenever the log is reset, so (generation, size) names the
+	// contents exactly.
+	std::uint64_t generation() const { return generation_; }
+
+	// Quoted "<generation>-<size>".
+	std::string etag() const {
+		return "\"" + std::to_string(generation_) + "-" + std::to_string(size_) + "\"";
+	}
+
+	// Whether etag was issued for this snapshot's generation, i.e. the
+	// client's dots are a prefix of these.
+	bool same_generation(std::string_view etag) const {
+		std::string prefix = "\"" + std::to_string(generation_) + "-";
+		return etag.size() > prefix.size() && etag.compare(0, prefix.size(), prefix) == 0;
+	}
+
+	std::vector<DotView> to_vector() const {
+		std::vector<DotView> out;
+		out.reserve(size_);
+		for (std::size_t i = 0; i < size_; ++i) out.push_back((*this)[i]);
+		return out;
+	}
+
+	// "YYYY-MM-DDTHH:MM:SS" <-> seconds since 0000-03-01, for valid
+	// dates of years 0001..9999 only, so that formatting what was parsed
+	// gives back the same text.
+	static constexpr std::size_t time_chars = 19;
+
+	static bool parse_time(std::string_view s, std::int64_t& out) {
+		if (s.size() != time_chars || s[4] != '-' || s[7] != '-' || s[10] != 'T' || s[13] != ':' || s[16] != ':')
+			return false;
+		int v[6];
+		const int pos[6] = { 0, 5, 8, 11, 14, 17 };
+		const int len[6] = { 4, 2, 2, 2, 2, 2 };
+		for (int f = 0; f < 6; ++f) {
+			v[f] = 0;
+			for (int j = 0; j < len[f]; ++j) {
+				char ch = s[pos[f] + j];
+				if (ch < '0' || ch > '9') return false;
+				v[f] = v[f] * 10 + (ch - '0');
+			}
+		}
+		int y = v[0], m = v[1], d = v[2];
+		if (y < 1 || m < 1 || m > 12 || d < 1 || d > days_in_month(y, m) || v[3] > 23 || v[4] > 59 || v[5] > 59)
+			return false;
+		out = days_from_civil(y, m, d) * 86400 + v[3] * 3600 + v[4] * 60 + v[5];
+		return true;
+	}
+
+	static std::string_view format_time(std::int64_t t, char (&buf)[time_chars]) {
+		std::int64_t days = t / 86400;
+		int secs = static_cast<int>(t % 86400);
+		int y, m, d;
+		civil_from_days(days, y, m, d);
+		put(buf + 0, y, 4);
+		buf[4] = '-';
+		put(buf + 5, m, 2);
+		buf[7] = '-';
+		put(buf + 8, d, 2);
+		buf[10] = 'T';
+		put(buf + 11, secs / 3600, 2);
+		buf[13] = ':';
+		put(buf + 14, secs / 60 % 60, 2);
+		buf[16] = ':';
+		put(buf + 17, secs % 60, 2);
+		return { buf, time_chars };
+	}
+
+private:
+	const Chunk& chunk_of(std::size_t i) const { return *table_->slots[i / chunk_size]; }
+
+	static std::string_view time_of(const Chunk& c, std::size_t k, const char* after_coords, char (&buf)[time_chars]) {
+		if (c.time[k] == text_time) return { after_coords, c.t_len[k] };
+		return format_time(c.time[k], buf);
+	}
+
+	static void put(char* p, int v, int width) {
+		for (int j = width - 1; j >= 0; --j) {
+			p[j] = static_cast<char>('0' + v % 10);
+			v /= 10;
+		}
+	}
+
+	static int days_in_month(int y, int m) {
+		static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+		bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+		return m == 2 && leap ? 29 : days[m - 1];
+	}
+
+	// Proleptic Gregorian calendar, days counted from 0000-03-01.
+	static std::int64_t days_from_civil(int y, int m, int d) {
+		y -= m <= 2;
+		int era = y / 400;
+		int yoe = y - era * 400;
+		int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+		int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return std::int64_t{ era } * 146097 + doe;
+	}
+
+	static void civil_from_days(std::int64_t z, int& y, int& m, int& d) {
+		int era = static_cast<int>(z / 146097);
+		int doe = static_cast<int>(z - std::int64_t{ era } * 146097);
+		int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		int mp = (5 * doy + 2) / 153;
+		d = doy - (153 * mp + 2) / 5 + 1;
+		m = mp < 10 ? mp + 3 : mp - 9;
+		y = yoe + era * 400 + (m <= 2);
+	}
+
+	std::shared_ptr<const Table> table_;
+	std::size_t size_ = 0;
+	std::uint64_t generation_ = 0;
+};
+
+// One user's dots as an append-only log of columnar chunks shared with
+// the snapshots taken from it. Appends only write slots no snapshot can
+// see yet; reset() starts a new generation on fresh chunks. Not
+// synchronized: the owner serializes appends, resets and snapshot().
+class DotLog {
+public:
+	DotLog() : generation_(next_generation()) {}
+
+	explicit DotLog(std::vector<DotView> dots) : DotLog() {
+		append(std::move(dots));
+	}
+
+	// Throws std::length_error for a coordinate or timestamp longer than
+	// 65535 bytes, which cannot get past request validation anyway.
+	void append(const DotView& dot) {
+		constexpr std::size_t cs = DotSnapshot::chunk_size;
+		constexpr std::size_t max_len = std::numeric_limits<std::uint16_t>::max();
+		if (dot.x.size() > max_len || dot.y.size() > max_len || dot.r.size() > max_len || dot.timestamp.size() > max_len)
+			throw std::length_error("dot field too long");
+
+		std::size_t chunk = size_ / cs;
+		std::size_t k = size_ % cs;
+		if (k == 0) {
+			if (!table_ || chunk == table_->capacity) grow();
+			add_chunk(chunk);
+		}
+		else if (k == table_->slots[chunk]->capacity) {
+			grow_chunk(chunk);
+		}
+		DotSnapshot::Chunk& c = *table_->slots[chunk];
+		std::size_t before = c.bytes;
+
+		std::int64_t packed = 0;
+		bool text_time = !DotSnapshot::parse_time(dot.timestamp, packed);
+		std::size_t t_len = text_time ? dot.timestamp.size() : 0;
+
+		std::size_t text_len = dot.x.size() + dot.y.size() + dot.r.size() + t_len;
+		char* p = c.text_arena.allocate(text_len, c.bytes);
+		c.text_bytes += text_len;
+		c.text[k] = p;
+		p = std::copy(dot.x.begin(), dot.x.end(), p);
+		p = std::copy(dot.y.begin(), dot.y.end(), p);
+		p = std::copy(dot.r.begin(), dot.r.end(), p);
+		if (text_time) std::copy(dot.timestamp.begin(), dot.timestamp.end(), p);
+
+		c.x_len[k] = static_cast<std::uint16_t>(dot.x.size());
+		c.y_len[k] = static_cast<std::uint16_t>(dot.y.size());
+		c.r_len[k] = static_cast<std::uint16_t>(dot.r.size());
+		c.t_len[k] = static_cast<std::uint16_t>(t_len);
+		c.time[k] = text_time ? DotSnapshot::text_time : packed;
+		c.exec_ms[k] = static_cast<std::int32_t>(std::clamp<long long>(dot.exec_time_ms,
+			std::numeric_limits<std::int32_t>::min(), std::numeric_limits<std::int32_t>::max()));
+		c.hit[k] = dot.hit;
+
+		json_.assign(1, ',');
+		JsonWriter w(json_);
+		DotSnapshot::write_json(w, c, k);
+		char* j = c.json.allocate(json_.size(), c.bytes);
+		std::copy(json_.begin(), json_.end(), j);
+		c.json_at[k] = j;
+		c.json_len[k] = static_cast<std::uint32_t>(json_.size());
+		c.json_bytes += json_.size();
+		json_bytes_ += json_.size();
+
+		bytes_ += c.bytes - before;
+		++size_;
+	}
+
+	void append(const std::vector<DotView>& dots) {
+		for (const auto& d : dots) append(d);
+	}
+
+	// Replaces the contents; snapshots taken before keep the old ones.
+	void reset(const std::vector<DotView>& dots = {}) {
+		table_.reset();
+		size_ = 0;
+		bytes_ = 0;
+		json_bytes_ = 0;
+		generation_ = next_generation();
+		append(dots);
+	}
+
+	DotSnapshot snapshot() const { return { table_, size_, generation_ }; }
+
+	std::size_t size() const { return size_; }
+
+	// Heap held by the chunks and the chunk table, rendered JSON included.
+	std::size_t memory_bytes() const { return bytes_; }
+
+	// Rendered JSON of all dots, commas included.
+	std::size_t json_bytes() const { return json_bytes_; }
+
+private:
+	// A full chunk after a full chunk gets arena blocks sized after it, so
+	// its elements usually share one block.
+	void add_chunk(std::size_t chunk) {
+		using Chunk = DotSnapshot::Chunk;
+		std::shared_ptr<Chunk> c;
+		if (chunk == 0) {
+			c = std::make_shared<Chunk>(Chunk::first_capacity, Chunk::first_text_block, Chunk::first_json_block);
+		}
+		else {
+			const Chunk& prev = *table_->slots[chunk - 1];
+			c = std::make_shared<Chunk>(DotSnapshot::chunk_size,
+				std::max(Chunk::first_text_block, prev.text_bytes + prev.text_bytes / 8),
+				std::max(Chunk::first_json_block, prev.json_bytes + prev.json_bytes / 8));
+		}
+		bytes_ += c->bytes;
+		table_->slots[chunk] = std::move(c);
+	}
+
+	// Replaces the full, partly sized chunk with a copy holding four times
+	// as many dots, in a copy of the table.
+	void grow_chunk(std::size_t chunk) {
+		using Chunk = DotSnapshot::Chunk;
+		Chunk& old = *table_->slots[chunk];
+		auto grown = std::make_shared<Chunk>(old, std::min(old.capacity * 4, DotSnapshot::chunk_size));
+		bytes_ += grown->bytes - old.bytes;
+		old.grown_into = grown;
+
+		auto copy = std::make_shared<DotSnapshot::Table>(table_->capacity);
+		for (std::size_t i = 0; i < table_->capacity; ++i) copy->slots[i] = table_->slots[i];
+		copy->slots[chunk] = std::move(grown);
+		table_ = std::move(copy);
+	}
+
+	void grow() {
+		std::size_t used = table_ ? table_->capacity : 0;
+		std::size_t cap = used ? used * 2 : 4;
+		auto bigger = std::make_shared<DotSnapshot::Table>(cap);
+		for (std::size_t i = 0; i < used; ++i) bigger->slots[i] = table_->slots[i];
+		table_ = std::move(bigger);
+		bytes_ += (cap - used) * sizeof(std::shared_ptr<DotSnapshot::Chunk>);
+	}
+
+	// Seeded from the clock so ETags from before a restart do not match.
+	static std::uint64_t next_generation() {
+		static std::atomic<std::uint64_t> next{ static_cast<std::uint64_t>(
+			std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count()) };
+		return next.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::shared_ptr<DotSnapshot::Table> table_;
+	std::size_t size_ = 0;
+	std::size_t bytes_ = 0;
+	std::size_t json_bytes_ = 0;
+	std::uint64_t generation_;
+	std::string json_; // render buffer, reused across appends
+};
@@ -0,0 +1,151 @@
+#include "hit_simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define HIT_SIMD_X86 1
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  endif
+#endif
+
+#if defined(HIT_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#  define HIT_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#  define HIT_SIMD_TARGET_AVX2
+#endif
+
+namespace hit_simd {
+
+	namespace scalar {
+
+		// Same doubled predicates as HitChecker::checkFixed. Below 2^29
+		// every sum fits int32_t; only the squares need 64 bits.
+		void check_small(const std::int32_t* x, const std::int32_t* y, const std::int32_t* r,
+			std::uint8_t* out, std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i) {
+				std::int32_t xi = x[i], yi = y[i], ri = r[i];
+				std::int32_t x2 = xi + xi, y2 = yi + yi;
+
+				bool circle = xi >= 0 && x2 <= ri && yi >= 0 && y2 <= ri &&
+					std::int64_t{ x2 } * x2 + std::int64_t{ y2 } * y2 <= std::int64_t{ ri } * ri;
+				bool rect = xi <= 0 && xi >= -ri && yi >= 0 && y2 <= ri;
+				bool tri = x2 >= -ri && xi <= 0 && yi <= 0 && yi >= -(x2 + ri);
+
+				out[i] = static_cast<std::uint8_t>(circle || rect || tri);
+			}
+		}
+
+	}
+
+	namespace {
+
+#if defined(HIT_SIMD_X86)
+
+		namespace avx2 {
+
+			// a <= b as an all-ones lane mask.
+			HIT_SIMD_TARGET_AVX2 inline __m256i le(__m256i a, __m256i b) {
+				return _mm256_xor_si256(_mm256_cmpgt_epi32(a, b), _mm256_set1_epi32(-1));
+			}
+
+			// Bits 0..3 of m moved to bits 0, 2, 4, 6.
+			inline unsigned spread_even(unsigned m) {
+				return (m & 1u) | ((m & 2u) << 1) | ((m & 4u) << 2) | ((m & 8u) << 3);
+			}
+
+			HIT_SIMD_TARGET_AVX2 void check_small(const std::int32_t* x, const std::int32_t* y, const std::int32_t* r,
+				std::uint8_t* out, std::size_t n) {
+				const __m256i zero = _mm256_setzero_si256();
+				std::size_t i = 0;
+				for (; i + 8 <= n; i += 8) {
+					__m256i xv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+					__m256i yv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));
+					__m256i rv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + i));
+					__m256i x2 = _mm256_add_epi32(xv, xv);
+					__m256i y2 = _mm256_add_epi32(yv, yv);
+					__m256i neg_r = _mm256_sub_epi32(zero, rv);
+
+					__m256i x_ge0 = le(zero, xv), x_le0 = le(xv, zero);
+					__m256i y_ge0 = le(zero, yv), y_le0 = le(yv, zero);
+					__m256i y2_le_r = le(y2, rv);
+
+					__m256i bounds = _mm256_and_si256(_mm256_and_si256(x_ge0, le(x2, rv)),
+						_mm256_and_si256(y_ge0, y2_le_r));
+					__m256i rect = _mm256_and_si256(_mm256_and_si256(x_le0, le(neg_r, xv)),
+						_mm256_and_si256(y_ge0, y2_le_r));
+					__m256i tri = _mm256_and_si256(_mm256_and_si256(le(neg_r, x2), x_le0),
+						_mm256_and_si256(y_le0, le(_mm256_sub_epi32(neg_r, x2), yv)));
+
+					// (2x)^2 + (2y)^2 <= r^2 in 64-bit lanes, even and odd
+					// 32-bit lanes separately. Lanes with negative x or y
+					// give garbage here but are already out of bounds.
+					__m256i sq_even = _mm256_add_epi64(_mm256_mul_epu32(x2, x2), _mm256_mul_epu32(y2, y2));
+					__m256i r_even = _mm256_mul_epu32(rv, rv);
+					__m256i x2o = _mm256_srli_epi64(x2, 32), y2o = _mm256_srli_epi64(y2, 32), ro = _mm256_srli_epi64(rv, 32);
+					__m256i sq_odd = _mm256_add_epi64(_mm256_mul_epu32(x2o, x2o), _mm256_mul_epu32(y2o, y2o));
+					__m256i r_odd = _mm256_mul_epu32(ro, ro);
+					unsigned out_even = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(sq_even, r_even))));
+					unsigned out_odd = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(sq_odd, r_odd))));
+					unsigned in_circle = ~(spread_even(out_even) | (spread_even(out_odd) << 1)) & 0xFFu;
+
+					unsigned bits = (static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(bounds))) & in_circle) |
+						static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(rect, tri))));
+
+					for (int k = 0; k < 8; ++k)
+						out[i + k] = static_cast<std::uint8_t>((bits >> k) & 1u);
+				}
+				scalar::check_small(x + i, y + i, r + i, out + i, n - i);
+			}
+
+		}
+
+		bool cpu_has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+			int regs[4];
+			__cpuid(regs, 0);
+			if (regs[0] < 7) return false;
+			__cpuid(regs, 1);
+			bool osxsave = (regs[2] & (1 << 27)) != 0;
+			bool avx = (regs[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false; // YMM state saved by the OS
+			__cpuidex(regs, 7, 0);
+			return (regs[1] & (1 << 5)) != 0;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		}
+
+#endif
+
+		struct Kernels {
+			void (*check_small)(const std::int32_t*, const std::int32_t*, const std::int32_t*, std::uint8_t*, std::size_t);
+			const char* name;
+		};
+
+		Kernels select_kernels() {
+#if defined(HIT_SIMD_X86)
+			if (cpu_has_avx2()) {
+				return { avx2::check_small, "avx2" };
+			}
+#endif
+			return { scalar::check_small, "scalar" };
+		}
+
+		const Kernels& kernels() {
+			static const Kernels k = select_kernels();
+			return k;
+		}
+
+	}
+
+	void check_small(const std::int32_t* x, const std::int32_t* y, const std::int32_t* r,
+		std::uint8_t* out, std::size_t n) {
+		kernels().check_small(x, y, r, out, n);
+	}
+
+	const char* kernel_name() {
+		return kernels().name;
+	}
+
+}
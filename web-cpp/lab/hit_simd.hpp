@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Region test for hit_check_batch over structure-of-arrays input. Each
+// point i is x[i], y[i], r[i] on its own common decimal scale, with
+// |x|, |y| and r below SMALL_LIMIT and r > 0; out[i] becomes 1 for a
+// hit and 0 for a miss. The AVX2 kernel checks eight points at a time
+// and is picked once at run time; other targets use the scalar loop.
+namespace hit_simd {
+
+	constexpr std::int32_t SMALL_LIMIT = std::int32_t{ 1 } << 29;
+
+	void check_small(const std::int32_t* x, const std::int32_t* y, const std::int32_t* r,
+		std::uint8_t* out, std::size_t n);
+
+	// "avx2" or "scalar".
+	const char* kernel_name();
+
+	namespace scalar {
+		void check_small(const std::int32_t* x, const std::int32_t* y, const std::int32_t* r,
+			std::uint8_t* out, std::size_t n);
+	}
+
+}
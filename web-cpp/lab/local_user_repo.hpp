@@ -1,81 +1,358 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
-#include <string>
-#include <mutex>
 
-#include "models.hpp" 
+#include "dot_log.hpp"
+#include "models.hpp"
+#include "session_store.hpp"
 
+namespace tests {
+    int RunLocalUserRepoTests(bool verbose);
+};
+
+// In-memory sessions and per-user dot caches. Sessions live in a
+// SessionStore, which expires them; the reverse index (login -> tokens)
+// and the dot caches are maps split into hash-partitioned shards behind a
+// shared_mutex, so token lookups only take a shared lock on one shard and
+// never wait on dot appends. When both are needed, a login's index shard
+// is locked before the session store. Each cached user's dots are a
+// DotLog, which readers snapshot instead of copying.
+//
+// The dot caches share a memory budget. Once they outgrow it, the least
+// recently used users are dropped until usage is back under 90% of the
+// budget; their dots come back from the database on the next read. Use
+// is an access time stamped on each entry, so reads never write shared
+// state beyond their own entry.
 class LocalUserRepository {
 public:
-   
+    static constexpr unsigned shard_bits = 4;
+    static constexpr std::size_t shard_count = std::size_t{ 1 } << shard_bits;
+    static constexpr std::size_t default_dot_budget = std::size_t{ 256 } << 20;
+
+    explicit LocalUserRepository(std::size_t dot_budget_bytes = default_dot_budget, SessionConfig sessions = {})
+        : sessions_(sessions, now_s()), last_expiry_s_(now_s()), dot_budget_(dot_budget_bytes) {
+    }
+
+    // Returns the new session's token as hex.
     std::string create_session(const std::string& login) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::string token = generate_token();
-        sessions_[token] = login;
-        return token;
+        expire_sessions();
+        auto& index = user_tokens_[shard_of(login)];
+        std::unique_lock<std::shared_mutex> index_lock(index.mutex);
+        SessionToken token = sessions_.create(login, now_s());
+        index.map[login].push_back(token);
+        return to_hex(token);
     }
 
-    void remove_session(const std::string& token) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        sessions_.erase(token);
+    void remove_session(const std::string& token_hex) {
+        SessionToken token;
+        if (!from_hex(token_hex, token)) return;
+        std::string login = sessions_.erase(token);
+        if (!login.empty()) unindex(login, token);
     }
 
+    // Drops the user's sessions and dot cache; touches only that user's
+    // tokens.
     void remove_user(const std::string& login) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        for (auto it = sessions_.begin(); it != sessions_.end(); ) {
-            if (it->second == login) {
-                it = sessions_.erase(it);
-            }
-            else {
-                ++it;
+        {
+            auto& index = user_tokens_[shard_of(login)];
+            std::unique_lock<std::shared_mutex> index_lock(index.mutex);
+            auto it = index.map.find(login);
+            if (it != index.map.end()) {
+                for (const auto& token : it->second) sessions_.erase(token);
+                index.map.erase(it);
             }
         }
-        user_dots_cache_.erase(login);
+
+        auto& dots = dots_[shard_of(login)];
+        std::unique_lock<std::shared_mutex> lock(dots.mutex);
+        auto it = dots.map.find(login);
+        if (it != dots.map.end()) {
+            dot_bytes_.fetch_sub(it->second.bytes, std::memory_order_relaxed);
+            dots.map.erase(it);
+        }
     }
 
-    std::string get_login_by_token(const std::string& token) const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = sessions_.find(token);
-        if (it == sessions_.end()) return {};
-        return it->second;
+    // Empty for unknown, malformed and expired tokens.
+    std::string get_login_by_token(const std::string& token_hex) {
+        expire_sessions();
+        SessionToken token;
+        if (!from_hex(token_hex, token)) return {};
+        return sessions_.find(token, now_s());
     }
 
-    void set_dots(const std::string& login, const std::vector<DotView>& dots) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        user_dots_cache_[login] = dots;
+    std::size_t session_count() const { return sessions_.size(); }
+
+    // Replaces the cached dots and returns a snapshot of them.
+    DotSnapshot set_dots(const std::string& login, const std::vector<DotView>& dots) {
+        DotSnapshot snap;
+        {
+            auto& shard = dots_[shard_of(login)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            snap = reset_dots(shard, login, dots);
+        }
+        enforce_budget(login);
+        return snap;
     }
 
-    std::vector<DotView> get_dots(const std::string& login) const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = user_dots_cache_.find(login);
-        if (it == user_dots_cache_.end()) return {};
-        return it->second;
+    // Marks a read of login's dots from the database as under way; writes
+    // for login committed by add_dot/add_dots from now on are counted
+    // against it, cached or not. Pass the returned mark to set_loaded_dots,
+    // or to end_load if the read fails.
+    std::uint64_t begin_load(const std::string& login) {
+        auto& shard = dots_[shard_of(login)];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto& load = shard.loads[login];
+        ++load.readers;
+        return load.writes;
     }
 
+    // Ends the load and caches dots, unless a write for login was
+    // committed since begin_load returned `mark`; nullopt, leaving the
+    // cache as it was, then.
+    std::optional<DotSnapshot> set_loaded_dots(const std::string& login, std::uint64_t mark,
+        const std::vector<DotView>& dots) {
+        DotSnapshot snap;
+        {
+            auto& shard = dots_[shard_of(login)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            if (!finish_load(shard, login, mark)) return std::nullopt;
+            snap = reset_dots(shard, login, dots);
+        }
+        enforce_budget(login);
+        return snap;
+    }
+
+    void end_load(const std::string& login, std::uint64_t mark) {
+        auto& shard = dots_[shard_of(login)];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        finish_load(shard, login, mark);
+    }
+
+    // nullopt when the user's dots are not cached.
+    std::optional<DotSnapshot> get_dots(const std::string& login) const {
+        const auto& shard = dots_[shard_of(login)];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(login);
+        if (it == shard.map.end()) return std::nullopt;
+        it->second.last_used.store(now_ms(), std::memory_order_relaxed);
+        return it->second.log.snapshot();
+    }
+
+    // Appends to a cached user only. An evicted user's dots reach the
+    // cache again through the database.
     void add_dot(const std::string& login, const DotView& dot) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        user_dots_cache_[login].push_back(dot);
+        add_dot(login, dot, [] { return true; });
+    }
+
+    void add_dots(const std::string& login, const std::vector<DotView>& dots) {
+        add_dots(login, dots, [] { return true; });
+    }
+
+    // add_dot, run after commit() (e.g. queueing the database write) under
+    // the same cache lock, so a load of the user sees either both or
+    // neither. false, appending nothing, when commit() does.
+    bool add_dot(const std::string& login, const DotView& dot, const std::function<bool()>& commit) {
+        {
+            auto& shard = dots_[shard_of(login)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            if (!commit()) return false;
+            count_write(shard, login);
+            auto it = shard.map.find(login);
+            if (it == shard.map.end()) return true;
+            it->second.log.append(dot);
+            touch(it->second);
+        }
+        enforce_budget(login);
+        return true;
+    }
+
+    bool add_dots(const std::string& login, const std::vector<DotView>& dots, const std::function<bool()>& commit) {
+        {
+            auto& shard = dots_[shard_of(login)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            if (!commit()) return false;
+            count_write(shard, login);
+            auto it = shard.map.find(login);
+            if (it == shard.map.end()) return true;
+            it->second.log.append(dots);
+            touch(it->second);
+        }
+        enforce_budget(login);
+        return true;
     }
 
     void clear_dots(const std::string& login) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        user_dots_cache_[login].clear();
+        auto& shard = dots_[shard_of(login)];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto& entry = shard.map[login];
+        entry.log.reset();
+        touch(entry);
     }
 
+    // Bytes held by all dot caches, and the budget they are kept under.
+    std::size_t dot_bytes() const { return dot_bytes_.load(std::memory_order_relaxed); }
+    std::size_t dot_budget() const { return dot_budget_; }
+
+    // Users dropped from the dot cache so far.
+    std::size_t dot_evictions() const { return evictions_.load(std::memory_order_relaxed); }
+
 private:
-  
-    std::string generate_token() {
-        static std::mt19937_64 rng(std::random_device{}());
-        static std::uniform_int_distribution<unsigned long long> dist;
 
-        std::ostringstream oss;
-        oss << std::hex << dist(rng) << dist(rng);
-        return oss.str();
+    // One lock and its slice of a map, on its own cache line so that
+    // neighbouring shards do not share one.
+    template <typename Map>
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        Map map;
+    };
+
+    struct CachedDots {
+        DotLog log;
+        std::size_t bytes = 0; // log.memory_bytes() as counted in dot_bytes_
+        mutable std::atomic<std::int64_t> last_used{ 0 };
+    };
+
+    // Database reads of one login's dots in flight, and the writes for it
+    // committed since the first of them began.
+    struct PendingLoad {
+        std::size_t readers = 0;
+        std::uint64_t writes = 0;
+    };
+
+    struct DotShard : Shard<std::unordered_map<std::string, CachedDots>> {
+        std::unordered_map<std::string, PendingLoad> loads;
+    };
+
+    static std::int64_t now_s() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Reaps expired sessions at most once a second, by whichever caller
+    // first sees the new second.
+    void expire_sessions() {
+        std::int64_t now = now_s();
+        std::int64_t last = last_expiry_s_.load(std::memory_order_relaxed);
+        if (now <= last || !last_expiry_s_.compare_exchange_strong(last, now, std::memory_order_relaxed)) return;
+        for (const auto& e : sessions_.expire(now)) unindex(e.login, e.token);
+    }
+
+    void unindex(const std::string& login, const SessionToken& token) {
+        auto& index = user_tokens_[shard_of(login)];
+        std::unique_lock<std::shared_mutex> lock(index.mutex);
+        auto it = index.map.find(login);
+        if (it == index.map.end()) return;
+        auto& tokens = it->second;
+        for (std::size_t i = 0; i < tokens.size(); ++i) {
+            if (tokens[i] == token) {
+                tokens[i] = tokens.back();
+                tokens.pop_back();
+                break;
+            }
+        }
+        if (tokens.empty()) index.map.erase(it);
+    }
+
+    static std::int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
     }
 
-    mutable std::mutex mutex_;
-    std::unordered_map<std::string, std::string> sessions_;               
-    std::unordered_map<std::string, std::vector<DotView>> user_dots_cache_;
+    // The helpers below run under the shard's unique lock.
+
+    DotSnapshot reset_dots(DotShard& shard, const std::string& login, const std::vector<DotView>& dots) {
+        auto& entry = shard.map[login];
+        entry.log.reset(dots);
+        DotSnapshot snap = entry.log.snapshot();
+        touch(entry);
+        return snap;
+    }
+
+    static void count_write(DotShard& shard, const std::string& login) {
+        auto it = shard.loads.find(login);
+        if (it != shard.loads.end()) ++it->second.writes;
+    }
+
+    // true when no write for login was committed since `mark`.
+    static bool finish_load(DotShard& shard, const std::string& login, std::uint64_t mark) {
+        auto it = shard.loads.find(login);
+        bool current = it->second.writes == mark;
+        if (--it->second.readers == 0) shard.loads.erase(it);
+        return current;
+    }
+
+    // After the entry's log changed.
+    void touch(CachedDots& entry) {
+        std::size_t now = entry.log.memory_bytes();
+        if (now >= entry.bytes) dot_bytes_.fetch_add(now - entry.bytes, std::memory_order_relaxed);
+        else dot_bytes_.fetch_sub(entry.bytes - now, std::memory_order_relaxed);
+        entry.bytes = now;
+        entry.last_used.store(now_ms(), std::memory_order_relaxed);
+    }
+
+    // Drops least recently used users, never `keep`, until the caches are
+    // under 90% of the budget. One caller evicts at a time; the others
+    // carry on. An entry used again since it was inspected survives.
+    void enforce_budget(const std::string& keep) {
+        if (dot_bytes() <= dot_budget_) return;
+        std::unique_lock<std::mutex> guard(evict_mutex_, std::try_to_lock);
+        if (!guard.owns_lock()) return;
+
+        struct Candidate {
+            std::int64_t used;
+            std::size_t shard;
+            std::string login;
+        };
+        std::vector<Candidate> candidates;
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            std::shared_lock<std::shared_mutex> lock(dots_[i].mutex);
+            for (const auto& [login, entry] : dots_[i].map) {
+                if (login != keep) candidates.push_back({ entry.last_used.load(std::memory_order_relaxed), i, login });
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.used < b.used; });
+
+        const std::size_t low_water = dot_budget_ / 10 * 9;
+        for (const auto& c : candidates) {
+            if (dot_bytes() <= low_water) break;
+            auto& shard = dots_[c.shard];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.map.find(c.login);
+            if (it == shard.map.end() || it->second.last_used.load(std::memory_order_relaxed) != c.used) continue;
+            dot_bytes_.fetch_sub(it->second.bytes, std::memory_order_relaxed);
+            shard.map.erase(it);
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Top bits of a multiplicative mix, so shard choice does not follow
+    // the bucket choice inside each map.
+    static std::size_t shard_of(std::string_view key) {
+        std::uint64_t h = std::hash<std::string_view>{}(key);
+        return static_cast<std::size_t>((h * 0x9E3779B97F4A7C15ull) >> (64 - shard_bits));
+    }
+
+    SessionStore sessions_;
+    std::atomic<std::int64_t> last_expiry_s_;
+    std::array<Shard<std::unordered_map<std::string, std::vector<SessionToken>>>, shard_count> user_tokens_;
+    std::array<DotShard, shard_count> dots_;
+
+    const std::size_t dot_budget_;
+    std::atomic<std::size_t> dot_bytes_{ 0 };
+    std::atomic<std::size_t> evictions_{ 0 };
+    std::mutex evict_mutex_;
 };
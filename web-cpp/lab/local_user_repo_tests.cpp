@@ -0,0 +1,432 @@
+#include "local_user_repo.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tests {
+
+	bool test_local_sessions() {
+		LocalUserRepository repo;
+		std::string a1 = repo.create_session("alice");
+		std::string a2 = repo.create_session("alice");
+		std::string b1 = repo.create_session("bob");
+		assert(a1 != a2);
+		assert(repo.get_login_by_token(a1) == "alice");
+		assert(repo.get_login_by_token(a2) == "alice");
+		assert(repo.get_login_by_token(b1) == "bob");
+		assert(repo.get_login_by_token("nope").empty());
+
+		repo.remove_session(a1);
+		repo.remove_session(a1);
+		assert(repo.get_login_by_token(a1).empty());
+		assert(repo.get_login_by_token(a2) == "alice");
+
+		repo.set_dots("alice", {});
+		repo.set_dots("bob", {});
+		repo.add_dot("alice", DotView{ "1", "2", "3", true, 0, "t" });
+		repo.add_dot("bob", DotView{ "4", "5", "6", false, 0, "t" });
+		repo.remove_user("alice");
+		assert(repo.get_login_by_token(a2).empty());
+		assert(!repo.get_dots("alice"));
+		assert(repo.get_login_by_token(b1) == "bob");
+		assert(repo.get_dots("bob")->size() == 1);
+
+		// A removed user can log in again.
+		std::string a3 = repo.create_session("alice");
+		assert(repo.get_login_by_token(a3) == "alice");
+		return true;
+	}
+
+	bool test_local_dots() {
+		LocalUserRepository repo;
+		repo.set_dots("u", { DotView{ "1", "1", "1", true, 0, "t" } });
+		repo.add_dots("u", { DotView{ "2", "2", "2", false, 0, "t" }, DotView{ "3", "3", "3", false, 0, "t" } });
+		auto dots = repo.get_dots("u");
+		assert(dots && dots->size() == 3 && (*dots)[0].x == "1" && (*dots)[2].x == "3");
+		repo.clear_dots("u");
+		assert(repo.get_dots("u")->empty());
+		assert((*dots)[2].x == "3"); // snapshots outlive a clear
+		assert(!repo.get_dots("nobody"));
+
+		// A load with a write for the user since it began leaves the cache
+		// alone; a failed one just ends.
+		std::uint64_t mark = repo.begin_load("late");
+		repo.add_dot("late", DotView{ "4", "4", "4", true, 0, "t" });
+		auto refused = repo.set_loaded_dots("late", mark, {});
+		auto uncached = repo.get_dots("late");
+		assert(!refused && !uncached);
+		repo.end_load("late", repo.begin_load("late"));
+		auto accepted = repo.set_loaded_dots("late", repo.begin_load("late"), {});
+		assert(accepted && accepted->empty());
+		repo.add_dot("late", DotView{ "5", "5", "5", true, 0, "t" });
+		assert(repo.get_dots("late")->size() == 1);
+		return true;
+	}
+
+	bool test_dot_log_snapshots() {
+		DotLog log;
+		DotSnapshot empty = log.snapshot();
+		assert(empty.empty() && empty.begin() == empty.end());
+
+		// Enough dots to fill several chunks and grow the chunk table.
+		const std::size_t n = DotSnapshot::chunk_size * 9 + 5;
+		std::vector<DotSnapshot> taken;
+		for (std::size_t i = 0; i < n; ++i) {
+			log.append(DotView{ std::to_string(i), "0", "1", i % 2 == 0, 0, "t" });
+			if (i % 37 == 0) taken.push_back(log.snapshot());
+		}
+		for (const auto& s : taken) {
+			for (std::size_t i = 0; i < s.size(); ++i) assert(s[i].x == std::to_string(i));
+		}
+
+		DotSnapshot all = log.snapshot();
+		assert(all.size() == n && all.generation() == empty.generation());
+		std::size_t i = 0;
+		for (const auto& d : all) assert(d.x == std::to_string(i++));
+		assert(i == n);
+		assert((*all.at_index(n - 1)).x == std::to_string(n - 1));
+		assert(all.at_index(n + 10) == all.end());
+
+		// ETags name (generation, size); a reset starts a new generation.
+		assert(all.etag() != taken.back().etag());
+		assert(all.same_generation(taken.back().etag()));
+		log.reset({ DotView{ "a", "b", "c", true, 0, "t" } });
+		DotSnapshot fresh = log.snapshot();
+		assert(fresh.size() == 1 && fresh[0].x == "a");
+		assert(fresh.generation() != all.generation());
+		assert(!fresh.same_generation(all.etag()));
+		assert(!fresh.same_generation(""));
+		assert(all[n - 1].x == std::to_string(n - 1));
+		return true;
+	}
+
+	std::string dot_json(const DotView& d) {
+		std::string out;
+		JsonWriter(out).value(d);
+		return out;
+	}
+
+	bool test_dot_log_columns() {
+		std::string long_text(3000, '7');
+		std::vector<DotView> in = {
+			{ "0.5", "-1", "2", true, 12, "2026-10-14T18:16:57" },
+			{ "", "", "", false, 0, "" },
+			{ long_text, "1e", "\"q\"", false, -3, "2024-02-29T23:59:59" },
+			{ "1", "2", "3", true, 1LL << 40, "2023-02-29T00:00:00" },  // not a date: kept as text
+			{ "1", "2", "3", true, 5, "0001-01-01T00:00:00" },
+			{ "1", "2", "3", true, 5, "9999-12-31T23:59:59" },
+			{ "1", "2", "3", true, 5, "2026-10-14 18:16:57.123" },
+		};
+		DotLog log;
+		log.append(in);
+		DotSnapshot snap = log.snapshot();
+		assert(snap.size() == in.size());
+		for (std::size_t i = 0; i < in.size(); ++i) {
+			DotView d = snap[i];
+			long long exec = i == 3 ? 2147483647LL : in[i].exec_time_ms;
+			assert(d.x == in[i].x && d.y == in[i].y && d.r == in[i].r);
+			assert(d.hit == in[i].hit && d.exec_time_ms == exec && d.timestamp == in[i].timestamp);
+
+			std::string got;
+			JsonWriter w(got);
+			snap.write_json(w, i);
+			assert(got == dot_json(d));
+		}
+
+		std::int64_t t = 0;
+		bool parsed = DotSnapshot::parse_time("2000-03-01T00:00:00", t);
+		char buf[DotSnapshot::time_chars];
+		assert(parsed && DotSnapshot::format_time(t, buf) == "2000-03-01T00:00:00");
+		bool bad_month = DotSnapshot::parse_time("2000-13-01T00:00:00", t);
+		bool bad_hour = DotSnapshot::parse_time("2000-01-01T24:00:00", t);
+		bool bad_year = DotSnapshot::parse_time("0000-01-01T00:00:00", t);
+		assert(!bad_month && !bad_hour && !bad_year);
+
+		// Columns take far less than the DotViews they replace; the
+		// rendered JSON comes on top and is counted too.
+		DotLog big;
+		for (int i = 0; i < 10000; ++i) {
+			big.append(DotView{ "0.25", "-1.5", "3", i % 3 == 0, 0, "2026-10-14T18:16:57" });
+		}
+		assert(big.json_bytes() > 10000 * dot_json(big.snapshot()[0]).size());
+		assert(big.memory_bytes() - big.json_bytes() < 10000 * sizeof(DotView) / 2);
+		return true;
+	}
+
+	std::string json_array(const DotSnapshot& s, std::size_t from, std::size_t* runs = nullptr) {
+		std::string out = "[";
+		s.json_elements(from, [&](std::shared_ptr<const void> owner, std::string_view bytes) {
+			assert(owner && !bytes.empty());
+			out.append(bytes);
+			if (runs) ++*runs;
+			});
+		return out + "]";
+	}
+
+	bool test_dot_log_json() {
+		DotLog log;
+		assert(json_array(log.snapshot(), 0) == "[]");
+
+		const std::size_t n = DotSnapshot::chunk_size * 5 + 3;
+		std::vector<DotSnapshot> taken;
+		for (std::size_t i = 0; i < n; ++i) {
+			std::string x = i % 7 == 0 ? "\"" + std::to_string(i) + "\\" : std::to_string(i);
+			log.append(DotView{ x, "-0.5", "2", i % 2 == 0, static_cast<long long>(i), "2026-10-14T18:16:57" });
+			if (i % 50 == 0) taken.push_back(log.snapshot());
+		}
+		taken.push_back(log.snapshot());
+
+		for (const auto& s : taken) {
+			for (std::size_t from : { std::size_t{ 0 }, std::size_t{ 1 }, s.size() / 2, s.size() }) {
+				std::string expected = "[";
+				for (std::size_t i = from; i < s.size(); ++i) {
+					if (i > from) expected.push_back(',');
+					JsonWriter w(expected);
+					s.write_json(w, i);
+				}
+				expected.push_back(']');
+				assert(json_array(s, from) == expected);
+			}
+		}
+
+		// Whole chunks come out in one run each after the first, whose
+		// blocks grew with it.
+		std::size_t runs = 0;
+		json_array(taken.back(), 0, &runs);
+		assert(runs <= n / DotSnapshot::chunk_size + 8);
+
+		// The rendered bytes outlive a reset of the log.
+		std::string before = json_array(taken.back(), 0);
+		log.reset();
+		assert(json_array(log.snapshot(), 0) == "[]" && log.json_bytes() == 0);
+		assert(json_array(taken.back(), 0) == before);
+		return true;
+	}
+
+	// A user with a few dots pays for about what they hold, not for a
+	// whole chunk; growing the first chunk leaves older snapshots intact.
+	bool test_dot_log_small_users() {
+		const DotView dot{ "0.25", "-1.5", "3", true, 12, "2026-10-14T18:16:57" };
+		DotLog log;
+		log.append(dot);
+		assert(log.memory_bytes() < 1024);
+		DotSnapshot one = log.snapshot();
+
+		log.append({ dot, dot, dot });
+		assert(log.memory_bytes() < 2 * 1024);
+		DotSnapshot four = log.snapshot();
+		std::string four_json = json_array(four, 0);
+
+		for (int i = 0; i < 12; ++i) log.append(dot);
+		assert(log.memory_bytes() < 4 * 1024);
+
+		for (std::size_t i = log.size(); i < DotSnapshot::chunk_size + 1; ++i) {
+			log.append(DotView{ std::to_string(i), "0", "1", false, 0, "t" });
+		}
+		assert(one.size() == 1 && one[0].x == "0.25" && one[0].timestamp == dot.timestamp);
+		assert(four.size() == 4 && json_array(four, 0) == four_json);
+		DotSnapshot all = log.snapshot();
+		assert(all[3].x == "0.25" && all[DotSnapshot::chunk_size].x == std::to_string(DotSnapshot::chunk_size));
+
+		log.reset();
+		assert(json_array(four, 0) == four_json);
+		return true;
+	}
+
+	bool test_local_eviction() {
+		std::vector<DotView> dots(DotSnapshot::chunk_size * 4, DotView{ "1", "1", "1", true, 0, "2026-01-01T00:00:00" });
+		std::size_t per_user = DotLog(dots).memory_bytes();
+
+		LocalUserRepository repo(per_user * 3 + per_user / 2);
+		repo.set_dots("a", dots);
+		repo.set_dots("b", dots);
+		repo.set_dots("c", dots);
+		assert(repo.dot_evictions() == 0);
+		assert(repo.dot_bytes() == per_user * 3);
+
+		// "a" was used last, so "b" and then "c" go to make room for "d".
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		bool cached = repo.get_dots("a").has_value();
+		assert(cached);
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		repo.set_dots("d", dots);
+		assert(repo.dot_bytes() <= repo.dot_budget() / 10 * 9);
+		bool a_cached = repo.get_dots("a").has_value();
+		bool d_cached = repo.get_dots("d").has_value();
+		bool b_cached = repo.get_dots("b").has_value();
+		assert(a_cached && d_cached && !b_cached);
+		assert(repo.dot_evictions() >= 1);
+
+		// Evicted users are not resurrected by appends.
+		repo.add_dot("b", dots[0]);
+		b_cached = repo.get_dots("b").has_value();
+		assert(!b_cached);
+
+		repo.remove_user("a");
+		repo.remove_user("c");
+		repo.remove_user("d");
+		assert(repo.dot_bytes() == 0);
+		return true;
+	}
+
+	bool test_local_concurrent() {
+		LocalUserRepository repo;
+		std::vector<std::string> tokens;
+		for (int i = 0; i < 64; ++i) {
+			tokens.push_back(repo.create_session("user" + std::to_string(i)));
+		}
+
+		std::atomic<int> mismatches{ 0 };
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([&, t] {
+				for (int i = 0; i < 5000; ++i) {
+					int u = (i + t) % 64;
+					if (repo.get_login_by_token(tokens[u]) != "user" + std::to_string(u)) ++mismatches;
+				}
+				});
+			threads.emplace_back([&, t] {
+				std::string login = "writer" + std::to_string(t);
+				repo.set_dots(login, {});
+				for (int i = 0; i < 2000; ++i) {
+					repo.add_dot(login, DotView{ "0", "0", "1", true, 0, "t" });
+					std::string token = repo.create_session(login);
+					repo.remove_session(token);
+				}
+				});
+		}
+		for (auto& th : threads) th.join();
+		assert(mismatches == 0);
+		for (int t = 0; t < 4; ++t) {
+			assert(repo.get_dots("writer" + std::to_string(t))->size() == 2000);
+		}
+		return true;
+	}
+
+	// UserService::load_dots against add_dot: the write is queued (and
+	// lands in the database read) while the load is between reading the
+	// queue counter and caching. The append must not add it a second time.
+	bool test_local_add_during_load() {
+		LocalUserRepository repo;
+		const DotView dot{ "1", "1", "1", true, 0, "t" };
+
+		std::mutex db_mutex;
+		std::vector<DotView> db;
+		std::atomic<bool> queued{ false };
+
+		std::uint64_t mark = repo.begin_load("u");
+		std::thread writer([&] {
+			bool ok = repo.add_dot("u", dot, [&] {
+				{
+					std::lock_guard<std::mutex> lock(db_mutex);
+					db.push_back(dot);
+				}
+				queued = true;
+				// The load reads and tries to cache while the append is due.
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				return true;
+				});
+			assert(ok);
+			(void)ok;
+			});
+
+		while (!queued) std::this_thread::yield();
+		std::vector<DotView> read;
+		{
+			std::lock_guard<std::mutex> lock(db_mutex);
+			read = db;
+		}
+		auto snap = repo.set_loaded_dots("u", mark, read);
+		writer.join();
+
+		// The write counts against the load, so the read is not cached
+		// and the next load picks the dot up.
+		auto uncached = repo.get_dots("u");
+		assert(!snap && !uncached);
+		snap = repo.set_loaded_dots("u", repo.begin_load("u"), read);
+		assert(snap && snap->size() == 1);
+		auto cached = repo.get_dots("u");
+		assert(cached && cached->size() == 1);
+
+		// A refused commit appends nothing.
+		bool refused = repo.add_dot("u", dot, [] { return false; });
+		assert(!refused);
+		assert(repo.get_dots("u")->size() == 1);
+		return true;
+	}
+
+	bool test_local_load_beside_other_writers() {
+		LocalUserRepository repo;
+		const DotView dot{ "1", "1", "1", true, 0, "t" };
+		repo.set_dots("hot0", {});
+
+		// Other logins, cached or not and in any shard, keep writing while
+		// a cold user loads; every load of that user is still cached.
+		std::atomic<bool> stop{ false };
+		std::thread writer([&] {
+			for (std::size_t i = 0; !stop; ++i) {
+				repo.add_dot("hot" + std::to_string(i % 64), dot);
+			}
+			});
+
+		for (int i = 0; i < 20; ++i) {
+			std::string login = "cold" + std::to_string(i);
+			std::uint64_t mark = repo.begin_load(login);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			auto snap = repo.set_loaded_dots(login, mark, { dot });
+			auto cached = repo.get_dots(login);
+			assert(snap && snap->size() == 1 && cached);
+		}
+		stop = true;
+		writer.join();
+		auto hot = repo.get_dots("hot0");
+		assert(hot && hot->size() > 0);
+		return true;
+	}
+
+	int RunLocalUserRepoTests(bool verbose) {
+		try {
+			if (verbose) std::cout << "test_local_sessions...\n";
+			test_local_sessions();
+
+			if (verbose) std::cout << "test_local_dots...\n";
+			test_local_dots();
+
+			if (verbose) std::cout << "test_dot_log_snapshots...\n";
+			test_dot_log_snapshots();
+
+			if (verbose) std::cout << "test_dot_log_columns...\n";
+			test_dot_log_columns();
+
+			if (verbose) std::cout << "test_dot_log_json...\n";
+			test_dot_log_json();
+
+			if (verbose) std::cout << "test_dot_log_small_users...\n";
+			test_dot_log_small_users();
+
+			if (verbose) std::cout << "test_local_eviction...\n";
+			test_local_eviction();
+
+			if (verbose) std::cout << "test_local_concurrent...\n";
+			test_local_concurrent();
+
+			if (verbose) std::cout << "test_local_add_during_load...\n";
+			test_local_add_during_load();
+
+			if (verbose) std::cout << "test_local_load_beside_other_writers...\n";
+			test_local_load_beside_other_writers();
+
+			std::cout << "All local user repository tests passed.\n";
+		}
+		catch (const std::exception& ex) {
+			std::cerr << "Test threw exception: " << ex.what() << "\n";
+			return 1;
+		}
+		return 0;
+	}
+};
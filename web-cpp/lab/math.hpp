@@ -1,12 +1,50 @@
 #pragma once
 #include "bigdec/bigdec.hpp"
+#include "hit_simd.hpp"
 
+#include <cctype>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Decides whether (x, y) falls inside the area for radius r.
+//
+// Inputs that fit scaled 64-bit integers on a common scale are decided
+// exactly in integer arithmetic: tier 1 keeps every intermediate in
+// uint64_t, tier 2 squares in 128 bits. Anything longer, or anything the
+// fixed-point parser does not accept, takes the BigDecimal path, which
+// also reports malformed input by throwing std::invalid_argument.
+// hit_check_batch runs the tier-1 points of a batch through the
+// hit_simd kernel.
 class HitChecker
 {
-	bool checkCircle(const BigDecimal& x, const BigDecimal& y, const BigDecimal& r) {
-		BigDecimal zero(0ll);
-		BigDecimal halfR = r / 2;
+	// The predicates below, doubled so r / 2 never leaves the integers:
+	//   circle:    0 <= 2x <= r, 0 <= 2y <= r, 4(x^2 + y^2) <= r^2
+	//   rectangle: -r <= x <= 0, 0 <= 2y <= r
+	//   triangle:  -r <= 2x <= 0, -(2x + r) <= y <= 0
+	// With |x|, |y|, r <= FIXED_LIMIT these are exact in int64_t, except
+	// for the squares, which Wide has to hold.
+	template <typename Wide>
+	static bool checkFixed(std::int64_t x, std::int64_t y, std::int64_t r) {
+		std::int64_t x2 = 2 * x;
+		std::int64_t y2 = 2 * y;
+
+		if (x >= 0 && x2 <= r && y >= 0 && y2 <= r) {
+			Wide ax = static_cast<Wide>(x), ay = static_cast<Wide>(y), ar = static_cast<Wide>(r);
+			if (4 * (ax * ax + ay * ay) <= ar * ar)
+				return true;
+		}
+
+		if (x <= 0 && x >= -r && y >= 0 && y2 <= r)
+			return true;
+
+		return x2 >= -r && x <= 0 && y <= 0 && y >= -(x2 + r);
+	}
 
+	bool checkCircle(const BigDecimal& x, const BigDecimal& y, const BigDecimal& halfR) {
 		bool inBounds =
 			(x >= zero) &&
 			(x <= halfR) &&
@@ -18,9 +56,7 @@ class HitChecker
 		return inBounds && inCircle;
 	}
 
-	bool checkRectangle(const BigDecimal& x, const BigDecimal& y, const BigDecimal& r) {
-		BigDecimal zero(0ll);
-		BigDecimal halfR = r / 2;
+	bool checkRectangle(const BigDecimal& x, const BigDecimal& y, const BigDecimal& r, const BigDecimal& halfR) {
 		BigDecimal minusR = -r;
 
 		return (x <= zero) &&
@@ -29,30 +65,218 @@ class HitChecker
 			(y <= halfR);
 	}
 
-	bool checkTriangle(const BigDecimal& x, const BigDecimal& y, const BigDecimal& r) {
-		BigDecimal zero(0ll);
-		BigDecimal halfR = r / 2;
+	bool checkTriangle(const BigDecimal& x, const BigDecimal& y, const BigDecimal& r, const BigDecimal& halfR) {
 		BigDecimal yMax = -(x * 2 + r);
 
-		return 
+		return
 			(x >= -halfR) &&
 			(x <= zero) &&
 			(y <= zero) &&
 			(y >= yMax);
 	}
 
+	// Signed decimal as mantissa * 10^-scale with trailing fraction zeros
+	// dropped. Accepts the BigDecimal grammar; returns false on bad input
+	// and on anything beyond MAX_FIXED_DIGITS significant digits.
+	struct Fixed {
+		std::int64_t mantissa = 0;
+		int scale = 0;
+	};
+
+	static constexpr int MAX_FIXED_DIGITS = 18;
+	static constexpr std::int64_t FIXED_LIMIT = 1000000000000000000LL; // 10^18
+	static constexpr std::int64_t TIER1_LIMIT = std::int64_t{ 1 } << 30;
+
+	static bool parseFixed(std::string_view s, Fixed& out) {
+		size_t i = 0, end = s.size();
+		while (i < end && std::isspace((unsigned char)s[i])) ++i;
+		while (end > i && std::isspace((unsigned char)s[end - 1])) --end;
+
+		bool neg = false;
+		if (i < end && (s[i] == '+' || s[i] == '-')) {
+			neg = s[i] == '-';
+			++i;
+		}
+
+		std::uint64_t m = 0;
+		int significant = 0;
+		int scale = 0;
+		bool digits = false, dot = false;
+		for (; i < end; ++i) {
+			char c = s[i];
+			if (c == '.') {
+				if (dot) return false;
+				dot = true;
+				continue;
+			}
+			if (c < '0' || c > '9') return false;
+			digits = true;
+			if (dot) ++scale;
+			if (m == 0 && c == '0') continue;
+			if (++significant > MAX_FIXED_DIGITS) return false;
+			m = m * 10 + static_cast<unsigned>(c - '0');
+		}
+		if (!digits) return false;
+
+		while (scale > 0 && m % 10 == 0 && m != 0) {
+			m /= 10;
+			--scale;
+		}
+		if (m == 0) scale = 0;
+
+		out.mantissa = neg ? -static_cast<std::int64_t>(m) : static_cast<std::int64_t>(m);
+		out.scale = scale;
+		return true;
+	}
+
+	// v * 10^k, false if the result leaves (-FIXED_LIMIT, FIXED_LIMIT).
+	static bool rescale(std::int64_t& v, int k) {
+		for (; k > 0; --k) {
+			if (v >= FIXED_LIMIT / 10 || v <= -FIXED_LIMIT / 10) return false;
+			v *= 10;
+		}
+		return v < FIXED_LIMIT && v > -FIXED_LIMIT;
+	}
+
+	// Puts x, y and |r| on their common scale. 1 done, 0 when r is zero
+	// (always a miss), -1 not representable.
+	static int scaleFixed(std::string_view x_str, std::string_view y_str, std::string_view r_str,
+		std::int64_t& x, std::int64_t& y, std::int64_t& r) {
+		Fixed fx, fy, fr;
+		if (!parseFixed(x_str, fx) || !parseFixed(y_str, fy) || !parseFixed(r_str, fr))
+			return -1;
+
+		if (fr.mantissa == 0)
+			return 0;
+
+		// At most 18 fraction digits keeps r / 2 within the 20 digits that
+		// BigDecimal division produces, so both paths see the same halfR.
+		int scale = std::max(fx.scale, std::max(fy.scale, fr.scale));
+		if (scale > MAX_FIXED_DIGITS)
+			return -1;
+		x = fx.mantissa;
+		y = fy.mantissa;
+		r = fr.mantissa;
+		if (r < 0) r = -r;
+		if (!rescale(x, scale - fx.scale) || !rescale(y, scale - fy.scale) || !rescale(r, scale - fr.scale))
+			return -1;
+		return 1;
+	}
+
+	// 1 hit, 0 miss, -1 needs BigDecimal.
+	static int checkScaled(std::int64_t x, std::int64_t y, std::int64_t r) {
+		if (x < TIER1_LIMIT && x > -TIER1_LIMIT &&
+			y < TIER1_LIMIT && y > -TIER1_LIMIT && r < TIER1_LIMIT)
+			return checkFixed<std::uint64_t>(x, y, r);
+
+#if defined(__SIZEOF_INT128__)
+		return checkFixed<unsigned __int128>(x, y, r);
+#else
+		return -1;
+#endif
+	}
+
+	static int hitCheckFixed(std::string_view x_str, std::string_view y_str, std::string_view r_str) {
+		std::int64_t x, y, r;
+		int scaled = scaleFixed(x_str, y_str, r_str, x, y, r);
+		if (scaled <= 0)
+			return scaled;
+		return checkScaled(x, y, r);
+	}
+
+	BigDecimal zero{ 0ll };
+
 public:
 
-	bool hit_check(const std::string& x_str, const std::string& y_str, const std::string& r_str) {
+	// Domain limits applied by validate() before any arithmetic. The
+	// bounds on r are inclusive and apply to r as sent.
+	struct Limits {
+		std::size_t max_digits = 64;
+		std::optional<BigDecimal> r_min;
+		std::optional<BigDecimal> r_max;
+	};
+
+	// Whether x, y and r are numbers within `limits`. Only r is parsed,
+	// and only when a bound is set; the rest is a scan of the text.
+	static bool validate(std::string_view x_str, std::string_view y_str, std::string_view r_str,
+		const Limits& limits) {
+		if (!BigDecimal::isValid(x_str, limits.max_digits) ||
+			!BigDecimal::isValid(y_str, limits.max_digits) ||
+			!BigDecimal::isValid(r_str, limits.max_digits))
+			return false;
+
+		if (limits.r_min || limits.r_max) {
+			BigDecimal r(r_str);
+			if (limits.r_min && r < *limits.r_min) return false;
+			if (limits.r_max && r > *limits.r_max) return false;
+		}
+		return true;
+	}
+
+	bool hit_check(std::string_view x_str, std::string_view y_str, std::string_view r_str) {
+		int fast = hitCheckFixed(x_str, y_str, r_str);
+		if (fast >= 0)
+			return fast == 1;
+		return hit_check_bigdec(x_str, y_str, r_str);
+	}
+
+	struct Point {
+		std::string_view x, y, r;
+	};
+
+	// hits[i] = hit_check of points[i]. Points small enough for 32-bit
+	// lanes are gathered into structure-of-arrays form and checked
+	// together; the rest go through the scalar tiers. Throws
+	// std::invalid_argument, before any result is used, if a point is
+	// malformed.
+	void hit_check_batch(std::span<const Point> points, std::vector<std::uint8_t>& hits) {
+		hits.assign(points.size(), 0);
+
+		std::vector<std::int32_t> xs, ys, rs;
+		std::vector<std::uint32_t> lanes;
+		xs.reserve(points.size());
+		ys.reserve(points.size());
+		rs.reserve(points.size());
+		lanes.reserve(points.size());
+
+		for (std::size_t i = 0; i < points.size(); ++i) {
+			const Point& p = points[i];
+			std::int64_t x = 0, y = 0, r = 0;
+			int scaled = scaleFixed(p.x, p.y, p.r, x, y, r);
+			if (scaled == 0)
+				continue;
+
+			if (scaled > 0 && x < hit_simd::SMALL_LIMIT && x > -hit_simd::SMALL_LIMIT &&
+				y < hit_simd::SMALL_LIMIT && y > -hit_simd::SMALL_LIMIT && r < hit_simd::SMALL_LIMIT) {
+				xs.push_back(static_cast<std::int32_t>(x));
+				ys.push_back(static_cast<std::int32_t>(y));
+				rs.push_back(static_cast<std::int32_t>(r));
+				lanes.push_back(static_cast<std::uint32_t>(i));
+				continue;
+			}
+
+			int fast = scaled > 0 ? checkScaled(x, y, r) : -1;
+			hits[i] = static_cast<std::uint8_t>(fast >= 0 ? fast == 1
+				: hit_check_bigdec(p.x, p.y, p.r));
+		}
+
+		std::vector<std::uint8_t> lane_hits(lanes.size());
+		hit_simd::check_small(xs.data(), ys.data(), rs.data(), lane_hits.data(), lanes.size());
+		for (std::size_t k = 0; k < lanes.size(); ++k)
+			hits[lanes[k]] = lane_hits[k];
+	}
+
+	// Reference path: the whole check in BigDecimal.
+	bool hit_check_bigdec(std::string_view x_str, std::string_view y_str, std::string_view r_str) {
 		BigDecimal x(x_str), y(y_str), r(r_str);
 
-		BigDecimal zero(0ll);
 		if (r == zero)
 			return false;
 
 		if (r < zero)
 			r = -r;
 
-		return checkCircle(x, y, r) || checkRectangle(x, y, r) || checkTriangle(x, y, r);
+		BigDecimal halfR = r / 2;
+		return checkCircle(x, y, halfR) || checkRectangle(x, y, r, halfR) || checkTriangle(x, y, r, halfR);
 	}
-};
\ No newline at end of file
+};
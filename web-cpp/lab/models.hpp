@@ -1,6 +1,7 @@
 #pragma once
 
 #include "json/json.hpp"
+#include "json/json_bind.hpp"
 
 #include <string>
 #include <vector>
@@ -13,6 +14,9 @@ struct DotView {
 	long long   exec_time_ms{};
 	std::string timestamp = "";
 
+	// Same members as to_json(), written from JsonFields<DotView>.
+	void write_json(JsonWriter& w) const;
+
 	JsonValue to_json() const {
 		JsonValue::object obj;
 		obj["x"] = JsonValue(x);
@@ -25,13 +29,71 @@ struct DotView {
 	}
 };
 
+template <>
+struct JsonFields<DotView> {
+	static constexpr auto fields = std::tuple{
+		json_field<"x">(&DotView::x),
+		json_field<"y">(&DotView::y),
+		json_field<"r">(&DotView::r),
+		json_field<"hit">(&DotView::hit),
+		json_field<"execTime">(&DotView::exec_time_ms),
+		json_field<"time">(&DotView::timestamp),
+	};
+};
+
+inline void DotView::write_json(JsonWriter& w) const {
+	json_bind::write(w, *this);
+}
+
+// Request bodies.
+struct LoginRequest {
+	std::string login;
+	std::string password;
+};
+
+template <>
+struct JsonFields<LoginRequest> {
+	static constexpr auto fields = std::tuple{
+		json_field<"login">(&LoginRequest::login),
+		json_field<"password">(&LoginRequest::password),
+	};
+};
+
+struct AddDotRequest {
+	std::string x;
+	std::string y;
+	std::string r;
+};
+
+template <>
+struct JsonFields<AddDotRequest> {
+	static constexpr auto fields = std::tuple{
+		json_field<"x">(&AddDotRequest::x),
+		json_field<"y">(&AddDotRequest::y),
+		json_field<"r">(&AddDotRequest::r),
+	};
+};
+
+struct AddDotBatchRequest {
+	std::vector<AddDotRequest> dots;
+};
+
+template <>
+struct JsonFields<AddDotBatchRequest> {
+	static constexpr auto fields = std::tuple{
+		json_field<"dots">(&AddDotBatchRequest::dots),
+	};
+};
+
 struct User {
 	std::string login;
 	std::string password;
 	std::vector<DotView> dots;
 };
 
+// One unit of asynchronous DB work: every dot here is inserted in a
+// single transaction.
 struct DbTask {
 	std::string login;
-	DotView dot;
+	std::vector<DotView> dots;
 };
\ No newline at end of file
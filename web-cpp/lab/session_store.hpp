@@ -0,0 +1,424 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace tests {
+	int RunSessionStoreTests(bool verbose);
+};
+
+struct SessionConfig {
+	std::chrono::seconds idle_ttl{ 12 * 3600 };          // since the last lookup
+	std::chrono::seconds absolute_ttl{ 7 * 24 * 3600 };  // since creation
+};
+
+// Session tokens are 128 random bits. Clients see them as 32 lowercase
+// hex digits; from_hex also takes uppercase.
+using SessionToken = std::array<std::uint8_t, 16>;
+
+inline std::string to_hex(const SessionToken& token) {
+	static constexpr char digits[] = "0123456789abcdef";
+	std::string out(token.size() * 2, '\0');
+	for (std::size_t i = 0; i < token.size(); ++i) {
+		out[2 * i] = digits[token[i] >> 4];
+		out[2 * i + 1] = digits[token[i] & 0xF];
+	}
+	return out;
+}
+
+inline bool from_hex(std::string_view hex, SessionToken& out) {
+	if (hex.size() != out.size() * 2) return false;
+	auto nibble = [](char c) -> int {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	};
+	for (std::size_t i = 0; i < out.size(); ++i) {
+		int hi = nibble(hex[2 * i]);
+		int lo = nibble(hex[2 * i + 1]);
+		if (hi < 0 || lo < 0) return false;
+		out[i] = static_cast<std::uint8_t>(hi << 4 | lo);
+	}
+	return true;
+}
+
+// ChaCha20 (RFC 8439) as a keystream generator. The default constructor
+// keys it from std::random_device, so each thread can keep its own
+// instance and draw tokens without locking or a system call per token.
+// A spent counter rekeys the same way.
+class ChaChaRng {
+public:
+	using Key = std::array<std::uint32_t, 8>;
+	using Nonce = std::array<std::uint32_t, 3>;
+
+	ChaChaRng() { reseed(); }
+
+	ChaChaRng(const Key& key, const Nonce& nonce, std::uint32_t counter) {
+		set_state(key, nonce, counter);
+	}
+
+	void fill(std::uint8_t* out, std::size_t n) {
+		while (n > 0) {
+			if (used_ == block_.size()) refill();
+			std::size_t take = std::min(n, block_.size() - used_);
+			std::memcpy(out, block_.data() + used_, take);
+			used_ += take;
+			out += take;
+			n -= take;
+		}
+	}
+
+	// One 64-byte block for the given input state, serialized little-endian.
+	static void block(const std::array<std::uint32_t, 16>& in, std::array<std::uint8_t, 64>& out) {
+		std::array<std::uint32_t, 16> x = in;
+		for (int round = 0; round < 10; ++round) {
+			quarter(x, 0, 4, 8, 12);
+			quarter(x, 1, 5, 9, 13);
+			quarter(x, 2, 6, 10, 14);
+			quarter(x, 3, 7, 11, 15);
+			quarter(x, 0, 5, 10, 15);
+			quarter(x, 1, 6, 11, 12);
+			quarter(x, 2, 7, 8, 13);
+			quarter(x, 3, 4, 9, 14);
+		}
+		for (std::size_t i = 0; i < 16; ++i) {
+			std::uint32_t v = x[i] + in[i];
+			out[4 * i] = static_cast<std::uint8_t>(v);
+			out[4 * i + 1] = static_cast<std::uint8_t>(v >> 8);
+			out[4 * i + 2] = static_cast<std::uint8_t>(v >> 16);
+			out[4 * i + 3] = static_cast<std::uint8_t>(v >> 24);
+		}
+	}
+
+private:
+	static std::uint32_t rotl(std::uint32_t v, int n) { return (v << n) | (v >> (32 - n)); }
+
+	static void quarter(std::array<std::uint32_t, 16>& x, int a, int b, int c, int d) {
+		x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+		x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+		x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+		x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+	}
+
+	void reseed() {
+		std::random_device rd;
+		Key key;
+		Nonce nonce;
+		for (auto& w : key) w = rd();
+		for (auto& w : nonce) w = rd();
+		set_state(key, nonce, 0);
+	}
+
+	void set_state(const Key& key, const Nonce& nonce, std::uint32_t counter) {
+		state_ = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+		std::copy(key.begin(), key.end(), state_.begin() + 4);
+		state_[12] = counter;
+		std::copy(nonce.begin(), nonce.end(), state_.begin() + 13);
+		used_ = block_.size();
+	}
+
+	void refill() {
+		if (spent_) reseed();
+		block(state_, block_);
+		used_ = 0;
+		spent_ = ++state_[12] == 0;
+	}
+
+	std::array<std::uint32_t, 16> state_{};
+	std::array<std::uint8_t, 64> block_{};
+	std::size_t used_ = 64;
+	bool spent_ = false;
+};
+
+// Hierarchical timing wheel of one-second ticks: levels of 64 slots, each
+// level's slot spanning the whole level below, 64^4 s (~194 days) in all.
+// Adding a timer and each tick are O(1); a timer is moved down at most
+// once per level on its way to firing. Timers cannot be cancelled: the
+// owner checks what a fired entry refers to. Not synchronized.
+template <typename T>
+class TimerWheel {
+public:
+	static constexpr unsigned slot_bits = 6;
+	static constexpr std::size_t slots = std::size_t{ 1 } << slot_bits;
+	static constexpr std::size_t levels = 4;
+
+	explicit TimerWheel(std::int64_t now = 0) : now_(now) {}
+
+	// Fires at the first tick at or after due.
+	void add(T item, std::int64_t due) {
+		if (due <= now_) due = now_ + 1;
+		place(Entry{ std::move(item), due });
+		++size_;
+	}
+
+	// Ticks up to now and calls fire(item, due) for every timer that came
+	// due, in order of ticks.
+	template <typename Fire>
+	void advance(std::int64_t now, Fire&& fire) {
+		if (size_ == 0) {
+			now_ = std::max(now_, now);
+			return;
+		}
+		while (now_ < now) {
+			++now_;
+			// Entering a new span of a higher level: spread its slot out.
+			for (std::size_t level = 1; level < levels; ++level) {
+				if ((now_ & ((std::int64_t{ 1 } << (slot_bits * level)) - 1)) != 0) break;
+				auto& slot = wheel_[level][index(now_, level)];
+				std::vector<Entry> moved = std::move(slot);
+				slot.clear();
+				for (auto& e : moved) place(std::move(e));
+			}
+
+			auto& due = wheel_[0][index(now_, 0)];
+			if (due.empty()) continue;
+			std::vector<Entry> firing = std::move(due);
+			due.clear();
+			size_ -= firing.size();
+			for (auto& e : firing) fire(std::move(e.item), e.due);
+		}
+	}
+
+	std::int64_t now() const { return now_; }
+	std::size_t size() const { return size_; }
+
+private:
+	struct Entry {
+		T item;
+		std::int64_t due;
+	};
+
+	static std::size_t index(std::int64_t t, std::size_t level) {
+		return static_cast<std::size_t>(t >> (slot_bits * level)) & (slots - 1);
+	}
+
+	// Into the lowest level whose span reaches due; a due time past the
+	// last level waits in its farthest slot and is placed again later.
+	void place(Entry e) {
+		std::int64_t delta = e.due - now_;
+		for (std::size_t level = 0; level < levels; ++level) {
+			if (delta < (std::int64_t{ 1 } << (slot_bits * (level + 1)))) {
+				wheel_[level][index(e.due, level)].push_back(std::move(e));
+				return;
+			}
+		}
+		std::int64_t far = now_ + (std::int64_t{ 1 } << (slot_bits * levels)) - 1;
+		wheel_[levels - 1][index(far, levels - 1)].push_back(std::move(e));
+	}
+
+	std::array<std::array<std::vector<Entry>, slots>, levels> wheel_;
+	std::int64_t now_;
+	std::size_t size_ = 0;
+};
+
+// Sessions (token -> login) with idle and absolute expiry. Tokens are
+// drawn from a per-thread ChaChaRng. Each of the hash-partitioned shards
+// is an open-addressing table keyed on the token bytes, which are random
+// and so hash themselves, plus a TimerWheel holding one timer per
+// session.
+//
+// Lookups take a shared lock and only stamp the session's last use; the
+// idle deadline it implies is checked when the timer fires, and a
+// session still in use is put back on the wheel for its new deadline.
+// An expired session is not returned even before its timer reaps it.
+// Times are whole seconds on a caller-chosen monotonic clock.
+class SessionStore {
+public:
+	static constexpr unsigned shard_bits = 4;
+	static constexpr std::size_t shard_count = std::size_t{ 1 } << shard_bits;
+
+	struct Expired {
+		SessionToken token;
+		std::string login;
+	};
+
+	explicit SessionStore(SessionConfig config = {}, std::int64_t now = 0)
+		: idle_ttl_(config.idle_ttl.count()), absolute_ttl_(config.absolute_ttl.count()) {
+		for (auto& shard : shards_) shard.wheel = TimerWheel<SessionToken>(now);
+	}
+
+	static SessionToken generate_token() {
+		thread_local ChaChaRng rng;
+		SessionToken token;
+		rng.fill(token.data(), token.size());
+		return token;
+	}
+
+	SessionToken create(const std::string& login, std::int64_t now) {
+		SessionToken token = generate_token();
+		Shard& shard = shard_of(token);
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		shard.insert(token, login, now);
+		shard.wheel.add(token, deadline(now, now));
+		return token;
+	}
+
+	// The session's login, or empty when there is none or it has expired.
+	// Counts as use of the session.
+	std::string find(const SessionToken& token, std::int64_t now) const {
+		const Shard& shard = shard_of(token);
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		const Slot* slot = shard.find(token);
+		if (!slot) return {};
+		std::int64_t used = slot->last_used.load(std::memory_order_relaxed);
+		if (deadline(slot->created, used) <= now) return {};
+		if (used < now) slot->last_used.store(now, std::memory_order_relaxed);
+		return slot->login;
+	}
+
+	// Removes the session and returns its login, empty if there was none.
+	std::string erase(const SessionToken& token) {
+		Shard& shard = shard_of(token);
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		return shard.erase(token);
+	}
+
+	// Runs every shard's wheel up to now and removes the sessions that
+	// expired, returning them so the caller can drop its own references.
+	std::vector<Expired> expire(std::int64_t now) {
+		std::vector<Expired> out;
+		for (auto& shard : shards_) {
+			std::unique_lock<std::shared_mutex> lock(shard.mutex);
+			shard.wheel.advance(now, [&](SessionToken token, std::int64_t) {
+				Slot* slot = shard.find(token);
+				if (!slot) return; // erased before its timer fired
+				std::int64_t due = deadline(slot->created, slot->last_used.load(std::memory_order_relaxed));
+				if (due > shard.wheel.now()) {
+					shard.wheel.add(token, due);
+					return;
+				}
+				out.push_back({ token, shard.erase(token) });
+				});
+		}
+		return out;
+	}
+
+	std::size_t size() const {
+		std::size_t n = 0;
+		for (const auto& shard : shards_) {
+			std::shared_lock<std::shared_mutex> lock(shard.mutex);
+			n += shard.count;
+		}
+		return n;
+	}
+
+private:
+	struct Slot {
+		Slot() = default;
+		Slot(Slot&& o) noexcept { *this = std::move(o); }
+		Slot& operator=(Slot&& o) noexcept {
+			token = o.token;
+			used = o.used;
+			login = std::move(o.login);
+			created = o.created;
+			last_used.store(o.last_used.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
+
+		SessionToken token{};
+		bool used = false;
+		std::string login;
+		std::int64_t created = 0;
+		mutable std::atomic<std::int64_t> last_used{ 0 };
+	};
+
+	// Linear probing over a power-of-two table kept at most half full;
+	// erase shifts the following run back, so there are no tombstones.
+	struct alignas(64) Shard {
+		static constexpr std::size_t initial_capacity = 16;
+
+		mutable std::shared_mutex mutex;
+		std::vector<Slot> slots;
+		std::size_t count = 0;
+		TimerWheel<SessionToken> wheel;
+
+		std::size_t mask() const { return slots.size() - 1; }
+
+		const Slot* find(const SessionToken& token) const {
+			if (slots.empty()) return nullptr;
+			for (std::size_t i = home(token) & mask();; i = (i + 1) & mask()) {
+				const Slot& s = slots[i];
+				if (!s.used) return nullptr;
+				if (s.token == token) return &s;
+			}
+		}
+
+		Slot* find(const SessionToken& token) {
+			return const_cast<Slot*>(static_cast<const Shard*>(this)->find(token));
+		}
+
+		void insert(const SessionToken& token, const std::string& login, std::int64_t now) {
+			if ((count + 1) * 2 > slots.size()) grow();
+			std::size_t i = home(token) & mask();
+			while (slots[i].used) i = (i + 1) & mask();
+			Slot& s = slots[i];
+			s.token = token;
+			s.used = true;
+			s.login = login;
+			s.created = now;
+			s.last_used.store(now, std::memory_order_relaxed);
+			++count;
+		}
+
+		std::string erase(const SessionToken& token) {
+			Slot* found = find(token);
+			if (!found) return {};
+			std::string login = std::move(found->login);
+			std::size_t hole = static_cast<std::size_t>(found - slots.data());
+			for (std::size_t i = (hole + 1) & mask(); slots[i].used; i = (i + 1) & mask()) {
+				// Move back each entry whose home is not in (hole, i].
+				std::size_t h = home(slots[i].token) & mask();
+				if (((i - h) & mask()) >= ((i - hole) & mask())) {
+					slots[hole] = std::move(slots[i]);
+					hole = i;
+				}
+			}
+			slots[hole] = Slot{};
+			--count;
+			return login;
+		}
+
+		void grow() {
+			std::vector<Slot> old = std::move(slots);
+			slots = std::vector<Slot>(old.empty() ? initial_capacity : old.size() * 2);
+			for (auto& s : old) {
+				if (!s.used) continue;
+				std::size_t i = home(s.token) & mask();
+				while (slots[i].used) i = (i + 1) & mask();
+				slots[i] = std::move(s);
+			}
+		}
+	};
+
+	// Tokens are uniformly random: their first bytes pick the bucket and
+	// the last byte the shard.
+	static std::size_t home(const SessionToken& token) {
+		std::uint64_t h;
+		std::memcpy(&h, token.data(), sizeof(h));
+		return static_cast<std::size_t>(h);
+	}
+
+	Shard& shard_of(const SessionToken& token) { return shards_[token.back() & (shard_count - 1)]; }
+	const Shard& shard_of(const SessionToken& token) const { return shards_[token.back() & (shard_count - 1)]; }
+
+	std::int64_t deadline(std::int64_t created, std::int64_t last_used) const {
+		return std::min(last_used + idle_ttl_, created + absolute_ttl_);
+	}
+
+	const std::int64_t idle_ttl_;
+	const std::int64_t absolute_ttl_;
+	std::array<Shard, shard_count> shards_;
+};
@@ -0,0 +1,173 @@
+#include "session_store.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tests {
+
+	bool test_chacha_block() {
+		// RFC 8439, 2.3.2.
+		ChaChaRng::Key key;
+		for (std::uint32_t i = 0; i < 8; ++i) {
+			std::uint32_t b = 4 * i;
+			key[i] = b | (b + 1) << 8 | (b + 2) << 16 | (b + 3) << 24;
+		}
+		ChaChaRng rng(key, { 0x09000000, 0x4a000000, 0x00000000 }, 1);
+		std::uint8_t out[64];
+		rng.fill(out, sizeof(out));
+		const std::uint8_t expected[16] = {
+			0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15,
+			0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4 };
+		for (int i = 0; i < 16; ++i) assert(out[i] == expected[i]);
+		assert(out[60] == 0xa2 && out[61] == 0x50 && out[62] == 0x3c && out[63] == 0x4e);
+		return true;
+	}
+
+	bool test_token_hex() {
+		SessionToken t{};
+		for (std::size_t i = 0; i < t.size(); ++i) t[i] = static_cast<std::uint8_t>(i * 17);
+		std::string hex = to_hex(t);
+		assert(hex == "00112233445566778899aabbccddeeff");
+
+		SessionToken back{};
+		bool ok = from_hex(hex, back);
+		assert(ok && back == t);
+		back = {};
+		ok = from_hex("00112233445566778899AABBCCDDEEFF", back);
+		assert(ok && back == t);
+		bool short_ok = from_hex("00112233445566778899aabbccddeef", back);
+		bool bad_ok = from_hex("00112233445566778899aabbccddeefg", back);
+		bool empty_ok = from_hex("", back);
+		assert(!short_ok && !bad_ok && !empty_ok);
+
+		// Tokens are distinct across threads.
+		std::set<SessionToken> seen;
+		for (int i = 0; i < 1000; ++i) seen.insert(SessionStore::generate_token());
+		SessionToken other;
+		std::thread([&] { other = SessionStore::generate_token(); }).join();
+		seen.insert(other);
+		assert(seen.size() == 1001);
+		return true;
+	}
+
+	bool test_timer_wheel() {
+		TimerWheel<int> wheel(100);
+		const std::int64_t dues[] = { 100, 101, 163, 164, 5000, 300000, 100 + (std::int64_t{ 1 } << 24) + 7 };
+		for (int i = 0; i < 7; ++i) wheel.add(i, dues[i]);
+		assert(wheel.size() == 7);
+
+		std::vector<std::pair<int, std::int64_t>> fired;
+		auto record = [&](int item, std::int64_t) { fired.push_back({ item, wheel.now() }); };
+		wheel.advance(99, record);
+		assert(fired.empty());
+		wheel.advance(200000, record);
+		assert(fired.size() == 5);
+		assert(fired[0].first == 0 && fired[0].second == 101); // already due: next tick
+		assert(fired[1].first == 1 && fired[1].second == 101);
+		assert(fired[2].second == 163 && fired[3].second == 164 && fired[4].second == 5000);
+
+		wheel.advance(dues[6] + 1, record);
+		assert(fired.size() == 7);
+		assert(fired[5].second == 300000 && fired[6].second == dues[6]);
+		assert(wheel.size() == 0);
+		return true;
+	}
+
+	bool test_session_store_expiry() {
+		SessionStore store(SessionConfig{ std::chrono::seconds(60), std::chrono::seconds(1000) }, 10);
+		SessionToken a = store.create("alice", 10);
+		SessionToken b = store.create("bob", 10);
+		std::string la = store.find(a, 11);
+		std::string lb = store.find(b, 11);
+		assert(la == "alice" && lb == "bob");
+
+		// bob goes idle; alice keeps being used and survives her first timer.
+		for (std::int64_t t = 20; t <= 200; t += 20) {
+			la = store.find(a, t);
+			assert(la == "alice");
+			auto expired = store.expire(t);
+			if (t < 80) assert(expired.empty());
+			if (t == 80) assert(expired.size() == 1 && expired[0].token == b && expired[0].login == "bob");
+		}
+		lb = store.find(b, 200);
+		assert(lb.empty());
+		assert(store.size() == 1);
+
+		// Past due but not yet reaped: already gone for lookups.
+		la = store.find(a, 261);
+		assert(la.empty());
+		auto reaped = store.expire(261);
+		assert(reaped.size() == 1 && store.size() == 0);
+
+		// The absolute TTL holds however busy the session is.
+		SessionToken c = store.create("carol", 300);
+		for (std::int64_t t = 330; t <= 1350; t += 30) {
+			bool alive = t < 300 + 1000;
+			std::string lc = store.find(c, t);
+			assert(lc.empty() != alive);
+			store.expire(t);
+		}
+		assert(store.size() == 0);
+
+		// Erased sessions leave a stale timer behind, which is skipped.
+		SessionToken d = store.create("dave", 2000);
+		std::string first = store.erase(d);
+		std::string second = store.erase(d);
+		assert(first == "dave" && second.empty());
+		reaped = store.expire(3000);
+		assert(reaped.empty());
+		return true;
+	}
+
+	bool test_session_store_table() {
+		SessionStore store(SessionConfig{}, 0);
+		std::vector<SessionToken> tokens;
+		for (int i = 0; i < 5000; ++i) tokens.push_back(store.create("u" + std::to_string(i), 0));
+		assert(store.size() == 5000);
+
+		// Erase every third, shifting runs back, then check everyone else.
+		for (std::size_t i = 0; i < tokens.size(); i += 3) {
+			std::string login = store.erase(tokens[i]);
+			assert(login == "u" + std::to_string(i));
+		}
+		for (std::size_t i = 0; i < tokens.size(); ++i) {
+			std::string login = store.find(tokens[i], 1);
+			assert(i % 3 == 0 ? login.empty() : login == "u" + std::to_string(i));
+		}
+		SessionToken unknown{};
+		std::string found = store.find(unknown, 1);
+		std::string erased = store.erase(unknown);
+		assert(found.empty() && erased.empty());
+		return true;
+	}
+
+	int RunSessionStoreTests(bool verbose) {
+		try {
+			if (verbose) std::cout << "test_chacha_block...\n";
+			test_chacha_block();
+
+			if (verbose) std::cout << "test_token_hex...\n";
+			test_token_hex();
+
+			if (verbose) std::cout << "test_timer_wheel...\n";
+			test_timer_wheel();
+
+			if (verbose) std::cout << "test_session_store_expiry...\n";
+			test_session_store_expiry();
+
+			if (verbose) std::cout << "test_session_store_table...\n";
+			test_session_store_table();
+
+			std::cout << "All session store tests passed.\n";
+		}
+		catch (const std::exception& ex) {
+			std::cerr << "Test threw exception: " << ex.what() << "\n";
+			return 1;
+		}
+		return 0;
+	}
+};
@@ -1,14 +1,38 @@
 #include "user_service.hpp"
 
 
+// add_dot skips users that are not cached, so a dot queued after the
+// flush would be missing from both the read and the cache. The read is
+// cached only if no write for this login was queued meanwhile, which
+// add_dot records under the cache lock it queues and appends under, so a
+// write is either in the read or appended to it, never both. After a few
+// tries the read is returned uncached and the next one loads again.
+DotSnapshot UserService::load_dots(const std::string& login) {
+    std::vector<DotView> dots;
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        std::uint64_t mark = local_.begin_load(login);
+        try {
+            db_.flush_writes();
+            dots = db_.db_get_dots(login);
+        }
+        catch (...) {
+            local_.end_load(login, mark);
+            throw;
+        }
+        auto snap = local_.set_loaded_dots(login, mark, dots);
+        if (snap) return std::move(*snap);
+    }
+    return DotLog(std::move(dots)).snapshot();
+}
+
 Result<AuthResult> UserService::login(const std::string& login, const std::string& password) {
     try {
         if (!db_.db_check_password(login, password)) {
             return Result<AuthResult>::failure(UserError::InvalidCredentials);
         }
 
-        auto dots = db_.db_get_dots(login);
-        local_.set_dots(login, dots);
+        auto cached = local_.get_dots(login);
+        DotSnapshot dots = cached ? std::move(*cached) : load_dots(login);
         std::string token = local_.create_session(login);
 
         AuthResult ar{ token, std::move(dots) };
@@ -25,10 +49,10 @@ Result<AuthResult> UserService::register_user(const std::string& login, const st
             return Result<AuthResult>::failure(UserError::UserAlreadyExists);
         }
 
-        local_.set_dots(login, {});
+        DotSnapshot dots = local_.set_dots(login, {});
         std::string token = local_.create_session(login);
 
-        AuthResult ar{ token, {} };
+        AuthResult ar{ token, std::move(dots) };
         return Result<AuthResult>::success(std::move(ar));
     }
     catch (...) {
@@ -43,6 +67,9 @@ ResultVoid UserService::logout(const std::string& token) {
 
 ResultVoid UserService::remove_user_by_login(const std::string& login) {
     try {
+        // Queued dots of this user would otherwise be written after the
+        // delete and dropped as belonging to an unknown user.
+        db_.flush_writes();
         bool ok = db_.db_delete_user(login);
         if (!ok) {
             return ResultVoid::failure(UserError::UserNotFound);
@@ -61,8 +88,9 @@ std::string UserService::login_from_token(const std::string& token) const {
 
 Result<DotView> UserService::add_dot(const std::string& login, const DotView& dot) {
     try {
-        local_.add_dot(login, dot);
-        db_.push_task(DbTask{ login, dot });
+        if (!local_.add_dot(login, dot, [&] { return db_.push_task(DbTask{ login, { dot } }); })) {
+            return Result<DotView>::failure(UserError::Busy);
+        }
         return Result<DotView>::success(dot);
     }
     catch (...) {
@@ -70,8 +98,21 @@ Result<DotView> UserService::add_dot(const std::string& login, const DotView& do
     }
 }
 
+ResultVoid UserService::add_dots(const std::string& login, const std::vector<DotView>& dots) {
+    try {
+        if (!local_.add_dots(login, dots, [&] { return db_.push_task(DbTask{ login, dots }); })) {
+            return ResultVoid::failure(UserError::Busy);
+        }
+        return ResultVoid::success(Unit{});
+    }
+    catch (...) {
+        return ResultVoid::failure(UserError::DbError);
+    }
+}
+
 ResultVoid UserService::clear_dots(const std::string& login) {
     try {
+        db_.flush_writes();
         db_.db_clear_dots(login);
         local_.clear_dots(login);
         return ResultVoid::success(Unit{});
@@ -81,18 +122,15 @@ ResultVoid UserService::clear_dots(const std::string& login) {
     }
 }
 
-Result<std::vector<DotView>> UserService::get_dots(const std::string& login) {
-    auto dots = local_.get_dots(login);
-    if (!dots.empty()) {
-        return Result<std::vector<DotView>>::success(std::move(dots));
+Result<DotSnapshot> UserService::get_dots(const std::string& login) {
+    if (auto cached = local_.get_dots(login)) {
+        return Result<DotSnapshot>::success(std::move(*cached));
     }
 
     try {
-        dots = db_.db_get_dots(login);
-        local_.set_dots(login, dots);
-        return Result<std::vector<DotView>>::success(std::move(dots));
+        return Result<DotSnapshot>::success(load_dots(login));
     }
     catch (...) {
-        return Result<std::vector<DotView>>::failure(UserError::DbError);
+        return Result<DotSnapshot>::failure(UserError::DbError);
     }
 }
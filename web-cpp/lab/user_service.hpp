@@ -13,7 +13,8 @@ enum class UserError {
     UserAlreadyExists,  
     UserNotFound,
     Unauthorized,
-    DbError
+    DbError,
+    Busy            // DB write queue full, retry later
 };
 
 template <typename T>
@@ -44,7 +45,7 @@ using ResultVoid = Result<Unit>;
 
 struct AuthResult {
     std::string token;
-    std::vector<DotView> dots;
+    DotSnapshot dots;
 };
 
 class UserService {
@@ -62,10 +63,23 @@ public:
     std::string login_from_token(const std::string& token) const;
 
     Result<DotView> add_dot(const std::string& login, const DotView& dot);
+    ResultVoid add_dots(const std::string& login, const std::vector<DotView>& dots);
     ResultVoid clear_dots(const std::string& login);
-    Result<std::vector<DotView>> get_dots(const std::string& login);
+    Result<DotSnapshot> get_dots(const std::string& login);
+
+    // The user's dots if cached; never touches the database.
+    std::optional<DotSnapshot> cached_dots(const std::string& login) const { return local_.get_dots(login); }
+
+    // co_await run_async([&] { return login(l, p); }) runs a blocking call
+    // on the database executor instead of the caller's thread; it yields
+    // nullopt when the executor's queue is full.
+    template <typename F>
+    auto run_async(F fn) { return db_.executor().run(std::move(fn)); }
 
 private:
+    // Fills the cache from the database once queued writes are in.
+    DotSnapshot load_dots(const std::string& login);
+
     DbUserRepository& db_;
     LocalUserRepository& local_;
 };
@@ -1,4 +1,5 @@
 #include "json/json.hpp"
+#include "json/json_bind.hpp"
 #include "web/http_server/http_server.hpp"
 #include "web/http_server/http_responses.hpp"
 
@@ -35,7 +36,7 @@ namespace utils {
     }
 
 
-    bool parse_json_object(const std::string& body,
+    bool parse_json_object(std::string_view body,
         JsonValue& out_val,
         std::unique_ptr<JsonObjectView>& out_view) {
         try {
@@ -49,23 +50,17 @@ namespace utils {
         }
     }
 
-    bool parse_and_require_fields(HttpRequest& req,
-        HttpResponse& resp,
-        const std::initializer_list<const char*>& required_fields,
-        JsonValue& root,
-        std::unique_ptr<JsonObjectView>& obj) {
-        if (!parse_json_object(req.body, root, obj)) {
+    // Binds the body straight into a JsonFields-described struct; any
+    // syntax, type or missing-field error answers 400.
+    template <JsonBound T>
+    bool parse_body(HttpRequest& req, HttpResponse& resp, T& out) {
+        try {
+            json_bind::read(req.body, out);
+        }
+        catch (...) {
             respond::BAD_REQUEST(resp);
             return false;
         }
-
-        for (const char* field : required_fields) {
-            if (!obj->has(field)) {
-                respond::BAD_REQUEST(resp);
-                return false;
-            }
-        }
-
         return true;
     }
 };
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "lab/user_service.hpp"
 #include "utils/utils.hpp"
 
+#include <algorithm>
 #include <chrono>
 
 #include <iostream>
@@ -20,48 +21,65 @@ DbUserRepository* db = nullptr;
 LocalUserRepository g_local_users;
 UserService* g_user_service = nullptr;
 
+// Rough size of one serialized dot, to reserve response buffers once.
+constexpr std::size_t dot_json_size_hint = 96;
 
-std::string extract_token(const std::string& auth_header) {
-	const std::string prefix = "Bearer ";
+// Upper bound on dots per /api/main/add_batch request.
+constexpr std::size_t max_batch_dots = 10000;
+
+// Checked on every dot before the hit test runs.
+const HitChecker::Limits dot_limits{};
+
+
+std::string extract_token(std::string_view auth_header) {
+	const std::string_view prefix = "Bearer ";
 	if (auth_header.size() >= prefix.size() &&
 		auth_header.compare(0, prefix.size(), prefix) == 0) {
 
-		std::string token = auth_header.substr(prefix.size());
+		std::string_view token = auth_header.substr(prefix.size());
 		std::size_t b = token.find_first_not_of(" \t\r\n");
 		std::size_t e = token.find_last_not_of(" \t\r\n");
-		if (b == std::string::npos) return {};
-		return token.substr(b, e - b + 1);
+		if (b == std::string_view::npos) return {};
+		return std::string(token.substr(b, e - b + 1));
 	}
 	return {};
 }
 
+// Sends dots [from, size()) as the elements of a JSON array the caller
+// has opened in resp.body, followed by close. They go out as shared views
+// of the snapshot's pre-rendered JSON, so nothing is serialized or copied
+// per request and Content-Length is known up front.
+void append_dot_elements(HttpResponse& resp, const DotSnapshot& dots, std::size_t from, std::string close) {
+	dots.json_elements(from, [&resp](std::shared_ptr<const void> owner, std::string_view bytes) {
+		resp.body_parts.emplace_back(std::move(owner), bytes);
+		});
+	resp.body_parts.emplace_back(std::move(close));
+}
+
 std::string get_login_from_auth(const HttpRequest& req) {
-	const std::string& auth = req.header("Authorization");
+	std::string_view auth = req.header("Authorization");
 	std::string token = extract_token(auth);
 	if (token.empty() || !g_user_service) return {};
 	return g_user_service->login_from_token(token);
 }
 
-void handle_login(HttpRequest& req, HttpResponse& resp) {
-	JsonValue root;
-	std::unique_ptr<JsonObjectView> obj;
-
-	if (!utils::parse_and_require_fields(req, resp, { "login", "password" }, root, obj)) {
-		return;
+// The handlers below that reach the database are coroutines: they wait
+// for it on the repository's executor, not on an HTTP worker, and answer
+// 503 BUSY when that executor is saturated.
+AsyncTask handle_login(HttpRequest& req, HttpResponse& resp) {
+	LoginRequest body;
+	if (!utils::parse_body(req, resp, body)) {
+		co_return;
 	}
+	const std::string& login = body.login;
+	const std::string& password = body.password;
 
-	std::string login;
-	std::string password;
-	try {
-		login = obj->get<std::string>("login");
-		password = obj->get<std::string>("password");
-	}
-	catch (...) {
-		respond::BAD_REQUEST(resp);
-		return;
+	auto call = co_await g_user_service->run_async([&] { return g_user_service->login(login, password); });
+	if (!call) {
+		respond::BUSY(resp);
+		co_return;
 	}
-
-	auto result = g_user_service->login(login, password);
+	auto& result = *call;
 	if (!result.ok()) {
 		switch (result.error) {
 		case UserError::InvalidCredentials:
@@ -72,43 +90,31 @@ void handle_login(HttpRequest& req, HttpResponse& resp) {
 			respond::SERVICE_UNAVAILABLE(resp);
 			break;
 		}
-		return;
+		co_return;
 	}
 
 	const auto& auth_res = *result.value;
 
-	JsonValue::object resp_obj;
-	resp_obj["token"] = JsonValue(auth_res.token);
-
-	JsonValue::array dots_arr;
-	for (const auto& d : auth_res.dots) {
-		dots_arr.push_back(d.to_json());
-	}
-	resp_obj["dots"] = JsonValue(dots_arr);
-
-	respond::OK(resp, JsonValue(resp_obj));
+	respond::OK_JSON(resp, [&auth_res](JsonWriter& w) {
+		w.begin_object().member("token", auth_res.token).key("dots").begin_array();
+		});
+	append_dot_elements(resp, auth_res.dots, 0, "]}");
 }
 
-void handle_register(HttpRequest& req, HttpResponse& resp) {
-	JsonValue root;
-	std::unique_ptr<JsonObjectView> obj;
-
-	if (!utils::parse_and_require_fields(req, resp, { "login", "password" }, root, obj)) {
-		return;
+AsyncTask handle_register(HttpRequest& req, HttpResponse& resp) {
+	LoginRequest body;
+	if (!utils::parse_body(req, resp, body)) {
+		co_return;
 	}
+	const std::string& login = body.login;
+	const std::string& password = body.password;
 
-	std::string login;
-	std::string password;
-	try {
-		login = obj->get<std::string>("login");
-		password = obj->get<std::string>("password");
+	auto call = co_await g_user_service->run_async([&] { return g_user_service->register_user(login, password); });
+	if (!call) {
+		respond::BUSY(resp);
+		co_return;
 	}
-	catch (...) {
-		respond::BAD_REQUEST(resp);
-		return;
-	}
-
-	auto result = g_user_service->register_user(login, password);
+	auto& result = *call;
 	if (!result.ok()) {
 		switch (result.error) {
 		case UserError::UserAlreadyExists:
@@ -119,20 +125,18 @@ void handle_register(HttpRequest& req, HttpResponse& resp) {
 			respond::SERVICE_UNAVAILABLE(resp);
 			break;
 		}
-		return;
+		co_return;
 	}
 
 	const auto& auth_res = *result.value;
 
-	JsonValue::object resp_obj;
-	resp_obj["token"] = JsonValue(auth_res.token);
-	resp_obj["dots"] = JsonValue(JsonValue::array{});
-
-	respond::OK(resp, JsonValue(resp_obj));
+	respond::OK_JSON(resp, [&auth_res](JsonWriter& w) {
+		w.begin_object().member("token", auth_res.token).key("dots").begin_array().end_array().end_object();
+		});
 }
 
 void handle_logout(HttpRequest& req, HttpResponse& resp) {
-	const std::string& auth = req.header("Authorization");
+	std::string_view auth = req.header("Authorization");
 	std::string token = extract_token(auth);
 
 	if (!token.empty()) {
@@ -142,21 +146,26 @@ void handle_logout(HttpRequest& req, HttpResponse& resp) {
 	respond::OK(resp);
 }
 
-void handle_remove(HttpRequest& req, HttpResponse& resp) {
-	const std::string& auth = req.header("Authorization");
+AsyncTask handle_remove(HttpRequest& req, HttpResponse& resp) {
+	std::string_view auth = req.header("Authorization");
 	std::string token = extract_token(auth);
 	if (token.empty()) {
 		respond::UNAUTHORIZED(resp);
-		return;
+		co_return;
 	}
 
 	std::string login = g_user_service->login_from_token(token);
 	if (login.empty()) {
 		respond::UNAUTHORIZED(resp);
-		return;
+		co_return;
 	}
 
-	auto res = g_user_service->remove_user_by_login(login);
+	auto call = co_await g_user_service->run_async([&] { return g_user_service->remove_user_by_login(login); });
+	if (!call) {
+		respond::BUSY(resp);
+		co_return;
+	}
+	auto& res = *call;
 	if (!res.ok()) {
 		switch (res.error) {
 		case UserError::UserNotFound:
@@ -167,7 +176,7 @@ void handle_remove(HttpRequest& req, HttpResponse& resp) {
 			respond::SERVICE_UNAVAILABLE(resp);
 			break;
 		}
-		return;
+		co_return;
 	}
 
 	respond::NO_CONTENT(resp);
@@ -186,93 +195,184 @@ void handle_add_dot(HttpRequest& req, HttpResponse& resp) {
 		return;
 	}
 
-	JsonValue root;
-	std::unique_ptr<JsonObjectView> obj;
-
-	if (!utils::parse_and_require_fields(req, resp, { "x", "y", "r" }, root, obj)) {
+	AddDotRequest body;
+	if (!utils::parse_body(req, resp, body)) {
 		return;
 	}
-
-	std::string x;
-	std::string y;
-	std::string r;
-	try {
-		x = obj->get<std::string>("x");
-		y = obj->get<std::string>("y");
-		r = obj->get<std::string>("r");
-	}
-	catch (std::exception&) {
+	if (!HitChecker::validate(body.x, body.y, body.r, dot_limits)) {
 		respond::BAD_REQUEST(resp);
 		return;
 	}
 
 	long long start = utils::current_time_millis();
-	bool hit = HitChecker().hit_check(x, y, r);
+	bool hit = HitChecker().hit_check(body.x, body.y, body.r);
 	long long exec_time = utils::current_time_millis() - start;
-	DotView dot{ x, y, r, hit, exec_time, utils::current_iso_local_datetime() };
+	DotView dot{ std::move(body.x), std::move(body.y), std::move(body.r), hit, exec_time, utils::current_iso_local_datetime() };
 
 	auto res = g_user_service->add_dot(login, dot);
 	if (!res.ok()) {
-		respond::SERVICE_UNAVAILABLE(resp);
+		if (res.error == UserError::Busy) respond::BUSY(resp);
+		else respond::SERVICE_UNAVAILABLE(resp);
 		return;
 	}
 
-	respond::OK(resp, dot.to_json());
+	respond::OK_JSON(resp, [&dot](JsonWriter& w) { w.value(dot); });
 }
 
-void handle_clear_dots(HttpRequest& req, HttpResponse& resp) {
+void handle_add_dot_batch(HttpRequest& req, HttpResponse& resp) {
 	std::string login = get_login_from_auth(req);
 	if (login.empty()) {
 		respond::UNAUTHORIZED(resp);
 		return;
 	}
 
-	auto res = g_user_service->clear_dots(login);
+	AddDotBatchRequest body;
+	if (!utils::parse_body(req, resp, body)) {
+		return;
+	}
+	if (body.dots.empty() || body.dots.size() > max_batch_dots) {
+		respond::BAD_REQUEST(resp);
+		return;
+	}
+
+	std::vector<HitChecker::Point> points;
+	points.reserve(body.dots.size());
+	for (const auto& d : body.dots) {
+		if (!HitChecker::validate(d.x, d.y, d.r, dot_limits)) {
+			respond::BAD_REQUEST(resp);
+			return;
+		}
+		points.push_back({ d.x, d.y, d.r });
+	}
+
+	// execTime of every dot in the batch is the time of the whole batch.
+	std::vector<std::uint8_t> hits;
+	long long start = utils::current_time_millis();
+	try {
+		HitChecker().hit_check_batch(points, hits);
+	}
+	catch (const std::exception&) {
+		respond::BAD_REQUEST(resp);
+		return;
+	}
+	long long exec_time = utils::current_time_millis() - start;
+	std::string now = utils::current_iso_local_datetime();
+
+	std::vector<DotView> dots;
+	dots.reserve(body.dots.size());
+	for (std::size_t i = 0; i < body.dots.size(); ++i) {
+		auto& d = body.dots[i];
+		dots.push_back(DotView{ std::move(d.x), std::move(d.y), std::move(d.r), hits[i] != 0, exec_time, now });
+	}
+
+	auto res = g_user_service->add_dots(login, dots);
 	if (!res.ok()) {
-		respond::SERVICE_UNAVAILABLE(resp);
+		if (res.error == UserError::Busy) respond::BUSY(resp);
+		else respond::SERVICE_UNAVAILABLE(resp);
 		return;
 	}
 
-	respond::OK(resp);
+	respond::OK_JSON(resp, [&dots](JsonWriter& w) {
+		w.begin_array();
+		for (const auto& d : dots) {
+			w.value(d);
+		}
+		w.end_array();
+		}, 2 + dots.size() * dot_json_size_hint);
 }
 
-void handle_get_dots(HttpRequest& req, HttpResponse& resp) {
+AsyncTask handle_clear_dots(HttpRequest& req, HttpResponse& resp) {
 	std::string login = get_login_from_auth(req);
 	if (login.empty()) {
 		respond::UNAUTHORIZED(resp);
-		return;
+		co_return;
 	}
 
-	auto res = g_user_service->get_dots(login);
-	if (!res.ok()) {
+	auto call = co_await g_user_service->run_async([&] { return g_user_service->clear_dots(login); });
+	if (!call) {
+		respond::BUSY(resp);
+		co_return;
+	}
+	if (!call->ok()) {
 		respond::SERVICE_UNAVAILABLE(resp);
-		return;
+		co_return;
 	}
 
-	JsonValue::array arr;
-	for (const auto& d : *res.value) {
-		arr.push_back(d.to_json());
+	respond::OK(resp);
+}
+
+// Cached dots are served inline; only a miss, which flushes queued
+// writes and reads the database, waits on the executor.
+AsyncTask handle_get_dots(HttpRequest& req, HttpResponse& resp) {
+	std::string login = get_login_from_auth(req);
+	if (login.empty()) {
+		respond::UNAUTHORIZED(resp);
+		co_return;
 	}
 
-	respond::OK(resp, JsonValue(arr));
+	DotSnapshot dots;
+	if (auto cached = g_user_service->cached_dots(login)) {
+		dots = std::move(*cached);
+	}
+	else {
+		auto call = co_await g_user_service->run_async([&] { return g_user_service->get_dots(login); });
+		if (!call) {
+			respond::BUSY(resp);
+			co_return;
+		}
+		if (!call->ok()) {
+			respond::SERVICE_UNAVAILABLE(resp);
+			co_return;
+		}
+		dots = std::move(*call->value);
+	}
+
+	// Polling: a client that sends back the ETag it holds gets 304 while
+	// nothing changed. With ?since=N and an ETag of the same generation
+	// only dots from index N on are sent; X-Dots-From says where the
+	// array starts, 0 meaning the full list.
+	std::string etag = dots.etag();
+	std::string_view if_none_match = req.header("If-None-Match");
+	if (if_none_match == etag) {
+		respond::NOT_MODIFIED(resp);
+		resp.headers["ETag"] = etag;
+		co_return;
+	}
+
+	std::size_t from = 0;
+	if (auto since = req.query_param_int("since");
+		since && *since > 0 && static_cast<std::size_t>(*since) <= dots.size() &&
+		dots.same_generation(if_none_match)) {
+		from = static_cast<std::size_t>(*since);
+	}
+
+	respond::OK_JSON(resp, [](JsonWriter& w) { w.begin_array(); });
+	append_dot_elements(resp, dots, from, "]");
+	resp.headers["ETag"] = etag;
+	resp.headers["X-Dots-From"] = std::to_string(from);
 }
 
 void setup_routes(Router& r) {
-	r.add_route(HttpMethod::Post, "/api/auth/login", handle_login);
-	r.add_route(HttpMethod::Post, "/api/auth/register", handle_register);
+	r.add_async_route(HttpMethod::Post, "/api/auth/login", handle_login);
+	r.add_async_route(HttpMethod::Post, "/api/auth/register", handle_register);
 	r.add_route(HttpMethod::Post, "/api/auth/logout", handle_logout);
-	r.add_route(HttpMethod::Post, "/api/auth/remove", handle_remove);
+	r.add_async_route(HttpMethod::Post, "/api/auth/remove", handle_remove);
 
 	r.add_route(HttpMethod::Get, "/api/main/time", handle_time);
 	r.add_route(HttpMethod::Post, "/api/main/add", handle_add_dot);
-	r.add_route(HttpMethod::Post, "/api/main/clear", handle_clear_dots);
-	r.add_route(HttpMethod::Get, "/api/main/dots", handle_get_dots);
+	r.add_route(HttpMethod::Post, "/api/main/add_batch", handle_add_dot_batch);
+	r.add_async_route(HttpMethod::Post, "/api/main/clear", handle_clear_dots);
+	r.add_async_route(HttpMethod::Get, "/api/main/dots", handle_get_dots);
 }
 
 int main() {
 	tests::RunBigDecimalTests(false);
 	tests::RunJsonTests(true);
 	tests::RunHttpServerTests(true);
+	tests::RunDbPoolTests(true);
+	tests::RunDbQueueTests(true);
+	tests::RunLocalUserRepoTests(true);
+	tests::RunSessionStoreTests(true);
 
 	db = new DbUserRepository(
 		"host=localhost "
@@ -288,10 +388,29 @@ int main() {
 	HttpServerConfig cfg;
 	cfg.port = 41395;
 	cfg.enable_cors = true;
+	cfg.io_model = net::IoModel::Reactor;
+	cfg.metrics_path = "/metrics";
 
 	HttpServer server(cfg);
 	setup_routes(server.router());
 
+	// The backlogs behind the handlers, scraped along with the server's own.
+	HttpMetrics& metrics = server.metrics();
+	metrics.add_gauge("webcpp_db_write_queue_dots", "Dots queued for the database writer.",
+		[] { return static_cast<double>(db->pending_dots()); });
+	metrics.add_counter("webcpp_db_write_refused_total", "Dot writes refused by a full write queue.",
+		[] { return static_cast<double>(db->refused_tasks()); });
+	metrics.add_gauge("webcpp_db_executor_queued_jobs", "Database calls waiting for an executor thread.",
+		[] { return static_cast<double>(db->executor().queued()); });
+	metrics.add_counter("webcpp_db_executor_refused_total", "Database calls refused by a full executor queue.",
+		[] { return static_cast<double>(db->executor().refused()); });
+	metrics.add_gauge("webcpp_sessions", "Live sessions.",
+		[] { return static_cast<double>(g_local_users.session_count()); });
+	metrics.add_gauge("webcpp_dot_cache_bytes", "Memory held by cached dots.",
+		[] { return static_cast<double>(g_local_users.dot_bytes()); });
+	metrics.add_counter("webcpp_dot_cache_evictions_total", "Users whose dots were evicted from the cache.",
+		[] { return static_cast<double>(g_local_users.dot_evictions()); });
+
 	std::cout << "Starting HTTP server on port " << cfg.port << "...\n";
 	server.start();
 
@@ -0,0 +1,199 @@
+#include "http_metrics.hpp"
+
+#include <cstdio>
+
+namespace http {
+
+	namespace {
+
+		std::atomic<std::uint64_t> next_metrics_id{ 1 };
+
+		constexpr const char* phase_names[] = { "parse", "route", "handler", "serialize" };
+		constexpr const char* class_names[] = { "1xx", "2xx", "3xx", "4xx", "5xx" };
+
+		void append_double(std::string& out, double v) {
+			char buf[32];
+			int n = std::snprintf(buf, sizeof(buf), "%.9g", v);
+			out.append(buf, static_cast<std::size_t>(n));
+		}
+
+		void append_label(std::string& out, const std::string& value) {
+			for (char c : value) {
+				if (c == '\\' || c == '"') out.push_back('\\');
+				if (c == '\n') {
+					out += "\\n";
+					continue;
+				}
+				out.push_back(c);
+			}
+		}
+
+		void append_header(std::string& out, const char* name, const char* help, const char* type) {
+			out += "# HELP ";
+			out += name;
+			out.push_back(' ');
+			out += help;
+			out += "\n# TYPE ";
+			out += name;
+			out.push_back(' ');
+			out += type;
+			out.push_back('\n');
+		}
+
+		// Bucket bounds of the exposition: powers of four from ~1 us to
+		// ~17 s, which fall on HdrHistogram bucket edges and so are exact.
+		void append_histogram(std::string& out, const char* name, const std::string& labels, const HistogramSnapshot& h) {
+			auto line = [&](const char* suffix, const std::string& extra, const std::string& value) {
+				out += name;
+				out += suffix;
+				if (!labels.empty() || !extra.empty()) {
+					out.push_back('{');
+					out += labels;
+					if (!labels.empty() && !extra.empty()) out.push_back(',');
+					out += extra;
+					out.push_back('}');
+				}
+				out.push_back(' ');
+				out += value;
+				out.push_back('\n');
+				};
+			for (unsigned e = 10; e <= 34; e += 2) {
+				std::uint64_t bound = std::uint64_t{ 1 } << e;
+				std::string le = "le=\"";
+				append_double(le, static_cast<double>(bound) / 1e9);
+				le += "\"";
+				line("_bucket", le, std::to_string(h.count_below(bound)));
+			}
+			std::string sum;
+			append_double(sum, static_cast<double>(h.sum_ns) / 1e9);
+			line("_bucket", "le=\"+Inf\"", std::to_string(h.count));
+			line("_sum", "", sum);
+			line("_count", "", std::to_string(h.count));
+		}
+
+	}
+
+	HttpMetrics::HttpMetrics() : id_(next_metrics_id.fetch_add(1)) {}
+
+	void HttpMetrics::set_routes(std::vector<std::string> labels) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!threads_.empty()) return; // slots are sized already
+		routes_ = std::move(labels);
+	}
+
+	ThreadMetrics& HttpMetrics::local() {
+		thread_local std::uint64_t cached_id = 0;
+		thread_local ThreadMetrics* cached = nullptr;
+		if (cached_id == id_) return *cached;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		ThreadMetrics*& slot = by_thread_[std::this_thread::get_id()];
+		if (!slot) {
+			threads_.push_back(std::make_unique<ThreadMetrics>(routes_.size() + 1));
+			slot = threads_.back().get();
+		}
+		cached_id = id_;
+		cached = slot;
+		return *slot;
+	}
+
+	void HttpMetrics::add_gauge(std::string name, std::string help, std::function<double()> read) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		external_.push_back(External{ std::move(name), std::move(help), "gauge", std::move(read) });
+	}
+
+	void HttpMetrics::add_counter(std::string name, std::string help, std::function<double()> read) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		external_.push_back(External{ std::move(name), std::move(help), "counter", std::move(read) });
+	}
+
+	HistogramSnapshot HttpMetrics::phase(std::size_t series, RequestPhase p) const {
+		HistogramSnapshot out;
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& t : threads_) out.merge(t->phase(series, p));
+		return out;
+	}
+
+	HistogramSnapshot HttpMetrics::send() const {
+		HistogramSnapshot out;
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& t : threads_) out.merge(t->send);
+		return out;
+	}
+
+	std::uint64_t HttpMetrics::requests(std::size_t series) const {
+		std::uint64_t n = 0;
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& t : threads_) n += t->requests[series].load(std::memory_order_relaxed);
+		return n;
+	}
+
+	std::uint64_t HttpMetrics::counter(HttpCounter c) const {
+		std::uint64_t n = 0;
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& t : threads_) n += t->counters[static_cast<std::size_t>(c)].load(std::memory_order_relaxed);
+		return n;
+	}
+
+	std::string HttpMetrics::render_prometheus() const {
+		std::string out;
+		out.reserve(16 * 1024);
+
+		auto route_label = [this](std::size_t s) {
+			std::string l = "route=\"";
+			append_label(l, s < routes_.size() ? routes_[s] : std::string("other"));
+			return l + "\"";
+			};
+
+		append_header(out, "webcpp_http_requests_total", "Requests answered, by route.", "counter");
+		for (std::size_t s = 0; s < series_count(); ++s) {
+			out += "webcpp_http_requests_total{";
+			out += route_label(s);
+			out += "} ";
+			out += std::to_string(requests(s));
+			out.push_back('\n');
+		}
+
+		append_header(out, "webcpp_http_responses_total", "Responses sent, by status class.", "counter");
+		for (std::size_t c = 0; c < 5; ++c) {
+			out += "webcpp_http_responses_total{code=\"";
+			out += class_names[c];
+			out += "\"} ";
+			out += std::to_string(counter(static_cast<HttpCounter>(c)));
+			out.push_back('\n');
+		}
+
+		append_header(out, "webcpp_http_parse_errors_total", "Requests rejected by the parser.", "counter");
+		out += "webcpp_http_parse_errors_total ";
+		out += std::to_string(counter(HttpCounter::ParseErrors));
+		out.push_back('\n');
+
+		append_header(out, "webcpp_http_phase_seconds", "Time per request phase, by route.", "histogram");
+		for (std::size_t s = 0; s < series_count(); ++s) {
+			for (std::size_t p = 0; p < ThreadMetrics::phase_count; ++p) {
+				HistogramSnapshot h = phase(s, static_cast<RequestPhase>(p));
+				if (h.count == 0) continue;
+				append_histogram(out, "webcpp_http_phase_seconds",
+					route_label(s) + ",phase=\"" + phase_names[p] + "\"", h);
+			}
+		}
+
+		append_header(out, "webcpp_http_send_seconds", "Time to hand a batch of responses to the socket.", "histogram");
+		append_histogram(out, "webcpp_http_send_seconds", "", send());
+
+		std::vector<External> external;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			external = external_;
+		}
+		for (const auto& e : external) {
+			append_header(out, e.name.c_str(), e.help.c_str(), e.type);
+			out += e.name;
+			out.push_back(' ');
+			append_double(out, e.read());
+			out.push_back('\n');
+		}
+		return out;
+	}
+
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace http {
+
+	inline std::uint64_t now_ns() {
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// Log-linear latency histogram in the style of HdrHistogram: values in
+	// nanoseconds, 8 linear sub-buckets per power of two, so a bucket is
+	// at most 1/8 of its lower bound wide. Values from 2^37 ns (~2 min) on
+	// land in the last bucket. Written by one thread only (relaxed load and
+	// store, no read-modify-write); any thread may read.
+	class LatencyHistogram {
+	public:
+		static constexpr unsigned sub_bits = 3;
+		static constexpr std::size_t sub_count = std::size_t{ 1 } << sub_bits;
+		static constexpr unsigned max_exponent = 36;
+		static constexpr std::size_t bucket_count = (max_exponent - sub_bits + 2) * sub_count;
+
+		static std::size_t index_of(std::uint64_t v) {
+			if (v < sub_count) return static_cast<std::size_t>(v);
+			unsigned e = static_cast<unsigned>(std::bit_width(v)) - 1;
+			if (e > max_exponent) return bucket_count - 1;
+			return (e - sub_bits + 1) * sub_count + static_cast<std::size_t>((v >> (e - sub_bits)) & (sub_count - 1));
+		}
+
+		// Smallest value that lands in bucket i.
+		static std::uint64_t lower_bound(std::size_t i) {
+			if (i < sub_count) return i;
+			unsigned e = static_cast<unsigned>(i / sub_count) + sub_bits - 1;
+			return static_cast<std::uint64_t>(sub_count + i % sub_count) << (e - sub_bits);
+		}
+
+		void record(std::uint64_t ns) {
+			bump(buckets_[index_of(ns)], 1);
+			bump(count_, 1);
+			bump(sum_, ns);
+		}
+
+		std::uint64_t bucket(std::size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+		std::uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+		std::uint64_t sum_ns() const { return sum_.load(std::memory_order_relaxed); }
+
+	private:
+		static void bump(std::atomic<std::uint64_t>& a, std::uint64_t n) {
+			a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+		std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+		std::atomic<std::uint64_t> count_{ 0 };
+		std::atomic<std::uint64_t> sum_{ 0 };
+	};
+
+	// Plain copy of one or more merged histograms.
+	struct HistogramSnapshot {
+		std::array<std::uint64_t, LatencyHistogram::bucket_count> buckets{};
+		std::uint64_t count = 0;
+		std::uint64_t sum_ns = 0;
+
+		void merge(const LatencyHistogram& h) {
+			for (std::size_t i = 0; i < buckets.size(); ++i) buckets[i] += h.bucket(i);
+			count += h.count();
+			sum_ns += h.sum_ns();
+		}
+
+		// Values below bound; exact when bound is a power of two.
+		std::uint64_t count_below(std::uint64_t bound) const {
+			std::uint64_t n = 0;
+			for (std::size_t i = 0; i < buckets.size() && LatencyHistogram::lower_bound(i) < bound; ++i) n += buckets[i];
+			return n;
+		}
+
+		// Lower bound of the bucket holding quantile q (0..1); 0 when empty.
+		std::uint64_t quantile(double q) const {
+			if (count == 0) return 0;
+			std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1));
+			std::uint64_t seen = 0;
+			for (std::size_t i = 0; i < buckets.size(); ++i) {
+				seen += buckets[i];
+				if (seen > rank) return LatencyHistogram::lower_bound(i);
+			}
+			return LatencyHistogram::lower_bound(buckets.size() - 1);
+		}
+	};
+
+	// Steps of a request that are timed per route. Sending is timed per
+	// write, which may carry several pipelined responses.
+	enum class RequestPhase : std::uint8_t {
+		Parse,
+		Route,
+		Handler,   // until an async handler's task completes
+		Serialize,
+		count_
+	};
+
+	enum class HttpCounter : std::uint8_t {
+		Responses1xx,
+		Responses2xx,
+		Responses3xx,
+		Responses4xx,
+		Responses5xx,
+		ParseErrors, // answered by the parser, connection closed
+		count_
+	};
+
+	// Response counter of a status code; codes outside 100..599 count as 5xx.
+	inline HttpCounter status_counter(int code) {
+		if (code < 100 || code >= 600) return HttpCounter::Responses5xx;
+		return static_cast<HttpCounter>(code / 100 - 1);
+	}
+
+	// Set by HttpServer while it serves a request, for its metrics.
+	struct RequestTiming {
+		std::uint32_t route = 0;         // series index, see HttpMetrics
+		std::uint64_t parse_ns = 0;
+		std::uint64_t handler_start = 0; // now_ns() when the handler was entered
+	};
+
+	// Counters and histograms of the calling thread; only it writes them.
+	struct alignas(64) ThreadMetrics {
+		static constexpr std::size_t phase_count = static_cast<std::size_t>(RequestPhase::count_);
+		static constexpr std::size_t counter_count = static_cast<std::size_t>(HttpCounter::count_);
+
+		explicit ThreadMetrics(std::size_t series)
+			: requests(series), phases(series * phase_count) {}
+
+		LatencyHistogram& phase(std::size_t series, RequestPhase p) {
+			return phases[series * phase_count + static_cast<std::size_t>(p)];
+		}
+
+		void count(HttpCounter c) {
+			auto& a = counters[static_cast<std::size_t>(c)];
+			a.store(a.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		void count_request(std::size_t series) {
+			requests[series].store(requests[series].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		std::vector<std::atomic<std::uint64_t>> requests; // per series
+		std::vector<LatencyHistogram> phases;             // series-major
+		LatencyHistogram send;
+		std::array<std::atomic<std::uint64_t>, counter_count> counters{};
+	};
+
+	// Per-thread metrics of an HttpServer. Recording touches only the
+	// calling thread's ThreadMetrics, found through a thread_local cache, so
+	// workers never share a cache line; readers sum over all threads.
+	// Series 0..n-1 are the router's routes, series n ("other") everything
+	// answered without a route: preflights, 404/405 and parse errors.
+	class HttpMetrics {
+	public:
+		HttpMetrics();
+
+		HttpMetrics(const HttpMetrics&) = delete;
+		HttpMetrics& operator=(const HttpMetrics&) = delete;
+
+		// Names the route series; must come before the first record.
+		void set_routes(std::vector<std::string> labels);
+
+		std::size_t series_count() const { return routes_.size() + 1; }
+		std::uint32_t other_series() const { return static_cast<std::uint32_t>(routes_.size()); }
+
+		// The calling thread's slot, created on first use.
+		ThreadMetrics& local();
+
+		// Read at scrape time and rendered after the built-in series.
+		void add_gauge(std::string name, std::string help, std::function<double()> read);
+		void add_counter(std::string name, std::string help, std::function<double()> read);
+
+		// Sums over all threads.
+		HistogramSnapshot phase(std::size_t series, RequestPhase p) const;
+		HistogramSnapshot send() const;
+		std::uint64_t requests(std::size_t series) const;
+		std::uint64_t counter(HttpCounter c) const;
+
+		// Prometheus text exposition format, version 0.0.4.
+		std::string render_prometheus() const;
+
+	private:
+		struct External {
+			std::string name;
+			std::string help;
+			const char* type;
+			std::function<double()> read;
+		};
+
+		const std::uint64_t id_; // tells instances apart in the thread cache
+		std::vector<std::string> routes_;
+
+		mutable std::mutex mutex_;
+		std::vector<std::unique_ptr<ThreadMetrics>> threads_;
+		std::unordered_map<std::thread::id, ThreadMetrics*> by_thread_;
+		std::vector<External> external_;
+	};
+
+}
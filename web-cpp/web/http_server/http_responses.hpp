@@ -15,13 +15,36 @@ namespace respond
 	{
 		resp.set_status(status, reason);
 		resp.headers["Content-Type"] = "application/json; charset=utf-8";
-		resp.body = body ? body->to_string() : "";
+		resp.body.clear();
+		if (body) {
+			JsonWriter(resp.body).value(*body);
+		}
+	}
+
+	// 200 whose JSON body write(JsonWriter&) serializes straight into
+	// resp.body, which is reserved to size_hint first.
+	template <typename Write>
+	inline void OK_JSON(HttpResponse& resp, Write&& write, std::size_t size_hint = 0) {
+		resp.set_status(200, "OK");
+		resp.headers["Content-Type"] = "application/json; charset=utf-8";
+		resp.body.clear();
+		resp.body.reserve(size_hint);
+		JsonWriter w(resp.body);
+		write(w);
 	}
 
 	inline void OK(HttpResponse& resp, std::optional<JsonValue> body = std::nullopt) {
 		send(resp, 200, "OK", body);
 	}
 
+	// Chunked 200 whose JSON body is produced piece by piece by source.
+	inline void OK_STREAM(HttpResponse& resp, HttpResponse::BodySource source) {
+		resp.set_status(200, "OK");
+		resp.headers["Content-Type"] = "application/json; charset=utf-8";
+		resp.body.clear();
+		resp.body_source = std::move(source);
+	}
+
 	inline void CREATED(HttpResponse& resp, std::optional<JsonValue> body = std::nullopt) {
 		send(resp, 201, "Created", body);
 	}
@@ -30,6 +53,12 @@ namespace respond
 		send(resp, 204, "No Content");
 	}
 
+	// 304 with no body; the caller sets the validator headers.
+	inline void NOT_MODIFIED(HttpResponse& resp) {
+		resp.set_status(304, "Not Modified");
+		resp.body.clear();
+	}
+
 	inline void BAD_REQUEST(HttpResponse& resp) {
 		send(resp, 400, "Bad Request");
 	}
@@ -54,4 +83,10 @@ namespace respond
 		send(resp, 503, "Service Unavailable");
 	}
 
+	// 503 for load shedding: the client may retry after retry_after_s.
+	inline void BUSY(HttpResponse& resp, int retry_after_s = 1) {
+		send(resp, 503, "Service Unavailable");
+		resp.headers["Retry-After"] = std::to_string(retry_after_s);
+	}
+
 };
\ No newline at end of file
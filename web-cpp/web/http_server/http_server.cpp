@@ -2,26 +2,43 @@
 
 #include <algorithm>
 #include <cctype>
-#include <sstream>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
 #include <stdexcept>
 
 namespace {
 
-	inline void ltrim(std::string& s) {
-		s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch) {
-			return !std::isspace(ch);
-			}));
+	inline bool is_space(char c) {
+		return std::isspace(static_cast<unsigned char>(c)) != 0;
 	}
 
-	inline void rtrim(std::string& s) {
-		s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch) {
-			return !std::isspace(ch);
-			}).base(), s.end());
+	inline std::string_view trim_view(std::string_view s) {
+		std::size_t b = 0;
+		std::size_t e = s.size();
+		while (b < e && is_space(s[b])) ++b;
+		while (e > b && is_space(s[e - 1])) --e;
+		return s.substr(b, e - b);
 	}
 
-	inline void trim(std::string& s) {
-		ltrim(s);
-		rtrim(s);
+	inline char lower_ascii(char c) {
+		return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+	}
+
+	inline bool iequals(std::string_view a, std::string_view b) {
+		if (a.size() != b.size()) return false;
+		for (std::size_t i = 0; i < a.size(); ++i) {
+			if (lower_ascii(a[i]) != lower_ascii(b[i])) return false;
+		}
+		return true;
+	}
+
+	inline bool icontains(std::string_view haystack, std::string_view needle) {
+		if (needle.size() > haystack.size()) return false;
+		for (std::size_t i = 0; i + needle.size() <= haystack.size(); ++i) {
+			if (iequals(haystack.substr(i, needle.size()), needle)) return true;
+		}
+		return false;
 	}
 
 	inline std::string to_lower(std::string s) {
@@ -36,11 +53,12 @@ namespace {
 		return s;
 	}
 
-	inline std::string default_reason_phrase(int code) {
+	inline std::string_view default_reason_phrase(int code) {
 		switch (code) {
 		case 200: return "OK";
 		case 201: return "Created";
 		case 204: return "No Content";
+		case 304: return "Not Modified";
 		case 400: return "Bad Request";
 		case 401: return "Unauthorized";
 		case 403: return "Forbidden";
@@ -51,12 +69,75 @@ namespace {
 		case 431: return "Request Header Fields Too Large";
 		case 500: return "Internal Server Error";
 		case 501: return "Not Implemented";
+		case 503: return "Service Unavailable";
 		default:  return "Unknown";
 		}
 	}
 
-	std::string url_decode(const std::string& s) {
-		std::string out;
+	// Full status lines for the codes above, so the common case is one append.
+	inline std::string_view default_status_line(int code) {
+		switch (code) {
+		case 200: return "HTTP/1.1 200 OK\r\n";
+		case 201: return "HTTP/1.1 201 Created\r\n";
+		case 204: return "HTTP/1.1 204 No Content\r\n";
+		case 304: return "HTTP/1.1 304 Not Modified\r\n";
+		case 400: return "HTTP/1.1 400 Bad Request\r\n";
+		case 401: return "HTTP/1.1 401 Unauthorized\r\n";
+		case 403: return "HTTP/1.1 403 Forbidden\r\n";
+		case 404: return "HTTP/1.1 404 Not Found\r\n";
+		case 405: return "HTTP/1.1 405 Method Not Allowed\r\n";
+		case 411: return "HTTP/1.1 411 Length Required\r\n";
+		case 413: return "HTTP/1.1 413 Payload Too Large\r\n";
+		case 431: return "HTTP/1.1 431 Request Header Fields Too Large\r\n";
+		case 500: return "HTTP/1.1 500 Internal Server Error\r\n";
+		case 501: return "HTTP/1.1 501 Not Implemented\r\n";
+		case 503: return "HTTP/1.1 503 Service Unavailable\r\n";
+		default:  return {};
+		}
+	}
+
+	inline void append_number(std::string& out, std::size_t v) {
+		char digits[24];
+		auto res = std::to_chars(digits, digits + sizeof(digits), v);
+		out.append(digits, static_cast<std::size_t>(res.ptr - digits));
+	}
+
+	inline void append_chunk_size(std::string& out, std::size_t v) {
+		char digits[24];
+		auto res = std::to_chars(digits, digits + sizeof(digits), v, 16);
+		out.append(digits, static_cast<std::size_t>(res.ptr - digits));
+		out.append("\r\n");
+	}
+
+	// Next '/'-separated segment of s starting at pos (one leading '/' is
+	// skipped). Returns an empty view with pos == s.size() at the end.
+	inline std::string_view next_segment(std::string_view s, std::size_t& pos) {
+		if (pos >= s.size()) return {};
+		if (s[pos] == '/') ++pos;
+		if (pos >= s.size()) return {};
+		std::size_t end = s.find('/', pos);
+		if (end == std::string_view::npos) end = s.size();
+		std::string_view seg = s.substr(pos, end - pos);
+		pos = end;
+		return seg;
+	}
+
+	// ":name" and "*name" captures of a route pattern, in path order.
+	std::vector<std::string> pattern_param_names(std::string_view pattern) {
+		std::vector<std::string> names;
+		std::size_t pos = 0;
+		while (pos < pattern.size()) {
+			std::string_view seg = next_segment(pattern, pos);
+			if (seg.empty()) continue;
+			if (seg[0] == ':' || seg[0] == '*') names.emplace_back(seg.substr(1));
+			if (seg[0] == '*') break;
+		}
+		return names;
+	}
+
+	// Decodes into out, which keeps its allocator.
+	void url_decode(std::string_view s, std::pmr::string& out) {
+		out.clear();
 		out.reserve(s.size());
 
 		for (std::size_t i = 0; i < s.size(); ++i) {
@@ -87,301 +168,993 @@ namespace {
 				out.push_back(c);
 			}
 		}
-		return out;
 	}
 
-	void parse_query_string(const std::string& raw, http::QueryParams& out) {
+	void parse_query_string(std::string_view raw, http::QueryParams& out) {
 		out.params.clear();
 		std::size_t i = 0;
 		while (i < raw.size()) {
 			std::size_t amp = raw.find('&', i);
-			std::string pair = (amp == std::string::npos)
+			std::string_view pair = (amp == std::string_view::npos)
 				? raw.substr(i)
 				: raw.substr(i, amp - i);
 
 			if (!pair.empty()) {
+				auto alloc = out.params.get_allocator();
 				std::size_t eq = pair.find('=');
-				std::string key;
-				std::string value;
-				if (eq == std::string::npos) {
-					key = url_decode(pair);
-					value = "";
+				std::pmr::string key(alloc);
+				std::pmr::string value(alloc);
+				if (eq == std::string_view::npos) {
+					url_decode(pair, key);
 				}
 				else {
-					key = url_decode(pair.substr(0, eq));
-					value = url_decode(pair.substr(eq + 1));
+					url_decode(pair.substr(0, eq), key);
+					url_decode(pair.substr(eq + 1), value);
 				}
 				if (!key.empty()) {
-					out.params[key].push_back(std::move(value));
+					auto it = out.params.find(key);
+					if (it == out.params.end()) {
+						it = out.params.emplace(std::move(key), std::pmr::vector<std::pmr::string>(alloc)).first;
+					}
+					it->second.push_back(std::move(value));
 				}
 			}
 
-			if (amp == std::string::npos) break;
+			if (amp == std::string_view::npos) break;
 			i = amp + 1;
 		}
 	}
 
+	// Answers 503 and closes conn when the worker pool cannot take its drain.
+	void reject_overloaded(net::TcpConnection& conn) {
+		http::HttpResponse resp;
+		resp.set_status(503, "Service Unavailable");
+		resp.headers["Content-Type"] = "text/plain";
+		resp.headers["Connection"] = "close";
+		resp.body = "Service Unavailable";
+		conn.set_busy(false);
+		conn.async_send(resp.to_string(), true);
+	}
+
 }
 
 namespace http {
 
 
-	HttpMethod parse_method(const std::string& s) {
-		if (s == "GET")     return HttpMethod::Get;
-		if (s == "POST")    return HttpMethod::Post;
-		if (s == "PUT")     return HttpMethod::Put;
-		if (s == "DELETE")  return HttpMethod::Delete_;
-		if (s == "PATCH")   return HttpMethod::Patch;
-		if (s == "OPTIONS") return HttpMethod::Options;
-		if (s == "HEAD")    return HttpMethod::Head;
+	RequestArena::RequestArena(std::size_t initial_size)
+		: block_(new std::byte[initial_size]), size_(initial_size) {
+		mono_.emplace(block_.get(), size_, &overflow_);
+	}
+
+	void RequestArena::reset() {
+		// Destroying the monotonic resource hands its overflow chunks back.
+		mono_.reset();
+		if (overflow_.bytes > 0 && size_ < max_size) {
+			std::size_t grown = std::min(max_size, std::max(size_ * 2, size_ + overflow_.bytes));
+			block_.reset(new std::byte[grown]);
+			size_ = grown;
+		}
+		overflow_.bytes = 0;
+		mono_.emplace(block_.get(), size_, &overflow_);
+	}
+
+	void* RequestArena::Overflow::do_allocate(std::size_t n, std::size_t align) {
+		bytes += n;
+		return std::pmr::new_delete_resource()->allocate(n, align);
+	}
+
+	void RequestArena::Overflow::do_deallocate(void* p, std::size_t n, std::size_t align) {
+		std::pmr::new_delete_resource()->deallocate(p, n, align);
+	}
+
+	std::string BufferPool::acquire() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (free_.empty()) return {};
+		std::string buffer = std::move(free_.back());
+		free_.pop_back();
+		return buffer;
+	}
+
+	void BufferPool::release(std::string buffer) {
+		// Only heap buffers are worth keeping (not the small-string storage).
+		if (buffer.capacity() <= std::string().capacity() || buffer.capacity() > max_capacity_) return;
+		buffer.clear();
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (free_.size() < max_buffers_) {
+			free_.push_back(std::move(buffer));
+		}
+	}
+
+	HttpMethod parse_method(std::string_view s) {
+		if (iequals(s, "GET"))     return HttpMethod::Get;
+		if (iequals(s, "POST"))    return HttpMethod::Post;
+		if (iequals(s, "PUT"))     return HttpMethod::Put;
+		if (iequals(s, "DELETE"))  return HttpMethod::Delete_;
+		if (iequals(s, "PATCH"))   return HttpMethod::Patch;
+		if (iequals(s, "OPTIONS")) return HttpMethod::Options;
+		if (iequals(s, "HEAD"))    return HttpMethod::Head;
 		return HttpMethod::Unknown;
 	}
 
-	const std::string& HttpRequest::header(const std::string& name) const {
-		static const std::string empty;
-		auto it = headers.find(to_lower(name));
-		if (it == headers.end()) return empty;
+	std::optional<std::string_view> HeaderList::find(std::string_view name) const {
+		for (std::size_t i = count; i > 0; --i) {
+			if (iequals(items[i - 1].name, name)) return items[i - 1].value;
+		}
+		return std::nullopt;
+	}
+
+	std::string_view HttpRequest::header(std::string_view name) const {
+		if (has_views) {
+			return raw_headers.find(name).value_or(std::string_view{});
+		}
+		auto it = headers.find(to_lower(std::string(name)));
+		if (it == headers.end()) return {};
 		return it->second;
 	}
 
-	std::string HttpResponse::to_string() const {
-		std::ostringstream oss;
+	void HttpRequest::own_storage() {
+		if (!has_views) return;
+
+		// Every view lies inside the request head, which starts at the method.
+		const char* lo = raw_method.data();
+		const char* hi = raw_version.data() + raw_version.size();
+		for (const auto& h : raw_headers) {
+			hi = std::max(hi, h.value.data() + h.value.size());
+		}
+
+		storage_ = std::make_shared<std::string>(lo, static_cast<std::size_t>(hi - lo));
+		const char* base = storage_->data();
+		auto rebase = [&](std::string_view v) {
+			if (v.data() == nullptr) return v;
+			return std::string_view(base + (v.data() - lo), v.size());
+			};
+
+		raw_method = rebase(raw_method);
+		raw_path = rebase(raw_path);
+		raw_query = rebase(raw_query);
+		raw_version = rebase(raw_version);
+		for (std::size_t i = 0; i < raw_headers.count; ++i) {
+			raw_headers.items[i].name = rebase(raw_headers.items[i].name);
+			raw_headers.items[i].value = rebase(raw_headers.items[i].value);
+		}
+	}
+
+	void HttpRequest::materialize() {
+		if (!has_views) return;
+
+		method_str = to_upper(std::string(raw_method));
+		path.assign(raw_path);
+		query.assign(raw_query);
+		http_version.assign(raw_version);
+		headers.clear();
+		for (const auto& h : raw_headers) {
+			std::pmr::string name(h.name, headers.get_allocator());
+			for (auto& c : name) c = lower_ascii(c);
+			headers.insert_or_assign(std::move(name), std::pmr::string(h.value, headers.get_allocator()));
+		}
+		parse_query_string(query, query_params);
+		query_parsed_ = true;
 
-		std::string reason_phrase = reason.empty() ? default_reason_phrase(status_code) : reason;
+		has_views = false;
+		raw_method = raw_path = raw_query = raw_version = {};
+		raw_headers.count = 0;
+		storage_.reset();
+	}
+
+	const QueryParams& HttpRequest::parsed_query() const {
+		if (!query_parsed_ && has_views) {
+			parse_query_string(raw_query, query_params);
+			query_parsed_ = true;
+		}
+		return query_params;
+	}
+
+	std::pmr::string& ResponseHeaders::operator[](std::string_view name) {
+		auto it = find(name);
+		if (it != items_.end()) return it->second;
+		items_.emplace_back(name, std::string_view{});
+		return items_.back().second;
+	}
+
+	ResponseHeaders::iterator ResponseHeaders::find(std::string_view name) {
+		return std::find_if(items_.begin(), items_.end(),
+			[name](const value_type& kv) { return iequals(kv.first, name); });
+	}
+
+	ResponseHeaders::const_iterator ResponseHeaders::find(std::string_view name) const {
+		return std::find_if(items_.begin(), items_.end(),
+			[name](const value_type& kv) { return iequals(kv.first, name); });
+	}
+
+	const std::pmr::string& ResponseHeaders::at(std::string_view name) const {
+		auto it = find(name);
+		if (it == items_.end()) {
+			throw std::out_of_range("ResponseHeaders::at: no such header");
+		}
+		return it->second;
+	}
 
-		oss << "HTTP/1.1 " << status_code << " " << reason_phrase << "\r\n";
+	std::size_t ResponseHeaders::erase(std::string_view name) {
+		auto it = find(name);
+		if (it == items_.end()) return 0;
+		items_.erase(it);
+		return 1;
+	}
+
+	void HttpResponse::serialize_head(std::string& out, std::string_view static_headers) const {
+		std::string_view default_reason = default_reason_phrase(status_code);
+		std::string_view line = default_status_line(status_code);
 
-		bool has_content_length = false;
+		if (!line.empty() && (reason.empty() || reason == default_reason)) {
+			out.append(line);
+		}
+		else {
+			out.append("HTTP/1.1 ");
+			append_number(out, static_cast<std::size_t>(status_code < 0 ? 0 : status_code));
+			out.push_back(' ');
+			out.append(reason.empty() ? default_reason : std::string_view(reason));
+			out.append("\r\n");
+		}
 
+		const bool streamed = static_cast<bool>(body_source);
+		bool has_length = false;
 		for (const auto& kv : headers) {
-			std::string name_lower = to_lower(kv.first);
-			if (name_lower == "content-length") has_content_length = true;
-			oss << kv.first << ": " << kv.second << "\r\n";
+			if (iequals(kv.first, "content-length")) {
+				if (streamed) continue;
+				has_length = true;
+			}
+			else if (streamed && iequals(kv.first, "transfer-encoding")) {
+				continue;
+			}
+			out.append(kv.first);
+			out.append(": ");
+			out.append(kv.second);
+			out.append("\r\n");
 		}
 
-		if (!has_content_length) {
-			oss << "Content-Length: " << body.size() << "\r\n";
+		if (headers.empty()) {
+			out.append(static_headers);
+		}
+		else {
+			// A header the response sets itself replaces the static one.
+			while (!static_headers.empty()) {
+				std::size_t eol = static_headers.find("\r\n");
+				std::size_t end = eol == std::string_view::npos ? static_headers.size() : eol + 2;
+				std::string_view entry = static_headers.substr(0, end);
+				static_headers.remove_prefix(end);
+
+				std::size_t colon = entry.find(':');
+				if (colon != std::string_view::npos && headers.find(entry.substr(0, colon)) != headers.end()) {
+					continue;
+				}
+				out.append(entry);
+			}
 		}
 
-		oss << "\r\n";
-		oss << body;
+		if (streamed) {
+			out.append("Transfer-Encoding: chunked\r\n");
+		}
+		else if (!has_length) {
+			std::size_t length = body.size();
+			for (const auto& part : body_parts) length += part.size();
+			out.append("Content-Length: ");
+			append_number(out, length);
+			out.append("\r\n");
+		}
 
-		return oss.str();
+		out.append("\r\n");
 	}
 
-	void Router::add_route(HttpMethod method, const std::string& path_pattern, Handler handler) {
-		std::string method_str;
-		switch (method) {
-		case HttpMethod::Get:     method_str = "GET"; break;
-		case HttpMethod::Post:    method_str = "POST"; break;
-		case HttpMethod::Put:     method_str = "PUT"; break;
-		case HttpMethod::Delete_: method_str = "DELETE"; break;
-		case HttpMethod::Patch:   method_str = "PATCH"; break;
-		case HttpMethod::Options: method_str = "OPTIONS"; break;
-		case HttpMethod::Head:    method_str = "HEAD"; break;
-		default:                  method_str = "UNKNOWN"; break;
+	std::string HttpResponse::to_string() const {
+		std::string out;
+		out.reserve(128 + headers.size() * 48 + body.size());
+		serialize_head(out);
+		if (!body_source) {
+			out.append(body);
+			for (const auto& part : body_parts) out.append(part.view());
+			return out;
+		}
+
+		std::string chunk;
+		while (body_source(chunk)) {
+			if (chunk.empty()) continue;
+			append_chunk_size(out, chunk.size());
+			out.append(chunk);
+			out.append("\r\n");
+			chunk.clear();
 		}
-		routes_.push_back(Route{ method_str, path_pattern, std::move(handler) });
+		out.append("0\r\n\r\n");
+		return out;
 	}
 
-	void Router::add_route(const std::string& method_str, const std::string& path_pattern, Handler handler) {
-		routes_.push_back(Route{ to_upper(method_str), path_pattern, std::move(handler) });
+	bool ResponseWriter::add(HttpResponse& resp, std::string_view static_headers) {
+		resp.serialize_head(buf_, static_headers);
+		if (resp.body_source) {
+			return add_stream(resp);
+		}
+		add_body_part(resp.body);
+		for (auto& part : resp.body_parts) {
+			if (!part.empty()) add_body_part(std::move(part));
+		}
+		resp.body_parts.clear();
+		return true;
 	}
 
-	bool Router::match_pattern(const std::string& pattern,
-		const std::string& path,
-		std::unordered_map<std::string, std::string>& out_params) {
-		out_params.clear();
+	void ResponseWriter::add_body_part(std::string& part) {
+		if (part.size() <= inline_body_limit) {
+			buf_.append(part);
+			segments_.push_back(Segment{ buf_.size(), 0 });
+			return;
+		}
+		add_body_part(net::SendBuffer(std::move(part)));
+		part.clear();
+	}
 
-		std::size_t i = 0;
-		std::size_t j = 0;
-
-		auto next_seg = [](const std::string& s, std::size_t& pos) -> std::string {
-			if (pos >= s.size()) return {};
-			if (s[pos] == '/') ++pos;
-			if (pos >= s.size()) return {};
-			std::size_t end = s.find('/', pos);
-			if (end == std::string::npos) end = s.size();
-			std::string seg = s.substr(pos, end - pos);
-			pos = end;
-			return seg;
-			};
+	void ResponseWriter::add_body_part(net::SendBuffer&& part) {
+		Segment seg;
+		if (part.size() <= inline_body_limit) {
+			buf_.append(part.view());
+		}
+		else {
+			body_bytes_ += part.size();
+			bodies_.push_back(std::move(part));
+			seg.body = bodies_.size();
+		}
+		seg.head_end = buf_.size();
+		segments_.push_back(seg);
+	}
 
-		while (true) {
-			std::string pseg = next_seg(pattern, i);
-			std::string sseg = next_seg(path, j);
+	bool ResponseWriter::add_stream(HttpResponse& resp) {
+		std::string chunk;
+		while (resp.body_source(chunk)) {
+			if (chunk.empty()) continue;
+			append_chunk_size(buf_, chunk.size());
+			add_body_part(chunk);
+			buf_.append("\r\n");
+			chunk.clear();
+
+			if (flush_ && buf_.size() + body_bytes_ >= stream_flush_bytes) {
+				if (!flush_(*this)) return false;
+			}
+		}
+		buf_.append("0\r\n\r\n");
+		segments_.push_back(Segment{ buf_.size(), 0 });
+		return true;
+	}
+
+	void ResponseWriter::add_raw(std::string_view bytes) {
+		buf_.append(bytes);
+		segments_.push_back(Segment{ buf_.size(), 0 });
+	}
+
+	void ResponseWriter::clear() {
+		buf_.clear();
+		bodies_.clear();
+		body_bytes_ = 0;
+		segments_.clear();
+		slices_.clear();
+	}
+
+	const std::vector<net::IoSlice>& ResponseWriter::slices() {
+		// Built after the batch is complete: buf_ may reallocate while adding.
+		// Consecutive inlined responses share one slice.
+		slices_.clear();
+		std::size_t pos = 0;
+		for (const auto& seg : segments_) {
+			if (seg.body == 0) continue;
+			if (seg.head_end > pos) {
+				slices_.push_back(net::IoSlice{ buf_.data() + pos, seg.head_end - pos });
+			}
+			const net::SendBuffer& body = bodies_[seg.body - 1];
+			slices_.push_back(net::IoSlice{ body.data(), body.size() });
+			pos = seg.head_end;
+		}
+		if (pos < buf_.size()) {
+			slices_.push_back(net::IoSlice{ buf_.data() + pos, buf_.size() - pos });
+		}
+		return slices_;
+	}
 
-			bool p_end = pseg.empty() && i >= pattern.size();
-			bool s_end = sseg.empty() && j >= path.size();
+	void ResponseWriter::reuse(std::string buffer) {
+		if (!buf_.empty() || buffer.capacity() <= buf_.capacity()) return;
+		buffer.clear();
+		buf_ = std::move(buffer);
+	}
+
+	std::vector<net::SendBuffer> ResponseWriter::take_parts() {
+		std::vector<net::SendBuffer> parts;
+		if (bodies_.empty()) {
+			if (!buf_.empty()) parts.emplace_back(std::move(buf_));
+		}
+		else {
+			// Heads are small; only they are split out, bodies are moved.
+			std::size_t pos = 0;
+			for (const auto& seg : segments_) {
+				if (seg.body == 0) continue;
+				if (seg.head_end > pos) parts.emplace_back(buf_.substr(pos, seg.head_end - pos));
+				parts.push_back(std::move(bodies_[seg.body - 1]));
+				pos = seg.head_end;
+			}
+			if (pos < buf_.size()) {
+				parts.emplace_back(buf_.substr(pos));
+			}
+		}
+		clear();
+		return parts;
+	}
 
-			if (p_end && s_end) {
+	bool PathParams::set(std::string_view name, std::string_view value) {
+		for (std::size_t i = 0; i < count_; ++i) {
+			if (items_[i].first == name) {
+				items_[i].second = value;
 				return true;
 			}
+		}
+		if (count_ == max_params) return false;
+		items_[count_++] = value_type{ name, value };
+		return true;
+	}
 
-			if (pseg.empty() && !p_end) {
-				return false;
+	PathParams::const_iterator PathParams::find(std::string_view name) const {
+		for (std::size_t i = 0; i < count_; ++i) {
+			if (items_[i].first == name) return &items_[i];
+		}
+		return end();
+	}
+
+	void AsyncTask::run_blocking() {
+		std::mutex m;
+		std::condition_variable cv;
+		bool finished = false;
+		start([&] {
+			std::lock_guard<std::mutex> lock(m);
+			finished = true;
+			cv.notify_one();
+			});
+		std::unique_lock<std::mutex> lock(m);
+		cv.wait(lock, [&] { return finished; });
+	}
+
+	static std::string method_name(HttpMethod method) {
+		switch (method) {
+		case HttpMethod::Get:     return "GET";
+		case HttpMethod::Post:    return "POST";
+		case HttpMethod::Put:     return "PUT";
+		case HttpMethod::Delete_: return "DELETE";
+		case HttpMethod::Patch:   return "PATCH";
+		case HttpMethod::Options: return "OPTIONS";
+		case HttpMethod::Head:    return "HEAD";
+		default:                  return "UNKNOWN";
+		}
+	}
+
+	void Router::add_route(HttpMethod method, const std::string& path_pattern, Handler handler) {
+		routes_.push_back(Route{ method_name(method), path_pattern, std::move(handler), pattern_param_names(path_pattern) });
+		compiled_ = false;
+	}
+
+	void Router::add_async_route(HttpMethod method, const std::string& path_pattern, AsyncHandler handler) {
+		routes_.push_back(Route{ method_name(method), path_pattern, nullptr, pattern_param_names(path_pattern), std::move(handler) });
+		compiled_ = false;
+	}
+
+	void Router::add_route(const std::string& method_str, const std::string& path_pattern, Handler handler) {
+		routes_.push_back(Route{ to_upper(method_str), path_pattern, std::move(handler), pattern_param_names(path_pattern) });
+		compiled_ = false;
+	}
+
+	void Router::compile() const {
+		nodes_.clear();
+		nodes_.emplace_back();
+		for (std::size_t i = 0; i < routes_.size(); ++i) {
+			insert(static_cast<std::uint32_t>(i));
+		}
+		compiled_ = true;
+	}
+
+	void Router::insert(std::uint32_t route_index) const {
+		const Route& r = routes_[route_index];
+		std::string_view pattern(r.pattern);
+		std::size_t pos = 0;
+		std::uint32_t node = 0;
+
+		while (true) {
+			std::string_view seg = next_segment(pattern, pos);
+			if (seg.empty()) {
+				// An empty segment in the middle ("//") never matched anything.
+				if (pos < pattern.size()) return;
+				break;
 			}
 
-			if (!p_end && pseg.size() > 0 && pseg[0] == '*') {
-				std::string name = pseg.substr(1);
-				std::string rest;
-				if (!sseg.empty()) {
-					std::size_t start_pos = path.find(sseg, j - sseg.size());
-					if (start_pos != std::string::npos) {
-						rest = path.substr(start_pos);
-					}
-					else {
-						rest = sseg;
+			std::uint32_t next = no_node;
+			if (seg[0] == '*') {
+				// The wildcard takes the rest of the path; the pattern ends here.
+				if (nodes_[node].wildcard == no_node) {
+					nodes_[node].wildcard = static_cast<std::uint32_t>(nodes_.size());
+					nodes_.emplace_back();
+				}
+				node = nodes_[node].wildcard;
+				break;
+			}
+			if (seg[0] == ':') {
+				next = nodes_[node].param;
+				if (next == no_node) {
+					next = static_cast<std::uint32_t>(nodes_.size());
+					nodes_[node].param = next;
+					nodes_.emplace_back();
+				}
+			}
+			else {
+				for (const auto& child : nodes_[node].statics) {
+					if (child.first == seg) {
+						next = child.second;
+						break;
 					}
 				}
-				else {
-					rest.clear();
+				if (next == no_node) {
+					next = static_cast<std::uint32_t>(nodes_.size());
+					nodes_[node].statics.emplace_back(std::string(seg), next);
+					nodes_.emplace_back();
 				}
-				out_params[name] = rest;
-				return true;
 			}
+			node = next;
+		}
 
-			if (s_end && !p_end) {
-				return false;
-			}
+		if (r.param_names.size() > PathParams::max_params) return;
+
+		// The first route registered for a path and method wins.
+		Node& n = nodes_[node];
+		HttpMethod m = parse_method(r.method);
+		if (m != HttpMethod::Unknown) {
+			auto& slot = n.handlers[static_cast<std::size_t>(m)];
+			if (slot == no_node) slot = route_index;
+			return;
+		}
+		for (const auto& c : n.custom) {
+			if (c.first == r.method) return;
+		}
+		n.custom.emplace_back(r.method, route_index);
+	}
 
-			if (!pseg.empty() && pseg[0] == ':') {
-				std::string name = pseg.substr(1);
-				out_params[name] = sseg;
+	std::uint32_t Router::terminal_route(const Node& node,
+		HttpMethod method,
+		std::string_view method_str,
+		Allowed& allowed) const {
+		if (method != HttpMethod::Unknown) {
+			std::uint32_t r = node.handlers[static_cast<std::size_t>(method)];
+			if (r != no_node) return r;
+		}
+		else {
+			for (const auto& c : node.custom) {
+				if (iequals(c.first, method_str)) return c.second;
 			}
-			else {
-				if (pseg != sseg) {
-					return false;
+		}
+
+		for (std::size_t i = 0; i < method_slots; ++i) {
+			if (node.handlers[i] != no_node) allowed.mask |= 1u << i;
+		}
+		for (const auto& c : node.custom) {
+			allowed.custom.push_back(c.second);
+		}
+		return no_node;
+	}
+
+	std::uint32_t Router::find_route(std::uint32_t node_index,
+		std::string_view path,
+		std::size_t pos,
+		HttpMethod method,
+		std::string_view method_str,
+		Captures& caps,
+		Allowed& allowed) const {
+		const Node& node = nodes_[node_index];
+
+		std::size_t seg_pos = pos;
+		std::string_view seg = next_segment(path, seg_pos);
+		bool at_end = seg.empty() && seg_pos >= path.size();
+
+		if (at_end) {
+			std::uint32_t r = terminal_route(node, method, method_str, allowed);
+			if (r != no_node) return r;
+		}
+		else {
+			for (const auto& child : node.statics) {
+				if (child.first == seg) {
+					std::uint32_t r = find_route(child.second, path, seg_pos, method, method_str, caps, allowed);
+					if (r != no_node) return r;
+					break;
 				}
 			}
 
-			if (i >= pattern.size() && j >= path.size()) {
-				return true;
+			if (node.param != no_node && caps.count < caps.values.size()) {
+				caps.values[caps.count++] = seg;
+				std::uint32_t r = find_route(node.param, path, seg_pos, method, method_str, caps, allowed);
+				if (r != no_node) return r;
+				--caps.count;
 			}
 		}
+
+		if (node.wildcard != no_node && caps.count < caps.values.size()) {
+			// Everything from the current segment on, or nothing at the end.
+			std::string_view rest = seg.empty() ? std::string_view{} : path.substr(seg_pos - seg.size());
+			caps.values[caps.count++] = rest;
+			std::uint32_t r = terminal_route(nodes_[node.wildcard], method, method_str, allowed);
+			if (r != no_node) return r;
+			--caps.count;
+		}
+
+		return no_node;
 	}
 
 	bool Router::route(HttpRequest& req, HttpResponse& resp) const {
-		if (req.method_str.empty()) {
+		AsyncTask task;
+		bool routed = route(req, resp, task);
+		if (task) {
+			task.run_blocking();
+			if (task.failed()) std::rethrow_exception(task.error());
+		}
+		return routed;
+	}
+
+	bool Router::route(HttpRequest& req, HttpResponse& resp, AsyncTask& task) const {
+		std::size_t index = resolve(req, resp);
+		if (index == no_route) return false;
+		dispatch(index, req, resp, task);
+		return true;
+	}
+
+	std::string Router::route_label(std::size_t index) const {
+		return routes_[index].method + " " + routes_[index].pattern;
+	}
+
+	void Router::dispatch(std::size_t index, HttpRequest& req, HttpResponse& resp, AsyncTask& task) const {
+		const Route& r = routes_[index];
+		if (r.async_handler) task = r.async_handler(req, resp);
+		else r.handler(req, resp);
+	}
+
+	std::size_t Router::resolve(HttpRequest& req, HttpResponse& resp) const {
+		std::string_view method = req.method_sv();
+		if (method.empty()) {
 			resp.status_code = 400;
 			resp.reason = "Bad Request";
 			resp.body = "Bad Request";
 			resp.headers["Content-Type"] = "text/plain";
-			return false;
+			return no_route;
 		}
 
-		std::unordered_map<std::string, std::string> tmp_params;
-		std::set<std::string> allowed_methods;
-		bool handler_found = false;
+		if (!compiled_) {
+			compile();
+		}
 
-		for (const auto& r : routes_) {
-			if (!match_pattern(r.pattern, req.path, tmp_params)) {
-				continue;
-			}
-			allowed_methods.insert(r.method);
-			if (r.method == req.method_str) {
-				req.path_params = tmp_params;
-				r.handler(req, resp);
-				handler_found = true;
-				break;
+		HttpMethod m = req.method != HttpMethod::Unknown ? req.method : parse_method(method);
+		Captures caps;
+		Allowed allowed;
+		std::uint32_t index = find_route(0, req.path_sv(), 0, m, method, caps, allowed);
+
+		if (index != no_node) {
+			const Route& r = routes_[index];
+			req.path_params.clear();
+			for (std::size_t i = 0; i < caps.count; ++i) {
+				req.path_params.set(r.param_names[i], caps.values[i]);
 			}
+			return index;
 		}
 
-		if (handler_found) {
-			return true;
-		}
+		if (allowed.mask != 0 || !allowed.custom.empty()) {
+			static constexpr std::array<std::string_view, method_slots> names = {
+				"GET", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "HEAD"
+			};
+			std::vector<std::string_view> methods;
+			for (std::size_t i = 0; i < method_slots; ++i) {
+				if (allowed.mask & (1u << i)) methods.push_back(names[i]);
+			}
+			for (auto idx : allowed.custom) {
+				methods.push_back(routes_[idx].method);
+			}
+			std::sort(methods.begin(), methods.end());
+			methods.erase(std::unique(methods.begin(), methods.end()), methods.end());
 
-		if (!allowed_methods.empty()) {
 			resp.status_code = 405;
 			resp.reason = "Method Not Allowed";
 			std::string allow;
-			bool first = true;
-			for (const auto& m : allowed_methods) {
-				if (!first) allow += ", ";
-				allow += m;
-				first = false;
+			for (std::size_t i = 0; i < methods.size(); ++i) {
+				if (i > 0) allow += ", ";
+				allow += methods[i];
 			}
 			resp.headers["Allow"] = allow;
 			resp.headers["Content-Type"] = "text/plain";
 			resp.body = "Method Not Allowed";
-			return false;
+			return no_route;
 		}
 
 		resp.status_code = 404;
 		resp.reason = "Not Found";
 		resp.headers["Content-Type"] = "text/plain";
 		resp.body = "Not Found";
-		return false;
+		return no_route;
 	}
 
 
-	bool parse_http_request(const std::string& raw, HttpRequest& req, std::size_t& header_length) {
-		const std::string delimiter = "\r\n\r\n";
-		auto pos = raw.find(delimiter);
-		if (pos == std::string::npos) {
-			return false;
+	ChunkedDecoder::Status ChunkedDecoder::feed(std::string_view data) {
+		// Returns the line starting at pos_ without its CR/LF, advancing pos_
+		// past it; nullopt while the line is incomplete.
+		auto take_line = [this, data]() -> std::optional<std::string_view> {
+			const void* nl = std::memchr(data.data() + pos_, '\n', data.size() - pos_);
+			if (!nl) return std::nullopt;
+			std::size_t end = static_cast<std::size_t>(static_cast<const char*>(nl) - data.data());
+			std::string_view line = data.substr(pos_, end - pos_);
+			if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+			pos_ = end + 1;
+			return line;
+			};
+
+		while (state_ != State::Done) {
+			switch (state_) {
+			case State::Size: {
+				auto line = take_line();
+				if (!line) {
+					return data.size() - pos_ > max_line ? Status::Malformed : Status::Incomplete;
+				}
+				std::string_view digits = trim_view(line->substr(0, line->find(';')));
+				std::size_t size = 0;
+				auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), size, 16);
+				if (digits.empty() || ec != std::errc() || ptr != digits.data() + digits.size()) {
+					return Status::Malformed;
+				}
+				if (size > max_body_size_ - body_.size()) {
+					return Status::TooLarge;
+				}
+				remaining_ = size;
+				state_ = size == 0 ? State::Trailer : State::Data;
+				break;
+			}
+			case State::Data: {
+				std::size_t take = std::min(remaining_, data.size() - pos_);
+				body_.append(data.data() + pos_, take);
+				pos_ += take;
+				remaining_ -= take;
+				if (remaining_ != 0) return Status::Incomplete;
+				state_ = State::DataEnd;
+				break;
+			}
+			case State::DataEnd: {
+				// Only CRLF (or a bare LF) may follow chunk data.
+				if (pos_ < data.size() && data[pos_] != '\r' && data[pos_] != '\n') {
+					return Status::Malformed;
+				}
+				auto line = take_line();
+				if (!line) {
+					return data.size() - pos_ > 1 ? Status::Malformed : Status::Incomplete;
+				}
+				if (!line->empty()) return Status::Malformed;
+				state_ = State::Size;
+				break;
+			}
+			case State::Trailer: {
+				auto line = take_line();
+				if (!line) {
+					return data.size() - pos_ > max_line ? Status::Malformed : Status::Incomplete;
+				}
+				if (line->empty()) state_ = State::Done;
+				break;
+			}
+			case State::Done:
+				break;
+			}
 		}
+		return Status::Complete;
+	}
 
-		header_length = pos + delimiter.size();
+	void ChunkedDecoder::reset() {
+		state_ = State::Size;
+		pos_ = 0;
+		remaining_ = 0;
+		body_.clear();
+	}
 
-		std::string header_block = raw.substr(0, pos);
-		std::istringstream iss(header_block);
-		std::string line;
+	void RequestParser::reset() {
+		state_ = State::RequestLine;
+		line_start_ = 0;
+		scan_pos_ = 0;
+		header_length_ = 0;
+		method_ = path_ = query_ = version_ = Slice{};
+		has_query_ = false;
+		header_count_ = 0;
+		too_many_headers_ = false;
+	}
 
-		if (!std::getline(iss, line)) {
-			return false;
+	RequestParser::Status RequestParser::feed(std::string_view data) {
+		if (state_ == State::Done) {
+			return Status::Complete;
 		}
-		if (!line.empty() && line.back() == '\r') line.pop_back();
 
-		{
-			std::istringstream rl(line);
-			std::string method;
-			std::string target;
-			std::string version;
+		while (scan_pos_ < data.size()) {
+			const void* nl = std::memchr(data.data() + scan_pos_, '\n', data.size() - scan_pos_);
+			if (!nl) {
+				scan_pos_ = data.size();
+				break;
+			}
+			std::size_t line_end = static_cast<std::size_t>(static_cast<const char*>(nl) - data.data());
+			std::size_t next = line_end + 1;
+			if (next > max_header_size_) {
+				return Status::TooLarge;
+			}
+
+			std::size_t content_end = line_end;
+			if (content_end > line_start_ && data[content_end - 1] == '\r') --content_end;
+
+			if (!on_line(data, line_start_, content_end)) {
+				return Status::Malformed;
+			}
+			line_start_ = next;
+			scan_pos_ = next;
+
+			if (state_ == State::Done) {
+				if (too_many_headers_) return Status::TooLarge;
+				header_length_ = next;
+				return Status::Complete;
+			}
+		}
+
+		if (data.size() > max_header_size_) {
+			return Status::TooLarge;
+		}
+		return Status::Incomplete;
+	}
 
-			if (!(rl >> method >> target >> version)) {
+	bool RequestParser::on_line(std::string_view data, std::size_t begin, std::size_t end) {
+		auto slice = [](std::size_t off, std::size_t len) {
+			return Slice{ static_cast<std::uint32_t>(off), static_cast<std::uint32_t>(len) };
+			};
+
+		if (state_ == State::RequestLine) {
+			if (begin == end) {
+				return true; // tolerate empty lines before the request line
+			}
+
+			// METHOD SP request-target SP HTTP-version; extra tokens are ignored.
+			Slice tokens[3];
+			std::size_t n = 0;
+			std::size_t p = begin;
+			while (p < end && n < 3) {
+				while (p < end && is_space(data[p])) ++p;
+				std::size_t t = p;
+				while (p < end && !is_space(data[p])) ++p;
+				if (p > t) tokens[n++] = slice(t, p - t);
+			}
+			if (n < 3) {
 				return false;
 			}
 
-			req.method_str = to_upper(method);
-			req.method = parse_method(req.method_str);
-			req.http_version = version;
+			method_ = tokens[0];
+			version_ = tokens[2];
 
-			auto qpos = target.find('?');
-			if (qpos == std::string::npos) {
-				req.path = target;
-				req.query.clear();
-				req.query_params.params.clear();
+			std::string_view target = data.substr(tokens[1].off, tokens[1].len);
+			std::size_t q = target.find('?');
+			if (q == std::string_view::npos) {
+				path_ = tokens[1];
+				has_query_ = false;
 			}
 			else {
-				req.path = target.substr(0, qpos);
-				req.query = target.substr(qpos + 1);
-				parse_query_string(req.query, req.query_params);
+				path_ = slice(tokens[1].off, q);
+				query_ = slice(tokens[1].off + q + 1, tokens[1].len - q - 1);
+				has_query_ = true;
 			}
-			req.path_params.clear();
+			state_ = State::Headers;
+			return true;
 		}
 
-		req.headers.clear();
+		if (begin == end) {
+			state_ = State::Done;
+			return true;
+		}
 
-		while (std::getline(iss, line)) {
-			if (!line.empty() && line.back() == '\r') line.pop_back();
-			if (line.empty()) {
-				break;
-			}
-			auto colon_pos = line.find(':');
-			if (colon_pos == std::string::npos) {
-				continue;
-			}
-			std::string name = line.substr(0, colon_pos);
-			std::string value = line.substr(colon_pos + 1);
-			trim(name);
-			trim(value);
-			req.headers[to_lower(name)] = value;
+		std::string_view line = data.substr(begin, end - begin);
+		std::size_t colon = line.find(':');
+		if (colon == std::string_view::npos) {
+			return true; // not a header line, ignored
+		}
+		if (header_count_ == headers_.size()) {
+			too_many_headers_ = true;
+			return true;
 		}
 
+		std::string_view name = trim_view(line.substr(0, colon));
+		std::string_view value = trim_view(line.substr(colon + 1));
+		headers_[header_count_++] = HeaderSlice{
+			slice(static_cast<std::size_t>(name.data() - data.data()), name.size()),
+			slice(static_cast<std::size_t>(value.data() - data.data()), value.size())
+		};
 		return true;
 	}
 
+	void RequestParser::bind(std::string_view data, HttpRequest& req) const {
+		auto view = [&](const Slice& s) { return data.substr(s.off, s.len); };
+
+		req.has_views = true;
+		req.raw_method = view(method_);
+		req.raw_path = view(path_);
+		req.raw_query = has_query_ ? view(query_) : std::string_view{};
+		req.raw_version = view(version_);
+		req.raw_headers.count = header_count_;
+		for (std::size_t i = 0; i < header_count_; ++i) {
+			req.raw_headers.items[i] = HeaderView{ view(headers_[i].name), view(headers_[i].value) };
+		}
+		req.method = parse_method(req.raw_method);
+		req.path_params.clear();
+	}
+
+	bool parse_http_request(const std::string& raw, HttpRequest& req, std::size_t& header_length) {
+		RequestParser parser(raw.size() + 1);
+		if (parser.feed(raw) != RequestParser::Status::Complete) {
+			return false;
+		}
+
+		header_length = parser.header_length();
+		parser.bind(raw, req);
+		req.materialize();
+		return true;
+	}
+
+	struct HttpServer::ReactorConnection {
+		struct Pending {
+			explicit Pending(std::pmr::memory_resource* mr) : req(mr) {}
+
+			HttpRequest req;
+			std::optional<HttpResponse> error;
+
+			// Held while an async handler runs.
+			std::optional<HttpResponse> response;
+			AsyncTask task;
+			bool keep_alive = false;
+		};
+
+		// Requests cut from one read, the bytes their views point into and
+		// the arena their (and their responses') allocations come from.
+		// Only one thread touches a batch at a time: the loop while filling
+		// it, then the worker; drained batches are recycled through `spare`.
+		struct Batch {
+			std::string bytes;
+			std::vector<Pending> items;
+			RequestArena arena;
+		};
+
+		static constexpr std::size_t max_spare_batches = 4;
+
+		// Parsed views point into `buffer` and must survive its swap into
+		// Batch::bytes, which holds only for heap storage: requests short
+		// enough for the small-string buffer (18 bytes fit in libc++'s)
+		// would move with the string object. Keep the capacity past that.
+		static constexpr std::size_t min_buffer_capacity = 4096;
+
+		// Loop thread only.
+		RequestParser parser;
+		ChunkedDecoder chunked;
+		std::string buffer;
+		std::size_t need = 0;
+		bool closed = false;
+		std::unique_ptr<Batch> current;
+
+		// Shared between the loop thread and the worker draining `pending`.
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Batch>> pending;
+		std::vector<std::unique_ptr<Batch>> spare;
+		bool busy = false;
+
+		// Worker draining `pending` only (serialized by `busy`). While an
+		// async handler runs, `busy` stays set and draining resumes from
+		// (next_batch, next_item) once it completes.
+		std::vector<std::unique_ptr<Batch>> draining;
+		std::size_t next_batch = 0;
+		std::size_t next_item = 0;
+		bool resuming = false;
+		ResponseWriter writer;
+
+		// Whichever of the drain and the handler's completion gets here
+		// second carries on.
+		std::atomic<bool> async_meet{ false };
+	};
+
 	HttpServer::HttpServer(const HttpServerConfig& cfg)
 		: config_(cfg)
 		, router_()
@@ -393,12 +1166,76 @@ namespace http {
 			cfg.thread_count,
 			cfg.max_queue_size)
 	{
+		if (config_.io_model == net::IoModel::Reactor) {
+			tcp_server_.enable_reactor(config_.event_loop_threads,
+				[this](const std::shared_ptr<net::TcpConnection>& conn, const char* data, std::size_t size) {
+					this->on_reactor_data(conn, data, size);
+				},
+				nullptr,
+				config_.socket_timeout_ms);
+		}
+		if (config_.pool_mode != net::PoolMode::Shared) {
+			tcp_server_.set_pool_mode(config_.pool_mode);
+		}
+		if (config_.listener_shards > 1) {
+			tcp_server_.enable_sharding(config_.listener_shards, config_.pin_shards_to_cores);
+		}
+
+		metrics_.add_gauge("webcpp_pool_threads", "Worker threads.",
+			[this] { return static_cast<double>(tcp_server_.pool_stats().threads); });
+		metrics_.add_gauge("webcpp_pool_queued_jobs", "Jobs waiting for a worker.",
+			[this] { return static_cast<double>(tcp_server_.pool_stats().queued); });
+		metrics_.add_counter("webcpp_pool_rejected_total", "Jobs refused by a full worker queue.",
+			[this] { return static_cast<double>(tcp_server_.pool_stats().rejected); });
+
+		if (!config_.metrics_path.empty()) {
+			router_.add_route(HttpMethod::Get, config_.metrics_path, [this](HttpRequest&, HttpResponse& resp) {
+				resp.headers["Content-Type"] = "text/plain; version=0.0.4; charset=utf-8";
+				resp.body = metrics_.render_prometheus();
+				});
+		}
 	}
 
 	void HttpServer::start() {
+		compile_static_headers();
+		router_.compile();
+
+		std::vector<std::string> labels;
+		for (std::size_t i = 0; i < router_.route_count(); ++i) labels.push_back(router_.route_label(i));
+		metrics_.set_routes(std::move(labels));
+
 		tcp_server_.start();
 	}
 
+	void HttpServer::compile_static_headers() {
+		std::string block;
+		auto add = [&block](std::string_view name, std::string_view value) {
+			block.append(name);
+			block.append(": ");
+			block.append(value);
+			block.append("\r\n");
+			};
+
+		if (config_.enable_cors) {
+			add("Access-Control-Allow-Origin", config_.cors_allow_origin);
+			add("Access-Control-Allow-Methods", config_.cors_allow_methods);
+			add("Access-Control-Allow-Headers", config_.cors_allow_headers);
+		}
+		for (const auto& kv : config_.static_headers) {
+			add(kv.first, kv.second);
+		}
+
+		static_keep_alive_ = block + "Connection: keep-alive\r\n";
+		static_close_ = block + "Connection: close\r\n";
+
+		HttpResponse preflight;
+		preflight.set_status(204, "No Content");
+		preflight_keep_alive_.clear();
+		preflight.serialize_head(preflight_keep_alive_, static_keep_alive_);
+		preflight_close_.clear();
+		preflight.serialize_head(preflight_close_, static_close_);
+	}
+
 	void HttpServer::stop() {
 		tcp_server_.stop();
 	}
@@ -407,176 +1244,543 @@ namespace http {
 		return tcp_server_.is_running();
 	}
 
+	HttpServer::ExtractStatus HttpServer::extract_request(RequestParser& parser,
+		ChunkedDecoder& chunked,
+		std::string_view data,
+		HttpRequest& req,
+		std::size_t& consumed,
+		HttpResponse& error_resp) const {
+		auto fail = [&](int code, const std::string& reason, const std::string& body) {
+			parser.reset();
+			chunked.reset();
+			error_resp.set_status(code, reason);
+			error_resp.headers["Content-Type"] = "text/plain";
+			error_resp.body = body;
+			return ExtractStatus::Error;
+			};
+
+		switch (parser.feed(data)) {
+		case RequestParser::Status::Incomplete:
+			return ExtractStatus::Incomplete;
+		case RequestParser::Status::TooLarge:
+			return fail(431, "Request Header Fields Too Large", "Request headers too large");
+		case RequestParser::Status::Malformed:
+			return fail(400, "Bad Request", "Malformed request");
+		case RequestParser::Status::Complete:
+			break;
+		}
+
+		std::size_t header_length = parser.header_length();
+		parser.bind(data, req);
+
+		// Chunked framing takes precedence over Content-Length (RFC 9112 6.3).
+		if (auto te = req.raw_headers.find("transfer-encoding")) {
+			if (icontains(*te, "chunked")) {
+				switch (chunked.feed(data.substr(header_length))) {
+				case ChunkedDecoder::Status::Incomplete:
+					consumed = data.size() + 1;
+					return ExtractStatus::IncompleteBody;
+				case ChunkedDecoder::Status::TooLarge:
+					return fail(413, "Payload Too Large", "Payload Too Large");
+				case ChunkedDecoder::Status::Malformed:
+					return fail(400, "Bad Request", "Malformed chunked body");
+				case ChunkedDecoder::Status::Complete:
+					break;
+				}
+				consumed = header_length + chunked.consumed();
+				req.body = chunked.take_body();
+				chunked.reset();
+				parser.reset();
+				return ExtractStatus::Complete;
+			}
+		}
+
+		std::size_t content_length = 0;
+		if (auto cl = req.raw_headers.find("content-length")) {
+			unsigned long long v = 0;
+			auto [ptr, ec] = std::from_chars(cl->data(), cl->data() + cl->size(), v);
+			if (ec != std::errc() || ptr != cl->data() + cl->size() || cl->empty()) {
+				return fail(400, "Bad Request", "Invalid Content-Length");
+			}
+			if (v > config_.max_body_size) {
+				return fail(413, "Payload Too Large", "Payload Too Large");
+			}
+			content_length = static_cast<std::size_t>(v);
+		}
+
+		consumed = header_length + content_length;
+		if (data.size() < consumed) {
+			return ExtractStatus::IncompleteBody;
+		}
+
+		req.body.assign(data.data() + header_length, content_length);
+		parser.reset();
+		return ExtractStatus::Complete;
+	}
+
+	static void internal_error(HttpResponse& resp, std::pmr::memory_resource* mr) {
+		resp = HttpResponse(mr);
+		resp.status_code = 500;
+		resp.reason = "Internal Server Error";
+		resp.headers["Content-Type"] = "text/plain";
+		resp.body = "Internal Server Error";
+	}
+
+	void HttpServer::write_response(HttpRequest& req, ResponseWriter& writer, bool& keep_alive) const {
+		HttpResponse resp(req.resource());
+		AsyncTask task;
+		if (begin_response(req, resp, task, writer, keep_alive)) return;
+		task.run_blocking();
+		if (task.failed()) internal_error(resp, req.resource());
+		task.reset();
+		end_response(req, resp, writer, keep_alive);
+	}
+
+	bool HttpServer::begin_response(HttpRequest& req, HttpResponse& resp, AsyncTask& task,
+		ResponseWriter& writer, bool& keep_alive) const {
+		std::string_view conn_hdr = req.header("connection");
+
+		const bool http10 = iequals(req.version_sv(), "http/1.0");
+		if (http10) {
+			keep_alive = iequals(conn_hdr, "keep-alive");
+		}
+		else {
+			keep_alive = !iequals(conn_hdr, "close");
+		}
+
+		ThreadMetrics* m = local_metrics();
+		req.timing.route = metrics_.other_series();
+		req.timing.handler_start = 0;
+
+		if (req.method == HttpMethod::Options) {
+			writer.add_raw(keep_alive ? preflight_keep_alive_ : preflight_close_);
+			if (m) {
+				m->phase(req.timing.route, RequestPhase::Parse).record(req.timing.parse_ns);
+				m->count_request(req.timing.route);
+				m->count(HttpCounter::Responses2xx);
+			}
+			return true;
+		}
+
+		try {
+			std::uint64_t start = m ? now_ns() : 0;
+			std::size_t index = router_.resolve(req, resp);
+			if (m) {
+				std::uint64_t resolved = now_ns();
+				if (index != Router::no_route) req.timing.route = static_cast<std::uint32_t>(index);
+				m->phase(req.timing.route, RequestPhase::Route).record(resolved - start);
+				req.timing.handler_start = resolved;
+			}
+			if (index != Router::no_route) router_.dispatch(index, req, resp, task);
+		}
+		catch (...) {
+			task.reset();
+			internal_error(resp, req.resource());
+		}
+		if (task) return false;
+
+		end_response(req, resp, writer, keep_alive);
+		return true;
+	}
+
+	void HttpServer::end_response(HttpRequest& req, HttpResponse& resp, ResponseWriter& writer, bool& keep_alive) const {
+		ThreadMetrics* m = local_metrics();
+		std::uint64_t start = m ? now_ns() : 0;
+
+		const bool http10 = iequals(req.version_sv(), "http/1.0");
+		if (resp.body_source && http10) {
+			// No chunked encoding before HTTP/1.1: buffer the stream.
+			std::string chunk;
+			while (resp.body_source(chunk)) {
+				resp.body += chunk;
+				chunk.clear();
+			}
+			resp.body_source = nullptr;
+		}
+
+		// The static block carries the Connection header: a handler asking
+		// to close gets the server's close, and cannot keep a connection open.
+		auto conn_it = resp.headers.find("connection");
+		if (conn_it != resp.headers.end()) {
+			if (iequals(conn_it->second, "close")) keep_alive = false;
+			resp.headers.erase("connection");
+		}
+
+		if (!writer.add(resp, keep_alive ? static_keep_alive_ : static_close_)) {
+			keep_alive = false;
+		}
+
+		if (m) {
+			std::uint32_t series = req.timing.route;
+			if (series != metrics_.other_series()) {
+				m->phase(series, RequestPhase::Handler).record(start - req.timing.handler_start);
+			}
+			m->phase(series, RequestPhase::Serialize).record(now_ns() - start);
+			m->phase(series, RequestPhase::Parse).record(req.timing.parse_ns);
+			m->count_request(series);
+			m->count(status_counter(resp.status_code));
+		}
+	}
+
+	void HttpServer::count_parse_error(const HttpResponse& error_resp) const {
+		if (ThreadMetrics* m = local_metrics()) {
+			m->count_request(metrics_.other_series());
+			m->count(HttpCounter::ParseErrors);
+			m->count(status_counter(error_resp.status_code));
+		}
+	}
+
+	bool HttpServer::send_parts(const std::shared_ptr<net::TcpConnection>& conn, ResponseWriter& writer, bool close) const {
+		ThreadMetrics* m = local_metrics();
+		std::uint64_t start = m ? now_ns() : 0;
+		bool ok = conn->async_send(writer.take_parts(), close);
+		if (m) m->send.record(now_ns() - start);
+		return ok;
+	}
+
 	void HttpServer::handle_connection(std::shared_ptr<net::TcpConnection> conn) {
 		try {
 			if (config_.socket_timeout_ms > 0) {
 				conn->set_timeout_ms(config_.socket_timeout_ms);
 			}
 
-			std::string buffer;
-			buffer.reserve(8192);
-
-			char temp[4096];
+			constexpr std::size_t recv_chunk = 16 * 1024;
+
+			// Requests are consumed by advancing read_pos; the buffer is only
+			// compacted (moving the unfinished tail) right before a recv.
+			auto lease = buffers_.lease();
+			std::string& buffer = lease.get();
+			buffer.reserve(recv_chunk);
+			std::size_t read_pos = 0;
+
+			// Requests and responses of a batch allocate from the arena; it
+			// is reset once the batch has been sent.
+			RequestArena arena;
+
+			RequestParser parser(config_.max_header_size);
+			ChunkedDecoder chunked(config_.max_body_size);
+
+			// Streamed bodies are sent as they are produced.
+			auto send_batch = [this, &conn](ResponseWriter& w) {
+				ThreadMetrics* m = local_metrics();
+				std::uint64_t start = m ? now_ns() : 0;
+				const auto& slices = w.slices();
+				std::size_t total = 0;
+				for (const auto& sl : slices) total += sl.size;
+				bool ok = conn->send(slices.data(), slices.size()) == total;
+				w.clear();
+				if (m) m->send.record(now_ns() - start);
+				return ok;
+				};
+			ResponseWriter writer;
+			writer.set_flush(send_batch);
 
 			while (true) {
-				HttpRequest req;
-				std::size_t header_length = 0;
-
-				while (true) {
-					if (buffer.size() > config_.max_header_size) {
-						HttpResponse resp;
-						resp.set_status(431, "Request Header Fields Too Large");
-						resp.headers["Content-Type"] = "text/plain";
-						resp.body = "Request headers too large";
-						auto out = resp.to_string();
-						conn->send(out.data(), out.size());
-						return;
+				ExtractStatus status = ExtractStatus::Incomplete;
+				std::size_t need = 0;
+				bool close = false;
+
+				// Answer every complete request already buffered, in order.
+				while (!close) {
+					std::string_view data(buffer);
+					data.remove_prefix(read_pos);
+
+					HttpRequest req(arena.resource());
+					HttpResponse error_resp(arena.resource());
+					std::size_t consumed = 0;
+					std::uint64_t parse_start = config_.collect_metrics ? now_ns() : 0;
+					status = extract_request(parser, chunked, data, req, consumed, error_resp);
+
+					if (status == ExtractStatus::Complete) {
+						if (config_.collect_metrics) req.timing.parse_ns = now_ns() - parse_start;
+						bool keep_alive = false;
+						write_response(req, writer, keep_alive);
+						read_pos += consumed;
+						close = !keep_alive;
 					}
-
-					if (parse_http_request(buffer, req, header_length)) {
+					else if (status == ExtractStatus::Error) {
+						writer.add(error_resp);
+						count_parse_error(error_resp);
+						close = true;
+					}
+					else {
+						need = (status == ExtractStatus::IncompleteBody) ? consumed : 0;
 						break;
 					}
+				}
 
-					std::size_t n = conn->recv(temp, sizeof(temp));
-					if (n == 0) {
-						return;
-					}
-					buffer.append(temp, temp + n);
+				if (!writer.empty() && !send_batch(writer)) {
+					return;
 				}
+				if (close) {
+					return;
+				}
+				arena.reset();
 
-				{
-					auto te_it = req.headers.find("transfer-encoding");
-					if (te_it != req.headers.end()) {
-						std::string te_lower = to_lower(te_it->second);
-						if (te_lower.find("chunked") != std::string::npos) {
-							HttpResponse resp;
-							resp.set_status(501, "Not Implemented");
-							resp.headers["Content-Type"] = "text/plain";
-							resp.body = "Chunked transfer encoding not supported";
-							auto out = resp.to_string();
-							conn->send(out.data(), out.size());
-							return;
-						}
-					}
+				if (read_pos == buffer.size()) {
+					buffer.clear();
+				}
+				else if (read_pos > 0) {
+					buffer.erase(0, read_pos);
 				}
+				read_pos = 0;
 
-				std::size_t content_length = 0;
-				{
-					auto it = req.headers.find("content-length");
-					if (it != req.headers.end()) {
-						try {
-							unsigned long long v = std::stoull(it->second);
-							if (v > config_.max_body_size) {
-								HttpResponse resp;
-								resp.set_status(413, "Payload Too Large");
-								resp.headers["Content-Type"] = "text/plain";
-								resp.body = "Payload Too Large";
-								auto out = resp.to_string();
-								conn->send(out.data(), out.size());
-								return;
-							}
-							content_length = static_cast<std::size_t>(v);
-						}
-						catch (...) {
-							HttpResponse resp;
-							resp.set_status(400, "Bad Request");
-							resp.headers["Content-Type"] = "text/plain";
-							resp.body = "Invalid Content-Length";
-							auto out = resp.to_string();
-							conn->send(out.data(), out.size());
-							return;
-						}
-					}
+				// A large Content-Length body is received straight into a buffer
+				// of its final size, in big reads.
+				constexpr std::size_t max_recv = 1024 * 1024;
+				if (need > buffer.capacity()) {
+					buffer.reserve(need);
 				}
 
-				std::size_t already_have = buffer.size() - header_length;
-				std::string body;
-				if (content_length > 0) {
-					body.reserve(content_length);
-					if (already_have >= content_length) {
-						body = buffer.substr(header_length, content_length);
+				do {
+					std::size_t old_size = buffer.size();
+					std::size_t want = recv_chunk;
+					if (need > old_size + want) {
+						want = std::min(need - old_size, max_recv);
 					}
-					else {
-						body.assign(buffer.begin() + static_cast<std::ptrdiff_t>(header_length),
-							buffer.end());
-						std::size_t remaining = content_length - body.size();
-						while (remaining > 0) {
-							std::size_t n = conn->recv(temp, std::min<std::size_t>(sizeof(temp), remaining));
-							if (n == 0) {
-								break;
-							}
-							body.append(temp, temp + n);
-							remaining -= n;
-						}
-						if (body.size() < content_length) {
+					buffer.resize(old_size + want);
+					std::size_t n = conn->recv(&buffer[old_size], want);
+					buffer.resize(old_size + n);
+					if (n == 0) {
+						if (status == ExtractStatus::IncompleteBody) {
 							HttpResponse resp;
 							resp.set_status(400, "Bad Request");
 							resp.headers["Content-Type"] = "text/plain";
 							resp.body = "Incomplete request body";
 							auto out = resp.to_string();
 							conn->send(out.data(), out.size());
-							return;
 						}
+						return;
 					}
-				}
-				req.body = std::move(body);
+				} while (buffer.size() < need);
+			}
+		}
+		catch (...) {
+			return;
+		}
+	}
 
-				std::string conn_hdr = to_lower(req.header("connection"));
-				std::string version_lower = to_lower(req.http_version);
-				bool keep_alive = false;
+	void HttpServer::on_reactor_data(const std::shared_ptr<net::TcpConnection>& conn,
+		const char* data,
+		std::size_t size) {
+		auto* st = conn->context<ReactorConnection>();
+		if (!st) {
+			conn->set_context(std::make_shared<ReactorConnection>());
+			st = conn->context<ReactorConnection>();
+			st->parser = RequestParser(config_.max_header_size);
+			st->chunked = ChunkedDecoder(config_.max_body_size);
+
+			// The writer lives in the connection's context, so a raw pointer
+			// keeps the connection from owning itself.
+			net::TcpConnection* raw = conn.get();
+			st->writer.set_flush([raw](ResponseWriter& w) {
+				return raw->async_send(w.take_parts(), false);
+				});
+		}
+		if (st->closed) {
+			return;
+		}
 
-				if (version_lower == "http/1.0") {
-					keep_alive = (conn_hdr == "keep-alive");
-				}
-				else {
-					keep_alive = (conn_hdr != "close");
-				}
+		if (st->buffer.capacity() < ReactorConnection::min_buffer_capacity) {
+			st->buffer.reserve(ReactorConnection::min_buffer_capacity);
+		}
+		st->buffer.append(data, size);
+		if (st->buffer.size() < st->need) {
+			return;
+		}
+		st->need = 0;
+
+		if (!st->current) {
+			std::lock_guard<std::mutex> lock(st->mutex);
+			if (!st->spare.empty()) {
+				st->current = std::move(st->spare.back());
+				st->spare.pop_back();
+			}
+		}
+		if (!st->current) {
+			st->current = std::make_unique<ReactorConnection::Batch>();
+		}
+		ReactorConnection::Batch& batch = *st->current;
+
+		std::size_t read_pos = 0;
+		while (!st->closed) {
+			std::string_view view(st->buffer);
+			view.remove_prefix(read_pos);
+
+			auto& item = batch.items.emplace_back(batch.arena.resource());
+			HttpResponse error_resp(batch.arena.resource());
+			std::size_t consumed = 0;
+
+			std::uint64_t parse_start = config_.collect_metrics ? now_ns() : 0;
+			ExtractStatus status = extract_request(st->parser, st->chunked, view, item.req, consumed, error_resp);
+			if (config_.collect_metrics) item.req.timing.parse_ns = now_ns() - parse_start;
+			if (status == ExtractStatus::Incomplete || status == ExtractStatus::IncompleteBody) {
+				batch.items.pop_back();
+				if (status == ExtractStatus::IncompleteBody) st->need = consumed;
+				break;
+			}
+			if (status == ExtractStatus::Error) {
+				item.error.emplace(std::move(error_resp));
+				st->closed = true;
+				read_pos = st->buffer.size();
+			}
+			else {
+				read_pos += consumed;
+			}
+		}
+
+		if (batch.items.empty()) {
+			// Grow once to the announced size instead of doubling per read.
+			if (st->need > st->buffer.capacity()) {
+				st->buffer.reserve(st->need);
+			}
+			return;
+		}
+
+		// The batch takes the (heap) buffer, so the parsed views stay valid
+		// without copying; only the unparsed tail moves to the (recycled) new
+		// buffer.
+		batch.bytes.clear();
+		batch.bytes.swap(st->buffer);
+		st->buffer.assign(batch.bytes, read_pos, std::string::npos);
+		if (st->need > st->buffer.capacity()) {
+			st->buffer.reserve(st->need);
+		}
+
+		bool dispatch = false;
+		{
+			std::lock_guard<std::mutex> lock(st->mutex);
+			st->pending.push_back(std::move(st->current));
+			if (!st->busy) {
+				st->busy = true;
+				dispatch = true;
+			}
+		}
+		if (!dispatch) {
+			return;
+		}
 
-				HttpResponse resp;
+		conn->set_busy(true);
+		bool ok = conn->pool()->try_enqueue([this, conn]() {
+			this->drain_reactor_requests(conn);
+			});
+		if (!ok) {
+			st->closed = true;
+			reject_overloaded(*conn);
+		}
+	}
 
-				if (config_.enable_cors) {
-					resp.headers["Access-Control-Allow-Origin"] = config_.cors_allow_origin;
-					resp.headers["Access-Control-Allow-Methods"] = config_.cors_allow_methods;
-					resp.headers["Access-Control-Allow-Headers"] = config_.cors_allow_headers;
+	bool HttpServer::start_async(const std::shared_ptr<net::TcpConnection>& conn, AsyncTask& task) {
+		auto* st = conn->context<ReactorConnection>();
+		st->async_meet.store(false);
+		task.start([this, conn, st] {
+			if (!st->async_meet.exchange(true)) return; // the drain carries on
+			bool ok = conn->pool()->try_enqueue([this, conn]() {
+				this->drain_reactor_requests(conn);
+				});
+			if (!ok) {
+				// Never drain on the executor. `busy` stays set, so nothing
+				// else is dispatched for the connection.
+				{
+					std::lock_guard<std::mutex> lock(st->mutex);
+					st->pending.clear();
 				}
+				reject_overloaded(*conn);
+			}
+			});
+		return !st->async_meet.exchange(true);
+	}
 
-				if (req.method == HttpMethod::Options) {
-					resp.status_code = 204;
-					resp.reason = "No Content";
-					resp.body.clear();
+	void HttpServer::drain_reactor_requests(const std::shared_ptr<net::TcpConnection>& conn) {
+		auto* st = conn->context<ReactorConnection>();
+		ResponseWriter& writer = st->writer;
+
+		while (true) {
+			if (!st->resuming) {
+				std::lock_guard<std::mutex> lock(st->mutex);
+				if (st->pending.empty()) {
+					st->busy = false;
+					conn->set_busy(false);
+					return;
 				}
-				else {
-					try {
-						router_.route(req, resp);
+				st->draining.swap(st->pending);
+				st->next_batch = 0;
+				st->next_item = 0;
+			}
+			st->resuming = false;
+
+			// Every response of a pipelined batch leaves in one vectored write,
+			// except that those before an async handler go out while it runs.
+			writer.reuse(conn->take_spare_buffer());
+			bool close = false;
+			while (!close && st->next_batch < st->draining.size()) {
+				auto& items = st->draining[st->next_batch]->items;
+				if (st->next_item == items.size()) {
+					++st->next_batch;
+					st->next_item = 0;
+					continue;
+				}
+				auto& item = items[st->next_item];
+				bool keep_alive = false;
+				try {
+					if (item.error) {
+						writer.add(*item.error);
+						count_parse_error(*item.error);
 					}
-					catch (...) {
-						resp.status_code = 500;
-						resp.reason = "Internal Server Error";
-						resp.headers["Content-Type"] = "text/plain";
-						resp.body = "Internal Server Error";
+					else if (item.task) {
+						// Its async handler has finished.
+						if (item.task.failed()) internal_error(*item.response, item.req.resource());
+						item.task.reset();
+						keep_alive = item.keep_alive;
+						end_response(item.req, *item.response, writer, keep_alive);
+					}
+					else {
+						item.response.emplace(item.req.resource());
+						if (!begin_response(item.req, *item.response, item.task, writer, keep_alive)) {
+							item.keep_alive = keep_alive;
+							// Once the task is started its completion may resume
+							// the drain on another worker, so the connection state
+							// is left ready for that first.
+							if (!writer.empty()) send_parts(conn, writer, false);
+							st->resuming = true;
+							if (start_async(conn, item.task)) return;
+							st->resuming = false; // done already
+							continue;
+						}
 					}
 				}
-
-				resp.headers["Connection"] = keep_alive ? "keep-alive" : "close";
-
-				auto out = resp.to_string();
-				conn->send(out.data(), out.size());
-
-				std::size_t consumed = header_length + content_length;
-				if (buffer.size() > consumed) {
-					buffer.erase(0, consumed);
-				}
-				else {
-					buffer.clear();
+				catch (...) {
+					keep_alive = false;
 				}
+				if (!keep_alive) close = true;
+				++st->next_item;
+			}
 
-				if (!keep_alive) {
-					return;
+			bool sent = send_parts(conn, writer, close);
+
+			// Requests and responses die before their arena is reset.
+			for (auto& batch : st->draining) {
+				batch->items.clear();
+				batch->arena.reset();
+			}
+			{
+				std::lock_guard<std::mutex> lock(st->mutex);
+				for (auto& batch : st->draining) {
+					if (st->spare.size() < ReactorConnection::max_spare_batches) {
+						st->spare.push_back(std::move(batch));
+					}
 				}
 			}
-		}
-		catch (...) {
-			return;
+			st->draining.clear();
+
+			if (!sent || close) {
+				// The connection is going away: leave `busy` set so nothing
+				// else is dispatched for it.
+				std::lock_guard<std::mutex> lock(st->mutex);
+				st->pending.clear();
+				conn->set_busy(false);
+				return;
+			}
 		}
 	}
 
@@ -1,12 +1,19 @@
 #pragma once
 
 #include "../tcp_server/tcp_server.hpp"
+#include "http_metrics.hpp"
 
+#include <array>
+#include <coroutine>
 #include <cstdint>
+#include <cstring>
+#include <exception>
 #include <functional>
 #include <map>
-#include <set>
+#include <memory_resource>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <optional>
@@ -28,11 +35,107 @@ namespace http {
 		Unknown
 	};
 
-	HttpMethod parse_method(const std::string& s);
+	// Case-insensitive.
+	HttpMethod parse_method(std::string_view s);
 
+	// Per-connection request arena: a monotonic buffer that is reset between
+	// requests. When a request outgrows the block, the next reset() replaces
+	// it with one large enough, so a steady keep-alive connection allocates
+	// nothing from the global heap. Not thread-safe; reset() only once
+	// nothing allocated from it is alive.
+	class RequestArena {
+	public:
+		static constexpr std::size_t default_size = 16 * 1024;
+		static constexpr std::size_t max_size = 1024 * 1024;
+
+		explicit RequestArena(std::size_t initial_size = default_size);
+
+		RequestArena(const RequestArena&) = delete;
+		RequestArena& operator=(const RequestArena&) = delete;
+
+		std::pmr::memory_resource* resource() { return &*mono_; }
+
+		void reset();
+
+		std::size_t capacity() const { return size_; }
+
+	private:
+		// Forwards to the default resource and records what overflowed.
+		struct Overflow : std::pmr::memory_resource {
+			std::size_t bytes = 0;
+
+			void* do_allocate(std::size_t n, std::size_t align) override;
+			void do_deallocate(void* p, std::size_t n, std::size_t align) override;
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+				return this == &other;
+			}
+		};
+
+		std::unique_ptr<std::byte[]> block_;
+		std::size_t size_ = 0;
+		Overflow overflow_;
+		std::optional<std::pmr::monotonic_buffer_resource> mono_;
+	};
+
+	// Thread-safe free list of I/O buffers; released buffers keep their
+	// capacity for the next user, oversized ones are dropped.
+	class BufferPool {
+	public:
+		explicit BufferPool(std::size_t max_buffers = 256, std::size_t max_capacity = 1024 * 1024)
+			: max_buffers_(max_buffers), max_capacity_(max_capacity) {}
+
+		std::string acquire();
+		void release(std::string buffer);
+
+		// Returns its buffer to the pool when destroyed.
+		class Lease {
+		public:
+			Lease(BufferPool& pool, std::string buffer) : pool_(pool), buffer_(std::move(buffer)) {}
+			~Lease() { pool_.release(std::move(buffer_)); }
+
+			Lease(const Lease&) = delete;
+			Lease& operator=(const Lease&) = delete;
+
+			std::string& get() { return buffer_; }
+
+		private:
+			BufferPool& pool_;
+			std::string buffer_;
+		};
+
+		Lease lease() { return Lease(*this, acquire()); }
+
+	private:
+		std::size_t max_buffers_;
+		std::size_t max_capacity_;
+		std::mutex mutex_;
+		std::vector<std::string> free_;
+	};
+
+	// Let pmr maps keyed by std::pmr::string be searched with any string
+	// type without building a key.
+	struct StringHash {
+		using is_transparent = void;
+		std::size_t operator()(std::string_view s) const noexcept {
+			return std::hash<std::string_view>{}(s);
+		}
+	};
+
+	struct StringEqual {
+		using is_transparent = void;
+		bool operator()(std::string_view a, std::string_view b) const noexcept {
+			return a == b;
+		}
+	};
 
 	struct QueryParams {
-		using Map = std::unordered_map<std::string, std::vector<std::string>>;
+		using Map = std::pmr::unordered_map<std::pmr::string,
+			std::pmr::vector<std::pmr::string>,
+			StringHash,
+			StringEqual>;
+
+		explicit QueryParams(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: params(mr) {}
 
 		Map params;
 
@@ -45,13 +148,13 @@ namespace http {
 			if (it == params.end() || it->second.empty()) {
 				return std::nullopt;
 			}
-			return it->second.front();
+			return std::string(it->second.front());
 		}
 
 		std::vector<std::string> get_all(const std::string& key) const {
 			auto it = params.find(key);
 			if (it == params.end()) return {};
-			return it->second;
+			return std::vector<std::string>(it->second.begin(), it->second.end());
 		}
 
 		std::optional<int> get_int(const std::string& key) const {
@@ -87,45 +190,161 @@ namespace http {
 		}
 	};
 
+	struct HeaderView {
+		std::string_view name;
+		std::string_view value;
+	};
+
+	// Fixed-capacity header list: parsing a request never allocates per header.
+	struct HeaderList {
+		static constexpr std::size_t max_headers = 64;
+
+		std::array<HeaderView, max_headers> items{};
+		std::size_t count = 0;
+
+		const HeaderView* begin() const { return items.data(); }
+		const HeaderView* end() const { return items.data() + count; }
+		bool empty() const { return count == 0; }
+		std::size_t size() const { return count; }
+
+		// Case-insensitive; the last occurrence wins, as with the owned map.
+		std::optional<std::string_view> find(std::string_view name) const;
+	};
+
+	// Path captures of the matched route. Names point into the Router and
+	// values into the request path, so routing copies nothing; they are
+	// meant for the handler and are not rebased when a request is copied.
+	// A repeated name keeps the last capture.
+	class PathParams {
+	public:
+		static constexpr std::size_t max_params = 16;
+
+		using value_type = std::pair<std::string_view, std::string_view>;
+		using const_iterator = const value_type*;
+
+		// Returns false when full.
+		bool set(std::string_view name, std::string_view value);
+
+		const_iterator find(std::string_view name) const;
+
+		const_iterator begin() const { return items_.data(); }
+		const_iterator end() const { return items_.data() + count_; }
+		std::size_t size() const { return count_; }
+		bool empty() const { return count_ == 0; }
+		void clear() { count_ = 0; }
+
+	private:
+		std::array<value_type, max_params> items_{};
+		std::size_t count_ = 0;
+	};
+
+	// Pull-style access to a request body for handlers that consume it in
+	// pieces rather than as one string. Bodies are framed completely
+	// (Content-Length or chunked) before a handler runs.
+	class BodyReader {
+	public:
+		explicit BodyReader(std::string_view body) : data_(body) {}
+
+		// Copies up to n bytes into dst; 0 at the end.
+		std::size_t read(char* dst, std::size_t n) {
+			std::string_view piece = next(n);
+			if (!piece.empty()) std::memcpy(dst, piece.data(), piece.size());
+			return piece.size();
+		}
+
+		// Next piece of at most max bytes; empty at the end.
+		std::string_view next(std::size_t max) {
+			std::string_view piece = data_.substr(pos_, max);
+			pos_ += piece.size();
+			return piece;
+		}
+
+		std::size_t remaining() const { return data_.size() - pos_; }
+		bool done() const { return pos_ == data_.size(); }
+
+	private:
+		std::string_view data_;
+		std::size_t pos_ = 0;
+	};
+
+	// Allocating members use the memory resource given at construction
+	// (a connection's RequestArena on the server path). Copies fall back to
+	// the default resource, so a copy may outlive the arena.
 	struct HttpRequest {
+		explicit HttpRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: query_params(mr), headers(mr), body(mr) {}
+
 		HttpMethod method = HttpMethod::Unknown;
+
+		// Zero-copy slices filled by RequestParser. They point into the buffer
+		// the request was parsed from until own_storage() copies that block.
+		bool has_views = false;
+		std::string_view raw_method;
+		std::string_view raw_path;
+		std::string_view raw_query;
+		std::string_view raw_version;
+		HeaderList raw_headers;
+
+		// Owned-string compatibility layer. parse_http_request() and
+		// materialize() fill it; the server's request path leaves it empty.
 		std::string method_str;
 		std::string path;
 		std::string query;
-		QueryParams query_params;
+		mutable QueryParams query_params; // parsed from raw_query on first use
 		std::string http_version;
-		std::unordered_map<std::string, std::string> headers;
-		std::string body;
+		std::pmr::unordered_map<std::pmr::string, std::pmr::string, StringHash, StringEqual> headers;
+
+		std::pmr::string body; // decoded when the request was chunked
 
-		std::unordered_map<std::string, std::string> path_params;
+		PathParams path_params;
 
-		const std::string& header(const std::string& name) const;
+		RequestTiming timing;
+
+		BodyReader body_reader() const { return BodyReader(body); }
+
+		// The resource the request allocates from; responses to it use it too.
+		std::pmr::memory_resource* resource() const { return body.get_allocator().resource(); }
+
+		std::string_view method_sv() const { return has_views ? raw_method : std::string_view(method_str); }
+		std::string_view path_sv() const { return has_views ? raw_path : std::string_view(path); }
+		std::string_view query_sv() const { return has_views ? raw_query : std::string_view(query); }
+		std::string_view version_sv() const { return has_views ? raw_version : std::string_view(http_version); }
+
+		// Case-insensitive lookup; empty if absent.
+		std::string_view header(std::string_view name) const;
+
+		// Copies the bytes the views point into into storage owned by the
+		// request, so it can outlive (or be queued past) the read buffer.
+		void own_storage();
+
+		// Fills the owned fields from the views and drops the views.
+		void materialize();
 
 
 		bool has_query(const std::string& key) const {
-			return query_params.has(key);
+			return parsed_query().has(key);
 		}
 
 		std::optional<std::string> query_param(const std::string& key) const {
-			return query_params.get(key);
+			return parsed_query().get(key);
 		}
 
 		std::string query_param_or(const std::string& key,
 			const std::string& default_value) const {
-			auto v = query_params.get(key);
+			auto v = parsed_query().get(key);
 			return v ? *v : default_value;
 		}
 
 		std::optional<int> query_param_int(const std::string& key) const {
-			return query_params.get_int(key);
+			return parsed_query().get_int(key);
 		}
 
 		std::optional<double> query_param_double(const std::string& key) const {
-			return query_params.get_double(key);
+			return parsed_query().get_double(key);
 		}
 
 		std::optional<bool> query_param_bool(const std::string& key) const {
-			return query_params.get_bool(key);
+			return parsed_query().get_bool(key);
 		}
 
 
@@ -136,45 +355,413 @@ namespace http {
 		std::optional<std::string> path_param(const std::string& key) const {
 			auto it = path_params.find(key);
 			if (it == path_params.end()) return std::nullopt;
-			return it->second;
+			return std::string(it->second);
 		}
+
+	private:
+		const QueryParams& parsed_query() const;
+
+		std::shared_ptr<std::string> storage_;
+		mutable bool query_parsed_ = false;
+	};
+
+	// Incremental decoder for Transfer-Encoding: chunked request bodies.
+	// Like RequestParser, feed() receives the body bytes received so far
+	// (starting right after the head) and resumes where it stopped. Decoded
+	// data accumulates in the decoder; extensions and trailers are skipped.
+	class ChunkedDecoder {
+	public:
+		enum class Status {
+			Incomplete,
+			Complete,
+			Malformed,
+			TooLarge
+		};
+
+		explicit ChunkedDecoder(std::size_t max_body_size = 10 * 1024 * 1024)
+			: max_body_size_(max_body_size) {}
+
+		Status feed(std::string_view data);
+
+		// Encoded bytes making up the body, once Complete.
+		std::size_t consumed() const { return pos_; }
+
+		std::string take_body() { return std::move(body_); }
+
+		void reset();
+
+	private:
+		enum class State {
+			Size,
+			Data,
+			DataEnd,
+			Trailer,
+			Done
+		};
+
+		static constexpr std::size_t max_line = 4096;
+
+		std::size_t max_body_size_;
+		State state_ = State::Size;
+		std::size_t pos_ = 0;
+		std::size_t remaining_ = 0;
+		std::string body_;
 	};
 
+	// Resumable HTTP/1.1 request-head parser. feed() is called with the bytes
+	// of the current request received so far (the same prefix, possibly
+	// grown and reallocated) and only scans what it has not seen yet. It
+	// records offsets, so views are bound to the buffer only by bind().
+	class RequestParser {
+	public:
+		enum class Status {
+			Incomplete,
+			Complete,
+			Malformed,
+			TooLarge
+		};
+
+		explicit RequestParser(std::size_t max_header_size = 64 * 1024)
+			: max_header_size_(max_header_size) {
+		}
+
+		Status feed(std::string_view data);
+
+		// Valid once feed() returned Complete.
+		std::size_t header_length() const { return header_length_; }
+		void bind(std::string_view data, HttpRequest& req) const;
+
+		bool done() const { return state_ == State::Done; }
+		void reset();
+
+	private:
+		enum class State {
+			RequestLine,
+			Headers,
+			Done
+		};
+
+		struct Slice {
+			std::uint32_t off = 0;
+			std::uint32_t len = 0;
+		};
+
+		struct HeaderSlice {
+			Slice name;
+			Slice value;
+		};
+
+		bool on_line(std::string_view data, std::size_t begin, std::size_t end);
+
+		std::size_t max_header_size_;
+		State state_ = State::RequestLine;
+		std::size_t line_start_ = 0;
+		std::size_t scan_pos_ = 0;
+		std::size_t header_length_ = 0;
+
+		Slice method_;
+		Slice path_;
+		Slice query_;
+		Slice version_;
+		bool has_query_ = false;
+		std::array<HeaderSlice, HeaderList::max_headers> headers_{};
+		std::size_t header_count_ = 0;
+		bool too_many_headers_ = false;
+	};
+
+	// Ordered response header list. A response carries a handful of headers,
+	// so a case-insensitive linear scan beats hashing every name.
+	class ResponseHeaders {
+	public:
+		using value_type = std::pair<std::pmr::string, std::pmr::string>;
+		using iterator = std::pmr::vector<value_type>::iterator;
+		using const_iterator = std::pmr::vector<value_type>::const_iterator;
+
+		explicit ResponseHeaders(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: items_(mr) {}
+
+		// Inserts an empty value when the name is missing.
+		std::pmr::string& operator[](std::string_view name);
+
+		iterator find(std::string_view name);
+		const_iterator find(std::string_view name) const;
+
+		// Throws std::out_of_range when the name is missing.
+		const std::pmr::string& at(std::string_view name) const;
+
+		std::size_t count(std::string_view name) const { return find(name) != end() ? 1 : 0; }
+		std::size_t erase(std::string_view name);
+
+		iterator begin() { return items_.begin(); }
+		iterator end() { return items_.end(); }
+		const_iterator begin() const { return items_.begin(); }
+		const_iterator end() const { return items_.end(); }
+
+		std::size_t size() const { return items_.size(); }
+		bool empty() const { return items_.empty(); }
+		void clear() { items_.clear(); }
+
+	private:
+		std::pmr::vector<value_type> items_;
+	};
+
+	// Reason and headers use the given memory resource, like HttpRequest.
+	// The body stays a std::string: ResponseWriter moves it, never copies.
 	struct HttpResponse {
+		explicit HttpResponse(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+			: reason("OK", mr), headers(mr) {}
+
 		int status_code = 200;
-		std::string reason = "OK";
-		std::unordered_map<std::string, std::string> headers;
+		std::pmr::string reason;
+		ResponseHeaders headers;
 		std::string body;
 
+		// Sent after body, in order. Shared parts are written from their own
+		// buffer and never copied, so one cached body can serve many
+		// responses at once. Content-Length covers body and all parts.
+		std::vector<net::SendBuffer> body_parts;
+
+		// Streams the body instead: called until it returns false, each call
+		// may fill chunk (handed in empty). Such a response is sent with
+		// Transfer-Encoding: chunked, and body, body_parts and Content-Length
+		// are ignored.
+		using BodySource = std::function<bool(std::string& chunk)>;
+		BodySource body_source;
+
+		// Appends the status line and headers (adding Content-Length or
+		// Transfer-Encoding unless set) to out; the body is not touched.
+		// static_headers is a block of pre-serialized "Name: value\r\n" lines
+		// emitted after our own, less those naming a header we set.
+		void serialize_head(std::string& out, std::string_view static_headers = {}) const;
+
 		std::string to_string() const;
 
-		void set_status(int code, const std::string& reason_phrase) {
+		void set_status(int code, std::string_view reason_phrase) {
 			status_code = code;
 			reason = reason_phrase;
 		}
 	};
 
+	// Serializes a batch of responses into one reusable head buffer. Bodies
+	// and body parts up to inline_body_limit are copied next to their head;
+	// larger ones are moved out of the response and sent as their own
+	// slice, never copied.
+	// Keep one writer per connection so its buffers are reused.
+	class ResponseWriter {
+	public:
+		static constexpr std::size_t inline_body_limit = 1024;
+
+		// While a body_source is drained, the writer calls flush each time
+		// this much is buffered. flush should send and clear the batch and
+		// return false once the connection is gone.
+		static constexpr std::size_t stream_flush_bytes = 64 * 1024;
+		using Flush = std::function<bool(ResponseWriter&)>;
+
+		void set_flush(Flush flush) { flush_ = std::move(flush); }
+
+		// Returns false if a flush failed while streaming the body.
+		bool add(HttpResponse& resp, std::string_view static_headers = {});
+
+		// Appends an already serialized response.
+		void add_raw(std::string_view bytes);
+
+		bool empty() const { return segments_.empty(); }
+		void clear();
+
+		// Slices over the batch, in order; valid until the next add/clear.
+		const std::vector<net::IoSlice>& slices();
+
+		// Moves the batch out as buffers for TcpConnection::async_send and
+		// clears the writer.
+		std::vector<net::SendBuffer> take_parts();
+
+		// Hands the writer a spare buffer (e.g. one the connection finished
+		// sending) to serialize into after take_parts() moved its own away.
+		void reuse(std::string buffer);
+
+	private:
+		struct Segment {
+			std::size_t head_end = 0;
+			std::size_t body = 0; // index into bodies_ + 1, 0 when inlined
+		};
+
+		void add_body_part(std::string& part);
+		void add_body_part(net::SendBuffer&& part);
+		bool add_stream(HttpResponse& resp);
+
+		std::string buf_;
+		std::vector<net::SendBuffer> bodies_;
+		std::size_t body_bytes_ = 0;
+		std::vector<Segment> segments_;
+		std::vector<net::IoSlice> slices_;
+		Flush flush_;
+	};
+
+	// Coroutine returned by an async handler. It starts suspended; start()
+	// runs it up to its first co_await and calls `done` once it has
+	// returned, on whichever thread resumed it last, possibly before
+	// start() returns. The response is filled in place, as with a plain
+	// handler. An exception escaping the handler is kept for failed().
+	class AsyncTask {
+	public:
+		struct promise_type {
+			std::function<void()> on_done;
+			std::exception_ptr error;
+
+			AsyncTask get_return_object() {
+				return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			auto final_suspend() noexcept {
+				struct Notify {
+					bool await_ready() noexcept { return false; }
+					void await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+						// May destroy the task: nothing touches the frame after this.
+						auto done = std::move(h.promise().on_done);
+						if (done) done();
+					}
+					void await_resume() noexcept {}
+				};
+				return Notify{};
+			}
+			void return_void() {}
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		AsyncTask() = default;
+		AsyncTask(AsyncTask&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+		AsyncTask& operator=(AsyncTask&& o) noexcept {
+			if (this != &o) {
+				reset();
+				h_ = std::exchange(o.h_, {});
+			}
+			return *this;
+		}
+		~AsyncTask() { reset(); }
+
+		explicit operator bool() const { return static_cast<bool>(h_); }
+
+		void start(std::function<void()> done) {
+			h_.promise().on_done = std::move(done);
+			h_.resume();
+		}
+
+		// Starts the task and blocks the calling thread until it is done.
+		void run_blocking();
+
+		bool done() const { return h_ && h_.done(); }
+		bool failed() const { return static_cast<bool>(error()); }
+		std::exception_ptr error() const { return h_ ? h_.promise().error : nullptr; }
+
+		// Destroys the coroutine; only valid before start() or once done.
+		void reset() {
+			if (h_) h_.destroy();
+			h_ = {};
+		}
+
+	private:
+		explicit AsyncTask(std::coroutine_handle<promise_type> h) : h_(h) {}
+
+		std::coroutine_handle<promise_type> h_;
+	};
+
+	// Routes are frozen into a segment trie: static segments are compared as
+	// string_views, ":name" and "*name" capture views into the path, and each
+	// node dispatches on HttpMethod through a small handler table. Lookup
+	// cost follows path depth, not route count, and does not allocate.
+	// Static segments win over ":param", which wins over "*wildcard".
 	class Router {
 	public:
 		using Handler = std::function<void(HttpRequest&, HttpResponse&)>;
 
+		// May suspend (e.g. on database work) without holding a worker; the
+		// response is sent once the task completes. req and resp stay valid
+		// until then.
+		using AsyncHandler = std::function<AsyncTask(HttpRequest&, HttpResponse&)>;
+
 		void add_route(HttpMethod method, const std::string& path_pattern, Handler handler);
 		void add_route(const std::string& method_str, const std::string& path_pattern, Handler handler);
+		void add_async_route(HttpMethod method, const std::string& path_pattern, AsyncHandler handler);
 
+		// Builds the trie. HttpServer::start calls it before serving; route()
+		// compiles lazily otherwise, which is not safe to race with.
+		void compile() const;
 
+		// Runs an async handler to completion on the calling thread.
 		bool route(HttpRequest& req, HttpResponse& resp) const;
 
+		// For an async route, leaves its not yet started coroutine in task
+		// instead of running it.
+		bool route(HttpRequest& req, HttpResponse& resp, AsyncTask& task) const;
+
+		static constexpr std::size_t no_route = static_cast<std::size_t>(-1);
+
+		// route() in two steps, for callers timing them apart. resolve binds
+		// the path params of the matching route and returns its index, or
+		// fills resp with the 400/404/405 answer and returns no_route.
+		std::size_t resolve(HttpRequest& req, HttpResponse& resp) const;
+		void dispatch(std::size_t index, HttpRequest& req, HttpResponse& resp, AsyncTask& task) const;
+
+		std::size_t route_count() const { return routes_.size(); }
+
+		// "METHOD /pattern", in registration order.
+		std::string route_label(std::size_t index) const;
+
 	private:
+		static constexpr std::uint32_t no_node = 0xFFFFFFFFu;
+		static constexpr std::size_t method_slots = static_cast<std::size_t>(HttpMethod::Unknown);
+
 		struct Route {
-			std::string method;
+			std::string method; // upper case
 			std::string pattern;
 			Handler handler;
+			std::vector<std::string> param_names; // in capture order
+			AsyncHandler async_handler{};          // set instead of handler
+		};
+
+		struct Node {
+			std::vector<std::pair<std::string, std::uint32_t>> statics;
+			std::uint32_t param = no_node;
+			std::uint32_t wildcard = no_node;
+
+			// Route index per HttpMethod, or no_node.
+			std::array<std::uint32_t, method_slots> handlers;
+			// Methods parse_method does not know, matched by name.
+			std::vector<std::pair<std::string, std::uint32_t>> custom;
+
+			Node() { handlers.fill(no_node); }
+		};
+
+		struct Captures {
+			std::array<std::string_view, PathParams::max_params> values;
+			std::size_t count = 0;
 		};
 
+		// Methods of path matches that did not accept the request's method.
+		struct Allowed {
+			std::uint32_t mask = 0;             // bit per HttpMethod
+			std::vector<std::uint32_t> custom;  // route indices
+		};
+
+		std::uint32_t find_route(std::uint32_t node_index,
+			std::string_view path,
+			std::size_t pos,
+			HttpMethod method,
+			std::string_view method_str,
+			Captures& caps,
+			Allowed& allowed) const;
+
+		std::uint32_t terminal_route(const Node& node,
+			HttpMethod method,
+			std::string_view method_str,
+			Allowed& allowed) const;
+
+		void insert(std::uint32_t route_index) const;
+
 		std::vector<Route> routes_;
-		static bool match_pattern(const std::string& pattern,
-			const std::string& path,
-			std::unordered_map<std::string, std::string>& out_params);
+
+		mutable std::vector<Node> nodes_;
+		mutable bool compiled_ = false;
 	};
 
 	bool parse_http_request(const std::string& raw, HttpRequest& req, std::size_t& header_length);
@@ -185,16 +772,40 @@ namespace http {
 
 		std::size_t thread_count = std::thread::hardware_concurrency();
 		std::size_t max_queue_size = 1024;
+		// WorkStealing keeps jobs that handlers submit to the pool (deferred
+		// work) on the submitting worker.
+		net::PoolMode pool_mode = net::PoolMode::Shared;
 
 		std::size_t max_header_size = 64 * 1024;        // 64 KB
 		std::size_t max_body_size = 10 * 1024 * 1024; // 10 MB
 
 		int socket_timeout_ms = 10000; // 10 sec
 
+		// Reactor multiplexes keep-alive connections over event_loop_threads
+		// event loops and only hands complete requests to the thread pool.
+		net::IoModel io_model = net::IoModel::Blocking;
+		std::size_t event_loop_threads = 2;
+
+		// Independent listener shards (acceptor + worker pool + loops each);
+		// thread_count, event_loop_threads and max_queue_size are split
+		// between them.
+		std::size_t listener_shards = 1;
+		bool pin_shards_to_cores = false;
+
 		bool enable_cors = false;
 		std::string cors_allow_origin = "*";
 		std::string cors_allow_methods = "GET, POST, PUT, DELETE, OPTIONS, PATCH";
 		std::string cors_allow_headers = "Content-Type, Authorization";
+
+		// Sent with every routed response and preflight. Together with the
+		// CORS headers they are serialized once, in HttpServer::start.
+		std::vector<std::pair<std::string, std::string>> static_headers;
+
+		// Per-thread request counters and phase histograms, see
+		// HttpServer::metrics(). With metrics_path set they are served there
+		// (GET) in the Prometheus text format.
+		bool collect_metrics = true;
+		std::string metrics_path;
 	};
 
 	class HttpServer {
@@ -220,15 +831,85 @@ namespace http {
 			router_.add_route(method_str, path_pattern, std::move(handler));
 		}
 
+		void add_async_route(HttpMethod method, const std::string& path_pattern, Router::AsyncHandler handler) {
+			router_.add_async_route(method, path_pattern, std::move(handler));
+		}
+
 		Router& router() { return router_; }
 		const Router& router() const { return router_; }
 
 		const HttpServerConfig& config() const { return config_; }
 
+		// Gauges and counters added here (e.g. of the application's queues)
+		// are rendered along with the server's own.
+		HttpMetrics& metrics() { return metrics_; }
+		const HttpMetrics& metrics() const { return metrics_; }
+
 	private:
+		enum class ExtractStatus {
+			Incomplete,     // headers not complete yet
+			IncompleteBody, // headers parsed, body still arriving
+			Complete,
+			Error           // error_resp is filled, connection must close
+		};
+
+		struct ReactorConnection;
+
+		ExtractStatus extract_request(RequestParser& parser,
+			ChunkedDecoder& chunked,
+			std::string_view data,
+			HttpRequest& req,
+			std::size_t& consumed,
+			HttpResponse& error_resp) const;
+		// On Complete, consumed is the full request size (head + body). On
+		// IncompleteBody it is how much must be buffered before trying again:
+		// the whole request for Content-Length, one more byte for chunked.
+
+		// Routes req and serializes the response into writer. keep_alive is
+		// cleared if a streamed response lost its connection. An async
+		// handler is run to completion on the calling thread.
+		void write_response(HttpRequest& req, ResponseWriter& writer, bool& keep_alive) const;
+
+		// write_response in two halves around an async handler: begin_response
+		// routes req into resp and returns false when task must run before
+		// end_response serializes resp into writer.
+		bool begin_response(HttpRequest& req, HttpResponse& resp, AsyncTask& task,
+			ResponseWriter& writer, bool& keep_alive) const;
+		void end_response(HttpRequest& req, HttpResponse& resp, ResponseWriter& writer, bool& keep_alive) const;
+
+		// Starts an async item's task; true when it suspended, in which case
+		// its completion resumes drain_reactor_requests on the pool (or
+		// answers 503 when the pool is full) and the caller must not touch
+		// the connection state again.
+		bool start_async(const std::shared_ptr<net::TcpConnection>& conn, AsyncTask& task);
+
+		// Queues the writer's batch on conn, timing it for the metrics.
+		bool send_parts(const std::shared_ptr<net::TcpConnection>& conn, ResponseWriter& writer, bool close) const;
+
+		// Counts a request the parser rejected with error_resp.
+		void count_parse_error(const HttpResponse& error_resp) const;
+
+		// The calling thread's metrics, or null when they are off.
+		ThreadMetrics* local_metrics() const { return config_.collect_metrics ? &metrics_.local() : nullptr; }
+
+		void compile_static_headers();
+
 		void handle_connection(std::shared_ptr<net::TcpConnection> conn);
 
+		void on_reactor_data(const std::shared_ptr<net::TcpConnection>& conn, const char* data, std::size_t size);
+		void drain_reactor_requests(const std::shared_ptr<net::TcpConnection>& conn);
+
 		HttpServerConfig config_;
+		BufferPool buffers_; // receive buffers of blocking-mode connections
+
+		// Built by compile_static_headers: CORS/static header blocks ending
+		// with the Connection header, and complete 204 preflight responses.
+		std::string static_keep_alive_;
+		std::string static_close_;
+		std::string preflight_keep_alive_;
+		std::string preflight_close_;
+
+		mutable HttpMetrics metrics_;
 		Router router_;
 		net::TcpServer tcp_server_;
 	};
@@ -1,10 +1,17 @@
 #include "http_server.hpp"
 #include <cassert>
+#include <condition_variable>
+#include <coroutine>
 #include <iostream>
+#include <map>
 #include <random>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <thread>
 
 namespace tests {
 
@@ -290,6 +297,85 @@ namespace tests {
 		return true;
 	}
 
+	bool test_router_trie_precedence_and_allow() {
+		http::Router router;
+		std::string hit;
+		std::map<std::string, std::string> params;
+
+		auto tag = [&](const char* name) {
+			return [&hit, &params, name](http::HttpRequest& req, http::HttpResponse& resp) {
+				hit = name;
+				for (const auto& kv : req.path_params) {
+					params[std::string(kv.first)] = std::string(kv.second);
+				}
+				resp.body = name;
+				};
+			};
+
+		router.add_route(http::HttpMethod::Get, "/users/:id", tag("param"));
+		router.add_route(http::HttpMethod::Get, "/users/me", tag("static"));
+		router.add_route(http::HttpMethod::Put, "/users/:name", tag("put"));
+		router.add_route(http::HttpMethod::Get, "/users/:id/files/*rest", tag("wild"));
+		router.add_route("PURGE", "/cache", tag("purge"));
+		router.add_route(http::HttpMethod::Get, "/cache", tag("cache"));
+
+		auto run = [&](const char* method, const char* path, http::HttpResponse& resp) {
+			http::HttpRequest req;
+			req.method = http::parse_method(method);
+			req.method_str = method;
+			req.path = path;
+			hit.clear();
+			params.clear();
+			return router.route(req, resp);
+			};
+
+		{
+			http::HttpResponse resp;
+			bool routed = run("GET", "/users/me", resp);
+			assert(routed && hit == "static");
+		}
+		{
+			http::HttpResponse resp;
+			bool routed = run("PUT", "/users/me", resp);
+			assert(routed && hit == "put");
+			// The capture name comes from the matched route.
+			assert(params.size() == 1 && params["name"] == "me");
+		}
+		{
+			http::HttpResponse resp;
+			bool routed = run("GET", "/users/7/files/a/b.txt", resp);
+			assert(routed && hit == "wild");
+			assert(params["id"] == "7");
+			assert(params["rest"] == "a/b.txt");
+		}
+		{
+			http::HttpResponse resp;
+			bool routed = run("GET", "/users/7/files", resp);
+			assert(routed && hit == "wild");
+			assert(params.count("rest") == 1 && params["rest"].empty());
+		}
+		{
+			http::HttpResponse resp;
+			bool routed = run("purge", "/cache", resp);
+			assert(routed && hit == "purge");
+		}
+		{
+			http::HttpResponse resp;
+			bool routed = run("DELETE", "/cache", resp);
+			assert(!routed);
+			assert(resp.status_code == 405);
+			assert(resp.headers.at("Allow") == "GET, PURGE");
+		}
+		{
+			http::HttpResponse resp;
+			bool routed = run("GET", "/users", resp);
+			assert(!routed);
+			assert(resp.status_code == 404);
+		}
+
+		return true;
+	}
+
 	bool test_response_to_string() {
 		http::HttpResponse resp;
 		resp.status_code = 200;
@@ -307,6 +393,229 @@ namespace tests {
 	}
 
 
+	bool test_response_writer_batches() {
+		http::HttpResponse small;
+		small.set_status(404, "Not Found");
+		small.headers["content-type"] = "text/plain";
+		small.headers["Content-Type"] = "text/html";
+		small.body = "Not Found";
+		assert(small.headers.size() == 1);
+		assert(small.headers.at("CONTENT-TYPE") == "text/html");
+
+		http::HttpResponse custom;
+		custom.set_status(299, "Whatever");
+		custom.headers["Content-Length"] = "0";
+
+		http::HttpResponse large;
+		large.body.assign(http::ResponseWriter::inline_body_limit + 1, 'x');
+
+		std::string expected = small.to_string() + custom.to_string() + large.to_string();
+		assert(expected.find("HTTP/1.1 299 Whatever\r\n") != std::string::npos);
+		assert(expected.find("Content-Length: 0\r\nContent-Length") == std::string::npos);
+
+		http::ResponseWriter writer;
+		writer.add(small);
+		writer.add(custom);
+		writer.add(large);
+		assert(large.body.empty());
+
+		std::string joined;
+		for (const auto& slice : writer.slices()) {
+			joined.append(slice.data, slice.size);
+		}
+		assert(joined == expected);
+		assert(writer.slices().size() == 2);
+
+		std::string from_parts;
+		for (const auto& part : writer.take_parts()) {
+			from_parts += part.view();
+		}
+		assert(from_parts == expected);
+		assert(writer.empty());
+
+		return true;
+	}
+
+	bool test_response_shared_parts() {
+		auto shared = std::make_shared<const std::string>(http::ResponseWriter::inline_body_limit * 3, 's');
+
+		http::HttpResponse resp;
+		resp.body = "[";
+		resp.body_parts.emplace_back(shared);
+		resp.body_parts.emplace_back(std::shared_ptr<const void>(shared), std::string_view(*shared).substr(0, 10));
+		resp.body_parts.emplace_back(std::string("]"));
+		std::string expected = resp.to_string();
+		std::size_t length = 2 + shared->size() + 10;
+		assert(expected.find("Content-Length: " + std::to_string(length) + "\r\n") != std::string::npos);
+		assert(expected.size() > length && expected.compare(expected.size() - length, length,
+			"[" + *shared + shared->substr(0, 10) + "]") == 0);
+
+		// The large part is sent from the shared buffer, the small ones are
+		// copied next to the head.
+		http::ResponseWriter writer;
+		writer.add(resp);
+		assert(resp.body_parts.empty());
+		bool zero_copy = false;
+		std::string joined;
+		for (const auto& slice : writer.slices()) {
+			zero_copy = zero_copy || slice.data == shared->data();
+			joined.append(slice.data, slice.size);
+		}
+		assert(zero_copy && joined == expected);
+
+		auto parts = writer.take_parts();
+		assert(parts.size() == 3 && parts[1].shared && parts[1].data() == shared->data());
+		assert(shared.use_count() == 2);
+		parts.clear();
+		assert(shared.use_count() == 1);
+		return true;
+	}
+
+	bool test_response_static_headers_block() {
+		http::HttpResponse resp;
+		resp.headers["Content-Type"] = "text/plain";
+		resp.body = "hi";
+
+		std::string head;
+		resp.serialize_head(head, "X-Static: 1\r\nConnection: close\r\n");
+		assert(head == "HTTP/1.1 200 OK\r\n"
+			"Content-Type: text/plain\r\n"
+			"X-Static: 1\r\n"
+			"Connection: close\r\n"
+			"Content-Length: 2\r\n\r\n");
+
+		// Headers the handler set win over static ones of the same name.
+		http::HttpResponse own;
+		own.headers["access-control-allow-origin"] = "https://a.example";
+		own.headers["Connection"] = "close";
+		head.clear();
+		own.serialize_head(head,
+			"Access-Control-Allow-Origin: *\r\n"
+			"X-Static: 1\r\n"
+			"Connection: keep-alive\r\n");
+		assert(head == "HTTP/1.1 200 OK\r\n"
+			"access-control-allow-origin: https://a.example\r\n"
+			"Connection: close\r\n"
+			"X-Static: 1\r\n"
+			"Content-Length: 0\r\n\r\n");
+
+		http::ResponseWriter writer;
+		writer.add_raw("HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n");
+		writer.add(resp);
+		assert(writer.slices().size() == 1);
+		std::string joined(writer.slices()[0].data, writer.slices()[0].size);
+		assert(joined.find("HTTP/1.1 204 No Content\r\n") == 0);
+		assert(joined.find("HTTP/1.1 200 OK\r\n") != std::string::npos);
+
+		return true;
+	}
+
+	bool test_chunked_decoder_incremental() {
+		const std::string encoded =
+			"4;ext=1\r\nWiki\r\n"
+			"5\r\npedia\r\n"
+			"E\r\n in\r\n\r\nchunks.\r\n"
+			"0\r\nX-Trailer: t\r\n\r\n"
+			"GET /next";
+		const std::size_t body_end = encoded.find("GET /next");
+
+		// Fed a growing prefix, as the server does.
+		http::ChunkedDecoder dec;
+		http::ChunkedDecoder::Status st = http::ChunkedDecoder::Status::Incomplete;
+		std::size_t fed = 0;
+		while (st == http::ChunkedDecoder::Status::Incomplete) {
+			assert(fed < encoded.size());
+			++fed;
+			st = dec.feed(std::string_view(encoded).substr(0, fed));
+		}
+		assert(st == http::ChunkedDecoder::Status::Complete);
+		assert(fed == body_end);
+		assert(dec.consumed() == body_end);
+		std::string body = dec.take_body();
+		assert(body == "Wikipedia in\r\n\r\nchunks.");
+
+		dec.reset();
+		st = dec.feed("zz\r\n");
+		assert(st == http::ChunkedDecoder::Status::Malformed);
+		dec.reset();
+		st = dec.feed("3\r\nabcX");
+		assert(st == http::ChunkedDecoder::Status::Malformed);
+
+		http::ChunkedDecoder small(8);
+		st = small.feed("9\r\n");
+		assert(st == http::ChunkedDecoder::Status::TooLarge);
+
+		http::BodyReader reader("Wikipedia");
+		char buf[4];
+		std::size_t n = reader.read(buf, sizeof(buf));
+		assert(n == 4 && std::string(buf, 4) == "Wiki");
+		std::string_view rest = reader.next(100);
+		assert(rest == "pedia");
+		n = reader.read(buf, sizeof(buf));
+		assert(reader.done() && n == 0);
+
+		return true;
+	}
+
+	bool test_response_streamed_body() {
+		auto make = [](int pieces, std::size_t piece_size) {
+			http::HttpResponse resp;
+			resp.headers["Content-Length"] = "123";
+			int produced = 0;
+			resp.body_source = [produced, pieces, piece_size](std::string& chunk) mutable {
+				if (produced == pieces) return false;
+				chunk.assign(piece_size, static_cast<char>('a' + produced % 26));
+				++produced;
+				return true;
+				};
+			return resp;
+			};
+
+		{
+			http::HttpResponse resp = make(2, 3);
+			std::string s = resp.to_string();
+			assert(s.find("Content-Length") == std::string::npos);
+			assert(s.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+			assert(s.substr(s.find("\r\n\r\n") + 4) == "3\r\naaa\r\n3\r\nbbb\r\n0\r\n\r\n");
+		}
+		{
+			// Decoding what the writer streams gives the produced bytes back,
+			// and flush is called along the way for a large body.
+			http::HttpResponse resp = make(40, 4000);
+			std::string wire;
+			int flushes = 0;
+			http::ResponseWriter writer;
+			writer.set_flush([&](http::ResponseWriter& w) {
+				++flushes;
+				for (const auto& sl : w.slices()) wire.append(sl.data, sl.size);
+				w.clear();
+				return true;
+				});
+			bool added = writer.add(resp);
+			assert(added);
+			for (const auto& part : writer.take_parts()) wire += part.view();
+			assert(flushes >= 2);
+
+			std::size_t head = wire.find("\r\n\r\n") + 4;
+			http::ChunkedDecoder dec;
+			auto st = dec.feed(std::string_view(wire).substr(head));
+			assert(st == http::ChunkedDecoder::Status::Complete);
+			assert(head + dec.consumed() == wire.size());
+			std::string body = dec.take_body();
+			assert(body.size() == 40 * 4000);
+			assert(body[0] == 'a' && body.back() == static_cast<char>('a' + 39 % 26));
+		}
+		{
+			http::HttpResponse resp = make(40, 4000);
+			http::ResponseWriter writer;
+			writer.set_flush([](http::ResponseWriter&) { return false; });
+			bool added = writer.add(resp);
+			assert(!added);
+		}
+
+		return true;
+	}
+
 	bool test_random_query_parsing() {
 		std::mt19937 rng(123456);
 
@@ -403,7 +712,7 @@ namespace tests {
 				const auto& orig_vec = kv.second;
 				assert(got_vec.size() == orig_vec.size());
 				for (std::size_t i = 0; i < orig_vec.size(); ++i) {
-					assert(got_vec[i] == orig_vec[i]);
+					assert(std::string_view(got_vec[i]) == orig_vec[i]);
 				}
 			}
 		}
@@ -564,6 +873,194 @@ namespace tests {
 		return true;
 	}
 
+	// Resumes the awaiting coroutine on a new thread, like work finished
+	// by another executor.
+	struct ResumeElsewhere {
+		std::thread* worker;
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> h) { *worker = std::thread([h] { h.resume(); }); }
+		void await_resume() const noexcept {}
+	};
+
+	bool test_router_async_handlers() {
+		http::Router router;
+		std::thread worker;
+		std::thread::id handler_thread;
+		router.add_async_route(http::HttpMethod::Post, "/slow/:id",
+			[&](http::HttpRequest& req, http::HttpResponse& resp) -> http::AsyncTask {
+				std::string id(*req.path_param("id"));
+				co_await ResumeElsewhere{ &worker };
+				handler_thread = std::this_thread::get_id();
+				if (id == "boom") throw std::runtime_error("handler failed");
+				resp.status_code = 201;
+				resp.body = "done " + id;
+			});
+
+		auto make_req = [](const char* path) {
+			http::HttpRequest req;
+			req.method = http::HttpMethod::Post;
+			req.method_str = "POST";
+			req.path = path;
+			return req;
+		};
+
+		// The three-argument route hands the task back unstarted.
+		{
+			http::HttpRequest req = make_req("/slow/7");
+			http::HttpResponse resp;
+			http::AsyncTask task;
+			bool routed = router.route(req, resp, task);
+			assert(routed);
+			assert(task && !task.done() && resp.body.empty());
+
+			std::mutex m;
+			std::condition_variable cv;
+			bool finished = false;
+			task.start([&] {
+				std::lock_guard<std::mutex> lock(m);
+				finished = true;
+				cv.notify_one();
+				});
+			{
+				std::unique_lock<std::mutex> lock(m);
+				cv.wait(lock, [&] { return finished; });
+			}
+			worker.join();
+			assert(task.done() && !task.failed());
+			assert(handler_thread != std::this_thread::get_id());
+			assert(resp.status_code == 201 && resp.body == "done 7");
+		}
+
+		// The plain route runs it to completion; failures surface as throws.
+		{
+			http::HttpRequest req = make_req("/slow/8");
+			http::HttpResponse resp;
+			bool routed = router.route(req, resp);
+			assert(routed);
+			worker.join();
+			assert(resp.body == "done 8");
+
+			http::HttpRequest bad = make_req("/slow/boom");
+			bool threw = false;
+			try {
+				router.route(bad, resp);
+			}
+			catch (const std::runtime_error&) {
+				threw = true;
+			}
+			worker.join();
+			assert(threw);
+		}
+
+		// Sync and async routes share the trie.
+		router.add_route(http::HttpMethod::Get, "/slow/:id",
+			[](http::HttpRequest&, http::HttpResponse& resp) { resp.body = "sync"; });
+		{
+			http::HttpRequest req = make_req("/slow/1");
+			req.method = http::HttpMethod::Get;
+			req.method_str = "GET";
+			http::HttpResponse resp;
+			http::AsyncTask task;
+			bool routed = router.route(req, resp, task);
+			assert(routed && !task && resp.body == "sync");
+		}
+		return true;
+	}
+
+	// Resumes the awaiting coroutine on a new thread right away, so the
+	// handler usually finishes while the reactor drain is still starting it.
+	struct ResumeNow {
+		std::mutex* m;
+		std::vector<std::thread>* workers;
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> h) {
+			std::lock_guard<std::mutex> lock(*m);
+			workers->emplace_back([h] { h.resume(); });
+		}
+		void await_resume() const noexcept {}
+	};
+
+	bool test_reactor_async_completes_elsewhere() {
+		net::NetInitializer net_init;
+
+		http::HttpServerConfig cfg;
+		cfg.bind_address = "127.0.0.1";
+		cfg.port = 41398;
+		cfg.io_model = net::IoModel::Reactor;
+		cfg.thread_count = 4;
+		http::HttpServer server(cfg);
+
+		std::mutex m;
+		std::vector<std::thread> workers;
+		server.add_async_route(http::HttpMethod::Get, "/async/:id",
+			[&](http::HttpRequest& req, http::HttpResponse& resp) -> http::AsyncTask {
+				std::string id(*req.path_param("id"));
+				co_await ResumeNow{ &m, &workers };
+				resp.body = "a" + id;
+			});
+		server.add_route(http::HttpMethod::Get, "/sync/:id",
+			[](http::HttpRequest& req, http::HttpResponse& resp) {
+				resp.body = "s" + std::string(*req.path_param("id"));
+			});
+		server.start();
+
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(cfg.port);
+		::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+		net::socket_t sock = ::socket(AF_INET, SOCK_STREAM, 0);
+		int connected = ::connect(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+		assert(connected == 0);
+
+		// Pipelined async and sync requests must all be answered, in order.
+		const int rounds = 200;
+		std::string buffer;
+		for (int i = 0; i < rounds; ++i) {
+			std::string id = std::to_string(i);
+			std::string batch =
+				"GET /async/" + id + " HTTP/1.1\r\nHost: localhost\r\n\r\n"
+				"GET /sync/" + id + " HTTP/1.1\r\nHost: localhost\r\n\r\n"
+				"GET /async/" + id + "b HTTP/1.1\r\nHost: localhost\r\n\r\n";
+			std::size_t sent = 0;
+			while (sent < batch.size()) {
+				auto n = ::send(sock, batch.data() + sent, static_cast<int>(batch.size() - sent), 0);
+				assert(n > 0);
+				if (n <= 0) return false;
+				sent += static_cast<std::size_t>(n);
+			}
+
+			std::string got;
+			for (int r = 0; r < 3; ++r) {
+				std::size_t head_end = std::string::npos;
+				std::size_t total = 0;
+				while (true) {
+					head_end = buffer.find("\r\n\r\n");
+					if (head_end != std::string::npos) {
+						std::size_t cl = buffer.find("Content-Length: ");
+						assert(cl != std::string::npos && cl < head_end);
+						total = head_end + 4 + std::stoul(buffer.substr(cl + 16));
+						if (buffer.size() >= total) break;
+					}
+					char chunk[4096];
+					auto n = ::recv(sock, chunk, static_cast<int>(sizeof(chunk)), 0);
+					assert(n > 0);
+					if (n <= 0) return false;
+					buffer.append(chunk, static_cast<std::size_t>(n));
+				}
+				got += buffer.substr(head_end + 4, total - head_end - 4) + " ";
+				buffer.erase(0, total);
+			}
+			assert(got == "a" + id + " s" + id + " a" + id + "b ");
+		}
+		net::close_socket(sock);
+
+		server.stop();
+		std::lock_guard<std::mutex> lock(m);
+		for (auto& t : workers) t.join();
+		assert(workers.size() == 2 * rounds);
+		return true;
+	}
+
 	bool test_router_unknown_method() {
 		http::Router router;
 
@@ -795,6 +1292,268 @@ namespace tests {
 	}
 
 
+	bool test_incremental_parser_byte_by_byte() {
+		std::string raw =
+			"POST /api/items?id=7&x=%20y HTTP/1.1\r\n"
+			"Host: example.com\r\n"
+			"Content-Length: 4\r\n"
+			"X-Dup: first\r\n"
+			"x-dup: second\r\n"
+			"\r\n"
+			"body";
+
+		http::RequestParser parser;
+		std::string buffer;
+		std::size_t head_len = raw.find("body");
+		for (std::size_t i = 0; i < head_len; ++i) {
+			buffer.push_back(raw[i]);
+			auto st = parser.feed(buffer);
+			if (i + 1 < head_len) {
+				assert(st == http::RequestParser::Status::Incomplete);
+			}
+			else {
+				assert(st == http::RequestParser::Status::Complete);
+			}
+		}
+		assert(parser.header_length() == head_len);
+
+		http::HttpRequest req;
+		parser.bind(buffer, req);
+		assert(req.has_views);
+		assert(req.method == http::HttpMethod::Post);
+		assert(req.method_sv() == "POST");
+		assert(req.path_sv() == "/api/items");
+		assert(req.query_sv() == "id=7&x=%20y");
+		assert(req.version_sv() == "HTTP/1.1");
+		assert(req.raw_headers.size() == 4);
+		assert(req.header("HOST") == "example.com");
+		assert(req.header("x-dup") == "second");
+		assert(req.header("missing").empty());
+		assert(req.query_param_int("id").value() == 7);
+		assert(req.query_param("x").value() == " y");
+
+		// Views point into the caller's buffer until the request owns a copy.
+		assert(req.path_sv().data() >= buffer.data() &&
+			req.path_sv().data() < buffer.data() + buffer.size());
+		req.own_storage();
+		buffer.assign(buffer.size(), '#');
+		assert(req.path_sv() == "/api/items");
+		assert(req.header("content-length") == "4");
+
+		http::HttpRequest copy = req;
+		req = http::HttpRequest{};
+		assert(copy.header("host") == "example.com");
+
+		copy.materialize();
+		assert(!copy.has_views);
+		assert(copy.method_str == "POST");
+		assert(copy.path == "/api/items");
+		assert(copy.headers.at("x-dup") == "second");
+		assert(copy.header("Host") == "example.com");
+
+		return true;
+	}
+
+	bool test_incremental_parser_limits() {
+		{
+			http::RequestParser parser(64);
+			std::string raw = "GET / HTTP/1.1\r\nX-Long: " + std::string(100, 'a') + "\r\n\r\n";
+			auto st = parser.feed(raw);
+			assert(st == http::RequestParser::Status::TooLarge);
+		}
+		{
+			http::RequestParser parser(64);
+			std::string partial = "GET / HTTP/1.1\r\nX-Long: " + std::string(100, 'a');
+			auto st = parser.feed(partial);
+			assert(st == http::RequestParser::Status::TooLarge);
+		}
+		{
+			http::RequestParser parser;
+			std::string raw = "GET / HTTP/1.1\r\n";
+			for (std::size_t i = 0; i <= http::HeaderList::max_headers; ++i) {
+				raw += "H" + std::to_string(i) + ": v\r\n";
+			}
+			raw += "\r\n";
+			auto st = parser.feed(raw);
+			assert(st == http::RequestParser::Status::TooLarge);
+		}
+		{
+			http::RequestParser parser;
+			auto st = parser.feed("GET\r\n\r\n");
+			assert(st == http::RequestParser::Status::Malformed);
+		}
+		{
+			// Leading blank lines and bare LF line endings are tolerated.
+			http::RequestParser parser;
+			std::string raw = "\r\nget /x HTTP/1.0\nA:b\n\n";
+			auto st = parser.feed(raw);
+			assert(st == http::RequestParser::Status::Complete);
+			assert(parser.header_length() == raw.size());
+			http::HttpRequest req;
+			parser.bind(raw, req);
+			assert(req.method == http::HttpMethod::Get);
+			assert(req.header("a") == "b");
+		}
+		return true;
+	}
+
+
+	bool test_request_arena_reuse() {
+		http::RequestArena arena(256);
+		{
+			http::HttpRequest req(arena.resource());
+			std::size_t consumed = 0;
+			bool ok = http::parse_http_request("GET /p?a=1&a=2&b=%20 HTTP/1.1\r\nHost: x\r\n\r\n", req, consumed);
+			assert(ok);
+			assert(req.query_params.get_all("a").size() == 2);
+			assert(req.query_params.get("b") == " ");
+			assert(req.header("host") == "x");
+			req.body.assign(1000, 'x');
+
+			http::HttpResponse resp(req.resource());
+			assert(resp.headers.empty());
+			resp.set_status(404, "Not Found");
+			resp.headers["X-Test"] = "1";
+			assert(resp.to_string().find("HTTP/1.1 404 Not Found\r\n") == 0);
+		}
+		// The request overflowed the block, so the next one gets a bigger one.
+		arena.reset();
+		assert(arena.capacity() > 256);
+		std::size_t grown = arena.capacity();
+		{
+			http::HttpRequest req(arena.resource());
+			req.body.assign(100, 'y');
+			assert(req.resource() == arena.resource());
+		}
+		arena.reset();
+		assert(arena.capacity() == grown);
+
+		http::BufferPool pool(1, 64);
+		{
+			auto lease = pool.lease();
+			lease.get().assign(32, 'z');
+		}
+		std::string again = pool.acquire();
+		assert(again.empty() && again.capacity() >= 32);
+		pool.release(std::string(128, 'w')); // over max_capacity: dropped
+		std::string fresh = pool.acquire();
+		assert(fresh.capacity() < 128);
+
+		http::ResponseWriter writer;
+		std::string spare;
+		spare.reserve(4096);
+		writer.reuse(std::move(spare));
+		http::HttpResponse resp;
+		resp.body = "ok";
+		writer.add(resp);
+		auto parts = writer.take_parts();
+		assert(parts.size() == 1 && parts[0].owned.capacity() >= 4096);
+		return true;
+	}
+
+
+	bool test_latency_histogram() {
+		using H = http::LatencyHistogram;
+
+		// Buckets tile the range: each starts where the previous ends, and
+		// is at most 1/8 of its lower bound wide.
+		for (std::size_t i = 1; i < H::bucket_count; ++i) {
+			std::uint64_t lo = H::lower_bound(i);
+			assert(lo > H::lower_bound(i - 1));
+			assert(H::index_of(lo) == i && H::index_of(lo - 1) == i - 1);
+			if (lo >= H::sub_count) assert(lo - H::lower_bound(i - 1) <= lo / H::sub_count);
+		}
+		assert(H::index_of(0) == 0 && H::index_of(7) == 7);
+		assert(H::index_of(~std::uint64_t{ 0 }) == H::bucket_count - 1);
+
+		auto h = std::make_unique<H>();
+		for (std::uint64_t v = 1; v <= 1000; ++v) h->record(v * 1000); // 1 us .. 1 ms
+		http::HistogramSnapshot snap;
+		snap.merge(*h);
+		assert(snap.count == 1000 && snap.sum_ns == 500500ull * 1000);
+
+		auto near = [](std::uint64_t got, std::uint64_t want) { return got <= want && got * 8 >= want * 7; };
+		assert(near(snap.quantile(0.5), 500000));
+		assert(near(snap.quantile(0.99), 990000));
+		assert(near(snap.quantile(1.0), 1000000));
+		assert(snap.quantile(0.0) <= 1000);
+
+		// Power-of-two bounds are exact.
+		assert(snap.count_below(std::uint64_t{ 1 } << 16) == 65);   // <= 65.536 us
+		assert(snap.count_below(std::uint64_t{ 1 } << 20) == 1000);
+		assert(http::HistogramSnapshot{}.quantile(0.5) == 0);
+		return true;
+	}
+
+	bool test_http_metrics() {
+		http::HttpMetrics metrics;
+		metrics.set_routes({ "GET /a", "POST /b\"c" });
+		assert(metrics.series_count() == 3 && metrics.other_series() == 2);
+
+		// Threads record into their own slots; reads sum them.
+		auto work = [&](std::uint64_t ns) {
+			http::ThreadMetrics& m = metrics.local();
+			assert(&m == &metrics.local());
+			for (int i = 0; i < 100; ++i) {
+				m.phase(0, http::RequestPhase::Handler).record(ns);
+				m.count_request(0);
+				m.count(http::status_counter(200));
+			}
+			m.count_request(2);
+			m.count(http::status_counter(404));
+			m.count(http::HttpCounter::ParseErrors);
+			m.send.record(ns);
+			};
+		std::thread t1(work, 1000), t2(work, 3000);
+		t1.join();
+		t2.join();
+		work(2000);
+
+		assert(metrics.requests(0) == 300 && metrics.requests(1) == 0 && metrics.requests(2) == 3);
+		assert(metrics.counter(http::HttpCounter::Responses2xx) == 300);
+		assert(metrics.counter(http::HttpCounter::Responses4xx) == 3);
+		assert(metrics.counter(http::HttpCounter::ParseErrors) == 3);
+		auto handler = metrics.phase(0, http::RequestPhase::Handler);
+		assert(handler.count == 300 && handler.sum_ns == 100 * 6000);
+		assert(metrics.send().count == 3);
+		assert(http::status_counter(99) == http::HttpCounter::Responses5xx);
+		assert(http::status_counter(101) == http::HttpCounter::Responses1xx);
+
+		// Instances do not share slots.
+		http::HttpMetrics other;
+		other.set_routes({});
+		other.local().count(http::HttpCounter::Responses2xx);
+		assert(other.counter(http::HttpCounter::Responses2xx) == 1);
+		assert(metrics.counter(http::HttpCounter::Responses2xx) == 300);
+
+		double queue = 7;
+		metrics.add_gauge("test_queue_depth", "Items waiting.", [&] { return queue; });
+		metrics.add_counter("test_refused_total", "Items refused.", [] { return 2.0; });
+
+		std::string text = metrics.render_prometheus();
+		auto has = [&](const std::string& line) { return text.find(line + "\n") != std::string::npos; };
+		assert(has("# TYPE webcpp_http_requests_total counter"));
+		assert(has("webcpp_http_requests_total{route=\"GET /a\"} 300"));
+		assert(has("webcpp_http_requests_total{route=\"POST /b\\\"c\"} 0"));
+		assert(has("webcpp_http_requests_total{route=\"other\"} 3"));
+		assert(has("webcpp_http_responses_total{code=\"4xx\"} 3"));
+		assert(has("webcpp_http_parse_errors_total 3"));
+		assert(has("# TYPE webcpp_http_phase_seconds histogram"));
+		assert(has("webcpp_http_phase_seconds_bucket{route=\"GET /a\",phase=\"handler\",le=\"1.024e-06\"} 100"));
+		assert(has("webcpp_http_phase_seconds_bucket{route=\"GET /a\",phase=\"handler\",le=\"4.096e-06\"} 300"));
+		assert(has("webcpp_http_phase_seconds_bucket{route=\"GET /a\",phase=\"handler\",le=\"+Inf\"} 300"));
+		assert(has("webcpp_http_phase_seconds_sum{route=\"GET /a\",phase=\"handler\"} 0.0006"));
+		assert(has("webcpp_http_phase_seconds_count{route=\"GET /a\",phase=\"handler\"} 300"));
+		assert(text.find("phase=\"parse\"") == std::string::npos); // nothing recorded
+		assert(has("webcpp_http_send_seconds_count 3"));
+		assert(has("# TYPE test_queue_depth gauge"));
+		assert(has("test_queue_depth 7"));
+		queue = 9;
+		assert(metrics.render_prometheus().find("test_queue_depth 9\n") != std::string::npos);
+		assert(has("# TYPE test_refused_total counter"));
+		return true;
+	}
+
 	int RunHttpServerTests(bool verbose) {
 		try {
 			if (verbose) std::cout << "test_parse_simple_get...\n";
@@ -812,9 +1571,27 @@ namespace tests {
 			if (verbose) std::cout << "test_router_basic_and_path_params...\n";
 			test_router_basic_and_path_params();
 
+			if (verbose) std::cout << "test_router_trie_precedence_and_allow...\n";
+			test_router_trie_precedence_and_allow();
+
 			if (verbose) std::cout << "test_response_to_string...\n";
 			test_response_to_string();
 
+			if (verbose) std::cout << "test_response_writer_batches...\n";
+			test_response_writer_batches();
+
+			if (verbose) std::cout << "test_response_shared_parts...\n";
+			test_response_shared_parts();
+
+			if (verbose) std::cout << "test_response_static_headers_block...\n";
+			test_response_static_headers_block();
+
+			if (verbose) std::cout << "test_chunked_decoder_incremental...\n";
+			test_chunked_decoder_incremental();
+
+			if (verbose) std::cout << "test_response_streamed_body...\n";
+			test_response_streamed_body();
+
 			if (verbose) std::cout << "test_random_query_parsing...\n";
 			test_random_query_parsing();
 
@@ -830,6 +1607,12 @@ namespace tests {
 			if (verbose) std::cout << "test_query_invalid_bool_and_double...\n";
 			test_query_invalid_bool_and_double();
 
+			if (verbose) std::cout << "test_router_async_handlers...\n";
+			test_router_async_handlers();
+
+			if (verbose) std::cout << "test_reactor_async_completes_elsewhere...\n";
+			test_reactor_async_completes_elsewhere();
+
 			if (verbose) std::cout << "test_router_unknown_method...\n";
 			test_router_unknown_method();
 
@@ -842,6 +1625,21 @@ namespace tests {
 			if (verbose) std::cout << "test_random_path_params_mismatch...\n";
 			test_random_path_params_mismatch();
 
+			if (verbose) std::cout << "test_incremental_parser_byte_by_byte...\n";
+			test_incremental_parser_byte_by_byte();
+
+			if (verbose) std::cout << "test_incremental_parser_limits...\n";
+			test_incremental_parser_limits();
+
+			if (verbose) std::cout << "test_request_arena_reuse...\n";
+			test_request_arena_reuse();
+
+			if (verbose) std::cout << "test_latency_histogram...\n";
+			test_latency_histogram();
+
+			if (verbose) std::cout << "test_http_metrics...\n";
+			test_http_metrics();
+
 			std::cout << "All HTTP tests passed.\n";
 		}
 		catch (const std::exception& ex) {
@@ -3,8 +3,116 @@
 #include <algorithm>
 #include <cstring>
 
+#if !defined(_WIN32) && defined(__linux__)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
+namespace {
+
+#if defined(__linux__)
+	constexpr int send_flags = MSG_NOSIGNAL;
+#else
+	constexpr int send_flags = 0;
+#endif
+
+	inline bool last_error_would_block() {
+#ifdef _WIN32
+		int err = ::WSAGetLastError();
+		return err == WSAEWOULDBLOCK || err == WSAEINTR;
+#else
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+	}
+
+	inline bool last_error_interrupted() {
+#ifdef _WIN32
+		return ::WSAGetLastError() == WSAEINTR;
+#else
+		return errno == EINTR;
+#endif
+	}
+
+	constexpr std::size_t max_slices_per_write = 64;
+
+	// Sent buffers a connection keeps for reuse, and the largest kept.
+	constexpr std::size_t max_spare_buffers = 2;
+	constexpr std::size_t max_spare_capacity = 256 * 1024;
+
+	// One vectored send. Returns bytes sent, or -1 (check last_error_would_block).
+	long long send_slices(net::socket_t s, const net::IoSlice* slices, std::size_t count) {
+#ifdef _WIN32
+		WSABUF bufs[max_slices_per_write];
+		DWORD n = static_cast<DWORD>(std::min(count, max_slices_per_write));
+		for (DWORD i = 0; i < n; ++i) {
+			bufs[i].buf = const_cast<CHAR*>(slices[i].data);
+			bufs[i].len = static_cast<ULONG>(slices[i].size);
+		}
+		DWORD sent = 0;
+		if (::WSASend(s, bufs, n, &sent, 0, nullptr, nullptr) != 0) {
+			return -1;
+		}
+		return static_cast<long long>(sent);
+#else
+		iovec iov[max_slices_per_write];
+		std::size_t n = std::min(count, max_slices_per_write);
+		for (std::size_t i = 0; i < n; ++i) {
+			iov[i].iov_base = const_cast<char*>(slices[i].data);
+			iov[i].iov_len = slices[i].size;
+		}
+		msghdr msg{};
+		msg.msg_iov = iov;
+		msg.msg_iovlen = n;
+		return static_cast<long long>(::sendmsg(s, &msg, send_flags));
+#endif
+	}
+
+	// Set on pool workers, so jobs they submit can go to their own deque.
+	thread_local const net::ThreadPool* tls_pool = nullptr;
+	thread_local std::size_t tls_worker = 0;
+
+	inline std::int64_t steady_now_ms() {
+		using namespace std::chrono;
+		return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+}
+
 namespace net {
 
+	bool set_non_blocking(socket_t s, bool enabled) {
+#ifdef _WIN32
+		u_long mode = enabled ? 1 : 0;
+		return ::ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+		int flags = ::fcntl(s, F_GETFL, 0);
+		if (flags < 0) return false;
+		flags = enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+		return ::fcntl(s, F_SETFL, flags) == 0;
+#endif
+	}
+
+
+	bool pin_thread(std::thread& t, int first_cpu, int count) {
+		if (!t.joinable() || first_cpu < 0 || count <= 0) return false;
+#if defined(_WIN32)
+		DWORD_PTR mask = 0;
+		for (int c = first_cpu; c < first_cpu + count && c < static_cast<int>(sizeof(DWORD_PTR) * 8); ++c) {
+			mask |= static_cast<DWORD_PTR>(1) << c;
+		}
+		return mask != 0 && ::SetThreadAffinityMask(t.native_handle(), mask) != 0;
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int c = first_cpu; c < first_cpu + count && c < CPU_SETSIZE; ++c) {
+			CPU_SET(c, &set);
+		}
+		return ::pthread_setaffinity_np(t.native_handle(), sizeof(set), &set) == 0;
+#else
+		return false;
+#endif
+	}
+
 
 	NetInitializer::NetInitializer() {
 #ifdef _WIN32
@@ -25,21 +133,28 @@ namespace net {
 	}
 
 
-	ThreadPool::ThreadPool(std::size_t thread_count, std::size_t max_queue_size)
-		: max_queue_size_(max_queue_size ? max_queue_size : 1) // avoid 0
+	ThreadPool::ThreadPool(std::size_t thread_count, std::size_t max_queue_size, PoolMode mode)
+		: mode_(mode)
+		, max_queue_size_(max_queue_size ? max_queue_size : 1) // avoid 0
+		, ring_(max_queue_size_)
 	{
 		if (thread_count == 0) {
 			thread_count = 1;
 		}
+		if (mode_ == PoolMode::WorkStealing) {
+			for (std::size_t i = 0; i < thread_count; ++i) {
+				locals_.push_back(std::make_unique<Worker>());
+			}
+		}
 		for (std::size_t i = 0; i < thread_count; ++i) {
-			workers_.emplace_back([this] { worker_loop(); });
+			workers_.emplace_back([this, i] { worker_loop(i); });
 		}
 	}
 
 	ThreadPool::~ThreadPool() {
 		{
-			std::lock_guard<std::mutex> lock(mutex_);
-			stop_ = true;
+			std::lock_guard<std::mutex> lock(park_mutex_);
+			stop_.store(true);
 		}
 		cv_jobs_.notify_all();
 		cv_space_.notify_all();
@@ -51,45 +166,125 @@ namespace net {
 		}
 	}
 
-	bool ThreadPool::try_enqueue(std::function<void()> job) {
-		std::lock_guard<std::mutex> lock(mutex_);
-		if (stop_) return false;
-		if (jobs_.size() >= max_queue_size_) {
+	bool ThreadPool::push(Job& job) {
+		if (mode_ == PoolMode::WorkStealing && tls_pool == this) {
+			Worker& local = *locals_[tls_worker];
+			std::lock_guard<std::mutex> lock(local.mutex);
+			if (local.jobs.size() < max_queue_size_) {
+				local.jobs.push_back(std::move(job));
+				return true;
+			}
+		}
+		return ring_.try_push(job);
+	}
+
+	bool ThreadPool::pop(std::size_t self, Job& job) {
+		if (!locals_.empty()) {
+			Worker& local = *locals_[self];
+			std::lock_guard<std::mutex> lock(local.mutex);
+			if (!local.jobs.empty()) {
+				job = std::move(local.jobs.back());
+				local.jobs.pop_back();
+				return true;
+			}
+		}
+		if (ring_.try_pop(job)) {
+			return true;
+		}
+		for (std::size_t i = 1; i < locals_.size(); ++i) {
+			Worker& victim = *locals_[(self + i) % locals_.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty()) {
+				job = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ThreadPool::has_work() {
+		if (ring_.size_approx() > 0) return true;
+		for (auto& local : locals_) {
+			std::lock_guard<std::mutex> lock(local->mutex);
+			if (!local->jobs.empty()) return true;
+		}
+		return false;
+	}
+
+	std::size_t ThreadPool::queued() const {
+		std::size_t n = ring_.size_approx();
+		for (const auto& local : locals_) {
+			std::lock_guard<std::mutex> lock(local->mutex);
+			n += local->jobs.size();
+		}
+		return n;
+	}
+
+	void ThreadPool::wake_worker() {
+		// Pairs with the sleepers_ increment in worker_loop: either the
+		// worker's re-check sees the job or this sees the sleeper.
+		if (sleepers_.load() > 0) {
+			std::lock_guard<std::mutex> lock(park_mutex_);
+			cv_jobs_.notify_one();
+		}
+	}
+
+	bool ThreadPool::try_enqueue(Job job) {
+		if (stop_.load(std::memory_order_relaxed) || !push(job)) {
+			rejected_.fetch_add(1, std::memory_order_relaxed);
 			return false;
 		}
-		jobs_.push(std::move(job));
-		cv_jobs_.notify_one();
+		wake_worker();
 		return true;
 	}
 
-	void ThreadPool::enqueue(std::function<void()> job) {
-		{
-			std::unique_lock<std::mutex> lock(mutex_);
-			cv_space_.wait(lock, [this] {
-				return stop_ || jobs_.size() < max_queue_size_;
-				});
-			if (stop_) return;
-			jobs_.push(std::move(job));
+	void ThreadPool::enqueue(Job job) {
+		while (!stop_.load(std::memory_order_relaxed)) {
+			if (push(job)) {
+				wake_worker();
+				return;
+			}
+			// Workers signal after taking a job; the timeout covers a
+			// signal sent just before we started waiting.
+			std::unique_lock<std::mutex> lock(park_mutex_);
+			space_waiters_.fetch_add(1);
+			cv_space_.wait_for(lock, std::chrono::milliseconds(1));
+			space_waiters_.fetch_sub(1);
 		}
-		cv_jobs_.notify_one();
 	}
 
-	void ThreadPool::worker_loop() {
+	void ThreadPool::worker_loop(std::size_t index) {
+		tls_pool = this;
+		tls_worker = index;
+
 		while (true) {
-			std::function<void()> job;
-			{
-				std::unique_lock<std::mutex> lock(mutex_);
-				cv_jobs_.wait(lock, [this] {
-					return stop_ || !jobs_.empty();
-					});
-				if (stop_ && jobs_.empty()) {
-					return;
+			Job job;
+			if (pop(index, job)) {
+				if (space_waiters_.load(std::memory_order_relaxed) > 0) {
+					std::lock_guard<std::mutex> lock(park_mutex_);
+					cv_space_.notify_one();
 				}
-				job = std::move(jobs_.front());
-				jobs_.pop();
-				cv_space_.notify_one();
+				job();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(park_mutex_);
+			sleepers_.fetch_add(1);
+			cv_jobs_.wait(lock, [this] {
+				return stop_.load() || has_work();
+				});
+			sleepers_.fetch_sub(1);
+			if (stop_.load() && !has_work()) {
+				return;
 			}
-			job();
+		}
+	}
+
+
+	void ThreadPool::pin_workers(int first_cpu, int count) {
+		for (auto& t : workers_) {
+			pin_thread(t, first_cpu, count);
 		}
 	}
 
@@ -140,6 +335,40 @@ namespace net {
 		return total_sent;
 	}
 
+	std::size_t TcpConnection::send(const IoSlice* slices, std::size_t count) {
+		std::vector<IoSlice> rest(slices, slices + count);
+		std::size_t first = 0;
+		std::size_t total_sent = 0;
+
+		std::lock_guard<std::mutex> lock(socket_mutex_);
+		while (first < rest.size()) {
+			if (rest[first].size == 0) {
+				++first;
+				continue;
+			}
+			long long sent = send_slices(sock_, rest.data() + first, rest.size() - first);
+			if (sent <= 0) {
+				if (sent < 0 && last_error_interrupted()) continue;
+				break;
+			}
+			total_sent += static_cast<std::size_t>(sent);
+
+			std::size_t left = static_cast<std::size_t>(sent);
+			while (left > 0 && first < rest.size()) {
+				if (left >= rest[first].size) {
+					left -= rest[first].size;
+					++first;
+				}
+				else {
+					rest[first].data += left;
+					rest[first].size -= left;
+					left = 0;
+				}
+			}
+		}
+		return total_sent;
+	}
+
 	std::size_t TcpConnection::recv(void* buffer, std::size_t size) {
 		std::lock_guard<std::mutex> lock(socket_mutex_);
 #ifdef _WIN32
@@ -154,6 +383,122 @@ namespace net {
 		return static_cast<std::size_t>(received);
 	}
 
+	bool TcpConnection::flush_unlocked() {
+		IoSlice slices[max_slices_per_write];
+
+		while (!out_queue_.empty()) {
+			std::size_t n = 0;
+			for (auto it = out_queue_.begin(); it != out_queue_.end() && n < max_slices_per_write; ++it) {
+				std::size_t off = (n == 0) ? out_off_ : 0;
+				slices[n++] = IoSlice{ it->data() + off, it->size() - off };
+			}
+
+			long long sent = send_slices(sock_, slices, n);
+			if (sent <= 0) {
+				return sent < 0 && last_error_would_block();
+			}
+
+			std::size_t left = static_cast<std::size_t>(sent);
+			while (left > 0) {
+				std::size_t front_left = out_queue_.front().size() - out_off_;
+				if (left >= front_left) {
+					left -= front_left;
+					std::string& done = out_queue_.front().owned;
+					if (!out_queue_.front().shared && spare_.size() < max_spare_buffers && done.capacity() <= max_spare_capacity) {
+						done.clear();
+						spare_.push_back(std::move(done));
+					}
+					out_queue_.pop_front();
+					out_off_ = 0;
+				}
+				else {
+					out_off_ += left;
+					left = 0;
+				}
+			}
+		}
+		out_off_ = 0;
+		return true;
+	}
+
+	bool TcpConnection::enqueue_and_flush(std::vector<SendBuffer>& parts, bool close_after_flush) {
+		if (!loop_) {
+			std::vector<IoSlice> slices;
+			std::size_t total = 0;
+			for (const auto& p : parts) {
+				slices.push_back(IoSlice{ p.data(), p.size() });
+				total += p.size();
+			}
+			bool ok = send(slices.data(), slices.size()) == total;
+			if (close_after_flush) close();
+			return ok;
+		}
+
+		bool failed = false;
+		bool close_now = false;
+		bool post_write = false;
+		{
+			std::lock_guard<std::mutex> lock(socket_mutex_);
+			if (sock_ == invalid_socket) return false;
+
+			for (auto& p : parts) {
+				if (!p.empty()) out_queue_.push_back(std::move(p));
+			}
+			close_after_flush_ = close_after_flush_ || close_after_flush;
+
+			failed = !flush_unlocked();
+			bool flushed = out_queue_.empty();
+			close_now = flushed && close_after_flush_;
+			if (!failed && !flushed && !want_write_) {
+				want_write_ = true;
+				post_write = true;
+			}
+		}
+		last_active_ms_.store(steady_now_ms(), std::memory_order_relaxed);
+
+		if (failed || close_now) {
+			loop_->request_close(shared_from_this());
+		}
+		else if (post_write) {
+			loop_->request_write(shared_from_this());
+		}
+		return !failed;
+	}
+
+	std::string TcpConnection::take_spare_buffer() {
+		std::lock_guard<std::mutex> lock(socket_mutex_);
+		if (spare_.empty()) return {};
+		std::string buf = std::move(spare_.back());
+		spare_.pop_back();
+		return buf;
+	}
+
+	bool TcpConnection::async_send(std::string data, bool close_after_flush) {
+		std::vector<SendBuffer> parts;
+		parts.emplace_back(std::move(data));
+		return enqueue_and_flush(parts, close_after_flush);
+	}
+
+	bool TcpConnection::async_send(std::vector<std::string> parts, bool close_after_flush) {
+		std::vector<SendBuffer> buffers;
+		buffers.reserve(parts.size());
+		for (auto& p : parts) buffers.emplace_back(std::move(p));
+		return enqueue_and_flush(buffers, close_after_flush);
+	}
+
+	bool TcpConnection::async_send(std::vector<SendBuffer> parts, bool close_after_flush) {
+		return enqueue_and_flush(parts, close_after_flush);
+	}
+
+	void TcpConnection::close_async() {
+		if (loop_) {
+			loop_->request_close(shared_from_this());
+		}
+		else {
+			close();
+		}
+	}
+
 	std::string TcpConnection::remote_address() const {
 		char host[NI_MAXHOST] = {};
 		char serv[NI_MAXSERV] = {};
@@ -202,6 +547,362 @@ namespace net {
 	}
 
 
+	EventLoop::EventLoop(DataHandler on_data, CloseHandler on_close, int idle_timeout_ms)
+		: on_data_(std::move(on_data))
+		, on_close_(std::move(on_close))
+		, idle_timeout_ms_(idle_timeout_ms)
+		, read_buf_(64 * 1024)
+	{
+#if defined(_WIN32) || !defined(__linux__)
+		wake_sock_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+		if (wake_sock_ == invalid_socket) {
+			throw std::runtime_error("Failed to create event loop wakeup socket");
+		}
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		socklen_t len = sizeof(addr);
+		if (::bind(wake_sock_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+			::getsockname(wake_sock_, reinterpret_cast<sockaddr*>(&addr), &len) != 0 ||
+			::connect(wake_sock_, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+			close_socket(wake_sock_);
+			throw std::runtime_error("Failed to set up event loop wakeup socket");
+		}
+		set_non_blocking(wake_sock_, true);
+#else
+		epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+		if (epoll_fd_ < 0) {
+			throw std::runtime_error("epoll_create1() failed");
+		}
+		wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (wake_fd_ < 0) {
+			::close(epoll_fd_);
+			throw std::runtime_error("eventfd() failed");
+		}
+		epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.fd = wake_fd_;
+		::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+#endif
+	}
+
+	EventLoop::~EventLoop() {
+		stop();
+#if defined(_WIN32) || !defined(__linux__)
+		close_socket(wake_sock_);
+#else
+		::close(wake_fd_);
+		::close(epoll_fd_);
+#endif
+	}
+
+	void EventLoop::start() {
+		if (running_.exchange(true)) {
+			return;
+		}
+		thread_ = std::thread(&EventLoop::run, this);
+	}
+
+	void EventLoop::stop() {
+		if (!running_.exchange(false)) {
+			return;
+		}
+		wakeup();
+		if (thread_.joinable()) {
+			thread_.join();
+		}
+	}
+
+	void EventLoop::pin_to_cpu(int cpu) {
+		pin_thread(thread_, cpu, 1);
+	}
+
+	void EventLoop::add(std::shared_ptr<TcpConnection> conn) {
+		conn->loop_ = this;
+		conn->last_active_ms_.store(steady_now_ms(), std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(pending_mutex_);
+			pending_add_.push_back(std::move(conn));
+		}
+		wakeup();
+	}
+
+	void EventLoop::request_write(std::shared_ptr<TcpConnection> conn) {
+		{
+			std::lock_guard<std::mutex> lock(pending_mutex_);
+			pending_write_.push_back(std::move(conn));
+		}
+		wakeup();
+	}
+
+	void EventLoop::request_close(std::shared_ptr<TcpConnection> conn) {
+		{
+			std::lock_guard<std::mutex> lock(pending_mutex_);
+			pending_close_.push_back(std::move(conn));
+		}
+		wakeup();
+	}
+
+	void EventLoop::wakeup() {
+#if defined(_WIN32) || !defined(__linux__)
+		char b = 1;
+		::send(wake_sock_, &b, 1, 0);
+#else
+		std::uint64_t one = 1;
+		ssize_t r = ::write(wake_fd_, &one, sizeof(one));
+		(void)r;
+#endif
+	}
+
+	void EventLoop::drain_wakeup() {
+#if defined(_WIN32) || !defined(__linux__)
+		char b[64];
+		while (::recv(wake_sock_, b, sizeof(b), 0) > 0) {
+		}
+#else
+		std::uint64_t v = 0;
+		ssize_t r = ::read(wake_fd_, &v, sizeof(v));
+		(void)r;
+#endif
+	}
+
+	void EventLoop::watch(const std::shared_ptr<TcpConnection>& conn, bool want_write) {
+		if (conn->watching_write_ == want_write) return;
+		conn->watching_write_ = want_write;
+#if !defined(_WIN32) && defined(__linux__)
+		epoll_event ev{};
+		ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0u);
+		ev.data.fd = conn->sock_;
+		::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->sock_, &ev);
+#endif
+	}
+
+	void EventLoop::apply_pending() {
+		std::vector<std::shared_ptr<TcpConnection>> adds;
+		std::vector<std::shared_ptr<TcpConnection>> writes;
+		std::vector<std::shared_ptr<TcpConnection>> closes;
+		{
+			std::lock_guard<std::mutex> lock(pending_mutex_);
+			adds.swap(pending_add_);
+			writes.swap(pending_write_);
+			closes.swap(pending_close_);
+		}
+
+		for (auto& conn : adds) {
+			socket_t s = conn->sock_;
+			if (s == invalid_socket) continue;
+#if !defined(_WIN32) && defined(__linux__)
+			epoll_event ev{};
+			ev.events = EPOLLIN;
+			ev.data.fd = s;
+			if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, s, &ev) != 0) {
+				conn->close();
+				continue;
+			}
+#endif
+			conns_[s] = conn;
+			conn_count_.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		for (auto& conn : writes) {
+			auto it = conns_.find(conn->sock_);
+			if (it == conns_.end() || it->second != conn) continue;
+			handle_writable(conn);
+		}
+
+		for (auto& conn : closes) {
+			auto it = conns_.find(conn->sock_);
+			if (it == conns_.end() || it->second != conn) {
+				conn->close();
+				continue;
+			}
+			remove(conn);
+		}
+	}
+
+	void EventLoop::handle_readable(const std::shared_ptr<TcpConnection>& conn) {
+#ifdef _WIN32
+		int received;
+#else
+		ssize_t received;
+#endif
+		{
+			std::lock_guard<std::mutex> lock(conn->socket_mutex_);
+			if (conn->sock_ == invalid_socket) return;
+#ifdef _WIN32
+			received = ::recv(conn->sock_, read_buf_.data(),
+				static_cast<int>(read_buf_.size()), 0);
+#else
+			received = ::recv(conn->sock_, read_buf_.data(), read_buf_.size(), 0);
+#endif
+		}
+
+		if (received > 0) {
+			conn->last_active_ms_.store(steady_now_ms(), std::memory_order_relaxed);
+			on_data_(conn, read_buf_.data(), static_cast<std::size_t>(received));
+			return;
+		}
+		if (received < 0 && last_error_would_block()) {
+			return;
+		}
+		remove(conn);
+	}
+
+	void EventLoop::handle_writable(const std::shared_ptr<TcpConnection>& conn) {
+		bool ok = true;
+		bool flushed = false;
+		bool close_now = false;
+		{
+			std::lock_guard<std::mutex> lock(conn->socket_mutex_);
+			if (conn->sock_ == invalid_socket) return;
+			ok = conn->flush_unlocked();
+			flushed = conn->out_queue_.empty();
+			close_now = flushed && conn->close_after_flush_;
+			if (flushed) conn->want_write_ = false;
+		}
+
+		if (!ok || close_now) {
+			remove(conn);
+			return;
+		}
+		watch(conn, !flushed);
+	}
+
+	void EventLoop::remove(const std::shared_ptr<TcpConnection>& conn) {
+		socket_t s = conn->sock_;
+		auto it = conns_.find(s);
+		if (it != conns_.end() && it->second == conn) {
+#if !defined(_WIN32) && defined(__linux__)
+			::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, s, nullptr);
+#endif
+			conns_.erase(it);
+			conn_count_.fetch_sub(1, std::memory_order_relaxed);
+		}
+		conn->close();
+		if (on_close_) {
+			on_close_(conn);
+		}
+	}
+
+	void EventLoop::sweep_idle() {
+		if (idle_timeout_ms_ <= 0) return;
+
+		std::int64_t now = steady_now_ms();
+		std::vector<std::shared_ptr<TcpConnection>> expired;
+		for (auto& kv : conns_) {
+			const auto& conn = kv.second;
+			if (conn->busy_.load(std::memory_order_relaxed) || conn->watching_write_) continue;
+			if (now - conn->last_active_ms_.load(std::memory_order_relaxed) > idle_timeout_ms_) {
+				expired.push_back(conn);
+			}
+		}
+		for (auto& conn : expired) {
+			remove(conn);
+		}
+	}
+
+	void EventLoop::run() {
+		const int poll_timeout_ms = idle_timeout_ms_ > 0
+			? std::min(idle_timeout_ms_, 1000)
+			: 1000;
+		std::int64_t last_sweep = steady_now_ms();
+
+#if defined(_WIN32) || !defined(__linux__)
+		std::vector<pollfd> fds;
+		std::vector<std::shared_ptr<TcpConnection>> polled;
+#else
+		epoll_event events[256];
+#endif
+
+		while (running_.load()) {
+#if defined(_WIN32) || !defined(__linux__)
+			fds.clear();
+			polled.clear();
+			pollfd wake{};
+			wake.fd = wake_sock_;
+			wake.events = POLLIN;
+			fds.push_back(wake);
+			for (auto& kv : conns_) {
+				pollfd p{};
+				p.fd = kv.first;
+				p.events = static_cast<short>(POLLIN | (kv.second->watching_write_ ? POLLOUT : 0));
+				fds.push_back(p);
+				polled.push_back(kv.second);
+			}
+#  ifdef _WIN32
+			int n = ::WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), poll_timeout_ms);
+#  else
+			int n = ::poll(fds.data(), static_cast<nfds_t>(fds.size()), poll_timeout_ms);
+#  endif
+			if (n < 0 && !last_error_would_block()) {
+				break;
+			}
+			if (n > 0) {
+				if (fds[0].revents & POLLIN) {
+					drain_wakeup();
+				}
+				for (std::size_t i = 1; i < fds.size(); ++i) {
+					short re = fds[i].revents;
+					if (re == 0) continue;
+					const auto& conn = polled[i - 1];
+					if (conn->sock_ == invalid_socket) continue;
+					if ((re & (POLLERR | POLLHUP | POLLNVAL)) && !(re & POLLIN)) {
+						remove(conn);
+						continue;
+					}
+					if (re & POLLIN) {
+						handle_readable(conn);
+					}
+					if ((re & POLLOUT) && conn->sock_ != invalid_socket) {
+						handle_writable(conn);
+					}
+				}
+			}
+#else
+			int n = ::epoll_wait(epoll_fd_, events, 256, poll_timeout_ms);
+			if (n < 0 && errno != EINTR) {
+				break;
+			}
+			for (int i = 0; i < n; ++i) {
+				int fd = events[i].data.fd;
+				std::uint32_t re = events[i].events;
+				if (fd == wake_fd_) {
+					drain_wakeup();
+					continue;
+				}
+				auto it = conns_.find(fd);
+				if (it == conns_.end()) continue;
+				std::shared_ptr<TcpConnection> conn = it->second;
+
+				if ((re & (EPOLLERR | EPOLLHUP)) && !(re & EPOLLIN)) {
+					remove(conn);
+					continue;
+				}
+				if (re & EPOLLIN) {
+					handle_readable(conn);
+				}
+				if ((re & EPOLLOUT) && conn->sock_ != invalid_socket) {
+					handle_writable(conn);
+				}
+			}
+#endif
+			apply_pending();
+
+			std::int64_t now = steady_now_ms();
+			if (now - last_sweep >= poll_timeout_ms) {
+				sweep_idle();
+				last_sweep = now;
+			}
+		}
+
+		apply_pending();
+		std::vector<std::shared_ptr<TcpConnection>> remaining;
+		for (auto& kv : conns_) remaining.push_back(kv.second);
+		for (auto& conn : remaining) remove(conn);
+	}
+
+
 	TcpServer::TcpServer(const std::string& bind_address,
 		std::uint16_t port,
 		ConnectionHandler handler,
@@ -211,7 +912,8 @@ namespace net {
 		, bind_address_(bind_address)
 		, port_(port)
 		, handler_(std::move(handler))
-		, pool_(thread_count, max_queue_size) {
+		, thread_count_(thread_count ? thread_count : 1)
+		, max_queue_size_(max_queue_size) {
 	}
 
 	TcpServer::~TcpServer() {
@@ -222,97 +924,178 @@ namespace net {
 		return running_.load();
 	}
 
-	void TcpServer::start() {
-		if (running_.exchange(true)) {
-			return;
+	void TcpServer::enable_reactor(std::size_t loop_count,
+		EventLoop::DataHandler on_data,
+		EventLoop::CloseHandler on_close,
+		int idle_timeout_ms) {
+		if (running_) {
+			throw std::logic_error("enable_reactor() must be called before start()");
 		}
+		loop_count_ = loop_count ? loop_count : 1;
+		on_data_ = std::move(on_data);
+		on_close_ = std::move(on_close);
+		idle_timeout_ms_ = idle_timeout_ms;
+		io_model_ = IoModel::Reactor;
+		shards_.clear();
+	}
 
-		listen_sock_ = ::socket(AF_INET6, SOCK_STREAM, 0);
-		if (listen_sock_ == invalid_socket) {
-			running_ = false;
+	void TcpServer::enable_sharding(std::size_t shard_count, bool pin_to_cores) {
+		if (running_) {
+			throw std::logic_error("enable_sharding() must be called before start()");
+		}
+		shard_count_ = shard_count ? shard_count : 1;
+		pin_to_cores_ = pin_to_cores;
+		shards_.clear();
+	}
+
+	void TcpServer::set_pool_mode(PoolMode mode) {
+		if (running_) {
+			throw std::logic_error("set_pool_mode() must be called before start()");
+		}
+		pool_mode_ = mode;
+		shards_.clear();
+	}
+
+	socket_t TcpServer::open_listener(bool reuse_port) const {
+		int opt = 1;
+		auto set_reuse = [&](socket_t s) {
+			::setsockopt(s, SOL_SOCKET, SO_REUSEADDR,
+				reinterpret_cast<const char*>(&opt), sizeof(opt));
+#ifdef SO_REUSEPORT
+			if (reuse_port) {
+				::setsockopt(s, SOL_SOCKET, SO_REUSEPORT,
+					reinterpret_cast<const char*>(&opt), sizeof(opt));
+			}
+#else
+			(void)reuse_port;
+#endif
+			};
+
+		socket_t sock = ::socket(AF_INET6, SOCK_STREAM, 0);
+		if (sock == invalid_socket) {
 			throw std::runtime_error("Failed to create IPv6 socket");
 		}
 
 		int no = 0;
-		::setsockopt(listen_sock_, IPPROTO_IPV6, IPV6_V6ONLY,
+		::setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY,
 			reinterpret_cast<const char*>(&no), sizeof(no));
-
-		int opt = 1;
-		::setsockopt(listen_sock_, SOL_SOCKET, SO_REUSEADDR,
-			reinterpret_cast<const char*>(&opt), sizeof(opt));
+		set_reuse(sock);
 
 		sockaddr_in6 addr6{};
 		addr6.sin6_family = AF_INET6;
 		addr6.sin6_port = htons(port_);
 		addr6.sin6_addr = in6addr_any;
 
-		bool bound = false;
-
 		if (!bind_address_.empty() && bind_address_ != "::" && bind_address_ != "0.0.0.0") {
-			if (inet_pton(AF_INET6, bind_address_.c_str(), &addr6.sin6_addr) == 1) {
-				if (::bind(listen_sock_,
-					reinterpret_cast<sockaddr*>(&addr6),
-					sizeof(addr6)) == 0) {
-					bound = true;
-				}
+			if (inet_pton(AF_INET6, bind_address_.c_str(), &addr6.sin6_addr) == 1 &&
+				::bind(sock, reinterpret_cast<sockaddr*>(&addr6), sizeof(addr6)) == 0) {
+				// bound as IPv6
 			}
-			if (!bound) {
-				close_socket(listen_sock_);
-				listen_sock_ = ::socket(AF_INET, SOCK_STREAM, 0);
-				if (listen_sock_ == invalid_socket) {
-					running_ = false;
+			else {
+				close_socket(sock);
+				sock = ::socket(AF_INET, SOCK_STREAM, 0);
+				if (sock == invalid_socket) {
 					throw std::runtime_error("Failed to create IPv4 socket");
 				}
-				::setsockopt(listen_sock_, SOL_SOCKET, SO_REUSEADDR,
-					reinterpret_cast<const char*>(&opt), sizeof(opt));
+				set_reuse(sock);
 
 				sockaddr_in addr4{};
 				addr4.sin_family = AF_INET;
 				addr4.sin_port = htons(port_);
 				if (inet_pton(AF_INET, bind_address_.c_str(), &addr4.sin_addr) != 1) {
-					close_socket(listen_sock_);
-					listen_sock_ = invalid_socket;
-					running_ = false;
+					close_socket(sock);
 					throw std::runtime_error("Invalid bind address");
 				}
-				if (::bind(listen_sock_,
-					reinterpret_cast<sockaddr*>(&addr4),
-					sizeof(addr4)) != 0) {
-					close_socket(listen_sock_);
-					listen_sock_ = invalid_socket;
-					running_ = false;
+				if (::bind(sock, reinterpret_cast<sockaddr*>(&addr4), sizeof(addr4)) != 0) {
+					close_socket(sock);
 					throw std::runtime_error("bind() failed");
 				}
-				bound = true;
 			}
 		}
-		else {
-			if (::bind(listen_sock_,
-				reinterpret_cast<sockaddr*>(&addr6),
-				sizeof(addr6)) != 0) {
-				close_socket(listen_sock_);
-				listen_sock_ = invalid_socket;
-				running_ = false;
-				throw std::runtime_error("bind() failed");
+		else if (::bind(sock, reinterpret_cast<sockaddr*>(&addr6), sizeof(addr6)) != 0) {
+			close_socket(sock);
+			throw std::runtime_error("bind() failed");
+		}
+
+		if (::listen(sock, SOMAXCONN) != 0) {
+			close_socket(sock);
+			throw std::runtime_error("listen() failed");
+		}
+		return sock;
+	}
+
+	void TcpServer::build_shards() {
+		int cpus = static_cast<int>(std::thread::hardware_concurrency());
+		if (cpus <= 0) cpus = 1;
+		int cpus_per_shard = std::max(1, cpus / static_cast<int>(shard_count_));
+
+		std::size_t threads_per_shard = std::max<std::size_t>(1, thread_count_ / shard_count_);
+		std::size_t loops_per_shard = std::max<std::size_t>(1, loop_count_ / shard_count_);
+		std::size_t queue_per_shard = std::max<std::size_t>(1, max_queue_size_ / shard_count_);
+
+		for (std::size_t i = 0; i < shard_count_; ++i) {
+			auto shard = std::make_unique<Shard>();
+			shard->pool = std::make_unique<ThreadPool>(threads_per_shard, queue_per_shard, pool_mode_);
+			if (io_model_ == IoModel::Reactor) {
+				for (std::size_t j = 0; j < loops_per_shard; ++j) {
+					shard->loops.push_back(std::make_unique<EventLoop>(on_data_, on_close_, idle_timeout_ms_));
+				}
+			}
+			if (pin_to_cores_) {
+				shard->first_cpu = (static_cast<int>(i) * cpus_per_shard) % cpus;
+				shard->cpu_count = std::min(cpus_per_shard, cpus - shard->first_cpu);
+				shard->pool->pin_workers(shard->first_cpu, shard->cpu_count);
 			}
-			bound = true;
+			shards_.push_back(std::move(shard));
 		}
+	}
 
-		if (!bound) {
-			close_socket(listen_sock_);
-			listen_sock_ = invalid_socket;
-			running_ = false;
-			throw std::runtime_error("bind() failed");
+	void TcpServer::start() {
+		if (running_.exchange(true)) {
+			return;
 		}
 
-		if (::listen(listen_sock_, SOMAXCONN) != 0) {
-			close_socket(listen_sock_);
-			listen_sock_ = invalid_socket;
+		try {
+			if (shards_.empty()) {
+				build_shards();
+			}
+
+#ifdef SO_REUSEPORT
+			const bool per_shard_socket = true;
+#else
+			const bool per_shard_socket = false;
+#endif
+			for (std::size_t i = 0; i < shards_.size(); ++i) {
+				Shard& shard = *shards_[i];
+				if (i == 0 || per_shard_socket) {
+					shard.listen_sock = open_listener(shards_.size() > 1);
+					shard.owns_socket = true;
+				}
+				else {
+					shard.listen_sock = shards_[0]->listen_sock;
+					shard.owns_socket = false;
+				}
+			}
+		}
+		catch (...) {
+			for (auto& shard : shards_) {
+				if (shard->owns_socket) close_socket(shard->listen_sock);
+				shard->listen_sock = invalid_socket;
+			}
 			running_ = false;
-			throw std::runtime_error("listen() failed");
+			throw;
 		}
 
-		accept_thread_ = std::thread(&TcpServer::accept_loop, this);
+		for (auto& shard : shards_) {
+			for (auto& loop : shard->loops) {
+				loop->start();
+				if (shard->first_cpu >= 0) loop->pin_to_cpu(shard->first_cpu);
+			}
+			shard->accept_thread = std::thread(&TcpServer::accept_loop, this, std::ref(*shard));
+			if (shard->first_cpu >= 0) {
+				pin_thread(shard->accept_thread, shard->first_cpu, 1);
+			}
+		}
 	}
 
 	void TcpServer::stop() {
@@ -320,22 +1103,44 @@ namespace net {
 			return;
 		}
 
-		if (listen_sock_ != invalid_socket) {
-			close_socket(listen_sock_);
-			listen_sock_ = invalid_socket;
+		for (auto& shard : shards_) {
+			if (shard->owns_socket && shard->listen_sock != invalid_socket) {
+#ifdef _WIN32
+				::shutdown(shard->listen_sock, SD_BOTH);
+#else
+				::shutdown(shard->listen_sock, SHUT_RDWR);
+#endif
+				close_socket(shard->listen_sock);
+			}
+		}
+
+		for (auto& shard : shards_) {
+			if (shard->accept_thread.joinable()) {
+				shard->accept_thread.join();
+			}
+			shard->listen_sock = invalid_socket;
+			for (auto& loop : shard->loops) {
+				loop->stop();
+			}
 		}
+	}
 
-		if (accept_thread_.joinable()) {
-			accept_thread_.join();
+	TcpServer::PoolStats TcpServer::pool_stats() const {
+		PoolStats stats;
+		for (const auto& shard : shards_) {
+			stats.threads += shard->pool->thread_count();
+			stats.queued += shard->pool->queued();
+			stats.rejected += shard->pool->rejected();
 		}
+		return stats;
 	}
 
-	void TcpServer::accept_loop() {
+	void TcpServer::accept_loop(Shard& shard) {
 		while (running_) {
 			sockaddr_storage client_addr{};
 			socklen_t addr_len = sizeof(client_addr);
 
-			socket_t client_sock = ::accept(listen_sock_,
+			socket_t client_sock = ::accept(shard.listen_sock,
 				reinterpret_cast<sockaddr*>(&client_addr),
 				&addr_len);
 			if (client_sock == invalid_socket) {
@@ -346,8 +1151,19 @@ namespace net {
 			}
 
 			auto conn = std::make_shared<TcpConnection>(client_sock, client_addr, addr_len);
+			conn->pool_ = shard.pool.get();
+
+			if (io_model_ == IoModel::Reactor) {
+				if (!set_non_blocking(client_sock, true)) {
+					conn->close();
+					continue;
+				}
+				shard.loops[shard.next_loop]->add(std::move(conn));
+				shard.next_loop = (shard.next_loop + 1) % shard.loops.size();
+				continue;
+			}
 
-			bool ok = pool_.try_enqueue([this, conn]() {
+			bool ok = shard.pool->try_enqueue([this, conn]() {
 				handler_(conn);
 				conn->close();
 				});
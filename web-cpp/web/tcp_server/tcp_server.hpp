@@ -1,16 +1,22 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <condition_variable>
 #include <cstddef>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #ifdef _WIN32
@@ -21,11 +27,19 @@
 #else
 #  include <arpa/inet.h>
 #  include <errno.h>
+#  include <fcntl.h>
 #  include <netdb.h>
 #  include <netinet/in.h>
 #  include <sys/socket.h>
 #  include <sys/types.h>
+#  include <sys/uio.h>
 #  include <unistd.h>
+#  ifdef __linux__
+#    include <sys/epoll.h>
+#    include <sys/eventfd.h>
+#  else
+#    include <poll.h>
+#  endif
 #endif
 
 namespace net {
@@ -48,6 +62,48 @@ namespace net {
 	}
 #endif
 
+	// Blocking: one pool job per connection for its whole keep-alive lifetime.
+	// Reactor: non-blocking sockets multiplexed over a few event loops; the
+	// pool only sees work once the upper layer has a complete request.
+	enum class IoModel {
+		Blocking,
+		Reactor
+	};
+
+	bool set_non_blocking(socket_t s, bool enabled);
+
+	// Best effort; returns false where affinity is not supported.
+	bool pin_thread(std::thread& t, int first_cpu, int count);
+
+	// One element of a scatter-gather write.
+	struct IoSlice {
+		const char* data;
+		std::size_t size;
+	};
+
+	// One buffer of an outgoing write: bytes handed over to the connection,
+	// or bytes of a shared immutable buffer, which are never copied and
+	// stay valid while `shared` keeps their owner alive.
+	struct SendBuffer {
+		SendBuffer() = default;
+		SendBuffer(std::string bytes) : owned(std::move(bytes)) {}
+		SendBuffer(std::shared_ptr<const void> owner, std::string_view bytes)
+			: shared(std::move(owner)), shared_bytes(bytes) {}
+		SendBuffer(const std::shared_ptr<const std::string>& buffer)
+			: shared(buffer), shared_bytes(*buffer) {}
+
+		const char* data() const { return shared ? shared_bytes.data() : owned.data(); }
+		std::size_t size() const { return shared ? shared_bytes.size() : owned.size(); }
+		bool empty() const { return size() == 0; }
+		std::string_view view() const { return { data(), size() }; }
+
+		std::string owned;
+		std::shared_ptr<const void> shared;
+		std::string_view shared_bytes;
+	};
+
+	class EventLoop;
+
 	class NetInitializer {
 	public:
 		NetInitializer();
@@ -58,28 +114,251 @@ namespace net {
 	};
 
 
+	// Move-only type-erased callable for pool jobs. Callables up to
+	// inline_size bytes (a lambda capturing a pointer and a shared_ptr, say)
+	// live inside the Job; larger ones are boxed on the heap.
+	class Job {
+	public:
+		static constexpr std::size_t inline_size = 48;
+
+		Job() noexcept = default;
+
+		template <typename F,
+			typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Job>>>
+		Job(F&& f) {
+			using Fn = std::decay_t<F>;
+			if constexpr (fits_inline<Fn>()) {
+				::new (static_cast<void*>(storage_)) Fn(std::forward<F>(f));
+				ops_ = &inline_ops<Fn>;
+			}
+			else {
+				::new (static_cast<void*>(storage_)) Fn*(new Fn(std::forward<F>(f)));
+				ops_ = &boxed_ops<Fn>;
+			}
+		}
+
+		Job(Job&& other) noexcept { take(other); }
+
+		Job& operator=(Job&& other) noexcept {
+			if (this != &other) {
+				reset();
+				take(other);
+			}
+			return *this;
+		}
+
+		Job(const Job&) = delete;
+		Job& operator=(const Job&) = delete;
+
+		~Job() { reset(); }
+
+		explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+		void operator()() { ops_->invoke(storage_); }
+
+	private:
+		struct Ops {
+			void (*invoke)(void* self);
+			void (*move)(void* dst, void* src) noexcept; // destroys src
+			void (*destroy)(void* self) noexcept;
+		};
+
+		template <typename Fn>
+		static constexpr bool fits_inline() {
+			return sizeof(Fn) <= inline_size
+				&& alignof(Fn) <= alignof(std::max_align_t)
+				&& std::is_nothrow_move_constructible_v<Fn>;
+		}
+
+		template <typename Fn>
+		static constexpr Ops inline_ops = {
+			[](void* self) { (*static_cast<Fn*>(self))(); },
+			[](void* dst, void* src) noexcept {
+				::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+				static_cast<Fn*>(src)->~Fn();
+			},
+			[](void* self) noexcept { static_cast<Fn*>(self)->~Fn(); }
+		};
+
+		template <typename Fn>
+		static constexpr Ops boxed_ops = {
+			[](void* self) { (**static_cast<Fn**>(self))(); },
+			[](void* dst, void* src) noexcept { ::new (dst) Fn*(*static_cast<Fn**>(src)); },
+			[](void* self) noexcept { delete *static_cast<Fn**>(self); }
+		};
+
+		void take(Job& other) noexcept {
+			if (other.ops_) {
+				other.ops_->move(storage_, other.storage_);
+				ops_ = other.ops_;
+				other.ops_ = nullptr;
+			}
+		}
+
+		void reset() noexcept {
+			if (ops_) {
+				ops_->destroy(storage_);
+				ops_ = nullptr;
+			}
+		}
+
+		alignas(std::max_align_t) unsigned char storage_[inline_size];
+		const Ops* ops_ = nullptr;
+	};
+
+	// Bounded lock-free multi-producer/multi-consumer ring (Vyukov's
+	// sequence-numbered cells). Capacity is rounded up to a power of two.
+	// try_push moves from the value only when it succeeds.
+	template <typename T>
+	class MpmcRing {
+	public:
+		explicit MpmcRing(std::size_t capacity) {
+			std::size_t n = 2;
+			while (n < capacity) n <<= 1;
+			cells_.reset(new Cell[n]);
+			mask_ = n - 1;
+			for (std::size_t i = 0; i < n; ++i) {
+				cells_[i].seq.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		MpmcRing(const MpmcRing&) = delete;
+		MpmcRing& operator=(const MpmcRing&) = delete;
+
+		bool try_push(T& value) {
+			std::size_t pos = tail_.load(std::memory_order_relaxed);
+			while (true) {
+				Cell& cell = cells_[pos & mask_];
+				std::size_t seq = cell.seq.load(std::memory_order_acquire);
+				auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+				if (diff == 0) {
+					if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+						cell.value = std::move(value);
+						cell.seq.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0) {
+					return false; // full
+				}
+				else {
+					pos = tail_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool try_pop(T& out) {
+			std::size_t pos = head_.load(std::memory_order_relaxed);
+			while (true) {
+				Cell& cell = cells_[pos & mask_];
+				std::size_t seq = cell.seq.load(std::memory_order_acquire);
+				auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+				if (diff == 0) {
+					if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+						out = std::move(cell.value);
+						cell.value = T();
+						cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0) {
+					return false; // empty, or the producer has not published yet
+				}
+				else {
+					pos = head_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Claimed pushes minus claimed pops; exact only when quiescent.
+		std::size_t size_approx() const {
+			std::size_t tail = tail_.load(std::memory_order_seq_cst);
+			std::size_t head = head_.load(std::memory_order_seq_cst);
+			return tail > head ? tail - head : 0;
+		}
+
+		std::size_t capacity() const { return mask_ + 1; }
+
+	private:
+		struct alignas(64) Cell {
+			std::atomic<std::size_t> seq{ 0 };
+			T value;
+		};
+
+		std::unique_ptr<Cell[]> cells_;
+		std::size_t mask_ = 0;
+		alignas(64) std::atomic<std::size_t> tail_{ 0 };
+		alignas(64) std::atomic<std::size_t> head_{ 0 };
+	};
+
+	// Shared: every job goes through one lock-free ring.
+	// WorkStealing: jobs submitted from a worker of the pool go to that
+	// worker's own deque (run newest first, while still hot in cache) and
+	// idle workers steal the oldest ones; jobs from other threads still go
+	// through the ring.
+	enum class PoolMode {
+		Shared,
+		WorkStealing
+	};
+
 	class ThreadPool {
 	public:
-		ThreadPool(std::size_t thread_count, std::size_t max_queue_size = 1024);
+		// The ring holds at least max_queue_size jobs; in WorkStealing mode
+		// each worker's deque holds up to max_queue_size more.
+		ThreadPool(std::size_t thread_count,
+			std::size_t max_queue_size = 1024,
+			PoolMode mode = PoolMode::Shared);
 		~ThreadPool();
 
 		ThreadPool(const ThreadPool&) = delete;
 		ThreadPool& operator=(const ThreadPool&) = delete;
 
-		bool try_enqueue(std::function<void()> job);
+		// Never blocks: false when the queue is full or the pool stopping.
+		bool try_enqueue(Job job);
 
-		void enqueue(std::function<void()> job);
+		// Waits for room.
+		void enqueue(Job job);
 
-	private:
-		void worker_loop();
+		// Restricts every worker to CPUs [first_cpu, first_cpu + count).
+		void pin_workers(int first_cpu, int count);
+
+		PoolMode mode() const { return mode_; }
+
+		std::size_t thread_count() const { return workers_.size(); }
 
+		// Jobs waiting to run; approximate while the pool is busy.
+		std::size_t queued() const;
+
+		// try_enqueue calls refused so far.
+		std::uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+	private:
+		struct Worker {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		bool push(Job& job);
+		bool pop(std::size_t self, Job& job);
+		bool has_work();
+		void wake_worker();
+		void worker_loop(std::size_t index);
+
+		PoolMode mode_;
+		std::size_t max_queue_size_;
+		MpmcRing<Job> ring_;
+		std::vector<std::unique_ptr<Worker>> locals_; // WorkStealing only
 		std::vector<std::thread> workers_;
-		std::queue<std::function<void()>> jobs_;
-		std::mutex mutex_;
+
+		// Idle workers park here; producers only take the mutex when
+		// someone is parked.
+		std::mutex park_mutex_;
 		std::condition_variable cv_jobs_;
 		std::condition_variable cv_space_;
-		std::size_t max_queue_size_;
-		bool stop_ = false;
+		std::atomic<std::size_t> sleepers_{ 0 };
+		std::atomic<std::size_t> space_waiters_{ 0 };
+		std::atomic<bool> stop_{ false };
+		std::atomic<std::uint64_t> rejected_{ 0 };
 	};
 
 
@@ -94,6 +373,9 @@ namespace net {
 
 		std::size_t send(const void* data, std::size_t size);
 
+		// Blocking scatter-gather send (sendmsg/WSASend); returns bytes sent.
+		std::size_t send(const IoSlice* slices, std::size_t count);
+
 		std::size_t recv(void* buffer, std::size_t size);
 
 		void close();
@@ -105,13 +387,126 @@ namespace net {
 
 		void set_timeout_ms(int ms);
 
+		// Reactor mode only. Queues data behind anything not yet flushed and
+		// writes as much as the socket takes right now; the owning loop
+		// finishes the rest. Safe to call from any thread.
+		bool async_send(std::string data, bool close_after_flush = false);
+
+		// Queues several buffers at once; they leave in one vectored write
+		// when the socket has room.
+		bool async_send(std::vector<std::string> parts, bool close_after_flush = false);
+		bool async_send(std::vector<SendBuffer> parts, bool close_after_flush = false);
+
+		// A buffer from an earlier async_send that has been fully written,
+		// cleared but with its capacity; empty if none is kept.
+		std::string take_spare_buffer();
+
+		// Reactor mode only: closes through the owning loop so it can drop
+		// the socket from its poll set first. Falls back to close().
+		void close_async();
+
+		// Per-connection state of the protocol layer (HTTP parser etc.).
+		void set_context(std::shared_ptr<void> ctx) { context_ = std::move(ctx); }
+
+		template <typename T>
+		T* context() const { return static_cast<T*>(context_.get()); }
+
+		// Worker pool of the listener shard that accepted this connection.
+		ThreadPool* pool() const { return pool_; }
+
+		// A busy connection has a request in flight and is skipped by the
+		// loop's idle sweep, however long the handler takes.
+		void set_busy(bool busy) { busy_.store(busy, std::memory_order_relaxed); }
+
 	private:
 		friend class TcpServer;
+		friend class EventLoop;
+
+		// Flushes out_queue_ without blocking. Caller holds socket_mutex_.
+		// Returns false on a hard socket error.
+		bool flush_unlocked();
+
+		bool enqueue_and_flush(std::vector<SendBuffer>& parts, bool close_after_flush);
 
 		socket_t sock_ = invalid_socket;
 		sockaddr_storage remote_addr_{};
 		socklen_t remote_addr_len_ = 0;
 		mutable std::mutex socket_mutex_;
+
+		EventLoop* loop_ = nullptr;
+		ThreadPool* pool_ = nullptr;
+		std::deque<SendBuffer> out_queue_;
+		std::size_t out_off_ = 0; // into out_queue_.front()
+		std::vector<std::string> spare_; // sent buffers kept for reuse
+		bool close_after_flush_ = false;
+		bool want_write_ = false;
+		bool watching_write_ = false; // loop thread only
+		std::atomic<bool> busy_{ false };
+		std::atomic<std::int64_t> last_active_ms_{ 0 };
+		std::shared_ptr<void> context_;
+	};
+
+
+	class EventLoop {
+	public:
+		using DataHandler = std::function<void(const std::shared_ptr<TcpConnection>&, const char*, std::size_t)>;
+		using CloseHandler = std::function<void(const std::shared_ptr<TcpConnection>&)>;
+
+		EventLoop(DataHandler on_data, CloseHandler on_close, int idle_timeout_ms);
+		~EventLoop();
+
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator=(const EventLoop&) = delete;
+
+		void start();
+		void stop();
+
+		// All three are thread-safe; the loop thread applies them.
+		void add(std::shared_ptr<TcpConnection> conn);
+		void request_write(std::shared_ptr<TcpConnection> conn);
+		void request_close(std::shared_ptr<TcpConnection> conn);
+
+		std::size_t connection_count() const { return conn_count_.load(std::memory_order_relaxed); }
+
+		// Call after start().
+		void pin_to_cpu(int cpu);
+
+	private:
+		void run();
+		void wakeup();
+		void drain_wakeup();
+		void apply_pending();
+		void handle_readable(const std::shared_ptr<TcpConnection>& conn);
+		void handle_writable(const std::shared_ptr<TcpConnection>& conn);
+		void remove(const std::shared_ptr<TcpConnection>& conn);
+		void watch(const std::shared_ptr<TcpConnection>& conn, bool want_write);
+		void sweep_idle();
+
+		DataHandler on_data_;
+		CloseHandler on_close_;
+		int idle_timeout_ms_;
+
+		std::thread thread_;
+		std::atomic<bool> running_{ false };
+
+		// Owned by the loop thread.
+		std::unordered_map<socket_t, std::shared_ptr<TcpConnection>> conns_;
+		std::vector<char> read_buf_;
+		std::atomic<std::size_t> conn_count_{ 0 };
+
+		std::mutex pending_mutex_;
+		std::vector<std::shared_ptr<TcpConnection>> pending_add_;
+		std::vector<std::shared_ptr<TcpConnection>> pending_write_;
+		std::vector<std::shared_ptr<TcpConnection>> pending_close_;
+
+#if defined(_WIN32) || !defined(__linux__)
+		// WSAPoll/poll have no eventfd; a UDP socket connected to itself
+		// serves as the wakeup channel instead.
+		socket_t wake_sock_ = invalid_socket;
+#else
+		int epoll_fd_ = -1;
+		int wake_fd_ = -1;
+#endif
 	};
 
 
@@ -130,23 +525,78 @@ namespace net {
 		TcpServer(const TcpServer&) = delete;
 		TcpServer& operator=(const TcpServer&) = delete;
 
+		// Switches the server to IoModel::Reactor. Must be called before
+		// start(); the ConnectionHandler is then unused.
+		void enable_reactor(std::size_t loop_count,
+			EventLoop::DataHandler on_data,
+			EventLoop::CloseHandler on_close,
+			int idle_timeout_ms);
+
+		// Splits the server into shard_count independent listener shards,
+		// each with its own acceptor thread, worker pool and (in reactor
+		// mode) event loops. Where SO_REUSEPORT exists every shard gets its
+		// own listening socket and the kernel balances between them;
+		// otherwise the acceptors share one socket. With pin_to_cores each
+		// shard's threads are bound to its own slice of the CPUs.
+		// Must be called before start().
+		void enable_sharding(std::size_t shard_count, bool pin_to_cores);
+
+		// Queueing strategy of the worker pools. Must be called before start().
+		void set_pool_mode(PoolMode mode);
+
 		void start();
 		void stop();
 
 		bool is_running() const;
 
+		IoModel io_model() const { return io_model_; }
+
+		std::size_t shard_count() const { return shard_count_; }
+
+		struct PoolStats {
+			std::size_t threads = 0;
+			std::size_t queued = 0;
+			std::uint64_t rejected = 0;
+		};
+
+		// Summed over the shards' worker pools; zeros before start().
+		PoolStats pool_stats() const;
+
 	private:
-		void accept_loop();
+		struct Shard {
+			socket_t listen_sock = invalid_socket;
+			bool owns_socket = true;
+			std::thread accept_thread;
+			std::unique_ptr<ThreadPool> pool;
+			std::vector<std::unique_ptr<EventLoop>> loops;
+			std::size_t next_loop = 0;
+			int first_cpu = -1;
+			int cpu_count = 0;
+		};
+
+		socket_t open_listener(bool reuse_port) const;
+		void build_shards();
+		void accept_loop(Shard& shard);
 
 		NetInitializer net_init_;
 		std::string bind_address_;
 		std::uint16_t port_;
 		ConnectionHandler handler_;
 
-		socket_t listen_sock_ = invalid_socket;
 		std::atomic<bool> running_{ false };
-		std::thread accept_thread_;
-		ThreadPool pool_;
+		std::size_t thread_count_;
+		std::size_t max_queue_size_;
+		PoolMode pool_mode_ = PoolMode::Shared;
+
+		std::size_t shard_count_ = 1;
+		bool pin_to_cores_ = false;
+		std::vector<std::unique_ptr<Shard>> shards_;
+
+		IoModel io_model_ = IoModel::Blocking;
+		std::size_t loop_count_ = 1;
+		EventLoop::DataHandler on_data_;
+		EventLoop::CloseHandler on_close_;
+		int idle_timeout_ms_ = 0;
 	};
 
 }